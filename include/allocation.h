@@ -0,0 +1,232 @@
+#ifndef EXPR_TEMPLATE_ALLOCATION_H
+#define EXPR_TEMPLATE_ALLOCATION_H
+
+#include <parallel.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace expr
+{
+
+/***************************************************************************//**
+* Huge page backing of large arrays: none, transparent huge pages
+* (madvise(MADV_HUGEPAGE) on a 2 MiB aligned mapping) or explicit huge pages
+* (mmap(MAP_HUGETLB), falling back to transparent ones when no huge pages are
+* reserved).
+ ******************************************************************************/
+enum class huge_pages {none, transparent, explicit_pages};
+
+/***************************************************************************//**
+* MemoryPolicy controls how the heap storage of arrays of at least
+* large_array_bytes bytes is allocated and initialized. With first_touch the
+* elements are initialized (and copied) in parallel with the same parallel_for
+* partitioning as the evaluators, so on NUMA machines each page is placed on
+* the node of the thread that first writes it instead of all pages landing on
+* the node of the constructing thread. interleave spreads the pages round robin
+* over all NUMA nodes instead, which balances the memory controllers
+* regardless of which threads later access the array. The policy applies to
+* arrays allocated after it is changed; change it before starting any
+* parallel work. Only Linux supports huge pages and interleaving.
+ ******************************************************************************/
+struct MemoryPolicy
+{
+        std::size_t large_array_bytes = std::size_t(1) << 21;
+        bool first_touch = true;
+        bool interleave = false;
+        huge_pages pages = huge_pages::transparent;
+};
+
+/***************************************************************************//**
+* The process wide MemoryPolicy. It is read without synchronization by every
+* allocation, so it must not be changed while other threads may allocate
+* arrays (including the pool threads of an asynchronous evaluation).
+ ******************************************************************************/
+inline MemoryPolicy& memory_policy() noexcept
+{
+        static MemoryPolicy policy;
+        return policy;
+}
+
+namespace detail
+{
+        inline constexpr std::size_t huge_page_size = std::size_t(1) << 21;
+        // Elements initialized per parallel_for chunk at least, a few pages
+        inline constexpr std::size_t first_touch_grain_bytes = std::size_t(1) << 16;
+
+        // Memory of a large array, mapping is the region to unmap (if mapped)
+        struct Allocation
+        {
+                void* ptr = nullptr;
+                void* mapping = nullptr;
+                std::size_t mapping_bytes = 0;
+        };
+
+#if defined(__linux__)
+        inline void interleave_pages(void* ptr, std::size_t bytes) noexcept
+        {
+                // MPOL_INTERLEAVE over all nodes, the kernel drops nodes that
+                // do not exist. Best effort, the default policy is kept on failure.
+                constexpr int mpol_interleave = 3;
+                const unsigned long nodes = ~0ul;
+                (void) syscall(SYS_mbind, ptr, bytes, mpol_interleave, &nodes, 8*sizeof(nodes) + 1, 0u);
+        }
+
+        inline Allocation map_pages(std::size_t bytes, const MemoryPolicy& policy) noexcept
+        {
+                Allocation res;
+                if(policy.pages == huge_pages::explicit_pages){
+                        const std::size_t rounded = (bytes + huge_page_size - 1)/huge_page_size*huge_page_size;
+                        void* p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                        if(p != MAP_FAILED){
+                                res = {p, p, rounded};
+                        }
+                }
+                if(!res.ptr){
+                        // Over allocate to place the array on a huge page boundary
+                        const std::size_t padded = policy.pages == huge_pages::none ? bytes : bytes + huge_page_size;
+                        void* p = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                        if(p == MAP_FAILED){
+                                return res;
+                        }
+                        res = {p, p, padded};
+                        if(policy.pages != huge_pages::none){
+                                const auto addr = reinterpret_cast<std::uintptr_t>(p);
+                                res.ptr = reinterpret_cast<void*>((addr + huge_page_size - 1)/huge_page_size*huge_page_size);
+                                madvise(res.ptr, bytes, MADV_HUGEPAGE);
+                        }
+                }
+                if(policy.interleave){
+                        interleave_pages(res.ptr, bytes);
+                }
+                return res;
+        }
+#endif
+
+        // Memory for bytes bytes, aligned for T, mapped directly for large arrays
+        template<typename T>
+        inline Allocation allocate_bytes(std::size_t bytes)
+        {
+#if defined(__linux__)
+                const MemoryPolicy& policy = memory_policy();
+                if(bytes >= policy.large_array_bytes && bytes > 0){
+                        const Allocation res = map_pages(bytes, policy);
+                        if(res.ptr){
+                                return res;
+                        }
+                }
+#endif
+                return {::operator new(bytes, std::align_val_t{alignof(T)}), nullptr, 0};
+        }
+
+        template<typename T>
+        inline void deallocate_bytes(const Allocation& allocation) noexcept
+        {
+#if defined(__linux__)
+                if(allocation.mapping){
+                        munmap(allocation.mapping, allocation.mapping_bytes);
+                        return;
+                }
+#endif
+                ::operator delete(allocation.ptr, std::align_val_t{alignof(T)});
+        }
+
+/***************************************************************************//**
+* Heap storage of the Matrix and MDArray leaves, a fixed size array of
+* elements allocated according to memory_policy(). Large arrays are mapped
+* directly (optionally on huge pages and interleaved over the NUMA nodes) and
+* initialized and copied in parallel for first touch placement.
+ ******************************************************************************/
+template<typename T>
+class heap_storage
+{
+    public:
+        using value_type = T;
+
+        heap_storage() noexcept = default;
+
+        heap_storage(std::size_t size, const T& val)
+         : m_allocation(allocate_bytes<T>(size*sizeof(T))), m_size(size)
+        {
+                initialize([&](T* first, std::size_t n){ std::uninitialized_fill_n(first, n, val); });
+        }
+
+        heap_storage(const heap_storage& other)
+         : m_allocation(allocate_bytes<T>(other.m_size*sizeof(T))), m_size(other.m_size)
+        {
+                const T* source = other.data();
+                initialize([&](T* first, std::size_t n){ std::uninitialized_copy_n(source + (first - data()), n, first); });
+        }
+
+        heap_storage(heap_storage&& other) noexcept
+         : m_allocation(std::exchange(other.m_allocation, Allocation{})), m_size(std::exchange(other.m_size, 0))
+        {}
+
+        heap_storage& operator=(heap_storage other) noexcept
+        {
+                std::swap(m_allocation, other.m_allocation);
+                std::swap(m_size, other.m_size);
+                return *this;
+        }
+
+        ~heap_storage() noexcept
+        {
+                if(m_allocation.ptr){
+                        std::destroy_n(data(), m_size);
+                        deallocate_bytes<T>(m_allocation);
+                }
+        }
+
+        T* data() noexcept {return static_cast<T*>(m_allocation.ptr);}
+        const T* data() const noexcept {return static_cast<const T*>(m_allocation.ptr);}
+        std::size_t size() const noexcept {return m_size;}
+
+        T& operator[](std::size_t n) noexcept {return data()[n];}
+        const T& operator[](std::size_t n) const noexcept {return data()[n];}
+
+        T* begin() noexcept {return data();}
+        T* end() noexcept {return data() + m_size;}
+        const T* begin() const noexcept {return data();}
+        const T* end() const noexcept {return data() + m_size;}
+
+    private:
+        Allocation m_allocation{};
+        std::size_t m_size = 0;
+
+        // Construct the elements with init(first, n), in parallel for large arrays
+        template<typename Init>
+        void initialize(Init&& init)
+        {
+                const MemoryPolicy& policy = memory_policy();
+                if constexpr(std::is_nothrow_copy_constructible_v<T>){
+                        if(policy.first_touch && m_size*sizeof(T) >= policy.large_array_bytes){
+                                const std::size_t grain = std::max<std::size_t>(1, first_touch_grain_bytes/sizeof(T));
+                                parallel_for(std::size_t(0), m_size, grain, [&](std::size_t begin, std::size_t end){
+                                        init(data() + begin, end - begin);
+                                });
+                                return;
+                        }
+                }
+                try{
+                        init(data(), m_size);
+                }catch(...){
+                        deallocate_bytes<T>(m_allocation);
+                        throw;
+                }
+        }
+};
+
+}; // detail
+
+}; // expr
+#endif // EXPR_TEMPLATE_ALLOCATION_H
@@ -0,0 +1,413 @@
+#ifndef EXPR_TEMPLATE_ASYNC_H
+#define EXPR_TEMPLATE_ASYNC_H
+
+#include <base_expression.h>
+#include <scalar_reduce_operators.h>
+#include <parallel.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace expr
+{
+
+namespace detail
+{
+        // Result of an asynchronous evaluation and the continuations waiting for it
+        template<typename T>
+        struct AsyncState
+        {
+                std::mutex mutex{};
+                bool done = false;
+                std::promise<T> promise{};
+                std::shared_future<T> future = promise.get_future().share();
+                std::vector<std::function<void()>> continuations{};
+
+                template<typename Compute>
+                void complete(Compute&& compute) noexcept
+                {
+                        try{
+                                if constexpr(std::is_void_v<T>){
+                                        compute();
+                                        promise.set_value();
+                                }else{
+                                        promise.set_value(compute());
+                                }
+                        }catch(...){
+                                promise.set_exception(std::current_exception());
+                        }
+                        std::vector<std::function<void()>> waiting;
+                        {
+                                std::lock_guard<std::mutex> lock(mutex);
+                                done = true;
+                                waiting.swap(continuations);
+                        }
+                        for(auto& continuation : waiting){
+                                continuation();
+                        }
+                }
+
+                // Run continuation once the result is available (immediately if it is)
+                void then(std::function<void()> continuation)
+                {
+                        {
+                                std::lock_guard<std::mutex> lock(mutex);
+                                if(!done){
+                                        continuations.push_back(std::move(continuation));
+                                        return;
+                                }
+                        }
+                        continuation();
+                }
+        };
+
+        // Run task on the default thread pool, or directly without worker threads
+        inline void run_async(std::function<void()> task)
+        {
+                ThreadPool& pool = default_thread_pool();
+                if(pool.size() == 0){
+                        task();
+                }else{
+                        pool.submit(std::move(task));
+                }
+        }
+}; // detail
+
+/***************************************************************************//**
+* AsyncResult is the handle of an evaluation running on the library's thread
+* pool. The result is available through get() (blocking), a std::shared_future
+* (future()) or by co_await-ing the handle from a C++20 coroutine, which is
+* then resumed on the pool thread that completed the evaluation. Exceptions
+* thrown by the evaluation are rethrown by get() and co_await.
+ ******************************************************************************/
+template<typename T>
+class AsyncResult
+{
+    public:
+        using value_type = T;
+
+        explicit AsyncResult(std::shared_ptr<detail::AsyncState<T>> state) noexcept
+         : m_state(std::move(state))
+        {}
+
+        T get() const
+        {
+                if constexpr(std::is_void_v<T>){
+                        m_state->future.get();
+                }else{
+                        return m_state->future.get();
+                }
+        }
+        void wait() const {m_state->future.wait();}
+        bool ready() const {return m_state->future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;}
+        std::shared_future<T> future() const {return m_state->future;}
+
+        // Calls continuation() once the evaluation has finished
+        void then(std::function<void()> continuation) const {m_state->then(std::move(continuation));}
+
+        bool await_ready() const {return ready();}
+        void await_suspend(std::coroutine_handle<> handle) const {then([handle](){ handle.resume(); });}
+        T await_resume() const {return get();}
+
+    private:
+        std::shared_ptr<detail::AsyncState<T>> m_state;
+};
+
+namespace detail
+{
+        // Run compute() on the pool, returning the handle of its result
+        template<typename T, typename Compute>
+        AsyncResult<T> launch(Compute&& compute)
+        {
+                auto state = std::make_shared<AsyncState<T>>();
+                run_async([state, compute = std::forward<Compute>(compute)]() mutable {
+                        state->complete(compute);
+                });
+                return AsyncResult<T>(std::move(state));
+        }
+
+        // Throws on the calling thread, before any task writes out of bounds
+        template<typename Destination, typename Expr>
+        void check_destination(const Destination& destination, const Expr& expr)
+        {
+                if (expr.extents().rank() != destination.extents().rank()){
+                        throw std::runtime_error("Rank of assigned expression does not match rank of destination!\n" + std::to_string(expr.extents().rank()) + " != " + std::to_string(destination.extents().rank()));
+                }
+                for (std::size_t i = 0; i < destination.extents().rank(); i++){
+                        if (static_cast<std::size_t>(expr.extent(i)) != static_cast<std::size_t>(destination.extent(i))){
+                                throw std::runtime_error("Dimensions do not match!\nDimension " + std::to_string(i) + ": " + std::to_string(expr.extent(i)) + " != " + std::to_string(destination.extent(i)));
+                        }
+                }
+        }
+
+        // Expression evaluated by a task: temporaries are moved into the task,
+        // lvalues (e.g. a whole MDArray) are referred to
+        template<typename Expr>
+        auto hold(Expr&& expr)
+        {
+                if constexpr(std::is_lvalue_reference_v<Expr>){
+                        return std::addressof(expr);
+                }else{
+                        return std::make_shared<std::remove_cvref_t<Expr>>(std::move(expr));
+                }
+        }
+
+        // Bytes [begin, end) of memory written or read by an assignment
+        struct MemoryRange
+        {
+                std::uintptr_t begin;
+                std::uintptr_t end;
+
+                bool overlaps(const MemoryRange& other) const noexcept {return begin < other.end && other.begin < end;}
+        };
+
+        template<typename T>
+        MemoryRange memory_range(const T* first, std::size_t size) noexcept
+        {
+                const auto begin = reinterpret_cast<std::uintptr_t>(first);
+                return {begin, begin + size*sizeof(T)};
+        }
+
+        // Memory referred to by the leaves of expr (or a destination): the
+        // elements of arrays and views, found from data() (or data_handle())
+        // and the mapping, or data() with flat row major access, and the
+        // object itself for other leaves, which own their elements (e.g.
+        // sparse matrices)
+        template<typename Expr>
+        void memory_ranges(const Expr& expr, std::vector<MemoryRange>& ranges)
+        {
+                if constexpr(requires{ expr.data_handle(); expr.mapping().required_span_size(); }){
+                        ranges.push_back(memory_range(expr.data_handle(), static_cast<std::size_t>(expr.mapping().required_span_size())));
+                }else if constexpr(requires{ expr.data(); expr.mapping().required_span_size(); }){
+                        ranges.push_back(memory_range(expr.data(), static_cast<std::size_t>(expr.mapping().required_span_size())));
+                }else if constexpr(exts::has_flat_access<const Expr&> && requires{ expr.data(); }){
+                        ranges.push_back(memory_range(expr.data(), exts::ext_size(expr.extents())));
+                }else if constexpr(has_operands<Expr>){
+                        std::apply([&](const auto&... operands){ (memory_ranges(operands, ranges), ...); }, expr.operands());
+                }else{
+                        ranges.push_back(memory_range(std::addressof(expr), 1));
+                }
+        }
+
+        template<typename Expr>
+        std::vector<MemoryRange> memory_ranges(const Expr& expr)
+        {
+                std::vector<MemoryRange> ranges;
+                memory_ranges(expr, ranges);
+                return ranges;
+        }
+}; // detail
+
+/***************************************************************************//**
+* Evaluate expr into destination on the library's thread pool. A temporary
+* expression is moved into the task, an lvalue expression (e.g. a whole
+* MDArray) is referred to. It, the leaves it refers to and destination must
+* stay alive and unmodified until the evaluation has finished. Mismatching
+* extents throw std::runtime_error here, before the evaluation is started.
+ ******************************************************************************/
+template<typename Destination, expression Expr>
+inline AsyncResult<void> async_assign(Destination& destination, Expr&& expr)
+{
+        auto e = detail::hold(std::forward<Expr>(expr));
+        detail::check_destination(destination, *e);
+        return detail::launch<void>([&destination, e](){
+                exts::assign_each_index(*e, destination);
+        });
+}
+
+/***************************************************************************//**
+* Evaluate a reduction (e.g. expr::sum(a), expr::reduce(a, op, init)) on the
+* library's thread pool.
+ ******************************************************************************/
+template<typename Reduction>
+requires requires(const std::remove_cvref_t<Reduction>& r){ static_cast<typename std::remove_cvref_t<Reduction>::value_type>(r); }
+inline auto async_reduce(Reduction&& reduction)
+{
+        using value_type = typename std::remove_cvref_t<Reduction>::value_type;
+        auto r = std::make_shared<std::remove_cvref_t<Reduction>>(std::forward<Reduction>(reduction));
+        return detail::launch<value_type>([r](){
+                return static_cast<value_type>(*r);
+        });
+}
+
+template<expression Expr, typename REDUCE_OP>
+inline auto async_reduce(Expr&& expr, REDUCE_OP&& op, reduce_return_type<Expr, REDUCE_OP>&& acc_init = 0)
+{
+        return async_reduce(reduce(std::forward<Expr>(expr), std::forward<REDUCE_OP>(op), std::move(acc_init)));
+}
+
+/***************************************************************************//**
+* Assignment is a deferred evaluation of an expression into a destination,
+* created by expr::assignment(destination, expr) and started by when_all. It
+* records the memory it writes (the destination) and reads (the leaves of the
+* expression), see when_all. The expression is held as by async_assign.
+* Mismatching extents throw std::runtime_error when the assignment is created.
+ ******************************************************************************/
+class Assignment
+{
+    public:
+        Assignment(std::vector<detail::MemoryRange> writes, std::vector<detail::MemoryRange> reads, std::function<void()> run)
+         : m_writes(std::move(writes)), m_reads(std::move(reads)), m_run(std::move(run))
+        {}
+
+        Assignment(const Assignment&) = default;
+        Assignment(Assignment&&) noexcept = default;
+        ~Assignment() noexcept = default;
+
+        Assignment& operator=(const Assignment&) = default;
+        Assignment& operator=(Assignment&&) noexcept = default;
+
+        // Whether this and other may not run concurrently: one writes memory the other reads or writes
+        bool conflicts(const Assignment& other) const noexcept
+        {
+                return overlap(m_writes, other.m_writes) || overlap(m_writes, other.m_reads) || overlap(m_reads, other.m_writes);
+        }
+        void operator()() const {m_run();}
+
+    private:
+        std::vector<detail::MemoryRange> m_writes;
+        std::vector<detail::MemoryRange> m_reads;
+        std::function<void()> m_run;
+
+        static bool overlap(const std::vector<detail::MemoryRange>& lhs, const std::vector<detail::MemoryRange>& rhs) noexcept
+        {
+                return std::ranges::any_of(lhs, [&](const auto& l){
+                        return std::ranges::any_of(rhs, [&](const auto& r){ return l.overlaps(r); });
+                });
+        }
+};
+
+template<typename Destination, expression Expr>
+inline Assignment assignment(Destination& destination, Expr&& expr)
+{
+        auto e = detail::hold(std::forward<Expr>(expr));
+        detail::check_destination(destination, *e);
+        return Assignment(detail::memory_ranges(destination), detail::memory_ranges(*e), [&destination, e](){
+                exts::assign_each_index(*e, destination);
+        });
+}
+
+/***************************************************************************//**
+* Handle completing when all the given evaluations have completed, with the
+* first exception thrown by any of them.
+ ******************************************************************************/
+template<typename... Ts>
+requires (sizeof...(Ts) > 0)
+inline AsyncResult<void> when_all(const AsyncResult<Ts>&... results)
+{
+        struct Join
+        {
+                std::atomic<std::size_t> remaining{sizeof...(Ts)};
+                std::mutex mutex{};
+                std::exception_ptr error{};
+        };
+        auto state = std::make_shared<detail::AsyncState<void>>();
+        auto join = std::make_shared<Join>();
+        auto finish = [state, join](const auto& result){
+                try{
+                        result.get();
+                }catch(...){
+                        std::lock_guard<std::mutex> lock(join->mutex);
+                        if(!join->error){
+                                join->error = std::current_exception();
+                        }
+                }
+                if(--join->remaining == 0){
+                        state->complete([&](){
+                                if(join->error){
+                                        std::rethrow_exception(join->error);
+                                }
+                        });
+                }
+        };
+        (results.then([finish, results](){ finish(results); }), ...);
+        return AsyncResult<void>(std::move(state));
+}
+
+/***************************************************************************//**
+* Run assignments on the library's thread pool, as if one after the other in
+* the order given. An assignment writing memory that an earlier one reads or
+* writes, or reading memory an earlier one writes (e.g. when_all(assignment(b,
+* a + a), assignment(c, 2*b))), runs after it, in the same task. Independent
+* assignments run concurrently.
+*
+* The memory of an assignment is that of its destination and of the leaves of
+* its expression (see has_operands): the element range of arrays and views
+* (e.g. an mdspan or a slice over the elements of an MDArray), the object
+* itself for other leaves. Strided views count as their whole range. Memory
+* only read by the function of a node (e.g. a lambda capturing an array by
+* reference, passed to expr::map) is not seen.
+ ******************************************************************************/
+template<typename... Assignments>
+requires (std::same_as<std::remove_cvref_t<Assignments>, Assignment> && ...)
+inline AsyncResult<void> when_all(Assignments&&... assignments)
+{
+        // Group conflicting assignments into chains, keeping their order
+        std::vector<Assignment> all{std::forward<Assignments>(assignments)...};
+        std::vector<std::vector<std::size_t>> chains;
+        for(std::size_t i = 0; i < all.size(); i++){
+                std::vector<std::size_t> chain;
+                std::vector<std::vector<std::size_t>> independent;
+                for(auto& other : chains){
+                        if(std::ranges::any_of(other, [&](std::size_t j){ return all[i].conflicts(all[j]); })){
+                                chain.insert(chain.end(), other.begin(), other.end());
+                        }else{
+                                independent.push_back(std::move(other));
+                        }
+                }
+                std::ranges::sort(chain);
+                chain.push_back(i);
+                independent.push_back(std::move(chain));
+                chains = std::move(independent);
+        }
+
+        std::vector<AsyncResult<void>> running;
+        running.reserve(chains.size());
+        for(const auto& chain : chains){
+                std::vector<Assignment> ordered;
+                ordered.reserve(chain.size());
+                for(std::size_t j : chain){
+                        ordered.push_back(all[j]);
+                }
+                running.push_back(detail::launch<void>([ordered = std::move(ordered)](){
+                        for(const auto& a : ordered){
+                                a();
+                        }
+                }));
+        }
+        auto state = std::make_shared<detail::AsyncState<void>>();
+        auto all = std::make_shared<std::vector<AsyncResult<void>>>(std::move(running));
+        auto remaining = std::make_shared<std::atomic<std::size_t>>(all->size());
+        if(all->empty()){
+                state->complete([](){});
+        }
+        for(const auto& result : *all){
+                result.then([state, all, remaining](){
+                        if(--*remaining == 0){
+                                state->complete([&](){
+                                        for(const auto& r : *all){
+                                                r.get();
+                                        }
+                                });
+                        }
+                });
+        }
+        return AsyncResult<void>(std::move(state));
+}
+
+}; // expr
+#endif // EXPR_TEMPLATE_ASYNC_H
@@ -65,6 +65,37 @@ namespace detail
                 {
                         return check_subscript(e, std::make_index_sequence<sizeof...(Extents)>{});
                 }
+
+        // Whether dimension lhs_dim of LHSExtents may equal dimension rhs_dim of
+        // RHSExtents, i.e. they are not both static and different
+        template<typename LHSExtents, typename RHSExtents>
+                consteval bool static_extents_compatible(std::size_t lhs_dim, std::size_t rhs_dim) noexcept
+                {
+                        const std::size_t lhs = LHSExtents::static_extent(lhs_dim);
+                        const std::size_t rhs = RHSExtents::static_extent(rhs_dim);
+                        return lhs == std::dynamic_extent || rhs == std::dynamic_extent || lhs == rhs;
+                }
+
+        // Subscript e with indices, using operator() when operator[] is unavailable
+        template<typename Expr, typename... Indices>
+                constexpr inline decltype(auto) subscript(Expr&& e, Indices... indices)
+                {
+#ifdef CLANGBUG
+                        return std::forward<Expr>(e)(indices...);
+#else
+                        return std::forward<Expr>(e)[indices...];
+#endif
+                }
+
+        // Operand held by a node that is rewritten away, moved out of the node.
+        // Operands the node only referred to are not unwrapped, so that the
+        // result stays a view rather than a reference (copied by auto).
+        template<typename Operand>
+                requires (!std::is_lvalue_reference_v<Operand>)
+                constexpr inline auto unwrap(Operand&& operand) noexcept
+                {
+                        return std::remove_cvref_t<Operand>(std::move(operand));
+                }
 }; // ::detail
 /***************************************************************************//**
 * \brief Concept ensuring the subscipt operator is present.
@@ -91,6 +122,18 @@ concept expression = derived_from_baseexpr<Expr> &&
                      has_extents<Expr> && 
                      has_subscript_operator<Expr>;
 
+/***************************************************************************//**
+* Concept for expression nodes exposing their operands: operands() returns a
+* tuple of references to the operand expressions, through which the leaves of
+* an expression can be visited (e.g. to find the memory an assignment reads,
+* see expr::when_all). Scalars and functions held by a node are not operands.
+ ******************************************************************************/
+template<typename Expr>
+concept has_operands = requires(const std::remove_cvref_t<Expr>& e)
+{
+        e.operands();
+};
+
 /***************************************************************************//**
 * \brief Base class for all template expressions.
 * 
@@ -106,8 +149,8 @@ class BaseExpr
     public:
 
 #ifndef DEDUCE_THIS
-        const Expr& self() const noexcept {return static_cast<const Expr&>(*this);}
-        Expr& self() noexcept {return static_cast<Expr&>(*this);}
+        constexpr const Expr& self() const noexcept {return static_cast<const Expr&>(*this);}
+        constexpr Expr& self() noexcept {return static_cast<Expr&>(*this);}
 #endif
 
 #ifndef DEDUCE_THIS
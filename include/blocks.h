@@ -0,0 +1,190 @@
+#ifndef EXPR_TEMPLATE_BLOCKS_H
+#define EXPR_TEMPLATE_BLOCKS_H
+
+#include <base_expression.h>
+#include <extents_utils.h>
+#include <array>
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <experimental/mdspan>
+namespace stdex = std::experimental;
+
+namespace expr
+{
+
+/***************************************************************************//**
+* Generator is a lazily evaluated, single pass range of the values yielded by
+* a coroutine (a minimal std::generator). The yielded values are referred to,
+* not copied, and are valid until the iterator is incremented.
+ ******************************************************************************/
+template<typename T>
+class Generator
+{
+    public:
+        struct promise_type
+        {
+                const T* value = nullptr;
+                std::exception_ptr error{};
+
+                Generator get_return_object() noexcept {return Generator(std::coroutine_handle<promise_type>::from_promise(*this));}
+                std::suspend_always initial_suspend() noexcept {return {};}
+                std::suspend_always final_suspend() noexcept {return {};}
+                std::suspend_always yield_value(const T& val) noexcept
+                {
+                        value = std::addressof(val);
+                        return {};
+                }
+                void return_void() noexcept {}
+                void unhandled_exception() noexcept {error = std::current_exception();}
+        };
+
+        class iterator
+        {
+            public:
+                using value_type = T;
+                using difference_type = std::ptrdiff_t;
+
+                iterator() noexcept = default;
+                explicit iterator(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) {}
+
+                const T& operator*() const noexcept {return *m_handle.promise().value;}
+                iterator& operator++()
+                {
+                        resume(m_handle);
+                        return *this;
+                }
+                iterator operator++(int)
+                {
+                        iterator res = *this;
+                        ++*this;
+                        return res;
+                }
+                bool operator==(std::default_sentinel_t) const noexcept {return !m_handle || m_handle.done();}
+
+            private:
+                std::coroutine_handle<promise_type> m_handle{};
+        };
+
+        explicit Generator(std::coroutine_handle<promise_type> handle) noexcept : m_handle(handle) {}
+        Generator(Generator&& other) noexcept : m_handle(std::exchange(other.m_handle, {})) {}
+        Generator& operator=(Generator&& other) noexcept
+        {
+                std::swap(m_handle, other.m_handle);
+                return *this;
+        }
+        Generator(const Generator&) = delete;
+        Generator& operator=(const Generator&) = delete;
+        ~Generator() noexcept
+        {
+                if(m_handle){
+                        m_handle.destroy();
+                }
+        }
+
+        iterator begin()
+        {
+                resume(m_handle);
+                return iterator(m_handle);
+        }
+        std::default_sentinel_t end() const noexcept {return {};}
+
+    private:
+        std::coroutine_handle<promise_type> m_handle;
+
+        // Run the coroutine to its next co_yield, rethrowing its exceptions
+        static void resume(std::coroutine_handle<promise_type> handle)
+        {
+                handle.resume();
+                if(handle.done() && handle.promise().error){
+                        std::rethrow_exception(std::exchange(handle.promise().error, nullptr));
+                }
+        }
+};
+
+namespace detail
+{
+        template<typename Expr, typename IndexType, std::size_t... BlockExtents>
+        Generator<stdex::mdspan<const typename Expr::value_type, stdex::dextents<IndexType, sizeof...(BlockExtents)>>>
+        evaluate_blocks(std::shared_ptr<const Expr> e, stdex::extents<IndexType, BlockExtents...> block_extents)
+        {
+                constexpr std::size_t rank = sizeof...(BlockExtents);
+                using value_type = typename Expr::value_type;
+                using block_type = stdex::dextents<IndexType, rank>;
+                std::array<IndexType, rank> ext{}, block{}, offset{};
+                std::size_t buffer_size = 1;
+                for(std::size_t d = 0; d < rank; d++){
+                        ext[d] = static_cast<IndexType>(e->extent(d));
+                        block[d] = std::max<IndexType>(1, block_extents.extent(d));
+                        buffer_size *= static_cast<std::size_t>(block[d]);
+                        if(ext[d] == 0){
+                                co_return;
+                        }
+                }
+                const auto buffer = std::make_unique<value_type[]>(buffer_size);
+
+                while(true){
+                        // Evaluate the block at offset, clipped to the extents
+                        std::array<IndexType, rank> shape{};
+                        for(std::size_t d = 0; d < rank; d++){
+                                shape[d] = std::min<IndexType>(block[d], ext[d] - offset[d]);
+                        }
+                        std::size_t n = 0;
+                        const block_type block_ext = [&]<std::size_t... Ds>(std::index_sequence<Ds...>){
+                                return block_type(shape[Ds]...);
+                        }(std::make_index_sequence<rank>{});
+                        [&]<std::size_t... Ds>(std::index_sequence<Ds...>){
+                                exts::for_each_index(block_ext, [&](auto... local){
+                                        const std::array<IndexType, rank> idx{static_cast<IndexType>(local)...};
+                                        buffer[n++] = subscript(*e, static_cast<IndexType>(offset[Ds] + idx[Ds])...);
+                                });
+                        }(std::make_index_sequence<rank>{});
+                        co_yield stdex::mdspan<const value_type, block_type>(buffer.get(), block_ext);
+
+                        // Next block in row major order
+                        std::size_t d = rank;
+                        while(d-- > 0){
+                                offset[d] += block[d];
+                                if(offset[d] < ext[d]){
+                                        break;
+                                }
+                                offset[d] = 0;
+                        }
+                        if(d == std::size_t(-1)){
+                                co_return;
+                        }
+                }
+        }
+}; // detail
+
+/***************************************************************************//**
+* Evaluate e block by block, yielding a row major mdspan view of each block.
+* The blocks of (at most) block_extents elements are visited in row major
+* order, those at the upper edges clipped to the extents of e. Each block is
+* evaluated into a single reusable buffer right before it is yielded, so
+* results can be streamed onward (to a file, a checksum, ...) in constant
+* memory while still in cache. A view is valid until the next block is
+* requested. Expressions passed as rvalues are kept alive by the generator,
+* leaves passed as lvalues must outlive it.
+ ******************************************************************************/
+template<expression Expr, typename IndexType, std::size_t... BlockExtents>
+inline auto blocks(Expr&& e, const stdex::extents<IndexType, BlockExtents...>& block_extents)
+{
+        using E = std::remove_cvref_t<Expr>;
+        static_assert(sizeof...(BlockExtents) == decltype(e.extents())::rank(), "Rank of blocks does not match the rank of the expression!");
+        std::shared_ptr<const E> held;
+        if constexpr(std::is_lvalue_reference_v<Expr>){
+                // Not owning, aliasing an empty shared_ptr
+                held = std::shared_ptr<const E>(std::shared_ptr<const E>{}, std::addressof(e));
+        }else{
+                held = std::make_shared<const E>(std::move(e));
+        }
+        return detail::evaluate_blocks(std::move(held), block_extents);
+}
+
+}; // expr
+#endif // EXPR_TEMPLATE_BLOCKS_H
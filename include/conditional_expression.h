@@ -0,0 +1,386 @@
+#ifndef EXPR_TEMPLATE_CONDITIONAL_EXPRESSION_H
+#define EXPR_TEMPLATE_CONDITIONAL_EXPRESSION_H
+
+#include <base_expression.h>
+#include <elementwise_unary_operators.h>
+#include <elementwise_binary_operators.h>
+#include <elementwise_nary_operators.h>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+
+namespace expr
+{
+
+namespace detail
+{
+        // Element of a mask expression
+        template<typename Expr>
+        concept mask_expression = expression<Expr> && std::same_as<typename std::remove_cvref_t<Expr>::value_type, bool>;
+
+        // Operands of where, clamp, min and max which are not expressions
+        template<typename T>
+        concept scalar_operand = !expression<T>;
+
+        /***********************************************************************
+        * blend returns a where mask is true and b elsewhere, for arithmetic
+        * types with bitwise operations on the values: both are used, so the
+        * compiler can neither move the computation of one into a branch (and
+        * then, as floating point operations may trap, keep the branch) nor
+        * branch itself, and a vectorized loop blends the two vectors.
+         **********************************************************************/
+        template<typename T>
+        constexpr T blend(bool mask, T a, T b) noexcept
+        {
+                if constexpr(std::is_arithmetic_v<T> && (sizeof(T) == 8 || sizeof(T) == 4 || sizeof(T) == 2 || sizeof(T) == 1)){
+                        using Bits = std::conditional_t<sizeof(T) == 8, std::uint64_t, std::conditional_t<sizeof(T) == 4, std::uint32_t,
+                                     std::conditional_t<sizeof(T) == 2, std::uint16_t, std::uint8_t>>>;
+                        const Bits m = mask ? static_cast<Bits>(~Bits{0}) : Bits{0};
+                        return std::bit_cast<T>(static_cast<Bits>((std::bit_cast<Bits>(a) & m) | (std::bit_cast<Bits>(b) & static_cast<Bits>(~m))));
+                }else{
+                        return mask ? a : b;
+                }
+        }
+
+        template<typename R, typename T>
+        constexpr R convert(const T& val) noexcept
+        {
+                if constexpr(std::same_as<R, T>){
+                        return val;
+                }else{
+                        return static_cast<R>(val);
+                }
+        }
+
+        // where with both values from expressions
+        struct select_op
+        {
+                template<typename A, typename B>
+                constexpr std::common_type_t<A, B> operator()(bool mask, const A& a, const B& b) const
+                {
+                        using R = std::common_type_t<A, B>;
+                        return blend<R>(mask, convert<R>(a), convert<R>(b));
+                }
+        };
+
+        // where with one of the values a scalar
+        template<typename T, bool ScalarIfTrue>
+        struct select_scalar
+        {
+                T scalar;
+
+                constexpr explicit select_scalar(T val) noexcept : scalar(val) {}
+                template<typename U>
+                constexpr std::common_type_t<T, U> operator()(bool mask, const U& elem) const
+                {
+                        using R = std::common_type_t<T, U>;
+                        if constexpr(ScalarIfTrue){
+                                return blend<R>(mask, convert<R>(scalar), convert<R>(elem));
+                        }else{
+                                return blend<R>(mask, convert<R>(elem), convert<R>(scalar));
+                        }
+                }
+        };
+
+        template<typename T, typename U>
+        struct select_scalars
+        {
+                T if_true;
+                U if_false;
+
+                constexpr select_scalars(T a, U b) noexcept : if_true(a), if_false(b) {}
+                constexpr std::common_type_t<T, U> operator()(bool mask) const
+                {
+                        using R = std::common_type_t<T, U>;
+                        return blend<R>(mask, convert<R>(if_true), convert<R>(if_false));
+                }
+        };
+
+        // Compare each element with a scalar, elem op scalar or scalar op elem
+        template<typename Compare, typename T, bool ScalarLeft>
+        struct compare_scalar
+        {
+                T scalar;
+
+                constexpr explicit compare_scalar(T val) noexcept : scalar(val) {}
+                template<typename U>
+                constexpr bool operator()(const U& elem) const
+                {
+                        if constexpr(ScalarLeft){
+                                return Compare{}(scalar, elem);
+                        }else{
+                                return Compare{}(elem, scalar);
+                        }
+                }
+        };
+
+        template<typename Compare, bool ScalarLeft, expression Expr>
+        constexpr inline auto compare(Expr&& expr, const typename std::remove_reference_t<Expr>::value_type scalar) noexcept
+        {
+                using T = typename std::remove_reference_t<Expr>::value_type;
+                return map(std::forward<Expr>(expr), compare_scalar<Compare, T, ScalarLeft>(scalar));
+        }
+
+        // std::min and std::max of two values, compared and selected in their common type
+        struct min_op
+        {
+                template<typename A, typename B>
+                constexpr std::common_type_t<A, B> operator()(const A& a, const B& b) const
+                {
+                        using R = std::common_type_t<A, B>;
+                        const R ra = convert<R>(a);
+                        const R rb = convert<R>(b);
+                        return blend<R>(rb < ra, rb, ra);
+                }
+        };
+
+        struct max_op
+        {
+                template<typename A, typename B>
+                constexpr std::common_type_t<A, B> operator()(const A& a, const B& b) const
+                {
+                        using R = std::common_type_t<A, B>;
+                        const R ra = convert<R>(a);
+                        const R rb = convert<R>(b);
+                        return blend<R>(ra < rb, rb, ra);
+                }
+        };
+
+        // Op applied to each element and a scalar, op(elem, scalar)
+        template<typename Op, typename T>
+        struct with_scalar
+        {
+                T scalar;
+
+                constexpr explicit with_scalar(T val) noexcept : scalar(val) {}
+                template<typename U>
+                constexpr auto operator()(const U& elem) const {return Op{}(elem, scalar);}
+        };
+}; // detail
+
+/***************************************************************************//**
+* Comparing two expressions, or an expression and a scalar, results in a mask
+* expression of bool elements, true where the comparison holds, e.g. a < b or
+* a >= 0.0. Masks are combined elementwise with &, | and !, and used with
+* expr::where.
+ ******************************************************************************/
+template<expression LHS, expression RHS>
+constexpr inline auto operator<(LHS&& lhs, RHS&& rhs)
+{
+    return zip(std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::less<>());
+}
+
+template<expression LHS, expression RHS>
+constexpr inline auto operator<=(LHS&& lhs, RHS&& rhs)
+{
+    return zip(std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::less_equal<>());
+}
+
+template<expression LHS, expression RHS>
+constexpr inline auto operator>(LHS&& lhs, RHS&& rhs)
+{
+    return zip(std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::greater<>());
+}
+
+template<expression LHS, expression RHS>
+constexpr inline auto operator>=(LHS&& lhs, RHS&& rhs)
+{
+    return zip(std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::greater_equal<>());
+}
+
+template<expression LHS, expression RHS>
+constexpr inline auto operator==(LHS&& lhs, RHS&& rhs)
+{
+    return zip(std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::equal_to<>());
+}
+
+template<expression LHS, expression RHS>
+constexpr inline auto operator!=(LHS&& lhs, RHS&& rhs)
+{
+    return zip(std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::not_equal_to<>());
+}
+
+template<expression LHS>
+constexpr inline auto operator<(LHS&& lhs, const typename std::remove_reference_t<LHS>::value_type scalar) noexcept
+{
+    return detail::compare<std::less<>, false>(std::forward<LHS>(lhs), scalar);
+}
+
+template<expression RHS>
+constexpr inline auto operator<(const typename std::remove_reference_t<RHS>::value_type scalar, RHS&& rhs) noexcept
+{
+    return detail::compare<std::less<>, true>(std::forward<RHS>(rhs), scalar);
+}
+
+template<expression LHS>
+constexpr inline auto operator<=(LHS&& lhs, const typename std::remove_reference_t<LHS>::value_type scalar) noexcept
+{
+    return detail::compare<std::less_equal<>, false>(std::forward<LHS>(lhs), scalar);
+}
+
+template<expression RHS>
+constexpr inline auto operator<=(const typename std::remove_reference_t<RHS>::value_type scalar, RHS&& rhs) noexcept
+{
+    return detail::compare<std::less_equal<>, true>(std::forward<RHS>(rhs), scalar);
+}
+
+template<expression LHS>
+constexpr inline auto operator>(LHS&& lhs, const typename std::remove_reference_t<LHS>::value_type scalar) noexcept
+{
+    return detail::compare<std::greater<>, false>(std::forward<LHS>(lhs), scalar);
+}
+
+template<expression RHS>
+constexpr inline auto operator>(const typename std::remove_reference_t<RHS>::value_type scalar, RHS&& rhs) noexcept
+{
+    return detail::compare<std::greater<>, true>(std::forward<RHS>(rhs), scalar);
+}
+
+template<expression LHS>
+constexpr inline auto operator>=(LHS&& lhs, const typename std::remove_reference_t<LHS>::value_type scalar) noexcept
+{
+    return detail::compare<std::greater_equal<>, false>(std::forward<LHS>(lhs), scalar);
+}
+
+template<expression RHS>
+constexpr inline auto operator>=(const typename std::remove_reference_t<RHS>::value_type scalar, RHS&& rhs) noexcept
+{
+    return detail::compare<std::greater_equal<>, true>(std::forward<RHS>(rhs), scalar);
+}
+
+template<expression LHS>
+constexpr inline auto operator==(LHS&& lhs, const typename std::remove_reference_t<LHS>::value_type scalar) noexcept
+{
+    return detail::compare<std::equal_to<>, false>(std::forward<LHS>(lhs), scalar);
+}
+
+template<expression RHS>
+constexpr inline auto operator==(const typename std::remove_reference_t<RHS>::value_type scalar, RHS&& rhs) noexcept
+{
+    return detail::compare<std::equal_to<>, true>(std::forward<RHS>(rhs), scalar);
+}
+
+template<expression LHS>
+constexpr inline auto operator!=(LHS&& lhs, const typename std::remove_reference_t<LHS>::value_type scalar) noexcept
+{
+    return detail::compare<std::not_equal_to<>, false>(std::forward<LHS>(lhs), scalar);
+}
+
+template<expression RHS>
+constexpr inline auto operator!=(const typename std::remove_reference_t<RHS>::value_type scalar, RHS&& rhs) noexcept
+{
+    return detail::compare<std::not_equal_to<>, true>(std::forward<RHS>(rhs), scalar);
+}
+
+/***************************************************************************//**
+* Elementwise and, or and not of mask expressions.
+ ******************************************************************************/
+template<detail::mask_expression LHS, detail::mask_expression RHS>
+constexpr inline auto operator&(LHS&& lhs, RHS&& rhs)
+{
+    return zip(std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::logical_and<>());
+}
+
+template<detail::mask_expression LHS, detail::mask_expression RHS>
+constexpr inline auto operator|(LHS&& lhs, RHS&& rhs)
+{
+    return zip(std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::logical_or<>());
+}
+
+template<detail::mask_expression RHS>
+constexpr inline auto operator!(RHS&& rhs) noexcept
+{
+    return map(std::forward<RHS>(rhs), std::logical_not<>());
+}
+
+/***************************************************************************//**
+* where(mask, a, b) is the expression whose elements are those of a where the
+* mask is true and those of b elsewhere, e.g. expr::where(x > 0.0, x, 0.01*x).
+* a and b may be expressions or scalars. Nothing is evaluated until an element
+* is required, and then without branching: the matching elements of both a and
+* b are read and one of them selected, which vectorizes to a blend. Temporary
+* elementwise operands (the comparison of the mask, formulas for a and b) are
+* folded into a single node, see zip_n.
+ ******************************************************************************/
+template<detail::mask_expression Mask, expression A, expression B>
+constexpr inline auto where(Mask&& mask, A&& a, B&& b)
+{
+    return zip_n(detail::select_op{}, std::forward<Mask>(mask), std::forward<A>(a), std::forward<B>(b));
+}
+
+template<detail::mask_expression Mask, expression A, detail::scalar_operand T>
+constexpr inline auto where(Mask&& mask, A&& a, const T& b)
+{
+    return zip(std::forward<Mask>(mask), std::forward<A>(a), detail::select_scalar<T, false>(b));
+}
+
+template<detail::mask_expression Mask, detail::scalar_operand T, expression B>
+constexpr inline auto where(Mask&& mask, const T& a, B&& b)
+{
+    return zip(std::forward<Mask>(mask), std::forward<B>(b), detail::select_scalar<T, true>(a));
+}
+
+template<detail::mask_expression Mask, detail::scalar_operand T, detail::scalar_operand U>
+constexpr inline auto where(Mask&& mask, const T& a, const U& b) noexcept
+{
+    return map(std::forward<Mask>(mask), detail::select_scalars<T, U>(a, b));
+}
+
+/***************************************************************************//**
+* Elementwise minimum and maximum of two expressions, or of an expression and a
+* scalar (e.g. expr::max(x, 0.0) for a ReLU): the results of std::min and
+* std::max, which return a when a NaN is compared. The elements are compared
+* and selected in the common type of both operands, e.g. double for
+* expr::max(int_array, 0.5), and each element of a temporary operand such as
+* x*y is evaluated once.
+ ******************************************************************************/
+template<expression A, expression B>
+constexpr inline auto min(A&& a, B&& b)
+{
+    return zip(std::forward<A>(a), std::forward<B>(b), detail::min_op{});
+}
+
+template<expression A, detail::scalar_operand T>
+constexpr inline auto min(A&& a, const T& b)
+{
+    return map(std::forward<A>(a), detail::with_scalar<detail::min_op, T>(b));
+}
+
+template<detail::scalar_operand T, expression B>
+constexpr inline auto min(const T& a, B&& b)
+{
+    return min(std::forward<B>(b), a);
+}
+
+template<expression A, expression B>
+constexpr inline auto max(A&& a, B&& b)
+{
+    return zip(std::forward<A>(a), std::forward<B>(b), detail::max_op{});
+}
+
+template<expression A, detail::scalar_operand T>
+constexpr inline auto max(A&& a, const T& b)
+{
+    return map(std::forward<A>(a), detail::with_scalar<detail::max_op, T>(b));
+}
+
+template<detail::scalar_operand T, expression B>
+constexpr inline auto max(const T& a, B&& b)
+{
+    return max(std::forward<B>(b), a);
+}
+
+/***************************************************************************//**
+* Elementwise clamp of an expression to [lo, hi], lo and hi expressions or
+* scalars, as std::clamp: min(max(e, lo), hi).
+ ******************************************************************************/
+template<expression Expr, typename Lo, typename Hi>
+constexpr inline auto clamp(Expr&& expr, Lo&& lo, Hi&& hi)
+{
+    return min(max(std::forward<Expr>(expr), std::forward<Lo>(lo)), std::forward<Hi>(hi));
+}
+
+}; // expr
+
+#endif // EXPR_TEMPLATE_CONDITIONAL_EXPRESSION_H
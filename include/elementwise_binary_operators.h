@@ -2,7 +2,10 @@
 #define EXPR_TEMPLATE_ELEMENTWISE_BINARY_OPERATOR_H
 
 #include<base_expression.h>
+#include <elementwise_nary_operators.h>
+#include <cmath>
 #include <functional>
+#include <tuple>
 
 namespace expr
 {
@@ -23,6 +26,7 @@ class ElementwiseBinaryOp: public BaseExpr<ElementwiseBinaryOp<LHS, RHS, BINARY_
         using RHS_noref = std::remove_reference_t<RHS>;
         using LHS_noref = std::remove_reference_t<LHS>;
         using value_type = binary_return_type<LHS, RHS, BINARY_OP>;
+        using layout_type = exts::common_layout_t<LHS, RHS>;
 
         constexpr explicit ElementwiseBinaryOp(LHS&& lhs, RHS&& rhs, BINARY_OP&& op) noexcept
          : Base(), m_lhs(std::forward<LHS>(lhs)), m_rhs(std::forward<RHS>(rhs)), m_op(std::forward<BINARY_OP>(op))
@@ -38,11 +42,23 @@ class ElementwiseBinaryOp: public BaseExpr<ElementwiseBinaryOp<LHS, RHS, BINARY_
 #endif
         constexpr auto operator[](auto&&  ... indices) const {return m_op(m_lhs[indices...], m_rhs[indices...]);}
 
+        constexpr auto flat(std::size_t n) const requires (exts::has_flat_access<LHS> && exts::has_flat_access<RHS>)
+        {
+                return m_op(m_lhs.flat(n), m_rhs.flat(n));
+        }
+
+        // Operator and operands, moved out to fold this node into an ElementwiseNaryOp
+        constexpr auto release() && noexcept
+        {
+                return std::tuple<BINARY_OP&&, LHS&&, RHS&&>(std::forward<BINARY_OP>(m_op), std::forward<LHS>(m_lhs), std::forward<RHS>(m_rhs));
+        }
+
         constexpr explicit ElementwiseBinaryOp(const ElementwiseBinaryOp&) noexcept = default;
         constexpr explicit ElementwiseBinaryOp(ElementwiseBinaryOp&&) noexcept = default;
 
         constexpr ElementwiseBinaryOp& operator=(const ElementwiseBinaryOp&) noexcept = default;
         constexpr ElementwiseBinaryOp& operator=(ElementwiseBinaryOp&&) noexcept = default;
+        constexpr auto operands() const noexcept {return std::forward_as_tuple(m_lhs, m_rhs);}
     private:
         std::remove_cv_t<LHS> m_lhs;
         std::remove_cv_t<RHS> m_rhs;
@@ -51,39 +67,115 @@ class ElementwiseBinaryOp: public BaseExpr<ElementwiseBinaryOp<LHS, RHS, BINARY_
         constexpr explicit ElementwiseBinaryOp() noexcept = default;
 };
 
+namespace detail
+{
+        template<typename LHS, typename RHS, typename BINARY_OP>
+        struct is_elementwise_node<ElementwiseBinaryOp<LHS, RHS, BINARY_OP>> : std::true_type {};
+
+        // Throws unless lhs and rhs have the same extents, static extents are checked at compile time
+        template<expression LHS, expression RHS>
+        constexpr inline void check_matching_extents(const LHS& lhs, const RHS& rhs)
+        {
+            using LHS_extents = decltype(lhs.extents());
+            using RHS_extents = decltype(rhs.extents());
+            if constexpr(LHS_extents::rank() == RHS_extents::rank()){
+                    static_assert([]<size_t... Is>(std::index_sequence<Is...>){
+                                return (static_extents_compatible<LHS_extents, RHS_extents>(Is, Is) && ...);
+                            }(std::make_index_sequence<LHS_extents::rank()>{}), "Static dimensions do not match!");
+            }
+            if (lhs.extents().rank() != rhs.extents().rank()){
+                    throw std::runtime_error("Rank of left hand side expression does not match rank of right hand side expression!\n" + std::to_string(lhs.extents().rank()) + " != " + std::to_string(rhs.extents().rank()));
+            }
+            for (size_t i = 0; i < lhs.extents().rank(); i++){
+                    if (lhs.extent(i) != rhs.extent(i)){
+                            throw std::runtime_error("Dimensions do not match!\nDimension " + std::to_string(i) + ": " + std::to_string(lhs.extent(i)) + " != " + std::to_string(rhs.extent(i)));
+                    }
+            }
+        }
+}; // detail
 
 /***************************************************************************//**
 * The zip function is the fundamental operation for an 
 * ElementwiseBinaryOp expression. It takes two expressions and an operator and
 * returns an ElementwiseBinaryOp representing the result of applying the
 * operator to each pair of matching elements element of the expressions.
+* Temporary elementwise operands are folded into an ElementwiseNaryOp (see
+* zip_n) instead of being nested.
  ******************************************************************************/
 template<expression LHS, expression RHS, typename BinaryOp>
 constexpr inline auto zip(LHS&& lhs, RHS&& rhs, BinaryOp&& op)
 {
-    if (lhs.extents().rank() != rhs.extents().rank()){
-            throw std::runtime_error("Rank of left hand side expression does not match rank of right hand side expression!\n" + std::to_string(lhs.extents().rank()) + " != " + std::to_string(rhs.extents().rank()));
-    }
-    for (size_t i = 0; i < lhs.extents().rank(); i++){
-            if (lhs.extent(i) != rhs.extent(i)){
-                    throw std::runtime_error("Dimensions do not match!\nDimension " + std::to_string(i) + ": " + std::to_string(lhs.extent(i)) + " != " + std::to_string(rhs.extent(i)));
-            }
+    detail::check_matching_extents(lhs, rhs);
+    if constexpr(detail::foldable<LHS> || detail::foldable<RHS>){
+            return detail::make_nary(std::forward<BinaryOp>(op), std::forward<LHS>(lhs), std::forward<RHS>(rhs));
+    }else{
+            return ElementwiseBinaryOp<LHS, RHS, BinaryOp>(std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::forward<BinaryOp>(op));
     }
-
-    if(lhs.extent(lhs.extents().rank() - 1) != rhs.extent(lhs.extents().rank() - 2)){
-            throw std::runtime_error("incompatible dimensions for matrix multiplication!\n" + std::to_string(lhs.extent(lhs.extents().rank() - 1)) + " != " + std::to_string(rhs.extent(rhs.extents().rank() - 2)));
-    }
-    return ElementwiseBinaryOp<LHS, RHS, BinaryOp>(std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::forward<BinaryOp>(op));
 }
 
+namespace detail
+{
+        template<typename T>
+        inline constexpr bool fast_fma = false;
+#ifdef FP_FAST_FMA
+        template<>
+        inline constexpr bool fast_fma<double> = true;
+#endif
+#ifdef FP_FAST_FMAF
+        template<>
+        inline constexpr bool fast_fma<float> = true;
+#endif
+
+        // a*b + c, rounded once with std::fma where the target has a fast fma instruction
+        struct fused_multiply_add
+        {
+                template<typename A, typename B, typename C>
+                constexpr auto operator()(A a, B b, C c) const
+                {
+                        if constexpr(std::same_as<A, B> && std::same_as<A, C> && fast_fma<A>){
+                                if !consteval {
+                                        return std::fma(a, b, c);
+                                }
+                        }
+                        return a*b + c;
+                }
+        };
+
+        template<typename Expr>
+        struct is_product : std::false_type {};
+        template<typename LHS, typename RHS>
+        struct is_product<ElementwiseBinaryOp<LHS, RHS, std::multiplies<>>> : std::true_type {};
+
+        // Temporary elementwise products, rewritten when added to or summed
+        template<typename Expr>
+        concept product_temporary = !std::is_lvalue_reference_v<Expr> && is_product<std::remove_cvref_t<Expr>>::value;
+
+        // c + a*b as an ElementwiseNaryOp of a, b and c with fused_multiply_add
+        template<expression Product, expression Addend>
+        constexpr inline auto multiply_add(Product&& product, Addend&& addend)
+        {
+                auto parts = std::move(product).release();
+                return zip_n(fused_multiply_add{}, std::get<1>(std::move(parts)), std::get<2>(std::move(parts)), std::forward<Addend>(addend));
+        }
+}; // detail
+
 /***************************************************************************//**
 * Elementwise addition of two expressions results in an ElementwiseBinaryOp
-* representing the addition of matching elements in two expressions.
+* representing the addition of matching elements in two expressions. Adding a
+* temporary product, a*b + c, results in a fused multiply-add of a, b and c
+* instead, computed with std::fma where FP_FAST_FMA(F) reports a fast fma
+* instruction (rounding the result once rather than twice).
  ******************************************************************************/
 template<expression LHS, expression RHS>
 constexpr inline auto operator+(LHS&& lhs, RHS&& rhs)
 {
-     return zip(std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::plus<>());
+     if constexpr(detail::product_temporary<LHS>){
+             return detail::multiply_add(std::forward<LHS>(lhs), std::forward<RHS>(rhs));
+     }else if constexpr(detail::product_temporary<RHS>){
+             return detail::multiply_add(std::forward<RHS>(rhs), std::forward<LHS>(lhs));
+     }else{
+             return zip(std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::plus<>());
+     }
 }
 
 /***************************************************************************//**
@@ -0,0 +1,232 @@
+#ifndef EXPR_TEMPLATE_ELEMENTWISE_NARY_OPERATOR_H
+#define EXPR_TEMPLATE_ELEMENTWISE_NARY_OPERATOR_H
+
+#include <base_expression.h>
+#include <functional>
+#include <tuple>
+#include <utility>
+
+namespace expr
+{
+
+template<typename NARY_OP, expression... Exprs>
+using nary_return_type = decltype(std::declval<NARY_OP>()(std::declval<typename std::remove_reference_t<Exprs>::value_type>()...));
+
+namespace detail
+{
+        template<typename... Layouts>
+        struct nary_layout {using type = void;};
+        template<typename Layout>
+        struct nary_layout<Layout> {using type = Layout;};
+        template<typename Layout1, typename Layout2, typename... Layouts>
+        struct nary_layout<Layout1, Layout2, Layouts...>
+        {
+                using type = typename nary_layout<typename exts::detail::common_layout<Layout1, Layout2>::type, Layouts...>::type;
+        };
+}; // detail
+
+/***************************************************************************//**
+* ElementwiseNaryOp represents expressions where a function is applied to
+* matching elements in any number of expressions. The evaluation of the
+* function is not performed until the specific element of this expression is
+* required (via the subscript operator), all operands are then read with a
+* single call of the function.
+ ******************************************************************************/
+template<typename NARY_OP, expression... Exprs>
+class ElementwiseNaryOp: public BaseExpr<ElementwiseNaryOp<NARY_OP, Exprs...>>{
+    public:
+        using Base = BaseExpr<ElementwiseNaryOp<NARY_OP, Exprs...>>;
+        using value_type = nary_return_type<NARY_OP, Exprs...>;
+        using layout_type = typename detail::nary_layout<exts::layout_of_t<Exprs>...>::type;
+
+        static_assert(sizeof...(Exprs) > 0, "ElementwiseNaryOp requires at least one operand!");
+
+        constexpr explicit ElementwiseNaryOp(NARY_OP&& op, Exprs&&... exprs) noexcept
+         : Base(), m_operands(std::forward<Exprs>(exprs)...), m_op(std::forward<NARY_OP>(op))
+        {}
+
+        ~ElementwiseNaryOp() noexcept = default;
+
+        constexpr auto extents() const noexcept {return std::get<0>(m_operands).extents();};
+        constexpr auto extent(std::size_t i) const noexcept {return std::get<0>(m_operands).extent(i);};
+
+#ifdef CLANGBUG
+        constexpr auto operator()(auto&&  ... indices) const
+        {
+                return std::apply([&](const auto&... operands){ return m_op(operands(indices...)...); }, m_operands);
+        }
+#endif
+        constexpr auto operator[](auto&&  ... indices) const
+        {
+                return std::apply([&](const auto&... operands){ return m_op(operands[indices...]...); }, m_operands);
+        }
+
+        constexpr auto flat(std::size_t n) const requires (exts::has_flat_access<Exprs> && ...)
+        {
+                return std::apply([&](const auto&... operands){ return m_op(operands.flat(n)...); }, m_operands);
+        }
+
+        // Operator and operands, moved out to fold this node into another one
+        constexpr auto release() && noexcept
+        {
+                return std::apply([&](auto&... operands){
+                        return std::tuple<NARY_OP&&, Exprs&&...>(std::forward<NARY_OP>(m_op), std::forward<Exprs>(operands)...);
+                }, m_operands);
+        }
+
+        constexpr explicit ElementwiseNaryOp(const ElementwiseNaryOp&) noexcept = default;
+        constexpr explicit ElementwiseNaryOp(ElementwiseNaryOp&&) noexcept = default;
+
+        constexpr ElementwiseNaryOp& operator=(const ElementwiseNaryOp&) noexcept = default;
+        constexpr ElementwiseNaryOp& operator=(ElementwiseNaryOp&&) noexcept = default;
+        constexpr auto operands() const noexcept
+        {
+                return std::apply([](const auto&... operands){ return std::forward_as_tuple(operands...); }, m_operands);
+        }
+    private:
+        std::tuple<std::remove_cv_t<Exprs>...> m_operands;
+        NARY_OP m_op;
+
+        constexpr explicit ElementwiseNaryOp() noexcept = default;
+};
+
+namespace detail
+{
+        // Elementwise nodes, specialized next to each node type
+        template<typename Expr>
+        struct is_elementwise_node : std::false_type {};
+        template<typename NARY_OP, typename... Exprs>
+        struct is_elementwise_node<ElementwiseNaryOp<NARY_OP, Exprs...>> : std::true_type {};
+
+        // Temporary elementwise nodes are folded into the node using them
+        template<typename Expr>
+        concept foldable = !std::is_lvalue_reference_v<Expr> && is_elementwise_node<std::remove_cvref_t<Expr>>::value;
+
+        /***********************************************************************
+        * fused_op applies op to the results of the inner operators, the k:th
+        * of which is called with the Arities[k] arguments following those of
+        * the previous ones.
+         **********************************************************************/
+        template<typename Op, typename Arities, typename... Inner>
+        struct fused_op;
+
+        template<typename Op, std::size_t... Arities, typename... Inner>
+        struct fused_op<Op, std::index_sequence<Arities...>, Inner...>
+        {
+                Op op;
+                std::tuple<Inner...> inner;
+
+                constexpr fused_op(Op&& outer, std::tuple<Inner...>&& inner_ops) noexcept
+                 : op(std::move(outer)), inner(std::move(inner_ops))
+                {}
+
+                template<typename... Args>
+                constexpr auto operator()(const Args&... args) const
+                {
+                        const auto all = std::forward_as_tuple(args...);
+                        return [&]<std::size_t... Ks>(std::index_sequence<Ks...>){
+                                return op(call<Ks>(all)...);
+                        }(std::index_sequence_for<Inner...>{});
+                }
+
+            private:
+                template<std::size_t K, typename Args>
+                constexpr auto call(const Args& all) const
+                {
+                        constexpr std::size_t arities[] = {Arities...};
+                        constexpr std::size_t offset = [&](){
+                                std::size_t res = 0;
+                                for(std::size_t k = 0; k < K; k++){
+                                        res += arities[k];
+                                }
+                                return res;
+                        }();
+                        return [&]<std::size_t... Is>(std::index_sequence<Is...>){
+                                return std::get<K>(inner)(std::get<offset + Is>(all)...);
+                        }(std::make_index_sequence<arities[K]>{});
+                }
+        };
+
+        // Operator (the identity for other expressions) and operands of expr
+        template<typename Expr>
+        constexpr auto elementwise_parts(Expr&& expr) noexcept
+        {
+                if constexpr(foldable<Expr>){
+                        return std::move(expr).release();
+                }else{
+                        return std::tuple<std::identity, Expr&&>(std::identity{}, std::forward<Expr>(expr));
+                }
+        }
+
+        // Template argument of an operand held as T&& in a tuple of parts
+        template<typename T>
+        using operand_type = std::conditional_t<std::is_lvalue_reference_v<T>, T, std::remove_reference_t<T>>;
+
+        // Build an ElementwiseNaryOp from op and the parts of each of its operands
+        template<typename Op, typename... Parts>
+        constexpr auto fuse(Op&& op, Parts&&... parts) noexcept
+        {
+                using Fused = fused_op<std::remove_cvref_t<Op>, std::index_sequence<(std::tuple_size_v<std::remove_cvref_t<Parts>> - 1)...>,
+                                       std::remove_cvref_t<std::tuple_element_t<0, std::remove_cvref_t<Parts>>>...>;
+                Fused fused(std::remove_cvref_t<Op>(std::forward<Op>(op)), std::tuple<std::remove_cvref_t<std::tuple_element_t<0, std::remove_cvref_t<Parts>>>...>(std::get<0>(std::move(parts))...));
+                auto operands = std::tuple_cat([]<typename Part, std::size_t... Is>(Part&& part, std::index_sequence<Is...>){
+                        return std::forward_as_tuple(std::get<Is + 1>(std::move(part))...);
+                }(std::move(parts), std::make_index_sequence<std::tuple_size_v<std::remove_cvref_t<Parts>> - 1>{})...);
+                using Operands = decltype(operands);
+                return [&]<std::size_t... Is>(std::index_sequence<Is...>){
+                        return ElementwiseNaryOp<Fused, operand_type<std::tuple_element_t<Is, Operands>>...>(
+                                std::move(fused), std::get<Is>(std::move(operands))...);
+                }(std::make_index_sequence<std::tuple_size_v<Operands>>{});
+        }
+
+        // Operands folded into a single ElementwiseNaryOp when any is a temporary elementwise node
+        template<typename NaryOp, expression... Exprs>
+        constexpr auto make_nary(NaryOp&& op, Exprs&&... exprs) noexcept
+        {
+                if constexpr((foldable<Exprs> || ...)){
+                        return fuse(std::forward<NaryOp>(op), elementwise_parts(std::forward<Exprs>(exprs))...);
+                }else{
+                        return ElementwiseNaryOp<NaryOp, Exprs...>(std::forward<NaryOp>(op), std::forward<Exprs>(exprs)...);
+                }
+        }
+}; // detail
+
+/***************************************************************************//**
+* The zip_n function applies op to the matching elements of any number of
+* expressions, returning an ElementwiseNaryOp, e.g.
+*
+*   expr::zip_n([](auto x, auto y, auto z){return std::fma(x, y, z);}, a, b, c)
+*
+* Temporary elementwise operands (e.g. the a*b in zip_n(op, a*b, c)) are
+* folded into the new node, so the leaves of a whole elementwise formula are
+* operands of one node and read with one call of the fused function per
+* element, instead of through a deep tree of nested nodes.
+ ******************************************************************************/
+template<typename NaryOp, expression Expr, expression... Exprs>
+constexpr inline auto zip_n(NaryOp&& op, Expr&& expr, Exprs&&... exprs)
+{
+    using Expr_extents = decltype(expr.extents());
+    constexpr auto compatible = []<typename Extents>(){
+            if constexpr(Expr_extents::rank() != Extents::rank()){
+                    return false;
+            }else{
+                    return []<size_t... Is>(std::index_sequence<Is...>){
+                                return (detail::static_extents_compatible<Expr_extents, Extents>(Is, Is) && ...);
+                            }(std::make_index_sequence<Extents::rank()>{});
+            }
+    };
+    static_assert((compatible.template operator()<decltype(exprs.extents())>() && ...), "Static dimensions do not match!");
+    auto check = [&](const auto& e){
+            for (size_t i = 0; i < expr.extents().rank(); i++){
+                    if (expr.extent(i) != e.extent(i)){
+                            throw std::runtime_error("Dimensions do not match!\nDimension " + std::to_string(i) + ": " + std::to_string(expr.extent(i)) + " != " + std::to_string(e.extent(i)));
+                    }
+            }
+    };
+    (check(exprs), ...);
+    return detail::make_nary(std::forward<NaryOp>(op), std::forward<Expr>(expr), std::forward<Exprs>(exprs)...);
+}
+
+}; //expr
+
+#endif // EXPR_TEMPLATE_ELEMENTWISE_NARY_OPERATOR_H
@@ -2,7 +2,9 @@
 #define EXPR_TEMPLATE_ELEMENTWISE_UNARY_OPERATOR_H
 
 #include <base_expression.h>
+#include <elementwise_nary_operators.h>
 #include <functional>
+#include <tuple>
 
 namespace expr{
 
@@ -21,6 +23,7 @@ class ElementwiseUnaryOp: public BaseExpr<ElementwiseUnaryOp<RHS, UNARY_OP>>{
         using Base = BaseExpr<ElementwiseUnaryOp<RHS, UNARY_OP>>;
         using RHS_noref = std::remove_reference_t<RHS>;
         using value_type = unary_return_type<RHS, UNARY_OP>;
+        using layout_type = exts::layout_of_t<RHS>;
 
         constexpr explicit ElementwiseUnaryOp(RHS&& rhs, UNARY_OP&& op = UNARY_OP()) noexcept
             : Base(), m_rhs(std::forward<RHS>(rhs)), m_op(std::forward<UNARY_OP>(op))
@@ -35,11 +38,20 @@ class ElementwiseUnaryOp: public BaseExpr<ElementwiseUnaryOp<RHS, UNARY_OP>>{
 #endif
         constexpr auto operator[](auto&& ... indices) const {return m_op(m_rhs[indices...]);}
 
+        constexpr auto flat(std::size_t n) const requires exts::has_flat_access<RHS> {return m_op(m_rhs.flat(n));}
+
+        // Operator and operand, moved out to fold this node into an ElementwiseNaryOp
+        constexpr auto release() && noexcept
+        {
+                return std::tuple<UNARY_OP&&, RHS&&>(std::forward<UNARY_OP>(m_op), std::forward<RHS>(m_rhs));
+        }
+
         constexpr explicit ElementwiseUnaryOp(const ElementwiseUnaryOp&) noexcept = default;
         constexpr explicit ElementwiseUnaryOp(ElementwiseUnaryOp&&) noexcept = default;
 
         constexpr ElementwiseUnaryOp& operator=(const ElementwiseUnaryOp&) noexcept = default;
         constexpr ElementwiseUnaryOp& operator=(ElementwiseUnaryOp&&) noexcept = default;
+        constexpr auto operands() const noexcept {return std::forward_as_tuple(m_rhs);}
     private:
         std::remove_cv_t<RHS> m_rhs;
         UNARY_OP m_op;
@@ -47,28 +59,102 @@ class ElementwiseUnaryOp: public BaseExpr<ElementwiseUnaryOp<RHS, UNARY_OP>>{
         constexpr explicit ElementwiseUnaryOp() noexcept = default;
 };
 
+namespace detail
+{
+        template<typename RHS, typename UNARY_OP>
+        struct is_elementwise_node<ElementwiseUnaryOp<RHS, UNARY_OP>> : std::true_type {};
+
+        template<typename Expr>
+        struct is_unary_node : std::false_type {};
+        template<typename RHS, typename UNARY_OP>
+        struct is_unary_node<ElementwiseUnaryOp<RHS, UNARY_OP>> : std::true_type {};
+}; // detail
+
 /***************************************************************************//**
 * The map function is the fundamental operation for an ElementwiseUnaryOp
 * expression. It takes an expression and an operator and returns an
 * ElementwiseUnaryOp representing the result of applying the operator to
-* each element of the expression.
+* each element of the expression. Mapping a temporary ElementwiseBinaryOp or
+* ElementwiseNaryOp folds op into it instead (see zip_n).
  ******************************************************************************/
 template<expression Expr, typename UnaryOp>
 constexpr inline auto map(Expr&& expr, UnaryOp&& op) noexcept
 {
-    return ElementwiseUnaryOp<Expr, UnaryOp>(std::forward<Expr>(expr), std::forward<UnaryOp>(op));
+    if constexpr(detail::foldable<Expr> && !detail::is_unary_node<std::remove_cvref_t<Expr>>::value){
+            return detail::make_nary(std::forward<UnaryOp>(op), std::forward<Expr>(expr));
+    }else{
+            return ElementwiseUnaryOp<Expr, UnaryOp>(std::forward<Expr>(expr), std::forward<UnaryOp>(op));
+    }
 }
 
+namespace detail
+{
+        template<typename T>
+        struct cast_op
+        {
+                template<typename U>
+                constexpr T operator()(const U& val) const noexcept {return static_cast<T>(val);}
+        };
+}; // detail
+
+/***************************************************************************//**
+* Returns an ElementwiseUnaryOp converting each element of the expression to
+* T when it is evaluated, e.g. to store double results as float or
+* expr::bfloat16, or to compute with float elements stored as expr::half.
+ ******************************************************************************/
+template<typename T, expression Expr>
+constexpr inline auto cast(Expr&& expr) noexcept
+{
+    return map(std::forward<Expr>(expr), detail::cast_op<T>{});
+}
+
+namespace detail
+{
+        template<typename T>
+        struct scalar_multiplier
+        {
+                T scalar;
+
+                constexpr explicit scalar_multiplier(T val) noexcept : scalar(val) {}
+                constexpr auto operator()(auto elem) const {return elem*scalar;}
+        };
+
+        template<typename Expr>
+        struct is_scaled : std::false_type {};
+        template<typename RHS, typename T>
+        struct is_scaled<ElementwiseUnaryOp<RHS, scalar_multiplier<T>>> : std::true_type {};
+
+        template<typename Expr>
+        struct is_negated : std::false_type {};
+        template<typename RHS>
+        struct is_negated<ElementwiseUnaryOp<RHS, std::negate<>>> : std::true_type {};
+
+        // Multiply expr by scalar, s1*(s2*expr) becoming (s1*s2)*expr
+        template<expression Expr>
+        constexpr inline auto scale(Expr&& expr, const typename std::remove_reference_t<Expr>::value_type scalar) noexcept
+        {
+                using T = typename std::remove_reference_t<Expr>::value_type;
+                if constexpr(!std::is_lvalue_reference_v<Expr> && is_scaled<std::remove_cvref_t<Expr>>::value){
+                        auto parts = std::move(expr).release();
+                        using Operand = operand_type<std::tuple_element_t<1, decltype(parts)>>;
+                        return ElementwiseUnaryOp<Operand, scalar_multiplier<T>>(std::get<1>(std::move(parts)),
+                                        scalar_multiplier<T>(static_cast<T>(scalar*std::get<0>(parts).scalar)));
+                }else{
+                        return ElementwiseUnaryOp<Expr, scalar_multiplier<T>>(std::forward<Expr>(expr), scalar_multiplier<T>(scalar));
+                }
+        }
+}; // detail
+
 /***************************************************************************//**
 * Multiplying a scalar by an expression results in an 
 * ElementwiseUnaryOp representing the multiplication of every element in the
-* expression by the scalar.
+* expression by the scalar. Scaling a temporary scaled expression multiplies
+* the scalars instead, s1*(s2*A) becoming (s1*s2)*A.
  ******************************************************************************/
 template<expression RHS>
 constexpr inline auto operator*(const typename std::remove_reference_t<RHS>::value_type scalar, RHS&& rhs) noexcept
 {
-    auto multiplier = [scalar](auto elem){return elem*scalar;};
-    return map(std::forward<RHS>(rhs), std::move(multiplier));
+    return detail::scale(std::forward<RHS>(rhs), scalar);
 }
 
 /***************************************************************************//**
@@ -79,8 +165,7 @@ constexpr inline auto operator*(const typename std::remove_reference_t<RHS>::val
 template<expression LHS>
 constexpr inline auto operator*(LHS&& lhs, const typename std::remove_reference_t<LHS>::value_type scalar) noexcept
 {
-    auto multiplier = [scalar](auto elem){return elem*scalar;};
-    return map(std::forward<LHS>(lhs), std::move(multiplier));
+    return detail::scale(std::forward<LHS>(lhs), scalar);
 }
 
 /***************************************************************************//**
@@ -107,12 +192,19 @@ constexpr inline auto operator/(LHS&& lhs, const typename std::remove_reference_
 
 /***************************************************************************//**
 * Negatign an expression results in an ElementwiseUnaryOp representing
-* the negation of each element in the expression.
+* the negation of each element in the expression. Negating a temporary negated
+* expression holding its operand results in that operand, -(-(A + B)) being
+* A + B. -(-A) of an lvalue A stays a (doubly negated) view of A.
  ******************************************************************************/
 template<expression RHS>
 constexpr inline auto operator-(RHS&& rhs) noexcept
 {
-    return map(std::forward<RHS>(rhs), std::negate<>());
+    if constexpr(!std::is_lvalue_reference_v<RHS> && detail::is_negated<std::remove_cvref_t<RHS>>::value
+                 && !std::is_lvalue_reference_v<std::tuple_element_t<1, decltype(std::declval<RHS>().release())>>){
+            return detail::unwrap(std::get<1>(std::move(rhs).release()));
+    }else{
+            return ElementwiseUnaryOp<RHS, std::negate<>>(std::forward<RHS>(rhs));
+    }
 }
 
 }; // namespace expr
@@ -6,12 +6,26 @@
 #endif
 
 #include <base_expression.h>
+#include <reduced_precision.h>
 #include <elementwise_unary_operators.h>
 #include <elementwise_binary_operators.h>
+#include <elementwise_nary_operators.h>
+#include <conditional_expression.h>
 #include <scalar_reduce_operators.h>
+#include <inner_product_expression.h>
+#include <math_functions.h>
 #include <matrix_multiplication_expression.h>
+#include <sparse_multiplication_expression.h>
+#include <structured_multiplication_expression.h>
 #include <transpose_expression.h>
-// #include <slice_expression.h> // NOT YET DONE
+#include <slice_expression.h>
+#include <stencil_expression.h>
+#include <scan_expression.h>
+#include <histogram_expression.h>
+#include <take_expression.h>
+#include <async.h>
+#include <blocks.h>
+#include <runtime_expression.h>
 
 #endif // EXPR_TEMPLATE_H
 
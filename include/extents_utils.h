@@ -2,10 +2,111 @@
 #define EXPRESSION_TEMPLATE_EXTENTS_UTILS_H
 
 #include <experimental/mdspan>
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 namespace stdex = std::experimental;
 
 namespace exts{
 
+/***************************************************************************//**
+* Concept for expressions with flat access, i.e. a flat(n) member returning the
+* n:th element in row major (last index fastest) order. Evaluations of such
+* expressions can use a single linear loop instead of nested index loops.
+ ******************************************************************************/
+template<typename Expr>
+concept has_flat_access = requires(Expr e, std::size_t n)
+{
+        e.flat(n);
+};
+
+/***************************************************************************//**
+* Expressions may provide an assign_to(destination) member, evaluating the
+* whole expression into destination with a dedicated kernel. assign_each_index
+* uses it instead of the generic element by element evaluation, and passes on
+* the exceptions it throws (e.g. std::bad_alloc of its work buffers).
+ ******************************************************************************/
+template<typename Source, typename Destination>
+concept has_assign_to = requires(Source source, Destination& destination)
+{
+        source.assign_to(destination);
+};
+
+/***************************************************************************//**
+* Memory order of expressions. Leaves (and nodes forwarding the order of their
+* operands) define a layout_type, the mdspan layout policy of their elements.
+* Layouts for which left_order_layout is true store the first index fastest,
+* and are traversed with the first index innermost. Specialize it for other
+* column major layout policies (e.g. padded ones).
+ ******************************************************************************/
+template<typename Layout>
+inline constexpr bool left_order_layout = std::is_same_v<Layout, stdex::layout_left>;
+
+// Layout policy of an expression, void when unknown (e.g. computed elements)
+template<typename Expr>
+struct layout_of
+{
+        using type = void;
+};
+template<typename Expr>
+requires requires { typename std::remove_cvref_t<Expr>::layout_type; }
+struct layout_of<Expr>
+{
+        using type = typename std::remove_cvref_t<Expr>::layout_type;
+};
+template<typename Expr>
+using layout_of_t = typename layout_of<Expr>::type;
+
+/***************************************************************************//**
+* Memory order of expressions combining operands of different orders, e.g.
+* A + transpose(B), with dimension Dim fastest in one operand and the last
+* dimension fastest in the other. Such expressions are traversed tile by tile
+* over these two dimensions, so the operands are both read from cache.
+ ******************************************************************************/
+template<std::size_t Dim>
+struct layout_tiled {};
+
+namespace detail
+{
+        // Unrelated layouts, traversed in the default (row major) order
+        template<typename LHS, typename RHS>
+        struct common_layout
+        {
+                using type = stdex::layout_right;
+        };
+        template<typename Layout>
+        struct common_layout<Layout, Layout> {using type = Layout;};
+        template<typename Layout>
+        struct common_layout<Layout, void> {using type = Layout;};
+        template<typename Layout>
+        struct common_layout<void, Layout> {using type = Layout;};
+        template<>
+        struct common_layout<void, void> {using type = void;};
+        template<>
+        struct common_layout<stdex::layout_right, stdex::layout_left> {using type = layout_tiled<0>;};
+        template<>
+        struct common_layout<stdex::layout_left, stdex::layout_right> {using type = layout_tiled<0>;};
+        template<std::size_t Dim>
+        struct common_layout<stdex::layout_right, layout_tiled<Dim>> {using type = layout_tiled<Dim>;};
+        template<std::size_t Dim>
+        struct common_layout<layout_tiled<Dim>, stdex::layout_right> {using type = layout_tiled<Dim>;};
+        template<std::size_t Dim>
+        struct common_layout<stdex::layout_left, layout_tiled<Dim>> {using type = layout_tiled<0>;};
+        template<std::size_t Dim>
+        struct common_layout<layout_tiled<Dim>, stdex::layout_left> {using type = layout_tiled<0>;};
+        template<std::size_t Dim1, std::size_t Dim2>
+        requires (Dim1 != Dim2)
+        struct common_layout<layout_tiled<Dim1>, layout_tiled<Dim2>> {using type = layout_tiled<Dim1>;};
+}; // detail
+
+// Order in which to traverse two expressions (or an expression and its
+// destination) together: the known one if only one is known, tiled if one is
+// row and the other column major (or permuted)
+template<typename LHS, typename RHS>
+using common_layout_t = typename detail::common_layout<layout_of_t<LHS>, layout_of_t<RHS>>::type;
+
 template<typename IndexType, size_t... Extents, std::size_t Exti, std::size_t... Exts>
 constexpr inline size_t ext_size(const stdex::extents<IndexType, Extents...>& exts, std::index_sequence<Exti, Exts...>) noexcept
 {
@@ -22,6 +123,49 @@ constexpr inline size_t ext_size(const stdex::extents<IndexType, Extents...>& ex
     return ext_size(exts, std::make_index_sequence<sizeof...(Extents)>{});
 }
 
+/***************************************************************************//**
+* Loops over fully static extents with at most unroll_limit elements are
+* unrolled at compile time, the indices of every iteration being constants.
+* This lets small fixed size expressions (3x3, 4x4 matrices) be evaluated
+* without any loop overhead, with the elements kept in registers.
+ ******************************************************************************/
+inline constexpr std::size_t unroll_limit = 256;
+
+template<typename Extents>
+concept small_static_extents = Extents::rank() > 0 && Extents::rank_dynamic() == 0 && ext_size(Extents{}) <= unroll_limit;
+
+// Calls op(std::integral_constant<std::size_t, I>{}) for I = 0, ..., N - 1, unrolled
+template<std::size_t N, typename Operator>
+constexpr inline void static_for(Operator&& op)
+{
+    [&]<std::size_t... Is>(std::index_sequence<Is...>){
+        (op(std::integral_constant<std::size_t, Is>{}), ...);
+    }(std::make_index_sequence<N>{});
+}
+
+// Index along dimension d of the element with row major number n
+template<typename Extents>
+constexpr inline typename Extents::index_type unravel_index(std::size_t n, std::size_t d) noexcept
+{
+    for(std::size_t e = Extents::rank() - 1; e > d; e--){
+        n /= Extents::static_extent(e);
+    }
+    return static_cast<typename Extents::index_type>(n % Extents::static_extent(d));
+}
+
+template<typename Extents, std::size_t N, std::size_t... Ds, typename Operator>
+constexpr inline void call_unraveled(Operator& op, std::index_sequence<Ds...>)
+{
+    constexpr std::array<typename Extents::index_type, sizeof...(Ds)> indices{unravel_index<Extents>(N, Ds)...};
+    op(indices[Ds]...);
+}
+
+template<typename Extents, typename Operator, std::size_t... Ns>
+constexpr inline void for_each_index_unrolled(Operator& op, std::index_sequence<Ns...>)
+{
+    (call_unraveled<Extents, Ns>(op, std::make_index_sequence<Extents::rank()>{}), ...);
+}
+
 template<typename IndexType, std::size_t ... Extents, typename Operator,
          std::size_t Exti, std::size_t... Exts, typename... Indices>
 constexpr inline void for_each_index(const stdex::extents<IndexType, Extents...>& ext, Operator&& op,
@@ -39,7 +183,105 @@ constexpr inline void for_each_index(const stdex::extents<IndexType, Extents...>
 template<class IndexType, std::size_t ... Extents, typename Operator>
 constexpr inline void for_each_index(stdex::extents<IndexType, Extents...> ext, Operator&& op) noexcept
 {
-    for_each_index(ext, std::forward<Operator>(op), std::make_index_sequence<sizeof...(Extents)>{});
+    using Exts = stdex::extents<IndexType, Extents...>;
+    if constexpr(small_static_extents<Exts>){
+        for_each_index_unrolled<Exts>(op, std::make_index_sequence<ext_size(Exts{})>{});
+    }else{
+        for_each_index(ext, std::forward<Operator>(op), std::make_index_sequence<sizeof...(Extents)>{});
+    }
+}
+
+// Visits the indices with the first one fastest, dimension Exti being the outermost loop
+template<typename IndexType, std::size_t ... Extents, typename Operator, std::size_t Exti, std::size_t... Exts>
+constexpr inline void for_each_index_left(const stdex::extents<IndexType, Extents...>& ext, Operator&& op,
+                  std::index_sequence<Exti, Exts...>, std::array<IndexType, sizeof...(Extents)>& indices) noexcept
+{
+    for(indices[Exti] = 0; indices[Exti] < ext.extent(Exti); indices[Exti]++){
+        if constexpr(sizeof...(Exts) > 0){
+            for_each_index_left(ext, std::forward<Operator>(op), std::index_sequence<Exts...>{}, indices);
+        }else{
+            std::apply(op, std::as_const(indices));
+        }
+    }
+}
+
+// Side of the square tiles of tiled traversals
+inline constexpr std::size_t traversal_tile = 32;
+
+// Loops over the dimensions from D on, except Dim and the last one, then calls inner()
+template<std::size_t D, std::size_t Dim, typename IndexType, std::size_t ... Extents, typename Inner>
+constexpr inline void for_each_outer_index(const stdex::extents<IndexType, Extents...>& ext,
+                  std::array<IndexType, sizeof...(Extents)>& indices, Inner& inner) noexcept
+{
+    if constexpr(D + 1 == sizeof...(Extents)){
+        inner();
+    }else if constexpr(D == Dim){
+        for_each_outer_index<D + 1, Dim>(ext, indices, inner);
+    }else{
+        for(indices[D] = 0; indices[D] < ext.extent(D); indices[D]++){
+            for_each_outer_index<D + 1, Dim>(ext, indices, inner);
+        }
+    }
+}
+
+/***************************************************************************//**
+* Visits all indices of ext in square tiles of traversal_tile x traversal_tile
+* elements over dimension Dim and the last dimension, the other dimensions
+* being looped over within each tile. Expressions contiguous along either of
+* the two dimensions touch only traversal_tile cache lines per tile.
+ ******************************************************************************/
+template<std::size_t Dim, class IndexType, std::size_t ... Extents, typename Operator>
+constexpr inline void for_each_index_tiled(const stdex::extents<IndexType, Extents...>& ext, Operator&& op) noexcept
+{
+    constexpr std::size_t last = sizeof...(Extents) - 1;
+    constexpr IndexType tile = static_cast<IndexType>(traversal_tile);
+    std::array<IndexType, sizeof...(Extents)> indices{};
+    for(IndexType ii = 0; ii < ext.extent(Dim); ii += tile){
+        const IndexType i_end = std::min<IndexType>(ext.extent(Dim), ii + tile);
+        for(IndexType jj = 0; jj < ext.extent(last); jj += tile){
+            const IndexType j_end = std::min<IndexType>(ext.extent(last), jj + tile);
+            auto visit_tile = [&](){
+                for(indices[Dim] = ii; indices[Dim] < i_end; indices[Dim]++){
+                    for(indices[last] = jj; indices[last] < j_end; indices[last]++){
+                        std::apply(op, std::as_const(indices));
+                    }
+                }
+            };
+            for_each_outer_index<0, Dim>(ext, indices, visit_tile);
+        }
+    }
+}
+
+template<typename Layout>
+inline constexpr bool is_tiled_layout = false;
+template<std::size_t Dim>
+inline constexpr bool is_tiled_layout<layout_tiled<Dim>> = true;
+
+template<typename Layout>
+inline constexpr std::size_t tiled_dim = 0;
+template<std::size_t Dim>
+inline constexpr std::size_t tiled_dim<layout_tiled<Dim>> = Dim;
+
+/***************************************************************************//**
+* Calls op(indices...) for all indices of ext, in the memory order of Layout:
+* the first index innermost for left ordered (column major) layouts, the last
+* one otherwise (also when Layout is void, i.e. unknown), and in tiles for
+* mixed (layout_tiled) orders.
+ ******************************************************************************/
+template<typename Layout, class IndexType, std::size_t ... Extents, typename Operator>
+constexpr inline void for_each_index_ordered(stdex::extents<IndexType, Extents...> ext, Operator&& op) noexcept
+{
+    using Exts = stdex::extents<IndexType, Extents...>;
+    if constexpr(is_tiled_layout<Layout> && !small_static_extents<Exts> && tiled_dim<Layout> + 1 < sizeof...(Extents)){
+        for_each_index_tiled<tiled_dim<Layout>>(ext, op);
+    }else if constexpr(left_order_layout<Layout> && !small_static_extents<Exts> && sizeof...(Extents) > 1){
+        std::array<IndexType, sizeof...(Extents)> indices{};
+        [&]<std::size_t... Ds>(std::index_sequence<Ds...>){
+            for_each_index_left(ext, op, std::index_sequence<(sizeof...(Extents) - 1 - Ds)...>{}, indices);
+        }(std::make_index_sequence<sizeof...(Extents)>{});
+    }else{
+        for_each_index(ext, std::forward<Operator>(op));
+    }
 }
 
 template<typename Source1, typename Source2, typename Destination, typename IndexType, typename Operator, std::size_t ... Extents>
@@ -53,7 +295,7 @@ constexpr inline void transform_each_index(Source1&& source1, Source2&& source2,
                 destination[indices...] = std::forward<Operator>(op)(std::forward<Source1>(source1)[indices...], std::forward<Source2>(source2)[indices...]);
 #endif
         };
-    for_each_index(ext, std::move(transform));
+    for_each_index_ordered<layout_of_t<Destination>>(ext, std::move(transform));
 }
 
 template<typename Source1, typename Source2, typename Destination, typename Operator>
@@ -73,7 +315,7 @@ constexpr inline void transform_each_index(Source&& source, Destination& destina
                 destination[indices...] = std::forward<Operator>(op)(std::forward<Source>(source)[indices...]);
 #endif
         };
-    for_each_index(ext, std::move(transform));
+    for_each_index_ordered<layout_of_t<Destination>>(ext, std::move(transform));
 }
 
 template<typename Source, typename Destination, typename Operator>
@@ -83,21 +325,44 @@ constexpr inline void transform_each_index(Source&& source, Destination& destina
 }
 
 template<typename Source, typename Destination, typename IndexType, std::size_t ... Extents>
-constexpr inline void assign_each_index(Source&& source, Destination& destination, const stdex::extents<IndexType, Extents...>& ext) noexcept
+constexpr inline void assign_each_index(Source&& source, Destination& destination, const stdex::extents<IndexType, Extents...>& ext) noexcept(!has_assign_to<Source, Destination>)
 {
-    auto assign = [&](auto... indices)
-        {
+    if constexpr(has_assign_to<Source, Destination>){
+        // Dedicated kernels are not usable in constant expressions, these are
+        // evaluated element by element below
+        if !consteval{
+            source.assign_to(destination);
+            return;
+        }
+    }
+    if constexpr(requires(std::size_t n){destination.flat(n) = source.flat(n);}){
+        if constexpr(small_static_extents<stdex::extents<IndexType, Extents...>>){
+            static_for<ext_size(stdex::extents<IndexType, Extents...>{})>([&](auto n){
+                destination.flat(n) = source.flat(n);
+            });
+            return;
+        }
+        const size_t size = ext_size(ext);
+        for(size_t n = 0; n < size; n++){
+            destination.flat(n) = source.flat(n);
+        }
+    }else{
+        auto assign = [&](auto... indices)
+            {
 #ifdef CLANGBUG
-                destination(indices...) = std::forward<Source>(source)(indices...);
+                    destination(indices...) = std::forward<Source>(source)(indices...);
 #else
-                destination[indices...] = std::forward<Source>(source)[indices...];
+                    destination[indices...] = std::forward<Source>(source)[indices...];
 #endif
-        };
-    for_each_index(ext, std::move(assign));
+            };
+        // Traverse in the memory order of the destination and the source,
+        // tiled if they differ (e.g. assigning a transpose)
+        for_each_index_ordered<common_layout_t<Destination, Source>>(ext, std::move(assign));
+    }
 }
 
 template<typename Source, typename Destination>
-constexpr inline void assign_each_index(Source&& source, Destination& destination) noexcept
+constexpr inline void assign_each_index(Source&& source, Destination& destination) noexcept(!has_assign_to<Source, Destination>)
 {
         assign_each_index(std::forward<Source>(source), destination, source.extents());
 }
@@ -105,15 +370,26 @@ constexpr inline void assign_each_index(Source&& source, Destination& destinatio
 template<typename Source, typename Accumulator, typename IndexType, std::size_t ... Extents, typename Operator>
 constexpr inline Accumulator reduce_each_index(Source&& source, Accumulator acc, const stdex::extents<IndexType, Extents...>& ext, Operator&& op) noexcept
 {
-    auto reduce = [&](auto... indices)
-        {
+    if constexpr(has_flat_access<Source> && small_static_extents<stdex::extents<IndexType, Extents...>>){
+        static_for<ext_size(stdex::extents<IndexType, Extents...>{})>([&](auto n){
+            acc = std::forward<Operator>(op)(acc, source.flat(n));
+        });
+    }else if constexpr(has_flat_access<Source>){
+        const size_t size = ext_size(ext);
+        for(size_t n = 0; n < size; n++){
+            acc = std::forward<Operator>(op)(acc, source.flat(n));
+        }
+    }else{
+        auto reduce = [&](auto... indices)
+            {
 #ifdef CLANGBUG
-                acc = std::forward<Operator>(op)(acc, std::forward<Source>(source)(indices...));
+                    acc = std::forward<Operator>(op)(acc, std::forward<Source>(source)(indices...));
 #else
-                acc = std::forward<Operator>(op)(acc, std::forward<Source>(source)[indices...]);
+                    acc = std::forward<Operator>(op)(acc, std::forward<Source>(source)[indices...]);
 #endif
-        };
-    for_each_index(ext, std::move(reduce));
+            };
+        for_each_index_ordered<layout_of_t<Source>>(ext, std::move(reduce));
+    }
     return acc;
 }
 
@@ -0,0 +1,150 @@
+#ifndef EXPR_TEMPLATE_GEMM_H
+#define EXPR_TEMPLATE_GEMM_H
+
+#include <parallel.h>
+#include <extents_utils.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace expr::detail
+{
+
+// Cache blocking of the GEMM kernel, rows of A, depth and columns of B per block
+inline constexpr std::size_t gemm_mc = 64;
+inline constexpr std::size_t gemm_kc = 256;
+inline constexpr std::size_t gemm_nc = 512;
+// Side of the square tiles in which transposed operands are packed
+inline constexpr std::size_t transpose_tile = 32;
+// Minimum number of multiply-adds worth handing to a thread
+inline constexpr std::size_t gemm_parallel_work = std::size_t(1) << 16;
+
+/***************************************************************************//**
+* Blocked GEMM on packed, row major matrices, computing rows
+* [row_begin, row_end) of C = A*B, where A is m x k, B is k x n and C is m x n.
+* The innermost loop runs over contiguous columns of B and C, so it vectorizes,
+* and the blocking keeps the active panel of B in cache.
+ ******************************************************************************/
+template<typename T>
+inline void gemm_rows(const T* a, const T* b, T* c, std::size_t n, std::size_t k, std::size_t row_begin, std::size_t row_end) noexcept
+{
+        std::fill(c + row_begin*n, c + row_end*n, T(0));
+        for(std::size_t kk = 0; kk < k; kk += gemm_kc){
+                const std::size_t k_end = std::min(k, kk + gemm_kc);
+                for(std::size_t jj = 0; jj < n; jj += gemm_nc){
+                        const std::size_t j_end = std::min(n, jj + gemm_nc);
+                        for(std::size_t ii = row_begin; ii < row_end; ii += gemm_mc){
+                                const std::size_t i_end = std::min(row_end, ii + gemm_mc);
+                                for(std::size_t i = ii; i < i_end; i++){
+                                        T* c_i = c + i*n;
+                                        for(std::size_t kx = kk; kx < k_end; kx++){
+                                                const T a_ik = a[i*k + kx];
+                                                const T* b_k = b + kx*n;
+                                                for(std::size_t j = jj; j < j_end; j++){
+                                                        c_i[j] += a_ik*b_k[j];
+                                                }
+                                        }
+                                }
+                        }
+                }
+        }
+}
+
+// Largest number of multiply-adds of a fully unrolled small GEMM (16x16x16)
+inline constexpr std::size_t small_gemm_limit = 16*16*16;
+
+/***************************************************************************//**
+* Fully unrolled GEMM of small, fixed size row major matrices, C = A*B with A
+* M x K and B K x N. A row of C is accumulated in registers, the products
+* for all columns of a row of B being independent so they vectorize.
+ ******************************************************************************/
+template<typename T, std::size_t M, std::size_t N, std::size_t K>
+constexpr inline void small_gemm(const std::array<T, M*K>& a, const std::array<T, K*N>& b, std::array<T, M*N>& c) noexcept
+{
+        exts::static_for<M>([&](auto i){
+                std::array<T, N> c_i{};
+                exts::static_for<K>([&](auto kx){
+                        const T a_ik = a[i*K + kx];
+                        exts::static_for<N>([&](auto j){
+                                c_i[j] += a_ik*b[kx*N + j];
+                        });
+                });
+                exts::static_for<N>([&](auto j){
+                        c[i*N + j] = c_i[j];
+                });
+        });
+}
+
+/***************************************************************************//**
+* Batched GEMM engine. For every batch b, pack_a(b, a) and pack_b(b, b_buf)
+* write the m x k and k x n operands of that batch into row major buffers, the
+* product is computed with the blocked kernel and store(b, c) writes the m x n
+* result back. With at least as many batches as threads (or little work per
+* product) the batches are distributed over the threads, otherwise the batches
+* are computed one at a time with the rows of each product split over the
+* threads.
+ ******************************************************************************/
+template<typename T, typename PackA, typename PackB, typename Store>
+inline void batched_gemm(std::size_t batches, std::size_t m, std::size_t n, std::size_t k, PackA&& pack_a, PackB&& pack_b, Store&& store)
+{
+        if(batches == 0 || m == 0 || n == 0){
+                return;
+        }
+        const std::size_t work = std::max<std::size_t>(1, m*n*k);
+        if(batches >= num_threads() || work < gemm_parallel_work){
+                const std::size_t grain = std::max<std::size_t>(1, gemm_parallel_work/work);
+                parallel_for(std::size_t(0), batches, grain, [&](std::size_t begin, std::size_t end){
+                        std::vector<T> a(m*k), b(k*n), c(m*n);
+                        for(std::size_t batch = begin; batch < end; batch++){
+                                pack_a(batch, a.data());
+                                pack_b(batch, b.data());
+                                gemm_rows(a.data(), b.data(), c.data(), n, k, 0, m);
+                                store(batch, static_cast<const T*>(c.data()));
+                        }
+                });
+        }else{
+                std::vector<T> a(m*k), b(k*n), c(m*n);
+                const std::size_t row_grain = std::max<std::size_t>(1, gemm_parallel_work/std::max<std::size_t>(1, n*k));
+                for(std::size_t batch = 0; batch < batches; batch++){
+                        pack_a(batch, a.data());
+                        pack_b(batch, b.data());
+                        parallel_for(std::size_t(0), m, row_grain, [&](std::size_t begin, std::size_t end){
+                                gemm_rows(a.data(), b.data(), c.data(), n, k, begin, end);
+                        });
+                        store(batch, static_cast<const T*>(c.data()));
+                }
+        }
+}
+
+/***************************************************************************//**
+* Batched GEMM on operands already stored as consecutive row major matrices,
+* c[b] = a[b]*b[b] for every batch b, with the same scheduling as
+* batched_gemm.
+ ******************************************************************************/
+template<typename T>
+inline void batched_gemm_packed(std::size_t batches, std::size_t m, std::size_t n, std::size_t k, const T* a, const T* b, T* c)
+{
+        if(batches == 0 || m == 0 || n == 0){
+                return;
+        }
+        const std::size_t work = std::max<std::size_t>(1, m*n*k);
+        if(batches >= num_threads() || work < gemm_parallel_work){
+                const std::size_t grain = std::max<std::size_t>(1, gemm_parallel_work/work);
+                parallel_for(std::size_t(0), batches, grain, [&](std::size_t begin, std::size_t end){
+                        for(std::size_t batch = begin; batch < end; batch++){
+                                gemm_rows(a + batch*m*k, b + batch*k*n, c + batch*m*n, n, k, 0, m);
+                        }
+                });
+        }else{
+                const std::size_t row_grain = std::max<std::size_t>(1, gemm_parallel_work/std::max<std::size_t>(1, n*k));
+                for(std::size_t batch = 0; batch < batches; batch++){
+                        parallel_for(std::size_t(0), m, row_grain, [&](std::size_t begin, std::size_t end){
+                                gemm_rows(a + batch*m*k, b + batch*k*n, c + batch*m*n, n, k, begin, end);
+                        });
+                }
+        }
+}
+
+}; // expr::detail
+#endif // EXPR_TEMPLATE_GEMM_H
@@ -0,0 +1,312 @@
+#ifndef EXPR_TEMPLATE_HISTOGRAM_EXPRESSION_H
+#define EXPR_TEMPLATE_HISTOGRAM_EXPRESSION_H
+
+#include <base_expression.h>
+#include <conditional_expression.h>
+#include <extents_utils.h>
+#include <parallel.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace expr
+{
+
+namespace detail
+{
+        // Elements counted per thread at least
+        inline constexpr std::size_t histogram_grain = std::size_t(1) << 16;
+        // Bin indices computed at a time, in a loop of their own, before counting them
+        inline constexpr std::size_t histogram_batch = 256;
+
+        inline std::int32_t checked_bins(std::size_t nbins)
+        {
+                if(nbins == 0 || nbins >= static_cast<std::size_t>(std::numeric_limits<std::int32_t>::max())){
+                        throw std::runtime_error("Invalid number of histogram bins!\n" + std::to_string(nbins));
+                }
+                return static_cast<std::int32_t>(nbins);
+        }
+
+        /***********************************************************************
+        * Bins of equal width over [lo, hi], the last one including hi. The bin
+        * of an element is computed with a multiplication and a conversion,
+        * without any branches, elements outside getting the index nbins.
+         **********************************************************************/
+        struct uniform_bins
+        {
+                double lo;
+                double hi;
+                double scale;
+                std::int32_t nbins;
+
+                uniform_bins(std::size_t n, double low, double high)
+                        : lo(low), hi(high), scale(static_cast<double>(n)/(high - low)), nbins(checked_bins(n))
+                {
+                        if(!(low < high)){
+                                throw std::runtime_error("Histogram range must be increasing!\n" + std::to_string(low) + " >= " + std::to_string(high));
+                        }
+                }
+
+                constexpr std::size_t size() const noexcept {return static_cast<std::size_t>(nbins);}
+
+                template<typename T>
+                constexpr std::int32_t operator()(const T& x) const noexcept
+                {
+                        const double v = convert<double>(x);
+                        const double t = std::min((v - lo)*scale, static_cast<double>(nbins - 1));
+                        // Both comparisons are evaluated (&, not &&), so the
+                        // selection is not a branch and the loop vectorizes
+                        return static_cast<std::int32_t>((v >= lo) & (v <= hi) ? t : static_cast<double>(nbins));
+                }
+        };
+
+        /***********************************************************************
+        * Bins between consecutive (increasing) edges, the last one including
+        * the last edge. For edges of (nearly) equal widths the bin is
+        * estimated as for uniform bins then corrected by comparing with the
+        * edges next to it, otherwise it is searched for.
+         **********************************************************************/
+        struct edge_bins
+        {
+                std::vector<double> edges;
+                double scale;
+                std::int32_t nbins;
+                bool uniform;
+
+                explicit edge_bins(std::vector<double>&& e)
+                        : edges(std::move(e)), scale(0.), nbins(0), uniform(true)
+                {
+                        if(edges.size() < 2){
+                                throw std::runtime_error("Histograms need at least two edges!\n" + std::to_string(edges.size()));
+                        }
+                        nbins = checked_bins(edges.size() - 1);
+                        const double width = (edges.back() - edges.front())/static_cast<double>(nbins);
+                        scale = 1./width;
+                        for(std::size_t b = 0; b + 1 < edges.size(); b++){
+                                if(!(edges[b] < edges[b + 1])){
+                                        throw std::runtime_error("Histogram edges must be increasing!\nEdge " + std::to_string(b + 1) + ": " + std::to_string(edges[b + 1]) + " <= " + std::to_string(edges[b]));
+                                }
+                                uniform = uniform && std::abs(edges[b] - (edges.front() + static_cast<double>(b)*width)) <= 1e-6*width;
+                        }
+                }
+
+                std::size_t size() const noexcept {return static_cast<std::size_t>(nbins);}
+
+                template<typename T>
+                std::int32_t operator()(const T& x) const noexcept
+                {
+                        const double v = convert<double>(x);
+                        if(!(v >= edges.front() && v <= edges.back())){
+                                return nbins;
+                        }
+                        if(uniform){
+                                auto b = static_cast<std::int32_t>(std::min((v - edges.front())*scale, static_cast<double>(nbins - 1)));
+                                b -= v < edges[static_cast<std::size_t>(b)];
+                                b += b + 1 < nbins && v >= edges[static_cast<std::size_t>(b + 1)];
+                                return b;
+                        }
+                        const auto b = std::upper_bound(edges.begin(), edges.end(), v) - edges.begin() - 1;
+                        return std::min(static_cast<std::int32_t>(b), nbins - 1);
+                }
+        };
+
+        // Bins of the integers 0, ..., nbins - 1
+        struct integer_bins
+        {
+                std::int32_t nbins;
+
+                explicit integer_bins(std::size_t n) : nbins(checked_bins(n)) {}
+
+                constexpr std::size_t size() const noexcept {return static_cast<std::size_t>(nbins);}
+
+                template<std::integral T>
+                constexpr std::int32_t operator()(const T& x) const noexcept
+                {
+                        return std::cmp_greater_equal(x, 0) & std::cmp_less(x, nbins) ? convert<std::int32_t>(x) : nbins;
+                }
+        };
+}; // detail
+
+/***************************************************************************//**
+* HistogramOp represents the number of elements of an expression in each of
+* a number of bins, a 1D expression of std::size_t. Elements outside all bins
+* are not counted.
+*
+* A single bin is counted with a pass over the expression, all of them
+* (assign_to) with one parallel pass: every thread counts a part of the
+* elements into a private array of bins, padded to whole cache lines so
+* threads never write to the same line, and these are summed at the end.
+* Bin indices are computed a batch at a time in a loop of their own, which
+* vectorizes for uniform bins, before the counts are incremented.
+ ******************************************************************************/
+template<expression Expr, typename Bins>
+class HistogramOp : public BaseExpr<HistogramOp<Expr, Bins>>
+{
+    public:
+        using Base = BaseExpr<HistogramOp<Expr, Bins>>;
+        using Expr_noref = std::remove_cvref_t<Expr>;
+        using value_type = std::size_t;
+        using extents_type = stdex::dextents<std::size_t, 1>;
+        using source_extents_type = decltype(std::declval<Expr_noref>().extents());
+        using source_index_type = typename source_extents_type::index_type;
+        static constexpr std::size_t source_rank = source_extents_type::rank();
+
+        explicit HistogramOp(Expr&& expr, Bins&& bins)
+         : Base(), m_expr(std::forward<Expr>(expr)), m_bins(std::move(bins))
+        {}
+        explicit HistogramOp(const HistogramOp&) = default;
+        explicit HistogramOp(HistogramOp&&) noexcept = default;
+        ~HistogramOp() noexcept = default;
+
+        constexpr extents_type extents() const noexcept {return extents_type(m_bins.size());}
+        constexpr std::size_t extent(std::size_t) const noexcept {return m_bins.size();}
+
+#ifdef CLANGBUG
+        value_type operator()(auto&& index) const {return count(detail::convert<std::int32_t>(index));}
+#endif
+        value_type operator[](auto&& index) const {return count(detail::convert<std::int32_t>(index));}
+
+        /***************************************************************
+        * Count all bins into destination.
+         **************************************************************/
+        template<typename Destination>
+        void assign_to(Destination& destination) const
+        {
+                const std::size_t total = exts::ext_size(m_expr.extents());
+                const std::size_t nbins = m_bins.size();
+                if(total == 0){
+                        for(std::size_t b = 0; b < nbins; b++){
+                                detail::subscript(destination, b) = 0;
+                        }
+                        return;
+                }
+                // One more bin for the elements outside, and a line
+                // between the bins of two threads
+                constexpr std::size_t line = detail::cache_line_bytes/sizeof(std::size_t);
+                const std::size_t stride = (nbins + line)/line*line + line;
+                const std::size_t parts = std::clamp<std::size_t>(total/detail::histogram_grain, 1, num_threads());
+                std::vector<std::size_t> counts(parts*stride, 0);
+                parallel_for(std::size_t(0), parts, std::size_t(1), [&](std::size_t begin, std::size_t end){
+                        for(std::size_t p = begin; p < end; p++){
+                                count_range(p*total/parts, (p + 1)*total/parts, counts.data() + p*stride);
+                        }
+                });
+                for(std::size_t b = 0; b < nbins; b++){
+                        std::size_t sum = 0;
+                        for(std::size_t p = 0; p < parts; p++){
+                                sum += counts[p*stride + b];
+                        }
+                        detail::subscript(destination, b) = sum;
+                }
+        }
+
+        HistogramOp& operator=(const HistogramOp&) = default;
+        HistogramOp& operator=(HistogramOp&&) noexcept = default;
+        constexpr auto operands() const noexcept {return std::forward_as_tuple(m_expr);}
+    private:
+        std::remove_cv_t<Expr> m_expr;
+        Bins m_bins;
+
+        value_type count(std::int32_t bin) const
+        {
+                auto f = [&](std::size_t acc, const auto& x){return acc + (m_bins(x) == bin);};
+                return exts::reduce_each_index(m_expr, std::size_t(0), m_expr.extents(), f);
+        }
+
+        // Counts the elements [first, last), in row major order, into bins
+        void count_range(std::size_t first, std::size_t last, std::size_t* bins) const
+        {
+                std::array<std::int32_t, detail::histogram_batch> index;
+                std::array<source_index_type, source_rank> indices = unravel(first);
+                for(std::size_t n = first; n < last; n += detail::histogram_batch){
+                        const std::size_t len = std::min(detail::histogram_batch, last - n);
+                        if constexpr(exts::has_flat_access<Expr>){
+                                for(std::size_t j = 0; j < len; j++){
+                                        index[j] = m_bins(m_expr.flat(n + j));
+                                }
+                        }else{
+                                for(std::size_t j = 0; j < len; j++){
+                                        index[j] = m_bins(std::apply([&](auto... i){ return detail::subscript(m_expr, i...); }, indices));
+                                        next(indices);
+                                }
+                        }
+                        for(std::size_t j = 0; j < len; j++){
+                                bins[index[j]]++;
+                        }
+                }
+        }
+
+        // Indices of the n:th element in row major order, all extents
+        // must be non-zero
+        std::array<source_index_type, source_rank> unravel(std::size_t n) const noexcept
+        {
+                std::array<source_index_type, source_rank> indices{};
+                for(std::size_t d = source_rank; d-- > 0;){
+                        const auto e = static_cast<std::size_t>(m_expr.extent(d));
+                        indices[d] = static_cast<source_index_type>(n%e);
+                        n /= e;
+                }
+                return indices;
+        }
+
+        // Advances indices to the next element in row major order
+        void next(std::array<source_index_type, source_rank>& indices) const noexcept
+        {
+                for(std::size_t d = source_rank; d-- > 0;){
+                        if(++indices[d] < m_expr.extent(d) || d == 0){
+                                return;
+                        }
+                        indices[d] = 0;
+                }
+        }
+};
+
+/***************************************************************************//**
+* Returns the histogram of expr over the bins between consecutive elements
+* of the (increasing) 1D expression edges, [edges[b], edges[b + 1]), the
+* last bin also including the last edge.
+ ******************************************************************************/
+template<expression Expr, expression Edges>
+inline auto histogram(Expr&& expr, const Edges& edges)
+{
+        static_assert(decltype(edges.extents())::rank() == 1, "Histogram edges must be a 1D expression");
+        std::vector<double> e(static_cast<std::size_t>(edges.extent(0)));
+        for(std::size_t b = 0; b < e.size(); b++){
+                e[b] = detail::convert<double>(detail::subscript(edges, static_cast<typename decltype(edges.extents())::index_type>(b)));
+        }
+        return HistogramOp<Expr, detail::edge_bins>(std::forward<Expr>(expr), detail::edge_bins(std::move(e)));
+}
+
+/***************************************************************************//**
+* Returns the histogram of expr over nbins bins of equal width covering
+* [lo, hi], the bin of x being floor((x - lo)*nbins/(hi - lo)) (nbins - 1
+* for hi).
+ ******************************************************************************/
+template<expression Expr>
+inline auto histogram(Expr&& expr, std::size_t nbins, double lo, double hi)
+{
+        return HistogramOp<Expr, detail::uniform_bins>(std::forward<Expr>(expr), detail::uniform_bins(nbins, lo, hi));
+}
+
+/***************************************************************************//**
+* Returns the number of occurrences of each of the integers 0, ..., nbins - 1
+* in the integer expression expr.
+ ******************************************************************************/
+template<expression Expr>
+requires std::integral<typename std::remove_cvref_t<Expr>::value_type>
+inline auto bincount(Expr&& expr, std::size_t nbins)
+{
+        return HistogramOp<Expr, detail::integer_bins>(std::forward<Expr>(expr), detail::integer_bins(nbins));
+}
+
+}; // expr
+#endif // EXPR_TEMPLATE_HISTOGRAM_EXPRESSION_H
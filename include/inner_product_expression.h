@@ -0,0 +1,313 @@
+#ifndef EXPR_TEMPLATE_INNER_PRODUCT_EXPRESSION_H
+#define EXPR_TEMPLATE_INNER_PRODUCT_EXPRESSION_H
+
+#include <base_expression.h>
+#include <elementwise_binary_operators.h>
+#include <elementwise_nary_operators.h>
+#include <extents_utils.h>
+#include <cmath>
+#include <functional>
+#include <tuple>
+#include <utility>
+
+namespace expr
+{
+
+namespace detail
+{
+        // Independent partial sums of the inner product kernels
+        inline constexpr std::size_t inner_product_accumulators = 8;
+
+        /***********************************************************************
+        * Sum of n terms, term(acc, i) adding the i:th to acc. The terms are
+        * spread over inner_product_accumulators partial sums, which breaks the
+        * dependency chain of a single accumulator and lets the compiler keep the
+        * partial sums in vector registers, and are added pairwise at the end.
+         **********************************************************************/
+        template<typename T, typename Term>
+        constexpr inline T accumulate_terms(std::size_t n, Term&& term) noexcept
+        {
+                constexpr std::size_t K = inner_product_accumulators;
+                T acc[K]{};
+                std::size_t i = 0;
+                for(; i + K <= n; i += K){
+                        exts::static_for<K>([&](auto k){
+                                term(acc[k], i + k);
+                        });
+                }
+                for(; i < n; i++){
+                        term(acc[0], i);
+                }
+                for(std::size_t width = K/2; width > 0; width /= 2){
+                        for(std::size_t k = 0; k < width; k++){
+                                acc[k] += acc[k + width];
+                        }
+                }
+                return acc[0];
+        }
+
+        // Terms of the inner products, acc += x*y and acc += (x - y)^2, with fused multiply-adds
+        struct product_term
+        {
+                template<typename X, typename Y>
+                static constexpr auto value(X x, Y y) {return x*y;}
+                template<typename T, typename X, typename Y>
+                constexpr void operator()(T& acc, X x, Y y) const {acc = fused_multiply_add{}(x, y, acc);}
+        };
+        struct squared_difference_term
+        {
+                template<typename X, typename Y>
+                static constexpr auto value(X x, Y y) {return (x - y)*(x - y);}
+                template<typename T, typename X, typename Y>
+                constexpr void operator()(T& acc, X x, Y y) const
+                {
+                        const auto diff = x - y;
+                        acc = fused_multiply_add{}(diff, diff, acc);
+                }
+        };
+        struct square_term
+        {
+                template<typename X>
+                static constexpr auto value(X x) {return x*x;}
+                template<typename T, typename X>
+                constexpr void operator()(T& acc, X x) const {acc = fused_multiply_add{}(x, x, acc);}
+        };
+
+        struct sqrt_op
+        {
+                template<typename T>
+                constexpr T operator()(T val) const {return static_cast<T>(std::sqrt(val));}
+        };
+
+        template<typename Term, expression... Exprs>
+        using term_type = decltype(Term::value(std::declval<typename std::remove_reference_t<Exprs>::value_type>()...));
+}; // detail
+
+/***************************************************************************//**
+* InnerProductOp represents the sum of Term over the matching elements of one
+* or two expressions, passed through Finish: the dot product (DotProductOp),
+* squared euclidean distance or euclidean norm. The elementwise terms are never
+* formed as an expression of their own, expressions with flat access are summed
+* by a multi accumulator kernel using fused multiply-adds. The sum is not
+* computed until the scalar value is needed (via the conversion operator).
+ ******************************************************************************/
+template<typename Term, typename Finish, expression... Exprs>
+class InnerProductOp: public BaseExpr<InnerProductOp<Term, Finish, Exprs...>>{
+    public:
+        using Base = BaseExpr<InnerProductOp<Term, Finish, Exprs...>>;
+        using value_type = detail::term_type<Term, Exprs...>;
+
+        constexpr explicit InnerProductOp(Exprs&&... exprs) noexcept
+          : Base(), m_operands(std::forward<Exprs>(exprs)...)
+        {}
+        ~InnerProductOp() noexcept = default;
+
+        constexpr auto extents() const noexcept = delete;
+        constexpr auto extent(std::size_t i) const noexcept = delete;
+
+        constexpr operator value_type() const noexcept
+        {
+                const auto ext = std::get<0>(m_operands).extents();
+                return std::apply([&](const auto&... operands){
+                        if constexpr((exts::has_flat_access<Exprs> && ...)){
+                                return Finish{}(detail::accumulate_terms<value_type>(exts::ext_size(ext), [&](value_type& acc, std::size_t n){
+                                        Term{}(acc, operands.flat(n)...);
+                                }));
+                        }else{
+                                value_type acc{0};
+                                exts::for_each_index_ordered<typename detail::nary_layout<exts::layout_of_t<Exprs>...>::type>(ext, [&](auto... indices){
+                                        Term{}(acc, detail::subscript(operands, indices...)...);
+                                });
+                                return Finish{}(acc);
+                        }
+                }, m_operands);
+        }
+        constexpr explicit InnerProductOp(const InnerProductOp&) noexcept = default;
+        constexpr explicit InnerProductOp(InnerProductOp&&) noexcept = default;
+
+        constexpr InnerProductOp& operator=(const InnerProductOp&) noexcept = default;
+        constexpr InnerProductOp& operator=(InnerProductOp&&) noexcept = default;
+        constexpr auto operands() const noexcept
+        {
+                return std::apply([](const auto&... operands){ return std::forward_as_tuple(operands...); }, m_operands);
+        }
+    private:
+        constexpr explicit InnerProductOp() noexcept = default;
+        std::tuple<std::remove_cv_t<Exprs>...> m_operands;
+};
+
+template<expression LHS, expression RHS>
+using DotProductOp = InnerProductOp<detail::product_term, std::identity, LHS, RHS>;
+
+/***************************************************************************//**
+* RowwiseInnerProductOp represents the inner products (see InnerProductOp)
+* along the last dimension of one or two expressions, an expression with the
+* other dimensions. The second expression may also be a single row (of rank 1),
+* which is then used with every row of the first, e.g. the distances of a query
+* vector to each row of a matrix. A row is reduced when the element is
+* required (via the subscript operator), by the multi accumulator kernel for
+* expressions with flat access.
+ ******************************************************************************/
+template<typename Term, typename Finish, expression Expr, expression... Exprs>
+class RowwiseInnerProductOp: public BaseExpr<RowwiseInnerProductOp<Term, Finish, Expr, Exprs...>>{
+    public:
+        using Base = BaseExpr<RowwiseInnerProductOp<Term, Finish, Expr, Exprs...>>;
+        using value_type = detail::term_type<Term, Expr, Exprs...>;
+
+        static constexpr std::size_t rank = decltype(std::declval<const Expr&>().extents())::rank();
+        static_assert(rank >= 2, "Rowwise inner products require expressions of at least rank 2!");
+
+        constexpr explicit RowwiseInnerProductOp(Expr&& expr, Exprs&&... exprs) noexcept
+          : Base(), m_operands(std::forward<Expr>(expr), std::forward<Exprs>(exprs)...)
+        {}
+        ~RowwiseInnerProductOp() noexcept = default;
+
+        constexpr auto extents() const noexcept
+        {
+                const auto ext = std::get<0>(m_operands).extents();
+                using IndexType = typename decltype(ext)::index_type;
+                return [&]<std::size_t... Ds>(std::index_sequence<Ds...>){
+                        using Ext = decltype(ext);
+                        return stdex::extents<IndexType, Ext::static_extent(Ds)...>(ext.extent(Ds)...);
+                }(std::make_index_sequence<rank - 1>{});
+        }
+        constexpr auto extent(std::size_t i) const noexcept {return std::get<0>(m_operands).extent(i);}
+
+#ifdef CLANGBUG
+        constexpr value_type operator()(auto... indices) const {return row(indices...);}
+#endif
+        constexpr value_type operator[](auto... indices) const {return row(indices...);}
+
+        constexpr explicit RowwiseInnerProductOp(const RowwiseInnerProductOp&) noexcept = default;
+        constexpr explicit RowwiseInnerProductOp(RowwiseInnerProductOp&&) noexcept = default;
+
+        constexpr RowwiseInnerProductOp& operator=(const RowwiseInnerProductOp&) noexcept = default;
+        constexpr RowwiseInnerProductOp& operator=(RowwiseInnerProductOp&&) noexcept = default;
+        constexpr auto operands() const noexcept
+        {
+                return std::apply([](const auto&... operands){ return std::forward_as_tuple(operands...); }, m_operands);
+        }
+    private:
+        constexpr explicit RowwiseInnerProductOp() noexcept = default;
+        std::tuple<std::remove_cv_t<Expr>, std::remove_cv_t<Exprs>...> m_operands;
+
+        // Element k of row indices of operand, a single row being used for all rows
+        template<typename Operand>
+        static constexpr decltype(auto) element(const Operand& operand, std::size_t k, auto... indices)
+        {
+                if constexpr(decltype(operand.extents())::rank() == 1){
+                        return detail::subscript(operand, k);
+                }else{
+                        return detail::subscript(operand, indices..., k);
+                }
+        }
+
+        template<typename Operand>
+        static constexpr decltype(auto) flat_element(const Operand& operand, std::size_t offset, std::size_t k)
+        {
+                if constexpr(decltype(operand.extents())::rank() == 1){
+                        return operand.flat(k);
+                }else{
+                        return operand.flat(offset + k);
+                }
+        }
+
+        constexpr value_type row(auto... indices) const
+        {
+                const auto& first = std::get<0>(m_operands);
+                const std::size_t n = static_cast<std::size_t>(first.extent(rank - 1));
+                return std::apply([&](const auto&... operands){
+                        if constexpr(exts::has_flat_access<Expr> && (exts::has_flat_access<Exprs> && ...)){
+                                // Row major: the row starts at the linear index of indices times n
+                                std::size_t offset = 0;
+                                std::size_t d = 0;
+                                ((offset = offset*static_cast<std::size_t>(first.extent(d++)) + static_cast<std::size_t>(indices)), ...);
+                                offset *= n;
+                                return Finish{}(detail::accumulate_terms<value_type>(n, [&](value_type& acc, std::size_t k){
+                                        Term{}(acc, flat_element(operands, offset, k)...);
+                                }));
+                        }else{
+                                return Finish{}(detail::accumulate_terms<value_type>(n, [&](value_type& acc, std::size_t k){
+                                        Term{}(acc, element(operands, k, indices...)...);
+                                }));
+                        }
+                }, m_operands);
+        }
+};
+
+namespace detail
+{
+        // Throws unless row matches the rows (last dimension) of expr
+        template<expression Expr, expression Row>
+        constexpr inline void check_row_extents(const Expr& expr, const Row& row)
+        {
+                if constexpr(decltype(row.extents())::rank() == 1){
+                        constexpr std::size_t last = decltype(expr.extents())::rank() - 1;
+                        if(expr.extent(last) != row.extent(0)){
+                                throw std::runtime_error("Row length does not match!\n" + std::to_string(expr.extent(last)) + " != " + std::to_string(row.extent(0)));
+                        }
+                }else{
+                        check_matching_extents(expr, row);
+                }
+        }
+}; // detail
+
+/***************************************************************************//**
+* Returns an expression representing the dot product of two expressions, the
+* sum of the products of their matching elements.
+ ******************************************************************************/
+template<expression LHS, expression RHS>
+constexpr inline auto dot(LHS&& lhs, RHS&& rhs)
+{
+        detail::check_matching_extents(lhs, rhs);
+        return DotProductOp<LHS, RHS>(std::forward<LHS>(lhs), std::forward<RHS>(rhs));
+}
+
+/***************************************************************************//**
+* Returns an expression representing the euclidean norm of an expression, the
+* square root of the sum of its squared elements.
+ ******************************************************************************/
+template<expression Expr>
+constexpr inline auto norm2(Expr&& expr) noexcept
+{
+        return InnerProductOp<detail::square_term, detail::sqrt_op, Expr>(std::forward<Expr>(expr));
+}
+
+/***************************************************************************//**
+* Returns an expression representing the squared euclidean distance of two
+* expressions, the sum of the squared differences of their matching elements.
+ ******************************************************************************/
+template<expression LHS, expression RHS>
+constexpr inline auto squared_distance(LHS&& lhs, RHS&& rhs)
+{
+        detail::check_matching_extents(lhs, rhs);
+        return InnerProductOp<detail::squared_difference_term, std::identity, LHS, RHS>(std::forward<LHS>(lhs), std::forward<RHS>(rhs));
+}
+
+/***************************************************************************//**
+* Rowwise variants, reducing along the last dimension: dot_rows(a, b)[i] is
+* the dot product of rows a[i, :] and b[i, :] (or b when it is a single row),
+* similarly for norm2_rows and squared_distance_rows.
+ ******************************************************************************/
+template<expression LHS, expression RHS>
+constexpr inline auto dot_rows(LHS&& lhs, RHS&& rhs)
+{
+        detail::check_row_extents(lhs, rhs);
+        return RowwiseInnerProductOp<detail::product_term, std::identity, LHS, RHS>(std::forward<LHS>(lhs), std::forward<RHS>(rhs));
+}
+
+template<expression Expr>
+constexpr inline auto norm2_rows(Expr&& expr) noexcept
+{
+        return RowwiseInnerProductOp<detail::square_term, detail::sqrt_op, Expr>(std::forward<Expr>(expr));
+}
+
+template<expression LHS, expression RHS>
+constexpr inline auto squared_distance_rows(LHS&& lhs, RHS&& rhs)
+{
+        detail::check_row_extents(lhs, rhs);
+        return RowwiseInnerProductOp<detail::squared_difference_term, std::identity, LHS, RHS>(std::forward<LHS>(lhs), std::forward<RHS>(rhs));
+}
+
+}; // expr
+#endif // EXPR_TEMPLATE_INNER_PRODUCT_EXPRESSION_H
@@ -0,0 +1,548 @@
+#ifndef EXPR_TEMPLATE_MATH_FUNCTIONS_H
+#define EXPR_TEMPLATE_MATH_FUNCTIONS_H
+
+#include <base_expression.h>
+#include <elementwise_unary_operators.h>
+#include <elementwise_binary_operators.h>
+#include <extents_utils.h>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+namespace expr
+{
+
+/*******************************************************************************
+* The kernels below evaluate the functions in double precision without
+* branches on the element values (apart from the rare huge arguments of sin
+* and cos): special cases are selected after computing the polynomial, the
+* exponent is handled with integer operations on the bit patterns and integer
+* values are rounded with the 1.5*2^52 shift, which keeps every step
+* available as a vector instruction, so the loops assigning a math expression
+* are vectorized by the compiler. Defining EXPR_SCALAR_MATH makes all of them
+* call the standard library functions instead.
+ ******************************************************************************/
+namespace detail::math
+{
+        inline constexpr double round_shift = 0x1.8p52;
+        inline constexpr double inf = std::numeric_limits<double>::infinity();
+        inline constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+
+        inline constexpr double ln2_hi = 6.93147180369123816490e-01;
+        inline constexpr double ln2_lo = 1.90821492927058770002e-10;
+        inline constexpr double inv_ln2 = 1.44269504088896338700e+00;
+
+        constexpr std::uint64_t bits(double x) noexcept {return std::bit_cast<std::uint64_t>(x);}
+        constexpr double from_bits(std::uint64_t b) noexcept {return std::bit_cast<double>(b);}
+        constexpr double abs(double x) noexcept {return from_bits(bits(x) & 0x7fffffffffffffffu);}
+        constexpr double copysign(double x, double sign) noexcept {return from_bits((bits(x) & 0x7fffffffffffffffu) | (bits(sign) & 0x8000000000000000u));}
+
+        // Nearest integer to x, for |x| < 2^51
+        constexpr double round(double x) noexcept {return (x + round_shift) - round_shift;}
+
+        // 2^k for an integral k in [-1022, 1023]
+        constexpr double pow2(double k) noexcept {return from_bits((bits(k + round_shift) + 1023u) << 52);}
+
+        // x*2^k for an integral k in [-2044, 2046], scaling in two steps to reach subnormals and infinity
+        constexpr double scale(double x, double k) noexcept
+        {
+                const double k1 = round(0.5*k);
+                return x*pow2(k1)*pow2(k - k1);
+        }
+
+        // c[0] + x*(c[1] + x*(c[2] + ...)), unrolled
+        template<std::size_t N>
+        constexpr double polynomial(double x, const std::array<double, N>& c) noexcept
+        {
+                double res = c[N - 1];
+                exts::static_for<N - 1>([&](auto i){
+                        res = res*x + c[N - 2 - i];
+                });
+                return res;
+        }
+
+        // The table f(0), f(1), ..., f(N - 1)
+        template<std::size_t N, typename F>
+        consteval std::array<double, N> table(F f)
+        {
+                std::array<double, N> res{};
+                for(std::size_t n = 0; n < N; n++){
+                        res[n] = f(static_cast<double>(n));
+                }
+                return res;
+        }
+
+        // Taylor coefficients 1/n! of (e^r - 1 - r)/r^2, n = 2, 3, ...
+        inline constexpr auto expm1_coefficients = table<19>([](double n){
+                double factorial = 1.0;
+                for(double k = 2.0; k <= n + 2.0; k++){
+                        factorial *= k;
+                }
+                return 1.0/factorial;
+        });
+
+        // Taylor coefficients 2/(2n + 5) of (2atanh(s) - 2s - 2s^3/3)/s^5 in s^2
+        inline constexpr auto atanh_coefficients = table<12>([](double n){ return 2.0/(2.0*n + 5.0); });
+
+        // Taylor coefficients of (tanh(a) - a)/a^3 in a^2
+        inline constexpr std::array tanh_coefficients = {
+                -3.33333333333333315e-01,  1.33333333333333331e-01, -5.39682539682539708e-02,  2.18694885361552030e-02,
+                -8.86323552990219733e-03,  3.59212803657248114e-03, -1.45583438705131833e-03,  5.90027440945585947e-04,
+                -2.39129114243552478e-04,  9.69153795692945095e-05, -3.92783238833168327e-05,  1.59189050693289637e-05,
+                -6.45168921565543065e-06,  2.61477115129075465e-06, -1.05972683201046543e-06,  4.29491107827380574e-07,
+                -1.74066189635716480e-07,  7.05463694640096814e-08};
+
+        // Ratios 2/(2n + 1) of consecutive terms of the erf series
+        inline constexpr auto erf_series_factors = table<33>([](double n){ return 2.0/(2.0*n + 1.0); });
+
+        // hi + lo == a*b exactly
+        inline void two_prod(double a, double b, double& hi, double& lo) noexcept
+        {
+                hi = a*b;
+                if constexpr(fast_fma<double>){
+                        lo = std::fma(a, b, -hi);
+                }else{
+                        // Dekker's product of the 26 bit halves of a and b
+                        constexpr double split = 134217729.0;
+                        const double ca = split*a;
+                        const double cb = split*b;
+                        const double a_hi = ca - (ca - a);
+                        const double b_hi = cb - (cb - b);
+                        const double a_lo = a - a_hi;
+                        const double b_lo = b - b_hi;
+                        lo = ((a_hi*b_hi - hi) + a_hi*b_lo + a_lo*b_hi) + a_lo*b_lo;
+                }
+        }
+
+        // Range reduction x = k*ln2 + hi - lo, |hi - lo| <= ln2/2
+        struct exp_reduction
+        {
+                double k, hi, lo;
+
+                explicit exp_reduction(double x) noexcept
+                 : k(round(x*inv_ln2)), hi(x - k*ln2_hi), lo(k*ln2_lo)
+                {}
+        };
+
+        inline double exp(double x) noexcept
+        {
+                // Beyond the clamp the result is 0 or infinity, NaN passes through
+                const exp_reduction red(std::min(std::max(x, -746.0), 710.0));
+                constexpr double P1 =  1.66666666666666019037e-01;
+                constexpr double P2 = -2.77777777770155933842e-03;
+                constexpr double P3 =  6.61375632143793436117e-05;
+                constexpr double P4 = -1.65339022054652515390e-06;
+                constexpr double P5 =  4.13813679705723846039e-08;
+                const double r = red.hi - red.lo;
+                const double t = r*r;
+                const double c = r - t*(P1 + t*(P2 + t*(P3 + t*(P4 + t*P5))));
+                const double y = 1.0 - ((red.lo - (r*c)/(2.0 - c)) - red.hi);
+                return scale(y, red.k);
+        }
+
+        inline double expm1(double x) noexcept
+        {
+                // No reduction for x in (-ln2/2, 3ln2/2), k = 1 would lose up to 2 ulp in 2*(e^r - 1) + 1
+                const double xc = std::min(std::max(x, -746.0), 710.0);
+                const bool reduce = !(xc > -0.5*ln2_hi && xc < 1.5*ln2_hi);
+                const exp_reduction red(reduce ? xc : 0.0);
+                const double r = reduce ? red.hi - red.lo : xc;
+                // Taylor series of e^r - 1 = r + r^2*(1/2 + r/6 + ...), -0.35 < r < 1.04
+                const double q = polynomial(r, expm1_coefficients);
+                const double s = scale(1.0, red.k);
+                return s*(r + (r*r)*q) + (s - 1.0);
+        }
+
+        // x = 2^e*m with m in [sqrt(2)/2, sqrt(2)), for finite x > 0
+        struct log_reduction
+        {
+                double e, m;
+
+                explicit log_reduction(double x) noexcept : e(0.0), m(0.0)
+                {
+                        constexpr double sqrt2 = 1.41421356237309504880;
+                        const bool subnormal = x < 0x1p-1022;
+                        const std::uint64_t b = bits(subnormal ? x*0x1p54 : x);
+                        const double m1 = from_bits((b & 0x000fffffffffffffu) | 0x3ff0000000000000u);
+                        const bool above = m1 > sqrt2;
+                        m = above ? 0.5*m1 : m1;
+                        e = from_bits(0x4330000000000000u | ((b >> 52) & 0x7ffu)) - 0x1p52
+                          - (subnormal ? 1077.0 : 1023.0) + (above ? 1.0 : 0.0);
+                }
+        };
+
+        // R(s^2) of log(1 + f) = 2s + s*R(s^2), s = f/(2 + f)
+        inline double log_series(double s) noexcept
+        {
+                constexpr double Lg1 = 6.666666666666735130e-01;
+                constexpr double Lg2 = 3.999999999940941908e-01;
+                constexpr double Lg3 = 2.857142874366239149e-01;
+                constexpr double Lg4 = 2.222219843214978396e-01;
+                constexpr double Lg5 = 1.818357216161805012e-01;
+                constexpr double Lg6 = 1.531383769920937332e-01;
+                constexpr double Lg7 = 1.479819860511658591e-01;
+                const double z = s*s;
+                const double w = z*z;
+                return z*(Lg1 + w*(Lg3 + w*(Lg5 + w*Lg7))) + w*(Lg2 + w*(Lg4 + w*Lg6));
+        }
+
+        inline double log(double x) noexcept
+        {
+                const log_reduction red(x);
+                // log(1 + f) = f - (f^2/2 - s*(f^2/2 + R))
+                const double f = red.m - 1.0;
+                const double hfsq = 0.5*f*f;
+                const double s = f/(2.0 + f);
+                const double res = red.e*ln2_hi - ((hfsq - (s*(hfsq + log_series(s)) + red.e*ln2_lo)) - f);
+                return (x > 0.0 && x < inf) ? res : (x == 0.0 ? -inf : (x == inf ? inf : nan));
+        }
+
+        // log(x) as hi + lo with about 64 correct bits, for finite x > 0. pow
+        // multiplies the error by |y|, up to 745/|log x|.
+        inline void log_extended(double x, double& hi, double& lo) noexcept
+        {
+                const log_reduction red(x);
+                const double f = red.m - 1.0;
+                // s = f/(1 + m) in double-double
+                const double u = 1.0 + red.m;
+                const double u_lo = (1.0 - u) + red.m;
+                const double s = f/u;
+                double su, su_err;
+                two_prod(s, u, su, su_err);
+                const double s_lo = (((f - su) - su_err) - s*u_lo)/u;
+
+                // e*ln2 + 2s + s*R, e*ln2_hi is exact
+                const double a = red.e*ln2_hi;
+                const double sum = a + 2.0*s;
+                const double b = sum - a;
+                const double sum_err = (a - (sum - b)) + (2.0*s - b);
+                // 2s^3/3 in double-double, |s| < 0.172. Rounded to double it
+                // would be off by up to 2^-61, 8 ulp of pow for |y| ~ 700.
+                constexpr double two_thirds_hi = 2.0/3.0;
+                constexpr double two_thirds_lo = 3.700743415417188e-17;
+                double z, z_lo, cube, cube_lo, third, third_lo;
+                two_prod(s, s, z, z_lo);
+                two_prod(s, z, cube, cube_lo);
+                cube_lo += s*z_lo;
+                two_prod(cube, two_thirds_hi, third, third_lo);
+                third_lo += cube*two_thirds_lo + cube_lo*two_thirds_hi;
+                // |sum| > |third|
+                const double sum2 = sum + third;
+                const double sum2_err = third - (sum2 - sum);
+
+                // s^5*R(s^2) = 2s^5/5 + 2s^7/7 + ... from its Taylor series
+                const double R = polynomial(z, atanh_coefficients);
+                // with s_lo to first order, the derivative of 2atanh(s) being 2/(1 - s^2)
+                const double tail = (sum_err + sum2_err) + (third_lo + 2.0*s_lo*(1.0 + z*(1.0 + z*(1.0 + z))) + cube*(z*R) + red.e*ln2_lo);
+                hi = sum2 + tail;
+                lo = tail - (hi - sum2);
+        }
+
+        inline double sin_poly(double r, double z) noexcept
+        {
+                constexpr double S1 = -1.66666666666666324348e-01;
+                constexpr double S2 =  8.33333333332248946124e-03;
+                constexpr double S3 = -1.98412698298579493134e-04;
+                constexpr double S4 =  2.75573137070700676789e-06;
+                constexpr double S5 = -2.50507602534068634195e-08;
+                constexpr double S6 =  1.58969099521155010221e-10;
+                return r + r*z*(S1 + z*(S2 + z*(S3 + z*(S4 + z*(S5 + z*S6)))));
+        }
+
+        inline double cos_poly(double z) noexcept
+        {
+                constexpr double C1 =  4.16666666666666019037e-02;
+                constexpr double C2 = -1.38888888888741095749e-03;
+                constexpr double C3 =  2.48015872894767294178e-05;
+                constexpr double C4 = -2.75573143513906633035e-07;
+                constexpr double C5 =  2.08757232129817482790e-09;
+                constexpr double C6 = -1.13596475577881948265e-11;
+                const double hz = 0.5*z;
+                const double w = 1.0 - hz;
+                return w + (((1.0 - w) - hz) + z*z*(C1 + z*(C2 + z*(C3 + z*(C4 + z*(C5 + z*C6))))));
+        }
+
+        // sin(x + quadrant*pi/2)
+        inline double sin_quadrant(double x, std::uint64_t quadrant) noexcept
+        {
+                // Arguments whose reduction needs more than 3*33 bits of pi/2
+                if(!(abs(x) <= 0x1p20*1.57079632679489661923)) [[unlikely]]{
+                        return (quadrant & 1u) ? std::cos(x) : std::sin(x);
+                }
+                constexpr double two_over_pi = 6.36619772367581382433e-01;
+                constexpr double pio2_1 = 1.57079632673412561417e+00;
+                constexpr double pio2_2 = 6.07710050630396597660e-11;
+                constexpr double pio2_3 = 2.02226624871116645580e-21;
+                // x = k*pi/2 + r + r_lo, |r| <= pi/4, k*pio2_1 and k*pio2_2 are exact
+                const double shifted = x*two_over_pi + round_shift;
+                const double k = shifted - round_shift;
+                const double t = x - k*pio2_1;
+                const double w = k*pio2_2;
+                const double r1 = t - w;
+                const double w3 = k*pio2_3;
+                const double r = r1 - w3;
+                const double r_lo = (((t - r1) - w) + ((r1 - r) - w3));
+                const std::uint64_t q = bits(shifted) + quadrant;
+                const double z = r*r;
+                // First order correction for r_lo
+                const double res = (q & 1u) ? cos_poly(z) - r*r_lo : sin_poly(r, z) + r_lo*(1.0 - 0.5*z);
+                return from_bits(bits(res) ^ ((q & 2u) << 62));
+        }
+
+        inline double sin(double x) noexcept {return sin_quadrant(x, 0);}
+        inline double cos(double x) noexcept {return sin_quadrant(x, 1);}
+
+        inline double tanh(double x) noexcept
+        {
+                // Taylor series tanh a = a + a^3*(-1/3 + 2a^2/15 - ...) for a < 0.55
+                const double a = std::min(abs(x), 20.0);
+                const double z = a*a;
+                const double p = polynomial(z, tanh_coefficients);
+                const double small = a + a*(z*p);
+
+                // tanh a = t/(t + 2) with t = e^(2a) - 1 otherwise, tanh 20 rounds to 1
+                const double t = expm1(2.0*a);
+                const double large = t/(t + 2.0);
+                return copysign(a < 0.55 ? small : large, x);
+        }
+
+        inline double pow(double x, double y) noexcept
+        {
+                const double ax = abs(x);
+                double hi, lo;
+                log_extended(ax, hi, lo);
+                const double log_ax = (ax > 0.0 && ax < inf) ? hi : (ax == 0.0 ? -inf : (ax == inf ? inf : nan));
+
+                // y*log|x| as p + p_err, e^(p + p_err) ~ e^p + e^p*p_err
+                double p, p_err;
+                two_prod(y, log_ax, p, p_err);
+                p_err += y*lo;
+                const double e = exp(p);
+                const double res = (e < inf && abs(p_err) <= 1.0) ? e + e*p_err : e;
+
+                // Integral and odd exponents, all |y| >= 2^53 are even integers
+                const double ay = abs(y);
+                const std::uint64_t shifted = bits(ay + 0x1p52);
+                const bool integral = ay >= 0x1p52 || (from_bits(shifted) - 0x1p52) == ay;
+                const bool odd = ay < 0x1p52 ? (shifted & 1u) != 0 : (ay < 0x1p53 && (bits(ay) & 1u) != 0);
+
+                const bool negative_base = std::signbit(x);
+                const double signed_res = (negative_base && odd) ? -res : res;
+                const double checked = (x < 0.0 && x > -inf && !integral) ? nan : signed_res;
+                return (y == 0.0 || x == 1.0 || (ax == 1.0 && ay == inf)) ? 1.0 : checked;
+        }
+
+        inline double erf(double x) noexcept
+        {
+                constexpr double inv_sqrt_pi = 5.64189583547756286948e-01;
+                const double a = std::min(abs(x), 6.0);
+
+                // e^(-a^2), with the rounding error of a^2
+                double sq, sq_err;
+                two_prod(a, a, sq, sq_err);
+                const double gauss = exp(-sq)*(1.0 - sq_err);
+
+                // a < 2: erf a = 2/sqrt(pi)*e^(-a^2)*sum 2^n*a^(2n+1)/(2n+1)!!
+                double series = 1.0;
+                exts::static_for<32>([&](auto i){
+                        series = 1.0 + series*(sq*erf_series_factors[32 - i]);
+                });
+                const double small = 2.0*inv_sqrt_pi*a*series*gauss;
+
+                // a >= 2: erfc a = e^(-a^2)/sqrt(pi)*2a/(b_0 - 1*2/(b_1 - 3*4/(b_2 - ...))), b_n = 2a^2 + 4n + 1,
+                // with the convergents A/B of the continued fraction from their recurrence
+                const double two_sq = 2.0*sq;
+                double A_prev = 1.0, A = two_sq + 1.0;
+                double B_prev = 0.0, B = 1.0;
+                exts::static_for<24>([&](auto i){
+                        constexpr double n = static_cast<double>(decltype(i)::value + 1);
+                        const double b = two_sq + (4.0*n + 1.0);
+                        const double A_next = b*A - (2.0*n - 1.0)*(2.0*n)*A_prev;
+                        const double B_next = b*B - (2.0*n - 1.0)*(2.0*n)*B_prev;
+                        A_prev = A;
+                        A = A_next;
+                        B_prev = B;
+                        B = B_next;
+                });
+                const double large = 1.0 - gauss*inv_sqrt_pi*(2.0*a)*B/A;
+
+                return copysign(a < 2.0 ? small : large, x);
+        }
+
+        /***********************************************************************
+        * function applies Kernel to an element: double precision values (and
+        * integers, as in <cmath>) with the double kernel, float and the 16 bit
+        * types through the double kernel rounded to float, long double with the
+        * standard library.
+         **********************************************************************/
+        template<typename Kernel>
+        struct function
+        {
+                template<typename T>
+                auto operator()(const T& x) const
+                {
+                        using R = std::conditional_t<std::is_integral_v<T>, double, decltype(+x)>;
+#ifdef EXPR_SCALAR_MATH
+                        return static_cast<R>(Kernel::libm(static_cast<R>(x)));
+#else
+                        if constexpr(std::same_as<R, long double>){
+                                return Kernel::libm(x);
+                        }else{
+                                return static_cast<R>(Kernel::kernel(static_cast<double>(x)));
+                        }
+#endif
+                }
+        };
+
+        struct exp_kernel
+        {
+                static double kernel(double x) noexcept {return exp(x);}
+                static auto libm(auto x) {return std::exp(x);}
+        };
+        struct log_kernel
+        {
+                static double kernel(double x) noexcept {return log(x);}
+                static auto libm(auto x) {return std::log(x);}
+        };
+        struct sin_kernel
+        {
+                static double kernel(double x) noexcept {return sin(x);}
+                static auto libm(auto x) {return std::sin(x);}
+        };
+        struct cos_kernel
+        {
+                static double kernel(double x) noexcept {return cos(x);}
+                static auto libm(auto x) {return std::cos(x);}
+        };
+        struct tanh_kernel
+        {
+                static double kernel(double x) noexcept {return tanh(x);}
+                static auto libm(auto x) {return std::tanh(x);}
+        };
+        struct sqrt_kernel
+        {
+                // The square root is a single instruction already
+                static double kernel(double x) noexcept {return std::sqrt(x);}
+                static auto libm(auto x) {return std::sqrt(x);}
+        };
+        struct erf_kernel
+        {
+                static double kernel(double x) noexcept {return erf(x);}
+                static auto libm(auto x) {return std::erf(x);}
+        };
+
+        struct pow_op
+        {
+                template<typename T, typename U>
+                auto operator()(const T& x, const U& y) const
+                {
+                        using R = std::conditional_t<std::is_integral_v<decltype(+x + y)>, double, decltype(+x + y)>;
+#ifdef EXPR_SCALAR_MATH
+                        return static_cast<R>(std::pow(static_cast<R>(x), static_cast<R>(y)));
+#else
+                        if constexpr(std::same_as<R, long double>){
+                                return std::pow(static_cast<R>(x), static_cast<R>(y));
+                        }else{
+                                return static_cast<R>(pow(static_cast<double>(x), static_cast<double>(y)));
+                        }
+#endif
+                }
+        };
+
+        template<typename T>
+        struct pow_scalar
+        {
+                T exponent;
+
+                explicit pow_scalar(T y) noexcept : exponent(y) {}
+                auto operator()(const auto& x) const {return pow_op{}(x, exponent);}
+        };
+}; // detail::math
+
+/***************************************************************************//**
+* Elementwise math functions, returning an ElementwiseUnaryOp (or a node folded
+* into a temporary elementwise operand, see map) applying the function to each
+* element, e.g. expr::exp(-0.5*x*x) or expr::tanh(a*b + c). Elements of type
+* double are evaluated by branch-free polynomial kernels which the compiler
+* vectorizes in the assignment loops, float, half and bfloat16 elements are
+* evaluated through the double kernels and rounded to float, integers give
+* double results as in <cmath> and long double elements use the standard
+* library. Defining EXPR_SCALAR_MATH uses the standard library everywhere.
+*
+* Maximum errors of the double kernels measured against the standard library
+* (test/math_test.cpp), in units in the last place: exp 1, log 1, sin and cos
+* 1 (|x| > 2^20*pi/2 is evaluated by std::sin/std::cos), tanh 2, pow 2, erf 8.
+* sqrt is correctly rounded, float results are within 1 ulp. In vectorized
+* loops (-O3, or -O2 on compilers vectorizing beyond very cheap loops, best
+* with AVX2 or later for the 64 bit integer operations) the kernels are 2 to
+* 3 times faster than calling the standard library per element, without
+* vectorization exp, log, sin and tanh are on par with it and erf is slower.
+ ******************************************************************************/
+template<expression Expr>
+inline auto exp(Expr&& expr) noexcept
+{
+        return map(std::forward<Expr>(expr), detail::math::function<detail::math::exp_kernel>{});
+}
+
+template<expression Expr>
+inline auto log(Expr&& expr) noexcept
+{
+        return map(std::forward<Expr>(expr), detail::math::function<detail::math::log_kernel>{});
+}
+
+template<expression Expr>
+inline auto sin(Expr&& expr) noexcept
+{
+        return map(std::forward<Expr>(expr), detail::math::function<detail::math::sin_kernel>{});
+}
+
+template<expression Expr>
+inline auto cos(Expr&& expr) noexcept
+{
+        return map(std::forward<Expr>(expr), detail::math::function<detail::math::cos_kernel>{});
+}
+
+template<expression Expr>
+inline auto tanh(Expr&& expr) noexcept
+{
+        return map(std::forward<Expr>(expr), detail::math::function<detail::math::tanh_kernel>{});
+}
+
+template<expression Expr>
+inline auto sqrt(Expr&& expr) noexcept
+{
+        return map(std::forward<Expr>(expr), detail::math::function<detail::math::sqrt_kernel>{});
+}
+
+template<expression Expr>
+inline auto erf(Expr&& expr) noexcept
+{
+        return map(std::forward<Expr>(expr), detail::math::function<detail::math::erf_kernel>{});
+}
+
+/***************************************************************************//**
+* Elementwise power, of each element to a scalar exponent or of matching
+* elements of two expressions, computed as e^(y*log x) with log x in extended
+* precision (maximum error 2 ulp) and the special values of std::pow.
+ ******************************************************************************/
+template<expression Expr, typename T>
+requires std::is_arithmetic_v<T>
+inline auto pow(Expr&& expr, T exponent) noexcept
+{
+        return map(std::forward<Expr>(expr), detail::math::pow_scalar<T>(exponent));
+}
+
+template<expression Base, expression Exponent>
+inline auto pow(Base&& base, Exponent&& exponent)
+{
+        return zip(std::forward<Base>(base), std::forward<Exponent>(exponent), detail::math::pow_op{});
+}
+
+}; // expr
+
+#endif // EXPR_TEMPLATE_MATH_FUNCTIONS_H
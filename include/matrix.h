@@ -6,6 +6,7 @@
 
 #include <experimental/mdspan>
 #include <expr_template.h>
+#include <storage.h>
 
 namespace stdex = std::experimental;
 using expr::BaseExpr;
@@ -16,28 +17,27 @@ concept numeric = std::integral<T> || std::floating_point<T>;
 template<numeric T, std::size_t ROWS, std::size_t COLS>
 class Matrix;
 
+/***************************************************************************//**
+* Matrix is a row major matrix leaf with its size fixed at compile time. Small
+* matrices store their elements inline, so they (and expressions of them) can
+* be evaluated in constant expressions, e.g. to build coefficient tables at
+* compile time.
+ ******************************************************************************/
 template<numeric T, std::size_t ROWS, std::size_t COLS>
 class Matrix : public BaseExpr<Matrix<T, ROWS, COLS>>{
     public:
         using value_type = T;
+        using layout_type = stdex::layout_right;
+        using storage_type = expr::detail::storage_t<T, ROWS*COLS>;
 
-        Matrix() : m_values(ROWS*COLS) {}
-        Matrix(const T val) : m_values(ROWS*COLS, val) {}
+        constexpr Matrix() : m_values(expr::detail::make_storage<storage_type>(ROWS*COLS, T{})) {}
+        constexpr Matrix(const T val) : m_values(expr::detail::make_storage<storage_type>(ROWS*COLS, val)) {}
 
         template<expr::expression Expr>
-        Matrix(const Expr& expr)
+        constexpr Matrix(const Expr& expr)
          : Matrix()
         {
-            auto extents = expr.extents();
-            for(std::size_t i = 0; i < extents.extent(0); i++){
-                for(std::size_t j = 0; j < extents.extent(1); j++){
-#ifdef CLANGBUG
-                    (*this)(i, j) = expr(i, j);
-#else
-                    (*this)[i, j] = expr[i, j];
-#endif
-                }
-            }
+            exts::assign_each_index(expr, *this, extents());
         }
 
         static constexpr std::size_t rows = ROWS;
@@ -50,14 +50,20 @@ class Matrix : public BaseExpr<Matrix<T, ROWS, COLS>>{
         }
 
 #ifdef CLANGDEBUG
-        T& operator()(std::size_t i, std::size_t j){return m_values[i*COLS + j];}
-        T operator()(std::size_t i, std::size_t j) const {return m_values[i*COLS + j];}
+        constexpr T& operator()(std::size_t i, std::size_t j){return m_values[i*COLS + j];}
+        constexpr T operator()(std::size_t i, std::size_t j) const {return m_values[i*COLS + j];}
 #endif
-        T& operator[](std::size_t i, std::size_t j){return m_values[i*COLS + j];}
-        T operator[](std::size_t i, std::size_t j) const {return m_values[i*COLS + j];}
+        constexpr T& operator[](std::size_t i, std::size_t j){return m_values[i*COLS + j];}
+        constexpr T operator[](std::size_t i, std::size_t j) const {return m_values[i*COLS + j];}
+
+        constexpr T& flat(std::size_t n){return m_values[n];}
+        constexpr T flat(std::size_t n) const {return m_values[n];}
+
+        constexpr T* data() noexcept {return m_values.data();}
+        constexpr const T* data() const noexcept {return m_values.data();}
 
     private:
-        std::vector<T> m_values;
+        storage_type m_values;
 };
 
 #endif // MATRIX_H
@@ -2,8 +2,15 @@
 #define EXPR_TEMPLATE_MATRIX_MULTIPLICATION_OPERATOR_H
 
 #include<base_expression.h>
+#include <gemm.h>
+#include <transpose_expression.h>
 #include <bits/utility.h>
+#include <algorithm>
+#include <array>
 #include <functional>
+#include <limits>
+#include <tuple>
+#include <vector>
 #include<iostream>
 #include<exception>
 
@@ -51,19 +58,103 @@ constexpr auto build_matmul_extents(stdex::extents<IndexType,LHS_EXTENTS...> lhs
 template<expression LHS, expression RHS>
 using element_type = decltype(std::declval<typename std::remove_reference_t<LHS>::value_type>() * std::declval<typename std::remove_reference_t<RHS>::value_type>());
 
+template<expression LHS, expression RHS, typename EXT, typename ACC = element_type<LHS, RHS>>
+class MatrixMultiplicationOp;
+
+namespace detail
+{
+        template<typename T>
+        struct is_matmul : std::false_type {};
+        template<expression LHS, expression RHS, typename EXT, typename ACC>
+        struct is_matmul<MatrixMultiplicationOp<LHS, RHS, EXT, ACC>> : std::true_type {};
+
+        // Number of operands of a chain of nested matrix products
+        template<typename Expr>
+        constexpr std::size_t chain_length() noexcept
+        {
+                using Expr_noref = std::remove_cvref_t<Expr>;
+                if constexpr(is_matmul<Expr_noref>::value){
+                        return chain_length<typename Expr_noref::LHS_noref>() + chain_length<typename Expr_noref::RHS_noref>();
+                }else{
+                        return 1;
+                }
+        }
+
+        // References to the operands of a chain of nested matrix products, left to right
+        template<typename Expr>
+        constexpr auto chain_operands(const Expr& e) noexcept
+        {
+                if constexpr(is_matmul<Expr>::value){
+                        return std::tuple_cat(chain_operands(e.lhs()), chain_operands(e.rhs()));
+                }else{
+                        return std::tuple<const Expr&>(e);
+                }
+        }
+
+        /***********************************************************************
+        * Optimal parenthesization of a chain of N matrices, matrix i being
+        * dims[i] x dims[i + 1], minimizing the number of multiply-adds.
+        * split[i][j] = s means matrices i to j are best computed as
+        * (i ... s)*(s + 1 ... j).
+         **********************************************************************/
+        template<std::size_t N>
+        constexpr std::array<std::array<std::size_t, N>, N> matrix_chain_order(const std::array<std::size_t, N + 1>& dims) noexcept
+        {
+                std::array<std::array<std::size_t, N>, N> cost{}, split{};
+                for(std::size_t len = 1; len < N; len++){
+                        for(std::size_t i = 0; i + len < N; i++){
+                                const std::size_t j = i + len;
+                                cost[i][j] = std::numeric_limits<std::size_t>::max();
+                                for(std::size_t s = i; s < j; s++){
+                                        const std::size_t c = cost[i][s] + cost[s + 1][j] + dims[i]*dims[s + 1]*dims[j + 1];
+                                        if(c < cost[i][j]){
+                                                cost[i][j] = c;
+                                                split[i][j] = s;
+                                        }
+                                }
+                        }
+                }
+                return split;
+        }
+
+        // Product of the packed operands i to j of a chain, in the order given by split
+        template<typename T, std::size_t N>
+        std::vector<T> chain_product(std::array<std::vector<T>, N>& packed, const std::array<std::size_t, N + 1>& dims, const std::array<std::array<std::size_t, N>, N>& split, std::size_t batches, std::size_t i, std::size_t j)
+        {
+                if(i == j){
+                        return std::move(packed[i]);
+                }
+                const std::size_t s = split[i][j];
+                const std::vector<T> a = chain_product(packed, dims, split, batches, i, s);
+                const std::vector<T> b = chain_product(packed, dims, split, batches, s + 1, j);
+                std::vector<T> c(batches*dims[i]*dims[j + 1]);
+                batched_gemm_packed(batches, dims[i], dims[j + 1], dims[s + 1], a.data(), b.data(), c.data());
+                return c;
+        }
+}; // detail
+
 /***************************************************************************//**
-* ElementwiseBinaryOp represents expressions where a function is
-* applied to mathcing elements in two expressions. The evaluation of the
-* function is not performed until the specific element of this expression is
-* required (via the subscript operator).
+* MatrixMultiplicationOp represents the matrix product of two expressions,
+* batched over all leading dimensions for rank 3 and higher. Individual elements
+* are computed on demand (via the subscript operator), evaluating the whole
+* product (assign_to) runs the blocked, multi-threaded batched GEMM engine.
+* Small products with all extents known at compile time use fully unrolled
+* kernels instead. Nested products, e.g. matmul(matmul(A, B), C), are evaluated
+* as a chain: the cheapest order of the products is chosen from the operand
+* extents (at compile time when they are all static) and every intermediate
+* product is computed once. Transposed operands, e.g. A in
+* matmul(transpose(A), A), are packed in the storage order of A. Products are
+* accumulated in ACC, e.g. double for float operands, and converted to
+* value_type when the element is returned.
  ******************************************************************************/
-template<expression LHS, expression RHS, typename EXT>
-class MatrixMultiplicationOp: public BaseExpr<MatrixMultiplicationOp<LHS, RHS, EXT>>{
+template<expression LHS, expression RHS, typename EXT, typename ACC>
+class MatrixMultiplicationOp: public BaseExpr<MatrixMultiplicationOp<LHS, RHS, EXT, ACC>>{
     public:
-        using Base = BaseExpr<MatrixMultiplicationOp<LHS, RHS, EXT>>;
+        using Base = BaseExpr<MatrixMultiplicationOp<LHS, RHS, EXT, ACC>>;
         using RHS_noref = std::remove_reference_t<RHS>;
         using LHS_noref = std::remove_reference_t<LHS>;
         using value_type = element_type<LHS, RHS>;
+        using accumulator_type = ACC;
 
         constexpr explicit MatrixMultiplicationOp(LHS&& lhs, RHS&& rhs, EXT&& ext) noexcept
          : Base(), m_lhs(std::forward<LHS>(lhs)), m_rhs(std::forward<RHS>(rhs)), m_ext(std::forward<EXT>(ext))
@@ -71,17 +162,17 @@ class MatrixMultiplicationOp: public BaseExpr<MatrixMultiplicationOp<LHS, RHS, E
 
         ~MatrixMultiplicationOp() noexcept = default;
 
-        constexpr auto extents() const noexcept {return m_ext.extents();};
+        constexpr auto extents() const noexcept {return m_ext;};
         constexpr auto extent(std::size_t i) const noexcept {return m_ext.extent(i);};
 
 #ifdef CLANGBUG
         constexpr auto operator()(auto&&  ... indices, auto&& i, auto&& j) const
         {
-                value_type res = 0;
+                accumulator_type res = 0;
                 for (auto k = 0; k < m_lhs.extent(sizeof...(indices) + 1); k++){
-                        res += m_lhs(indices..., i, k) * m_rhs(indices..., k, j);
+                        res += static_cast<accumulator_type>(m_lhs(indices..., i, k)) * static_cast<accumulator_type>(m_rhs(indices..., k, j));
                 }
-                return res;
+                return static_cast<value_type>(res);
         }
 #endif
         constexpr auto operator[](auto&&... indices) const
@@ -93,11 +184,50 @@ class MatrixMultiplicationOp: public BaseExpr<MatrixMultiplicationOp<LHS, RHS, E
                 }
         }
 
+        /***********************************************************************
+        * Evaluate the full (batched) product into destination, one packed
+        * matrix product per combination of leading indices.
+         **********************************************************************/
+        template<typename Destination>
+        void assign_to(Destination& destination) const
+        {
+                if constexpr(small_static){
+                        assign_small(destination);
+                        return;
+                }else if constexpr(detail::chain_length<MatrixMultiplicationOp>() > 2){
+                        assign_chain(destination);
+                        return;
+                }
+                const std::size_t m = static_cast<std::size_t>(m_ext.extent(rank - 2));
+                const std::size_t n = static_cast<std::size_t>(m_ext.extent(rank - 1));
+                const std::size_t k = static_cast<std::size_t>(m_lhs.extent(rank - 1));
+                const std::size_t batches = batch_count();
+                auto pack_lhs = [&](std::size_t batch, accumulator_type* a){
+                        pack(m_lhs, batch_indices(batch), 0, m, k, a);
+                };
+                auto pack_rhs = [&](std::size_t batch, accumulator_type* b){
+                        pack(m_rhs, batch_indices(batch), 0, k, n, b);
+                };
+                auto store = [&](std::size_t batch, const accumulator_type* c){
+                        const auto idx = batch_indices(batch);
+                        for(std::size_t i = 0; i < m; i++){
+                                for(std::size_t j = 0; j < n; j++){
+                                        batch_at(destination, idx, i, j) = static_cast<value_type>(c[i*n + j]);
+                                }
+                        }
+                };
+                detail::batched_gemm<accumulator_type>(batches, m, n, k, pack_lhs, pack_rhs, store);
+        }
+
+        constexpr const auto& lhs() const noexcept {return m_lhs;}
+        constexpr const auto& rhs() const noexcept {return m_rhs;}
+
         constexpr explicit MatrixMultiplicationOp(const MatrixMultiplicationOp&) noexcept = default;
         constexpr explicit MatrixMultiplicationOp(MatrixMultiplicationOp&&) noexcept = default;
 
         constexpr MatrixMultiplicationOp& operator=(const MatrixMultiplicationOp&) noexcept = default;
         constexpr MatrixMultiplicationOp& operator=(MatrixMultiplicationOp&&) noexcept = default;
+        constexpr auto operands() const noexcept {return std::forward_as_tuple(m_lhs, m_rhs);}
     private:
         std::remove_cvref_t<LHS> m_lhs;
         std::remove_cvref_t<RHS> m_rhs;
@@ -105,30 +235,228 @@ class MatrixMultiplicationOp: public BaseExpr<MatrixMultiplicationOp<LHS, RHS, E
 
         constexpr explicit MatrixMultiplicationOp() noexcept = default;
 
+        static constexpr std::size_t rank = EXT::rank();
+        using index_type = typename EXT::index_type;
+        using batch_index_type = std::array<index_type, rank - 2>;
+
+        // Inner (summed over) dimension, std::dynamic_extent unless known at compile time
+        static constexpr std::size_t static_k = decltype(std::declval<const LHS_noref&>().extents())::static_extent(rank - 1);
+        static constexpr bool small_static = EXT::rank_dynamic() == 0 && static_k != std::dynamic_extent
+                && EXT::static_extent(rank - 2)*EXT::static_extent(rank - 1)*static_k <= detail::small_gemm_limit;
+
+        constexpr std::size_t batch_count() const noexcept
+        {
+                std::size_t batches = 1;
+                for(std::size_t d = 0; d + 2 < rank; d++){
+                        batches *= static_cast<std::size_t>(m_ext.extent(d));
+                }
+                return batches;
+        }
+
+        /***********************************************************************
+        * Evaluate a small product with static extents, batch by batch, with the
+        * operands copied to registers and a fully unrolled kernel.
+         **********************************************************************/
+        template<typename Destination>
+        void assign_small(Destination& destination) const
+        {
+                constexpr std::size_t m = EXT::static_extent(rank - 2);
+                constexpr std::size_t n = EXT::static_extent(rank - 1);
+                constexpr std::size_t k = static_k;
+                for(std::size_t batch = 0; batch < batch_count(); batch++){
+                        const auto idx = batch_indices(batch);
+                        std::array<accumulator_type, m*k> a;
+                        std::array<accumulator_type, k*n> b;
+                        std::array<accumulator_type, m*n> c;
+                        exts::static_for<m*k>([&](auto e){
+                                a[e] = static_cast<accumulator_type>(batch_at(m_lhs, idx, e/k, e % k));
+                        });
+                        exts::static_for<k*n>([&](auto e){
+                                b[e] = static_cast<accumulator_type>(batch_at(m_rhs, idx, e/n, e % n));
+                        });
+                        detail::small_gemm<accumulator_type, m, n, k>(a, b, c);
+                        exts::static_for<m*n>([&](auto e){
+                                batch_at(destination, idx, e/n, e % n) = static_cast<value_type>(c[e]);
+                        });
+                }
+        }
+
+        // Calls op(batch, batch indices, i) for all rows i of all batches, in parallel
+        template<typename Operator>
+        void for_each_batch_row(std::size_t batches, std::size_t rows, std::size_t cols, Operator&& op) const
+        {
+                const std::size_t grain = std::max<std::size_t>(1, detail::gemm_parallel_work/std::max<std::size_t>(1, cols));
+                parallel_for(std::size_t(0), batches*rows, grain, [&](std::size_t begin, std::size_t end){
+                        for(std::size_t r = begin; r < end; r++){
+                                const std::size_t batch = r/rows;
+                                op(batch, batch_indices(batch), r % rows);
+                        }
+                });
+        }
+
+        /***********************************************************************
+        * Evaluate a chain of nested products: pack every operand once, compute
+        * the products in the optimal order and store the final result.
+         **********************************************************************/
+        template<typename Destination>
+        void assign_chain(Destination& destination) const
+        {
+                constexpr std::size_t N = detail::chain_length<MatrixMultiplicationOp>();
+                using Dims = std::array<std::size_t, N + 1>;
+                const auto operands = detail::chain_operands(*this);
+                const std::size_t batches = batch_count();
+
+                // Operand i is dims[i] x dims[i + 1]
+                using Operands = decltype(operands);
+                constexpr Dims static_dims = []<size_t... Is>(std::index_sequence<Is...>){
+                        return Dims{operand_extents_t<Operands, 0>::static_extent(rank - 2),
+                                    operand_extents_t<Operands, Is>::static_extent(rank - 1)...};
+                }(std::make_index_sequence<N>{});
+                const Dims dims = [&]<size_t... Is>(std::index_sequence<Is...>){
+                        return Dims{static_cast<std::size_t>(std::get<0>(operands).extent(rank - 2)),
+                                    static_cast<std::size_t>(std::get<Is>(operands).extent(rank - 1))...};
+                }(std::make_index_sequence<N>{});
+
+                std::array<std::vector<accumulator_type>, N> packed;
+                [&]<size_t... Is>(std::index_sequence<Is...>){
+                        (pack_operand(std::get<Is>(operands), packed[Is], batches, dims[Is], dims[Is + 1]), ...);
+                }(std::make_index_sequence<N>{});
+
+                constexpr bool all_static = std::ranges::find(static_dims, std::dynamic_extent) == static_dims.end();
+                std::vector<accumulator_type> res;
+                if constexpr(all_static){
+                        constexpr auto split = detail::matrix_chain_order<N>(static_dims);
+                        res = detail::chain_product<accumulator_type, N>(packed, dims, split, batches, 0, N - 1);
+                }else{
+                        res = detail::chain_product<accumulator_type, N>(packed, dims, detail::matrix_chain_order<N>(dims), batches, 0, N - 1);
+                }
+
+                const std::size_t m = dims.front(), n = dims.back();
+                for_each_batch_row(batches, m, n, [&](std::size_t batch, const batch_index_type& idx, std::size_t i){
+                        for(std::size_t j = 0; j < n; j++){
+                                batch_at(destination, idx, i, j) = static_cast<value_type>(res[(batch*m + i)*n + j]);
+                        }
+                });
+        }
+
+        template<typename Operands, std::size_t I>
+        using operand_extents_t = decltype(std::get<I>(std::declval<Operands>()).extents());
+
+        template<typename Operand>
+        void pack_operand(const Operand& operand, std::vector<accumulator_type>& packed, std::size_t batches, std::size_t rows, std::size_t cols) const
+        {
+                packed.resize(batches*rows*cols);
+                // Blocks of transpose_tile rows, so transposed operands are packed tile by tile
+                const std::size_t blocks = (rows + detail::transpose_tile - 1)/detail::transpose_tile;
+                const std::size_t grain = std::max<std::size_t>(1, detail::gemm_parallel_work/std::max<std::size_t>(1, detail::transpose_tile*cols));
+                parallel_for(std::size_t(0), batches*blocks, grain, [&](std::size_t begin, std::size_t end){
+                        for(std::size_t r = begin; r < end; r++){
+                                const std::size_t batch = r/blocks;
+                                const std::size_t row_begin = (r % blocks)*detail::transpose_tile;
+                                pack(operand, batch_indices(batch), row_begin, std::min(rows, row_begin + detail::transpose_tile), cols, packed.data() + batch*rows*cols);
+                        }
+                });
+        }
+
+        /***********************************************************************
+        * Copy rows [row_begin, row_end) of the rows x cols matrix of batch idx
+        * of operand to the row major buffer dest. The transpose of a matrix
+        * (e.g. A in matmul(transpose(A), B)) is read in the order of the
+        * original expression, tile by tile, instead of with a stride of a
+        * whole row per element, giving the NT, TN and TT variants of the
+        * product without materializing the transpose.
+         **********************************************************************/
+        template<typename Operand>
+        static void pack(const Operand& operand, const batch_index_type& idx, std::size_t row_begin, std::size_t row_end, std::size_t cols, accumulator_type* dest)
+        {
+                if constexpr(detail::is_matrix_transpose<std::remove_cvref_t<Operand>>::value){
+                        const auto& original = operand.operand();
+                        for(std::size_t ii = row_begin; ii < row_end; ii += detail::transpose_tile){
+                                const std::size_t i_end = std::min(row_end, ii + detail::transpose_tile);
+                                for(std::size_t jj = 0; jj < cols; jj += detail::transpose_tile){
+                                        const std::size_t j_end = std::min(cols, jj + detail::transpose_tile);
+                                        for(std::size_t j = jj; j < j_end; j++){
+                                                for(std::size_t i = ii; i < i_end; i++){
+                                                        dest[i*cols + j] = static_cast<accumulator_type>(batch_at(original, idx, j, i));
+                                                }
+                                        }
+                                }
+                        }
+                }else{
+                        for(std::size_t i = row_begin; i < row_end; i++){
+                                for(std::size_t j = 0; j < cols; j++){
+                                        dest[i*cols + j] = static_cast<accumulator_type>(batch_at(operand, idx, i, j));
+                                }
+                        }
+                }
+        }
+
+        // Leading (batch) indices of the batch with row major number batch
+        constexpr batch_index_type batch_indices(std::size_t batch) const noexcept
+        {
+                batch_index_type idx{};
+                for(std::size_t d = rank - 2; d-- > 0;){
+                        const auto ext = static_cast<std::size_t>(m_ext.extent(d));
+                        idx[d] = static_cast<index_type>(batch % ext);
+                        batch /= ext;
+                }
+                return idx;
+        }
+
+        template<typename Expr, size_t... Bs>
+        static constexpr decltype(auto) batch_at(Expr& e, const batch_index_type& idx, std::index_sequence<Bs...>, std::size_t i, std::size_t j)
+        {
+                return detail::subscript(e, idx[Bs]..., static_cast<index_type>(i), static_cast<index_type>(j));
+        }
+        template<typename Expr>
+        static constexpr decltype(auto) batch_at(Expr& e, const batch_index_type& idx, std::size_t i, std::size_t j)
+        {
+                return batch_at(e, idx, std::make_index_sequence<rank - 2>{}, i, j);
+        }
+
         template<typename... Indices, size_t... Idxs>
         constexpr auto get_value(std::index_sequence<Idxs...>&&, std::tuple<Indices...>&& indices) const
         {
-                value_type res = 0;
+                accumulator_type res = 0;
                 auto i = std::get<sizeof...(Indices) - 2>(indices);
                 auto j = std::get<sizeof...(Indices) - 1>(indices);
                 for (decltype(m_lhs.extent(0)) k = 0; k < m_lhs.extent(sizeof...(Indices) - 1); k++){
-                        res+= m_lhs[std::get<Idxs>(indices)..., i, k] * m_rhs[std::get<Idxs>(indices)..., k, j];
+                        res+= static_cast<accumulator_type>(m_lhs[std::get<Idxs>(indices)..., i, k]) * static_cast<accumulator_type>(m_rhs[std::get<Idxs>(indices)..., k, j]);
                 }
-                return res;
+                return static_cast<value_type>(res);
         }
         constexpr auto get_value(auto&& i, auto&& j) const
         {
-                value_type res = 0;
-                for (decltype(m_lhs.extent(1)) k = 0; k < m_lhs.extent(1); k++){
-                        res+= m_lhs[i, k] * m_rhs[k, j];
+                accumulator_type res = 0;
+                if constexpr(static_k != std::dynamic_extent && static_k <= exts::unroll_limit){
+                        exts::static_for<static_k>([&](auto k){
+                                res+= static_cast<accumulator_type>(m_lhs[i, k()]) * static_cast<accumulator_type>(m_rhs[k(), j]);
+                        });
+                }else{
+                        for (decltype(m_lhs.extent(1)) k = 0; k < m_lhs.extent(1); k++){
+                                res+= static_cast<accumulator_type>(m_lhs[i, k]) * static_cast<accumulator_type>(m_rhs[k, j]);
+                        }
                 }
-                return res;
+                return static_cast<value_type>(res);
         }
 }; // MatrixMultiplicationOP
 
-template<expression LHS, expression RHS>
+/***************************************************************************//**
+* Matrix product of two (batched) expressions, accumulated in Acc, e.g.
+* matmul<double>(a, b) for float matrices a and b.
+ ******************************************************************************/
+template<typename Acc, expression LHS, expression RHS>
 constexpr inline auto matmul(LHS&& lhs, RHS&& rhs)
 {
+        using LHS_extents = decltype(lhs.extents());
+        using RHS_extents = decltype(rhs.extents());
+        if constexpr(LHS_extents::rank() == RHS_extents::rank()){
+                static_assert([]<size_t... Is>(std::index_sequence<Is...>){
+                                return (detail::static_extents_compatible<LHS_extents, RHS_extents>(Is, Is) && ...);
+                        }(std::make_index_sequence<LHS_extents::rank() - 2>{}), "Static batch dimensions do not match!");
+                static_assert(detail::static_extents_compatible<LHS_extents, RHS_extents>(LHS_extents::rank() - 1, RHS_extents::rank() - 2),
+                              "Incompatible static dimensions for matrix multiplication!");
+        }
         if (lhs.extents().rank() != rhs.extents().rank()){
                 throw std::runtime_error("Rank of left hand side expression does not match rank of right hand side expression!\n" + std::to_string(lhs.extents().rank()) + " != " + std::to_string(rhs.extents().rank()));
         }
@@ -142,7 +470,17 @@ constexpr inline auto matmul(LHS&& lhs, RHS&& rhs)
                 throw std::runtime_error("incompatible dimensions for matrix multiplication!\n" + std::to_string(lhs.extent(lhs.extents().rank() - 1)) + " != " + std::to_string(rhs.extent(rhs.extents().rank() - 2)));
         }
         auto matmul_exts = build_matmul_extents(lhs.extents(), rhs.extents());
-        return MatrixMultiplicationOp<LHS, RHS, decltype(matmul_exts)>{std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::move(matmul_exts)};
+        return MatrixMultiplicationOp<LHS, RHS, decltype(matmul_exts), Acc>{std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::move(matmul_exts)};
+}
+
+/***************************************************************************//**
+* Matrix product of two (batched) expressions, accumulated in the element type
+* of the product.
+ ******************************************************************************/
+template<expression LHS, expression RHS>
+constexpr inline auto matmul(LHS&& lhs, RHS&& rhs)
+{
+        return matmul<element_type<LHS, RHS>>(std::forward<LHS>(lhs), std::forward<RHS>(rhs));
 }
 
 
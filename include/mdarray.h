@@ -3,6 +3,9 @@
 
 #include <expr_template.h>
 #include <extents_utils.h>
+#include <storage.h>
+#include <concepts>
+#include <type_traits>
 #include <vector>
 
 #include <experimental/mdspan>
@@ -11,34 +14,61 @@ namespace stdex = std::experimental;
 using expr::BaseExpr;
 using expr::expression;
 
-template<typename T, typename Extents>
+template<typename T, typename Extents, typename Layout = stdex::layout_right>
 class MDArray;
 
-template<typename T, typename IndexType, size_t... Extents>
-class MDArray<T, stdex::extents<IndexType, Extents...>>: public BaseExpr<MDArray<T, stdex::extents<IndexType, Extents...>>>{
+/***************************************************************************//**
+* MDArray owns the elements of a multidimensional array, stored in the order
+* given by the mdspan layout policy Layout: row major (layout_right, the
+* default), column major (layout_left, e.g. Fortran data) or any other policy,
+* such as layout_stride or padded layouts, constructed from its mapping.
+* Expressions are evaluated into (and reduced over) arrays in their memory
+* order. Arrays with fully static extents of at most
+* expr::detail::inline_storage_limit elements in an exhaustive layout store
+* them inline, without any heap allocation, all others in a std::vector.
+ ******************************************************************************/
+template<typename T, typename IndexType, size_t... Extents, typename Layout>
+class MDArray<T, stdex::extents<IndexType, Extents...>, Layout>: public BaseExpr<MDArray<T, stdex::extents<IndexType, Extents...>, Layout>>{
     public:
         using value_type = T;
+        using extents_type = stdex::extents<IndexType, Extents...>;
+        using layout_type = Layout;
+        using mapping_type = typename Layout::template mapping<extents_type>;
+        using storage_type = expr::detail::storage_t<T, extents_type::rank_dynamic() == 0 && mapping_type::is_always_exhaustive() ? exts::ext_size(extents_type{}) : std::dynamic_extent>;
+
         constexpr explicit MDArray(const stdex::extents<IndexType, Extents...>& exts) noexcept 
-            : m_data(exts::ext_size(exts)), m_mdspan(m_data.data(), exts)
+            : m_data(expr::detail::make_storage<storage_type>(storage_size(mapping_type(exts)), T{})), m_mapping(exts)
         {}
 
         constexpr explicit MDArray(const stdex::extents<IndexType, Extents...>& exts, T val) noexcept 
-            : m_data(exts::ext_size(exts), val), m_mdspan(m_data.data(), exts)
+            : m_data(expr::detail::make_storage<storage_type>(storage_size(mapping_type(exts)), val)), m_mapping(exts)
+        {}
+
+        constexpr explicit MDArray(const mapping_type& mapping, T val = T{}) noexcept
+            : m_data(expr::detail::make_storage<storage_type>(storage_size(mapping), val)), m_mapping(mapping)
         {}
 
 #ifdef CLANGBUG
-        constexpr inline T& operator()(auto&&... indices) {return m_mdspan(indices...);}
-        constexpr inline const T& operator()(auto&&... indices) const {return m_mdspan(indices...);}
+        constexpr inline T& operator()(auto&&... indices) {return m_data[m_mapping(indices...)];}
+        constexpr inline const T& operator()(auto&&... indices) const {return m_data[m_mapping(indices...)];}
 #endif
-        constexpr inline T& operator[](auto&&... indices) {return m_mdspan[indices...];}
-        constexpr inline const T& operator[](auto&&... indices) const {return m_mdspan[indices...];}
+        constexpr inline T& operator[](auto&&... indices) {return m_data[m_mapping(indices...)];}
+        constexpr inline const T& operator[](auto&&... indices) const {return m_data[m_mapping(indices...)];}
+
+        // Elements in row major order, only for row major arrays
+        constexpr inline T& flat(std::size_t n) requires std::same_as<Layout, stdex::layout_right> {return m_data[n];}
+        constexpr inline const T& flat(std::size_t n) const requires std::same_as<Layout, stdex::layout_right> {return m_data[n];}
 
-        constexpr inline auto extents() const noexcept {return m_mdspan.extents();}
-        constexpr inline auto extent(size_t i) const noexcept {return m_mdspan.extent(i);}
-        constexpr operator stdex::mdspan<T, stdex::extents<IndexType, Extents...>>() noexcept {return m_mdspan;}
+        constexpr inline T* data() noexcept {return m_data.data();}
+        constexpr inline const T* data() const noexcept {return m_data.data();}
+
+        constexpr inline const mapping_type& mapping() const noexcept {return m_mapping;}
+        constexpr inline auto extents() const noexcept {return m_mapping.extents();}
+        constexpr inline auto extent(size_t i) const noexcept {return m_mapping.extents().extent(i);}
+        constexpr operator stdex::mdspan<T, stdex::extents<IndexType, Extents...>, Layout>() noexcept {return {m_data.data(), m_mapping};}
 
         template<expression Expr>
-        constexpr MDArray(Expr&& expr) noexcept
+        constexpr MDArray(Expr&& expr) noexcept(!exts::has_assign_to<Expr, MDArray>) requires std::is_constructible_v<mapping_type, const extents_type&>
          : MDArray(expr.extents())
         {
                 exts::assign_each_index(std::forward<Expr>(expr), *this);
@@ -52,8 +82,19 @@ class MDArray<T, stdex::extents<IndexType, Extents...>>: public BaseExpr<MDArray
         inline MDArray& operator=(const MDArray&) noexcept = default;
         inline MDArray& operator=(MDArray&&) noexcept = default;
     private:
-        std::vector<T> m_data;
-        stdex::mdspan<T, stdex::extents<IndexType, Extents...>> m_mdspan;
+        // The mdspan view is rebuilt from the data on demand, so copies never
+        // refer to the elements of the original
+        storage_type m_data;
+        mapping_type m_mapping;
+
+        static constexpr std::size_t storage_size(const mapping_type& mapping) noexcept
+        {
+                if constexpr(mapping_type::is_always_exhaustive()){
+                        return exts::ext_size(mapping.extents());
+                }else{
+                        return static_cast<std::size_t>(mapping.required_span_size());
+                }
+        }
 };
 
 #endif // MDARRAY_H
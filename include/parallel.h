@@ -0,0 +1,192 @@
+#ifndef EXPR_TEMPLATE_PARALLEL_H
+#define EXPR_TEMPLATE_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace expr
+{
+
+namespace detail{
+        // Bytes of a cache line, the unit of false sharing and of prefetches
+        inline constexpr std::size_t cache_line_bytes = 64;
+}; // detail
+
+/***************************************************************************//**
+* ThreadPool is a fixed size pool of worker threads executing submitted tasks
+* in FIFO order. The library's parallel evaluators all share the pool returned
+* by default_thread_pool().
+ ******************************************************************************/
+class ThreadPool
+{
+    public:
+        explicit ThreadPool(std::size_t n_threads)
+         : m_workers(), m_tasks(), m_mutex(), m_cv(), m_stop(false)
+        {
+                m_workers.reserve(n_threads);
+                for(std::size_t i = 0; i < n_threads; i++){
+                        m_workers.emplace_back([this](){ work(); });
+                }
+        }
+
+        ~ThreadPool() noexcept
+        {
+                {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_stop = true;
+                }
+                m_cv.notify_all();
+                for(auto& worker : m_workers){
+                        worker.join();
+                }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool(ThreadPool&&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ThreadPool& operator=(ThreadPool&&) = delete;
+
+        void submit(std::function<void()> task)
+        {
+                {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        m_tasks.push_back(std::move(task));
+                }
+                m_cv.notify_one();
+        }
+
+        std::size_t size() const noexcept {return m_workers.size();}
+
+    private:
+        std::vector<std::thread> m_workers;
+        std::deque<std::function<void()>> m_tasks;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop;
+
+        void work()
+        {
+                while(true){
+                        std::function<void()> task;
+                        {
+                                std::unique_lock<std::mutex> lock(m_mutex);
+                                m_cv.wait(lock, [this](){ return m_stop || !m_tasks.empty(); });
+                                if(m_stop && m_tasks.empty()){
+                                        return;
+                                }
+                                task = std::move(m_tasks.front());
+                                m_tasks.pop_front();
+                        }
+                        task();
+                }
+        }
+};
+
+/***************************************************************************//**
+* Number of threads used by the parallel evaluators, the calling thread
+* included. Set the EXPR_NUM_THREADS environment variable to override the
+* default (the hardware concurrency).
+ ******************************************************************************/
+inline std::size_t num_threads() noexcept
+{
+        static const std::size_t n = [](){
+                if(const char* env = std::getenv("EXPR_NUM_THREADS")){
+                        const long val = std::strtol(env, nullptr, 10);
+                        if(val > 0){
+                                return static_cast<std::size_t>(val);
+                        }
+                }
+                return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+        }();
+        return n;
+}
+
+inline ThreadPool& default_thread_pool()
+{
+        static ThreadPool pool(num_threads() - 1);
+        return pool;
+}
+
+/***************************************************************************//**
+* Calls op(chunk_begin, chunk_end) for consecutive chunks covering
+* [begin, end), in parallel on the default thread pool. Ranges of at most grain
+* elements are run directly on the calling thread. The calling thread takes
+* part in the work and only waits for chunks already being executed by other
+* threads, so parallel_for may be nested (e.g. from inside a pool task)
+* without deadlocking. The first exception thrown by op is rethrown.
+ ******************************************************************************/
+template<typename IndexType, typename Operator>
+inline void parallel_for(IndexType begin, IndexType end, IndexType grain, Operator&& op)
+{
+        if(end <= begin){
+                return;
+        }
+        const std::size_t n = static_cast<std::size_t>(end - begin);
+        const std::size_t min_chunk = std::max<std::size_t>(1, static_cast<std::size_t>(grain));
+        ThreadPool& pool = default_thread_pool();
+        if(n <= min_chunk || pool.size() == 0){
+                std::forward<Operator>(op)(begin, end);
+                return;
+        }
+
+        // A few chunks per thread evens out imbalanced work
+        const std::size_t max_chunks = std::min((n + min_chunk - 1)/min_chunk, 4*(pool.size() + 1));
+        const std::size_t chunk_size = (n + max_chunks - 1)/max_chunks;
+        const std::size_t n_chunks = (n + chunk_size - 1)/chunk_size;
+
+        struct State
+        {
+                std::atomic<std::size_t> next{0};
+                std::atomic<std::size_t> done{0};
+                std::mutex mutex{};
+                std::condition_variable cv{};
+                std::exception_ptr error{};
+        };
+        auto state = std::make_shared<State>();
+
+        auto run = [state, &op, begin, n, n_chunks, chunk_size]()
+        {
+                for(std::size_t c = state->next++; c < n_chunks; c = state->next++){
+                        const auto chunk_begin = static_cast<IndexType>(static_cast<std::size_t>(begin) + c*chunk_size);
+                        const auto chunk_end = static_cast<IndexType>(static_cast<std::size_t>(begin) + std::min(n, (c + 1)*chunk_size));
+                        try{
+                                op(chunk_begin, chunk_end);
+                        }catch(...){
+                                std::lock_guard<std::mutex> lock(state->mutex);
+                                if(!state->error){
+                                        state->error = std::current_exception();
+                                }
+                        }
+                        if(++state->done == n_chunks){
+                                std::lock_guard<std::mutex> lock(state->mutex);
+                                state->cv.notify_all();
+                        }
+                }
+        };
+
+        const std::size_t n_helpers = std::min(pool.size(), n_chunks - 1);
+        for(std::size_t i = 0; i < n_helpers; i++){
+                pool.submit(run);
+        }
+        run();
+        {
+                std::unique_lock<std::mutex> lock(state->mutex);
+                state->cv.wait(lock, [&](){ return state->done == n_chunks; });
+        }
+        if(state->error){
+                std::rethrow_exception(state->error);
+        }
+}
+
+}; // expr
+#endif // EXPR_TEMPLATE_PARALLEL_H
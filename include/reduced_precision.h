@@ -0,0 +1,164 @@
+#ifndef EXPR_TEMPLATE_REDUCED_PRECISION_H
+#define EXPR_TEMPLATE_REDUCED_PRECISION_H
+
+#include <bit>
+#include <cstdint>
+#include <limits>
+
+namespace expr
+{
+
+/***************************************************************************//**
+* bfloat16 is a 16 bit storage type holding the upper half of an IEEE single
+* precision float: the full float exponent range with an 8 bit significand.
+* Values convert implicitly to float, so all arithmetic is done in (at least)
+* float precision, and conversion from float rounds to nearest even. It halves
+* the memory traffic of bandwidth bound expressions on float data.
+ ******************************************************************************/
+class bfloat16
+{
+    public:
+        constexpr bfloat16() noexcept = default;
+        constexpr bfloat16(float val) noexcept : m_bits(from_float(val)) {}
+        constexpr explicit bfloat16(double val) noexcept : bfloat16(static_cast<float>(val)) {}
+
+        constexpr operator float() const noexcept {return std::bit_cast<float>(static_cast<std::uint32_t>(m_bits) << 16);}
+
+        static constexpr bfloat16 from_bits(std::uint16_t bits) noexcept
+        {
+                bfloat16 res;
+                res.m_bits = bits;
+                return res;
+        }
+        constexpr std::uint16_t bits() const noexcept {return m_bits;}
+
+    private:
+        std::uint16_t m_bits = 0;
+
+        static constexpr std::uint16_t from_float(float val) noexcept
+        {
+                const std::uint32_t bits = std::bit_cast<std::uint32_t>(val);
+                if ((bits & 0x7fffffffu) > 0x7f800000u){
+                        // Keep NaNs quiet, truncation could turn them into infinities
+                        return static_cast<std::uint16_t>((bits >> 16) | 0x40u);
+                }
+                return static_cast<std::uint16_t>((bits + 0x7fffu + ((bits >> 16) & 1u)) >> 16);
+        }
+};
+
+/***************************************************************************//**
+* half is a 16 bit storage type in the IEEE binary16 format (5 bit exponent,
+* 11 bit significand, subnormals, infinities and NaNs). Values convert
+* implicitly to float, so all arithmetic is done in (at least) float precision,
+* and conversion from float rounds to nearest even, overflowing to infinity.
+ ******************************************************************************/
+class half
+{
+    public:
+        constexpr half() noexcept = default;
+        constexpr half(float val) noexcept : m_bits(from_float(val)) {}
+        constexpr explicit half(double val) noexcept : half(static_cast<float>(val)) {}
+
+        constexpr operator float() const noexcept {return to_float(m_bits);}
+
+        static constexpr half from_bits(std::uint16_t bits) noexcept
+        {
+                half res;
+                res.m_bits = bits;
+                return res;
+        }
+        constexpr std::uint16_t bits() const noexcept {return m_bits;}
+
+    private:
+        std::uint16_t m_bits = 0;
+
+        static constexpr std::uint16_t from_float(float val) noexcept
+        {
+                const std::uint32_t bits = std::bit_cast<std::uint32_t>(val);
+                const std::uint32_t sign = (bits >> 16) & 0x8000u;
+                const std::uint32_t abs = bits & 0x7fffffffu;
+                if (abs >= 0x7f800000u){
+                        // Infinity or (quiet) NaN
+                        return static_cast<std::uint16_t>(sign | (abs > 0x7f800000u ? 0x7e00u : 0x7c00u));
+                }
+                if (abs >= 0x477ff000u){
+                        // Rounds to more than 65504, the largest finite half
+                        return static_cast<std::uint16_t>(sign | 0x7c00u);
+                }
+                std::uint32_t res, rem, halfway;
+                if (abs < 0x38800000u){
+                        // Below 2^-14, subnormal half in units of 2^-24
+                        if (abs < 0x33000000u){
+                                return static_cast<std::uint16_t>(sign);
+                        }
+                        const std::uint32_t mantissa = (abs & 0x7fffffu) | 0x800000u;
+                        const std::uint32_t shift = 126u - (abs >> 23);
+                        res = mantissa >> shift;
+                        rem = mantissa & ((1u << shift) - 1u);
+                        halfway = 1u << (shift - 1u);
+                }else{
+                        // Rebias the exponent and drop 13 significand bits
+                        res = (abs >> 13) - ((127u - 15u) << 10);
+                        rem = abs & 0x1fffu;
+                        halfway = 0x1000u;
+                }
+                // A carry out of the significand correctly increments the exponent
+                if (rem > halfway || (rem == halfway && (res & 1u))){
+                        res++;
+                }
+                return static_cast<std::uint16_t>(sign | res);
+        }
+
+        static constexpr float to_float(std::uint16_t h) noexcept
+        {
+                const std::uint32_t sign = (h & 0x8000u) << 16;
+                const std::uint32_t exponent = (h >> 10) & 0x1fu;
+                const std::uint32_t mantissa = h & 0x3ffu;
+                if (exponent == 0x1fu){
+                        return std::bit_cast<float>(sign | 0x7f800000u | (mantissa << 13));
+                }
+                if (exponent == 0){
+                        const float val = static_cast<float>(mantissa)*0x1p-24f;
+                        return sign ? -val : val;
+                }
+                return std::bit_cast<float>(sign | ((exponent + 112u) << 23) | (mantissa << 13));
+        }
+};
+
+}; // expr
+
+template<>
+struct std::numeric_limits<expr::bfloat16>
+{
+        static constexpr bool is_specialized = true;
+        static constexpr bool is_signed = true;
+        static constexpr bool is_integer = false;
+        static constexpr bool has_infinity = true;
+        static constexpr bool has_quiet_NaN = true;
+        static constexpr int digits = 8;
+        static constexpr expr::bfloat16 min() noexcept {return expr::bfloat16::from_bits(0x0080);}
+        static constexpr expr::bfloat16 max() noexcept {return expr::bfloat16::from_bits(0x7f7f);}
+        static constexpr expr::bfloat16 lowest() noexcept {return expr::bfloat16::from_bits(0xff7f);}
+        static constexpr expr::bfloat16 epsilon() noexcept {return expr::bfloat16::from_bits(0x3c00);}
+        static constexpr expr::bfloat16 infinity() noexcept {return expr::bfloat16::from_bits(0x7f80);}
+        static constexpr expr::bfloat16 quiet_NaN() noexcept {return expr::bfloat16::from_bits(0x7fc0);}
+};
+
+template<>
+struct std::numeric_limits<expr::half>
+{
+        static constexpr bool is_specialized = true;
+        static constexpr bool is_signed = true;
+        static constexpr bool is_integer = false;
+        static constexpr bool has_infinity = true;
+        static constexpr bool has_quiet_NaN = true;
+        static constexpr int digits = 11;
+        static constexpr expr::half min() noexcept {return expr::half::from_bits(0x0400);}
+        static constexpr expr::half max() noexcept {return expr::half::from_bits(0x7bff);}
+        static constexpr expr::half lowest() noexcept {return expr::half::from_bits(0xfbff);}
+        static constexpr expr::half epsilon() noexcept {return expr::half::from_bits(0x1400);}
+        static constexpr expr::half infinity() noexcept {return expr::half::from_bits(0x7c00);}
+        static constexpr expr::half quiet_NaN() noexcept {return expr::half::from_bits(0x7e00);}
+};
+
+#endif // EXPR_TEMPLATE_REDUCED_PRECISION_H
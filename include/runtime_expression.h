@@ -0,0 +1,403 @@
+#ifndef EXPR_TEMPLATE_RUNTIME_EXPRESSION_H
+#define EXPR_TEMPLATE_RUNTIME_EXPRESSION_H
+
+#include <extents_utils.h>
+#include <math_functions.h>
+#include <parallel.h>
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace expr::runtime
+{
+
+/***************************************************************************//**
+* Operations of runtime expressions.
+ ******************************************************************************/
+enum class unary_op {negate, abs, sqrt, exp, log, sin, cos, tanh};
+enum class binary_op {add, subtract, multiply, divide, min, max, pow};
+
+// Elements evaluated per instruction dispatch
+inline constexpr std::size_t block_size = 256;
+
+template<typename T>
+class Expression;
+template<typename T>
+class Program;
+
+namespace detail
+{
+        template<typename T>
+        struct Node
+        {
+                enum class kind {leaf, constant, unary, binary};
+                kind type;
+                const T* data = nullptr;
+                std::vector<std::size_t> extents{};
+                T value{};
+                unary_op uop{};
+                binary_op bop{};
+                std::shared_ptr<const Node> lhs{};
+                std::shared_ptr<const Node> rhs{};
+        };
+}; // detail
+
+/***************************************************************************//**
+* Expression is a node of a runtime built expression DAG with elements of type
+* T, for formulas only known at runtime (e.g. read from configuration files).
+* Leaves refer to the (row major, contiguous) elements of existing arrays,
+* which must outlive the expression and its compiled Program. Subexpressions
+* may be shared, they are then evaluated once. Expressions are evaluated by
+* compiling them into a Program (or through evaluate()).
+ ******************************************************************************/
+template<typename T>
+class Expression
+{
+    public:
+        using value_type = T;
+        using Node = detail::Node<T>;
+
+        // A leaf referring to the elements of array (e.g. a row major MDArray or a Matrix)
+        template<typename Array>
+        requires exts::has_flat_access<const Array&> && requires(const Array& a){ {a.data()} -> std::convertible_to<const T*>; }
+        static Expression leaf(const Array& array)
+        {
+                auto node = std::make_shared<Node>(Node{Node::kind::leaf});
+                node->data = array.data();
+                for(std::size_t d = 0; d < decltype(array.extents())::rank(); d++){
+                        node->extents.push_back(static_cast<std::size_t>(array.extent(d)));
+                }
+                return Expression(std::move(node));
+        }
+
+        static Expression constant(T value)
+        {
+                auto node = std::make_shared<Node>(Node{Node::kind::constant});
+                node->value = value;
+                return Expression(std::move(node));
+        }
+
+        static Expression unary(unary_op op, const Expression& operand)
+        {
+                auto node = std::make_shared<Node>(Node{Node::kind::unary});
+                node->uop = op;
+                node->extents = operand.m_node->extents;
+                node->lhs = operand.m_node;
+                return Expression(std::move(node));
+        }
+
+        // Constants are broadcast, all other operands must have the same extents
+        static Expression binary(binary_op op, const Expression& lhs, const Expression& rhs)
+        {
+                const auto& l = lhs.m_node->extents;
+                const auto& r = rhs.m_node->extents;
+                if(!l.empty() && !r.empty() && l != r){
+                        throw std::runtime_error("Extents of runtime expression operands do not match!\n" + extents_string(l) + " != " + extents_string(r));
+                }
+                auto node = std::make_shared<Node>(Node{Node::kind::binary});
+                node->bop = op;
+                node->extents = l.empty() ? r : l;
+                node->lhs = lhs.m_node;
+                node->rhs = rhs.m_node;
+                return Expression(std::move(node));
+        }
+
+        // Extents of the expression, empty for constants
+        const std::vector<std::size_t>& extents() const noexcept {return m_node->extents;}
+        const std::shared_ptr<const Node>& node() const noexcept {return m_node;}
+
+        /***********************************************************************
+        * Compile and evaluate into destination, which must provide data() to
+        * contiguous row major storage (flat access, as for leaves) with the
+        * extents of the expression.
+         **********************************************************************/
+        template<typename Destination>
+        requires exts::has_flat_access<Destination&> && requires(Destination& d){ {d.data()} -> std::convertible_to<T*>; }
+        void evaluate(Destination& destination) const
+        {
+                Program<T>(*this).evaluate(destination);
+        }
+
+        friend Expression operator+(const Expression& lhs, const Expression& rhs) {return binary(binary_op::add, lhs, rhs);}
+        friend Expression operator-(const Expression& lhs, const Expression& rhs) {return binary(binary_op::subtract, lhs, rhs);}
+        friend Expression operator*(const Expression& lhs, const Expression& rhs) {return binary(binary_op::multiply, lhs, rhs);}
+        friend Expression operator/(const Expression& lhs, const Expression& rhs) {return binary(binary_op::divide, lhs, rhs);}
+        friend Expression operator-(const Expression& operand) {return unary(unary_op::negate, operand);}
+
+    private:
+        std::shared_ptr<const Node> m_node;
+
+        explicit Expression(std::shared_ptr<const Node> node) noexcept : m_node(std::move(node)) {}
+
+        static std::string extents_string(const std::vector<std::size_t>& extents)
+        {
+                std::string res;
+                for(std::size_t e : extents){
+                        res += (res.empty() ? "" : "x") + std::to_string(e);
+                }
+                return res;
+        }
+};
+
+/***************************************************************************//**
+* Program is an Expression compiled to a flat list of instructions. Each
+* instruction applies one operation to a block of block_size elements, reading
+* leaves in place and block sized registers, the last one writing straight to
+* the destination. Registers are reused once their value is no longer
+* needed, so all intermediate values of a block stay in cache. The whole
+* expression is thus evaluated in a single pass over the leaves, blocks in
+* parallel on the library's thread pool, with one contiguous (vectorizable)
+* loop per instruction and block. Math functions use the branch free kernels
+* of the static expressions (see math_functions.h), so their loops vectorize
+* as well.
+ ******************************************************************************/
+template<typename T>
+class Program
+{
+    public:
+        explicit Program(const Expression<T>& expression)
+         : m_extents(expression.extents()), m_size(1), m_leaves(), m_constants(), m_code(), m_registers(0)
+        {
+                for(std::size_t e : m_extents){
+                        m_size *= e;
+                }
+                compile(expression.node());
+        }
+
+        const std::vector<std::size_t>& extents() const noexcept {return m_extents;}
+        std::size_t instruction_count() const noexcept {return m_code.size();}
+        std::size_t register_count() const noexcept {return m_registers;}
+
+        // Evaluate into the row major elements of destination, see Expression::evaluate
+        template<typename Destination>
+        requires exts::has_flat_access<Destination&> && requires(Destination& d){ {d.data()} -> std::convertible_to<T*>; }
+        void evaluate(Destination& destination) const
+        {
+                check_extents(destination);
+                T* out = destination.data();
+                const std::size_t n_blocks = (m_size + block_size - 1)/block_size;
+                parallel_for(std::size_t(0), n_blocks, std::size_t(64), [&](std::size_t begin, std::size_t end){
+                        std::vector<T> registers(m_registers*block_size);
+                        for(const auto& [reg, value] : m_constants){
+                                std::fill_n(registers.data() + reg*block_size, block_size, value);
+                        }
+                        for(std::size_t b = begin; b < end; b++){
+                                const std::size_t offset = b*block_size;
+                                run_block(registers.data(), out, offset, std::min(block_size, m_size - offset));
+                        }
+                });
+        }
+
+    private:
+        // Operand of an instruction: a register, a leaf (at the block offset) or the destination
+        struct Operand
+        {
+                enum class kind {reg, leaf, output};
+                kind type = kind::reg;
+                std::size_t index = 0;
+        };
+        enum class opcode {copy, unary, binary};
+        struct Instruction
+        {
+                opcode code;
+                unary_op uop;
+                binary_op bop;
+                Operand dst;
+                Operand lhs;
+                Operand rhs;
+        };
+
+        std::vector<std::size_t> m_extents;
+        std::size_t m_size;
+        std::vector<const T*> m_leaves;
+        std::vector<std::pair<std::size_t, T>> m_constants;
+        std::vector<Instruction> m_code;
+        std::size_t m_registers;
+
+        using Node = detail::Node<T>;
+
+        void compile(const std::shared_ptr<const Node>& root)
+        {
+                if(root->type == Node::kind::constant){
+                        throw std::runtime_error("Runtime expression has no array operands!");
+                }
+                // Post order, every shared node once, and the last instruction using each node
+                std::vector<const Node*> order;
+                std::unordered_map<const Node*, std::size_t> last_use;
+                visit(root.get(), order, last_use);
+
+                std::unordered_map<const Node*, Operand> values;
+                std::vector<std::size_t> free_registers;
+                auto allocate = [&](){
+                        if(free_registers.empty()){
+                                return m_registers++;
+                        }
+                        const std::size_t reg = free_registers.back();
+                        free_registers.pop_back();
+                        return reg;
+                };
+                auto release = [&](const Node* operand, std::size_t position){
+                        const Operand& value = values.at(operand);
+                        if(value.type == Operand::kind::reg && operand->type != Node::kind::constant && last_use.at(operand) == position){
+                                free_registers.push_back(value.index);
+                        }
+                };
+                for(std::size_t position = 0; position < order.size(); position++){
+                        const Node* node = order[position];
+                        switch(node->type){
+                                case Node::kind::leaf:
+                                        values[node] = {Operand::kind::leaf, m_leaves.size()};
+                                        m_leaves.push_back(node->data);
+                                        break;
+                                case Node::kind::constant:{
+                                        const std::size_t reg = m_registers++;
+                                        m_constants.emplace_back(reg, node->value);
+                                        values[node] = {Operand::kind::reg, reg};
+                                        break;
+                                }
+                                case Node::kind::unary:
+                                        release(node->lhs.get(), position);
+                                        values[node] = {Operand::kind::reg, allocate()};
+                                        m_code.push_back({opcode::unary, node->uop, binary_op{}, values[node], values.at(node->lhs.get()), {}});
+                                        break;
+                                case Node::kind::binary:
+                                        release(node->lhs.get(), position);
+                                        if(node->rhs != node->lhs){
+                                                release(node->rhs.get(), position);
+                                        }
+                                        values[node] = {Operand::kind::reg, allocate()};
+                                        m_code.push_back({opcode::binary, unary_op{}, node->bop, values[node], values.at(node->lhs.get()), values.at(node->rhs.get())});
+                                        break;
+                        }
+                }
+                // The root is written straight to the destination
+                if(m_code.empty() || root->type == Node::kind::leaf){
+                        m_code.push_back({opcode::copy, unary_op{}, binary_op{}, {Operand::kind::output, 0}, values.at(root.get()), {}});
+                }else{
+                        m_code.back().dst = {Operand::kind::output, 0};
+                }
+        }
+
+        void visit(const Node* node, std::vector<const Node*>& order, std::unordered_map<const Node*, std::size_t>& last_use) const
+        {
+                if(last_use.contains(node)){
+                        return;
+                }
+                last_use[node] = 0;
+                if(node->lhs){
+                        visit(node->lhs.get(), order, last_use);
+                }
+                if(node->rhs){
+                        visit(node->rhs.get(), order, last_use);
+                }
+                const std::size_t position = order.size();
+                order.push_back(node);
+                if(node->lhs){
+                        last_use[node->lhs.get()] = position;
+                }
+                if(node->rhs){
+                        last_use[node->rhs.get()] = position;
+                }
+        }
+
+        template<typename Destination>
+        void check_extents(const Destination& destination) const
+        {
+                constexpr std::size_t rank = decltype(destination.extents())::rank();
+                bool match = rank == m_extents.size();
+                for(std::size_t d = 0; match && d < rank; d++){
+                        match = static_cast<std::size_t>(destination.extent(d)) == m_extents[d];
+                }
+                if(!match){
+                        throw std::runtime_error("Destination extents do not match the runtime expression!");
+                }
+        }
+
+        void run_block(T* registers, T* out, std::size_t offset, std::size_t n) const noexcept
+        {
+                auto address = [&](const Operand& operand) -> T* {
+                        switch(operand.type){
+                                case Operand::kind::leaf:
+                                        return const_cast<T*>(m_leaves[operand.index]) + offset;
+                                case Operand::kind::output:
+                                        return out + offset;
+                                default:
+                                        return registers + operand.index*block_size;
+                        }
+                };
+                for(const Instruction& instruction : m_code){
+                        T* dst = address(instruction.dst);
+                        const T* a = address(instruction.lhs);
+                        switch(instruction.code){
+                                case opcode::copy:
+                                        std::copy_n(a, n, dst);
+                                        break;
+                                case opcode::unary:
+                                        apply_unary(instruction.uop, dst, a, n);
+                                        break;
+                                case opcode::binary:
+                                        apply_binary(instruction.bop, dst, a, address(instruction.rhs), n);
+                                        break;
+                        }
+                }
+        }
+
+        template<typename Op>
+        static void transform(T* dst, const T* a, std::size_t n, Op&& op) noexcept
+        {
+                for(std::size_t i = 0; i < n; i++){
+                        dst[i] = op(a[i]);
+                }
+        }
+        template<typename Op>
+        static void transform(T* dst, const T* a, const T* b, std::size_t n, Op&& op) noexcept
+        {
+                for(std::size_t i = 0; i < n; i++){
+                        dst[i] = op(a[i], b[i]);
+                }
+        }
+
+        // Math functions use the vectorizable kernels of the static expressions (math_functions.h)
+        template<typename Kernel>
+        static void apply_math(T* dst, const T* a, std::size_t n) noexcept
+        {
+                transform(dst, a, n, [](T x){ return static_cast<T>(expr::detail::math::function<Kernel>{}(x)); });
+        }
+
+        static void apply_unary(unary_op op, T* dst, const T* a, std::size_t n) noexcept
+        {
+                namespace math = expr::detail::math;
+                switch(op){
+                        case unary_op::negate: transform(dst, a, n, [](T x){ return static_cast<T>(-x); }); break;
+                        case unary_op::abs: transform(dst, a, n, [](T x){ return static_cast<T>(std::abs(x)); }); break;
+                        case unary_op::sqrt: apply_math<math::sqrt_kernel>(dst, a, n); break;
+                        case unary_op::exp: apply_math<math::exp_kernel>(dst, a, n); break;
+                        case unary_op::log: apply_math<math::log_kernel>(dst, a, n); break;
+                        case unary_op::sin: apply_math<math::sin_kernel>(dst, a, n); break;
+                        case unary_op::cos: apply_math<math::cos_kernel>(dst, a, n); break;
+                        case unary_op::tanh: apply_math<math::tanh_kernel>(dst, a, n); break;
+                }
+        }
+
+        static void apply_binary(binary_op op, T* dst, const T* a, const T* b, std::size_t n) noexcept
+        {
+                switch(op){
+                        case binary_op::add: transform(dst, a, b, n, [](T x, T y){ return static_cast<T>(x + y); }); break;
+                        case binary_op::subtract: transform(dst, a, b, n, [](T x, T y){ return static_cast<T>(x - y); }); break;
+                        case binary_op::multiply: transform(dst, a, b, n, [](T x, T y){ return static_cast<T>(x*y); }); break;
+                        case binary_op::divide: transform(dst, a, b, n, [](T x, T y){ return static_cast<T>(x/y); }); break;
+                        case binary_op::min: transform(dst, a, b, n, [](T x, T y){ return std::min(x, y); }); break;
+                        case binary_op::max: transform(dst, a, b, n, [](T x, T y){ return std::max(x, y); }); break;
+                        case binary_op::pow: transform(dst, a, b, n, [](T x, T y){ return static_cast<T>(expr::detail::math::pow_op{}(x, y)); }); break;
+                }
+        }
+};
+
+}; // expr::runtime
+#endif // EXPR_TEMPLATE_RUNTIME_EXPRESSION_H
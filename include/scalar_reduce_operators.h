@@ -2,6 +2,8 @@
 #define EXPR_TEMPLATE_SCALAR_REDUCE_OPERATOR_H
 
 #include <base_expression.h>
+#include <elementwise_binary_operators.h>
+#include <inner_product_expression.h>
 #include <extents_utils.h>
 #include <functional>
 #include <type_traits>
@@ -33,7 +35,7 @@ class ScalarReduceOp: public BaseExpr<ScalarReduceOp<RHS, REDUCE_OP>>{
         constexpr auto extents() const noexcept = delete;
         constexpr auto extent(std::size_t i) const noexcept = delete;
 
-        operator value_type() const noexcept
+        constexpr operator value_type() const noexcept
         {
                 return exts::reduce_each_index(m_rhs, m_acc, m_rhs.extents(), m_op);
         }
@@ -65,13 +67,32 @@ constexpr inline auto reduce(Expr&& expr, REDUCE_OP&& op, reduce_return_type<Exp
 
 /***************************************************************************//**
 * Returns an expression representing the sum of all elements in the
-* expression.
+* expression. The sum of a temporary product, sum(a*b), is the dot product of
+* a and b.
  ******************************************************************************/
 template<expression Expr>
 constexpr inline auto sum(Expr&& expr)
 {
-        auto f = [](auto acc, auto val){return acc + val;};
-        return reduce(std::forward<Expr>(expr), std::move(f), 0);
+        if constexpr(detail::product_temporary<Expr>){
+                auto parts = std::move(expr).release();
+                using LHS = detail::operand_type<std::tuple_element_t<1, decltype(parts)>>;
+                using RHS = detail::operand_type<std::tuple_element_t<2, decltype(parts)>>;
+                return DotProductOp<LHS, RHS>(std::get<1>(std::move(parts)), std::get<2>(std::move(parts)));
+        }else{
+                auto f = [](auto acc, auto val){return acc + val;};
+                return reduce(std::forward<Expr>(expr), std::move(f), 0);
+        }
+}
+
+/***************************************************************************//**
+* Returns an expression representing the sum of all elements in the
+* expression, accumulated in Acc, e.g. sum<double>(expr) for float elements.
+ ******************************************************************************/
+template<typename Acc, expression Expr>
+constexpr inline auto sum(Expr&& expr)
+{
+        auto f = [](Acc acc, auto val){return acc + static_cast<Acc>(val);};
+        return reduce(std::forward<Expr>(expr), std::move(f), Acc{0});
 }
 
 /***************************************************************************//**
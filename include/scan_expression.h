@@ -0,0 +1,423 @@
+#ifndef EXPR_TEMPLATE_SCAN_EXPRESSION_H
+#define EXPR_TEMPLATE_SCAN_EXPRESSION_H
+
+#include <base_expression.h>
+#include <conditional_expression.h>
+#include <scalar_reduce_operators.h>
+#include <extents_utils.h>
+#include <parallel.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <exception>
+#include <functional>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace expr
+{
+
+namespace detail
+{
+        // Elements scanned per parallel chunk (or block of a block scan) at least
+        inline constexpr std::size_t scan_grain = std::size_t(1) << 15;
+        // Consecutive elements of a row combined in registers at a time
+        inline constexpr std::size_t scan_width = 8;
+
+        template<typename Expr>
+        inline constexpr std::size_t last_axis = decltype(std::declval<std::remove_cvref_t<Expr>>().extents())::rank() - 1;
+
+        /***********************************************************************
+        * Inclusive scan of v in place, log2(N) steps of combining each element
+        * with the one s places before it (s = 1, 2, 4, ...). The steps are
+        * independent of each other within a step, unlike the chain of a
+        * sequential scan, and op is only ever applied to an earlier element
+        * on the left, so it need not be commutative.
+         **********************************************************************/
+        template<std::size_t N, typename T, typename Op>
+        constexpr void scan_registers(std::array<T, N>& v, const Op& op)
+        {
+                exts::static_for<std::bit_width(N - 1)>([&](auto l){
+                        constexpr std::size_t s = std::size_t(1) << l;
+                        exts::static_for<N - s>([&](auto j){
+                                constexpr std::size_t k = N - 1 - j;
+                                v[k] = op(v[k - s], v[k]);
+                        });
+                });
+        }
+
+        // Combination of v, pairwise in order
+        template<std::size_t N, typename T, typename Op>
+        constexpr T reduce_registers(std::array<T, N>& v, const Op& op)
+        {
+                exts::static_for<std::bit_width(N - 1)>([&](auto l){
+                        constexpr std::size_t s = std::size_t(1) << l;
+                        exts::static_for<(N + 2*s - 1)/(2*s)>([&](auto p){
+                                constexpr std::size_t k = 2*s*p;
+                                if constexpr(k + s < N){
+                                        v[k] = op(v[k], v[k + s]);
+                                }
+                        });
+                });
+                return v[0];
+        }
+}; // detail
+
+/***************************************************************************//**
+* ScanOp represents the inclusive (or, with Exclusive, exclusive) prefix scan
+* of an expression along one axis: element i along the axis is
+* op(op(op(e[0], e[1]), ...), e[i]) (op(...(op(init, e[0]), ...), e[i - 1])
+* for exclusive scans). op must be associative, it is applied in a different
+* grouping than a sequential scan would (but always to elements in order).
+*
+* Single elements are computed by scanning all elements before them, the
+* whole scan (assign_to) in one pass over the expression: parallel over the
+* other dimensions when there are enough independent scans, otherwise as a
+* two pass block scan, all threads reducing one block of the axis each,
+* then scanning it from the combination of the blocks before it (which reads
+* the expression twice, so it is only used with several threads). Elements
+* along the axis are scanned a few at a time in registers, rows across the
+* axis elementwise.
+ ******************************************************************************/
+template<expression Expr, typename Op, bool Exclusive>
+class ScanOp : public BaseExpr<ScanOp<Expr, Op, Exclusive>>
+{
+    public:
+        using Base = BaseExpr<ScanOp<Expr, Op, Exclusive>>;
+        using Expr_noref = std::remove_cvref_t<Expr>;
+        using value_type = reduce_return_type<Expr, Op>;
+        using extents_type = decltype(std::declval<Expr_noref>().extents());
+        using index_type = typename extents_type::index_type;
+        static constexpr std::size_t rank = extents_type::rank();
+        using point_type = std::array<index_type, rank>;
+
+        constexpr explicit ScanOp(Expr&& expr, Op&& op, std::size_t axis, value_type init)
+         : Base(), m_expr(std::forward<Expr>(expr)), m_op(std::forward<Op>(op)), m_axis(axis), m_init(init)
+        {
+                if(axis >= rank){
+                        throw std::runtime_error("Scan axis out of range!\n" + std::to_string(axis) + " >= " + std::to_string(rank));
+                }
+        }
+        constexpr explicit ScanOp(const ScanOp&) noexcept = default;
+        constexpr explicit ScanOp(ScanOp&&) noexcept = default;
+        ~ScanOp() noexcept = default;
+
+        constexpr auto extents() const noexcept {return m_expr.extents();}
+        constexpr auto extent(std::size_t i) const noexcept {return m_expr.extent(i);}
+        constexpr std::size_t axis() const noexcept {return m_axis;}
+
+#ifdef CLANGBUG
+        constexpr value_type operator()(auto&&... indices) const
+        {
+                return get_value({detail::convert<index_type>(indices)...});
+        }
+#endif
+        constexpr value_type operator[](auto&&... indices) const
+        {
+                return get_value({detail::convert<index_type>(indices)...});
+        }
+
+        /***************************************************************
+        * Number of blocks along the axis assign_to splits each scan
+        * into, 1 when the scans are run independently of each other
+        * (short scans, at least as many scans as threads, or a single
+        * thread).
+         **************************************************************/
+        std::size_t blocks() const noexcept
+        {
+                const std::size_t length = static_cast<std::size_t>(extent(m_axis));
+                const std::size_t slab = length*inner_size();
+                if(slab <= detail::scan_grain || outer_size() >= num_threads()){
+                        return 1;
+                }
+                return std::clamp<std::size_t>(slab/detail::scan_grain, 1, std::min(length, 4*num_threads()));
+        }
+
+        /***************************************************************
+        * Evaluate the whole scan into destination.
+         **************************************************************/
+        template<typename Destination>
+        void assign_to(Destination& destination) const
+        {
+                const std::size_t length = static_cast<std::size_t>(extent(m_axis));
+                const std::size_t outer = outer_size();
+                const std::size_t inner = inner_size();
+                if(length == 0 || outer == 0 || inner == 0){
+                        return;
+                }
+                const std::vector<value_type> init(Exclusive ? inner : 0, m_init);
+                const std::size_t slab = length*inner;
+                const std::size_t n_blocks = blocks();
+                if(n_blocks == 1){
+                        // Independent scans, parallel over the dimensions before the axis
+                        const std::size_t grain = std::max<std::size_t>(1, detail::scan_grain/slab);
+                        parallel_for(std::size_t(0), outer, grain, [&](std::size_t begin, std::size_t end){
+                                for(std::size_t o = begin; o < end; o++){
+                                        scan_slab(destination, outer_point(o), 0, length, std::span<const value_type>(init));
+                                }
+                        });
+                }else{
+                        for(std::size_t o = 0; o < outer; o++){
+                                block_scan(destination, outer_point(o), length, inner, n_blocks, init);
+                        }
+                }
+        }
+
+        constexpr ScanOp& operator=(const ScanOp&) noexcept = default;
+        constexpr ScanOp& operator=(ScanOp&&) noexcept = default;
+        constexpr auto operands() const noexcept {return std::forward_as_tuple(m_expr);}
+    private:
+        std::remove_cv_t<Expr> m_expr;
+        std::remove_cv_t<Op> m_op;
+        std::size_t m_axis;
+        value_type m_init;
+
+        constexpr value_type load(const point_type& indices) const
+        {
+                return detail::convert<value_type>(std::apply([&](auto... i){ return detail::subscript(m_expr, i...); }, indices));
+        }
+
+        template<typename Destination>
+        static constexpr void store(Destination& destination, const point_type& indices, const value_type& val)
+        {
+                std::apply([&](auto... i){ detail::subscript(destination, i...) = val; }, indices);
+        }
+
+        constexpr value_type get_value(point_type indices) const
+        {
+                const index_type stop = Exclusive ? indices[m_axis] : indices[m_axis] + 1;
+                indices[m_axis] = 0;
+                value_type acc = Exclusive ? m_init : load(indices);
+                for(index_type i = Exclusive ? 0 : 1; i < stop; i++){
+                        indices[m_axis] = i;
+                        acc = m_op(acc, load(indices));
+                }
+                return acc;
+        }
+
+        // Indices of the o:th (in row major order) scan, the dimensions before the axis
+        point_type outer_point(std::size_t o) const noexcept
+        {
+                point_type indices{};
+                for(std::size_t d = m_axis; d-- > 0;){
+                        const auto n = static_cast<std::size_t>(extent(d));
+                        indices[d] = static_cast<index_type>(o%n);
+                        o /= n;
+                }
+                return indices;
+        }
+
+        // Calls f(indices, c) for all indices of the dimensions after the
+        // axis, c numbering them in row major order
+        template<std::size_t D, typename F>
+        void visit_inner(point_type& indices, std::size_t& c, F& f) const
+        {
+                if constexpr(D == rank){
+                        f(std::as_const(indices), c++);
+                }else if(D <= m_axis){
+                        visit_inner<D + 1>(indices, c, f);
+                }else{
+                        for(indices[D] = 0; indices[D] < extent(D); indices[D]++){
+                                visit_inner<D + 1>(indices, c, f);
+                        }
+                }
+        }
+
+        template<typename F>
+        void for_each_inner(point_type& indices, F&& f) const
+        {
+                std::size_t c = 0;
+                visit_inner<0>(indices, c, f);
+        }
+
+        /***************************************************************
+        * Scans [begin, end) along the axis at indices, continuing from
+        * carry (one value per index of the dimensions after the axis),
+        * or from the first element if carry is empty.
+         **************************************************************/
+        template<typename Destination>
+        void scan_slab(Destination& destination, point_type indices, std::size_t begin, std::size_t end, std::span<const value_type> carry) const
+        {
+                const bool first = carry.empty();
+                const std::size_t inner = inner_size();
+                if(inner == 1){
+                        scan_row(destination, indices, begin, end, first ? value_type{} : carry[0], first);
+                        return;
+                }
+                std::vector<value_type> run = first ? std::vector<value_type>(inner) : std::vector<value_type>(carry.begin(), carry.end());
+                std::size_t i = begin;
+                if(first){
+                        indices[m_axis] = static_cast<index_type>(i++);
+                        for_each_inner(indices, [&](const point_type& idx, std::size_t c){
+                                run[c] = load(idx);
+                                store(destination, idx, run[c]);
+                        });
+                }
+                for(; i < end; i++){
+                        indices[m_axis] = static_cast<index_type>(i);
+                        for_each_inner(indices, [&](const point_type& idx, std::size_t c){
+                                const value_type x = load(idx);
+                                if constexpr(Exclusive){
+                                        store(destination, idx, run[c]);
+                                        run[c] = m_op(run[c], x);
+                                }else{
+                                        run[c] = m_op(run[c], x);
+                                        store(destination, idx, run[c]);
+                                }
+                        });
+                }
+        }
+
+        // Scan of a row along the axis, scan_width elements at a time
+        template<typename Destination>
+        void scan_row(Destination& destination, point_type& indices, std::size_t begin, std::size_t end, value_type acc, bool first) const
+        {
+                constexpr std::size_t width = detail::scan_width;
+                std::size_t i = begin;
+                if(first && i < end){
+                        indices[m_axis] = static_cast<index_type>(i++);
+                        acc = load(indices);
+                        store(destination, indices, acc);
+                }
+                for(; i + width <= end; i += width){
+                        std::array<value_type, width> v;
+                        exts::static_for<width>([&](auto j){
+                                indices[m_axis] = static_cast<index_type>(i + j);
+                                v[j] = load(indices);
+                        });
+                        detail::scan_registers(v, m_op);
+                        exts::static_for<width>([&](auto j){
+                                indices[m_axis] = static_cast<index_type>(i + j);
+                                if constexpr(Exclusive && j == 0){
+                                        store(destination, indices, acc);
+                                }else if constexpr(Exclusive){
+                                        store(destination, indices, m_op(acc, v[j - 1]));
+                                }else{
+                                        store(destination, indices, m_op(acc, v[j]));
+                                }
+                        });
+                        acc = m_op(acc, v[width - 1]);
+                }
+                for(; i < end; i++){
+                        indices[m_axis] = static_cast<index_type>(i);
+                        const value_type x = load(indices);
+                        if constexpr(Exclusive){
+                                store(destination, indices, acc);
+                                acc = m_op(acc, x);
+                        }else{
+                                acc = m_op(acc, x);
+                                store(destination, indices, acc);
+                        }
+                }
+        }
+
+        // Combination of the elements [begin, end) along the axis at
+        // indices, one value per index of the dimensions after the axis
+        void reduce_slab(point_type indices, std::size_t begin, std::size_t end, value_type* res) const
+        {
+                constexpr std::size_t width = detail::scan_width;
+                indices[m_axis] = static_cast<index_type>(begin);
+                for_each_inner(indices, [&](const point_type& idx, std::size_t c){
+                        res[c] = load(idx);
+                });
+                std::size_t i = begin + 1;
+                if(inner_size() == 1){
+                        for(; i + width <= end; i += width){
+                                std::array<value_type, width> v;
+                                exts::static_for<width>([&](auto j){
+                                        indices[m_axis] = static_cast<index_type>(i + j);
+                                        v[j] = load(indices);
+                                });
+                                res[0] = m_op(res[0], detail::reduce_registers(v, m_op));
+                        }
+                }
+                for(; i < end; i++){
+                        indices[m_axis] = static_cast<index_type>(i);
+                        for_each_inner(indices, [&](const point_type& idx, std::size_t c){
+                                res[c] = m_op(res[c], load(idx));
+                        });
+                }
+        }
+
+        /***************************************************************
+        * Two pass parallel scan of one slab: each block along the axis
+        * is reduced, the results combined in order into the value each
+        * block continues from, then the blocks are scanned.
+         **************************************************************/
+        template<typename Destination>
+        void block_scan(Destination& destination, const point_type& indices, std::size_t length, std::size_t inner, std::size_t n_blocks, const std::vector<value_type>& init) const
+        {
+                auto block_begin = [&](std::size_t b){ return b*length/n_blocks; };
+                std::vector<value_type> totals(n_blocks*inner);
+                parallel_for(std::size_t(0), n_blocks, std::size_t(1), [&](std::size_t begin, std::size_t end){
+                        for(std::size_t b = begin; b < end; b++){
+                                reduce_slab(indices, block_begin(b), block_begin(b + 1), totals.data() + b*inner);
+                        }
+                });
+                // Block b continues from the combination of init and
+                // blocks 0, ..., b - 1 (block 0 of inclusive scans from nothing)
+                std::vector<value_type> carries(n_blocks*inner);
+                for(std::size_t b = 0; b < n_blocks; b++){
+                        for(std::size_t c = 0; c < inner; c++){
+                                if(b == 0){
+                                        carries[c] = Exclusive ? init[c] : value_type{};
+                                }else if(!Exclusive && b == 1){
+                                        carries[inner + c] = totals[c];
+                                }else{
+                                        carries[b*inner + c] = m_op(carries[(b - 1)*inner + c], totals[(b - 1)*inner + c]);
+                                }
+                        }
+                }
+                parallel_for(std::size_t(0), n_blocks, std::size_t(1), [&](std::size_t begin, std::size_t end){
+                        for(std::size_t b = begin; b < end; b++){
+                                const bool first = !Exclusive && b == 0;
+                                scan_slab(destination, indices, block_begin(b), block_begin(b + 1), first ? std::span<const value_type>() : std::span<const value_type>(carries.data() + b*inner, inner));
+                        }
+                });
+        }
+
+        std::size_t outer_size() const noexcept
+        {
+                std::size_t outer = 1;
+                for(std::size_t d = 0; d < m_axis; d++){
+                        outer *= static_cast<std::size_t>(extent(d));
+                }
+                return outer;
+        }
+
+        std::size_t inner_size() const noexcept
+        {
+                std::size_t inner = 1;
+                for(std::size_t d = m_axis + 1; d < rank; d++){
+                        inner *= static_cast<std::size_t>(extent(d));
+                }
+                return inner;
+        }
+};
+
+/***************************************************************************//**
+* Returns the inclusive scan of expr with op along axis (by default the last
+* one), e.g. the cumulative sum inclusive_scan(e) or the running maximum
+* inclusive_scan(e, [](auto a, auto b){return std::max(a, b);}, 0).
+ ******************************************************************************/
+template<expression Expr, typename Op = std::plus<>>
+constexpr inline auto inclusive_scan(Expr&& expr, Op&& op = Op{}, std::size_t axis = detail::last_axis<Expr>)
+{
+        return ScanOp<Expr, Op, false>(std::forward<Expr>(expr), std::forward<Op>(op), axis, reduce_return_type<Expr, Op>{});
+}
+
+/***************************************************************************//**
+* Returns the exclusive scan of expr with op along axis, starting from init:
+* element i along the axis combines init with the elements before i only.
+ ******************************************************************************/
+template<expression Expr, typename Op = std::plus<>>
+constexpr inline auto exclusive_scan(Expr&& expr, Op&& op = Op{}, std::size_t axis = detail::last_axis<Expr>, reduce_return_type<Expr, Op> init = 0)
+{
+        return ScanOp<Expr, Op, true>(std::forward<Expr>(expr), std::forward<Op>(op), axis, init);
+}
+
+}; // expr
+#endif // EXPR_TEMPLATE_SCAN_EXPRESSION_H
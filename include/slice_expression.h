@@ -2,122 +2,392 @@
 #define EXPR_TEMPLATE_SLICE_EXPRESSION_H
 
 #include <base_expression.h>
+#include <extents_utils.h>
 #include <bits/utility.h>
+#include <array>
+#include <concepts>
+#include <exception>
+#include <string>
 #include <tuple>
-namespace expr{
+#include <type_traits>
 
+namespace expr{
 
-namespace detail{
-template <typename T> 
-int sgn(T val) {
-        return (T(0) < val) - (val < T(0));
-}
-}; // detail
+/***************************************************************************//**
+* SliceRange selects the indices start, start + step, start + 2*step, ... up
+* to, but not including, stop. The step may be negative, in which case start
+* should be larger than stop. If no step is given it is +1 or -1 depending on
+* the order of start and stop.
+ ******************************************************************************/
 template<typename IndexType>
 struct SliceRange
 {
         using StepType = typename std::make_signed<IndexType>::type;
-        SliceRange(IndexType start, IndexType stop, IndexType step)
+        constexpr SliceRange(IndexType start, IndexType stop, StepType step)
                 : m_start(start), m_stop(stop), m_step(step)
         {}
-        SliceRange(IndexType start, IndexType stop)
-                : m_start(start), m_stop(stop), m_step(detail::sgn(static_cast<StepType>(stop - start)))
+        constexpr SliceRange(IndexType start, IndexType stop)
+                : m_start(start), m_stop(stop), m_step(stop < start ? -1 : 1)
         {}
         IndexType m_start;
         IndexType m_stop;
         StepType m_step;
 };
-struct all
+
+/***************************************************************************//**
+* UnitSliceRange selects the indices start, start + 1, ..., stop - 1. Since the
+* step is known at compile time, slices whose innermost dimension is a
+* UnitSliceRange keep unit stride in that dimension.
+ ******************************************************************************/
+template<typename IndexType>
+struct UnitSliceRange
+{
+        constexpr UnitSliceRange(IndexType start, IndexType stop)
+                : m_start(start), m_stop(stop)
+        {}
+        IndexType m_start;
+        IndexType m_stop;
+};
+
+/***************************************************************************//**
+* Slice specifier selecting every index in a dimension. (The name all is
+* already taken by the all predicate reduction.)
+ ******************************************************************************/
+struct all_t
 {};
+
+namespace detail{
+template<typename Spec>
+struct is_slice_range : std::false_type {};
+template<typename IndexType>
+struct is_slice_range<SliceRange<IndexType>> : std::true_type {};
+
+template<typename Spec>
+struct is_unit_slice_range : std::false_type {};
+template<typename IndexType>
+struct is_unit_slice_range<UnitSliceRange<IndexType>> : std::true_type {};
+
+template<typename Spec>
+concept index_spec = std::integral<std::remove_cvref_t<Spec>>;
+template<typename Spec>
+concept all_spec = std::same_as<std::remove_cvref_t<Spec>, all_t>;
+template<typename Spec>
+concept range_spec = is_slice_range<std::remove_cvref_t<Spec>>::value;
+template<typename Spec>
+concept unit_range_spec = is_unit_slice_range<std::remove_cvref_t<Spec>>::value;
+template<typename Spec>
+concept slice_spec = index_spec<Spec> || all_spec<Spec> || range_spec<Spec> || unit_range_spec<Spec>;
+
 /*******************************************************************************
- * m ~ (1, 2, 3, 4, 5)
- * s = slice(m, 0, 0, all, all, {1, 5, 2}) ~ (3, 4, 2)
- * s[2, 3, 1] = m[0, 0, 2, 3, 1 + 1*2] = m[0, 0, 2, 3, 3]
- *
- * store offset, (o1, o2, o3, o4, o5) and strides(s1, s2, s3, s4, s5)
+ * Compile time information about a list of slice specifiers. Dimensions given
+ * an integer index are dropped from the slice, all other dimensions are kept.
  ******************************************************************************/
-template<expression Expr, typename OriginalExtents, typename SliceExtents, typename Offsets, typename Steps>
-class Slice;
+template<typename... Specs>
+struct slice_traits
+{
+        static constexpr size_t original_rank = sizeof...(Specs);
+        static constexpr std::array<bool, original_rank> kept{!index_spec<Specs>...};
+        static constexpr std::array<bool, original_rank> unit_step{(all_spec<Specs> || unit_range_spec<Specs>)...};
+        static constexpr std::array<bool, original_rank> full{all_spec<Specs>...};
 
-template<expression Expr, typename IndexType, size_t... OriginalExtents, size_t... SliceExtents, typename... Offsets, typename... Steps>
-#ifndef DEDUCE_THIS
-class Slice<Expr,  stdex::extents<IndexType, OriginalExtents...>, stdex::extents<IndexType, SliceExtents...>, Pack<Offsets...>, Pack<Steps...>> : public BaseExpr<Slice<Expr, stdex::extents<IndexType, OriginalExtents...>, stdex::extents<IndexType, SliceExtents...>, Pack<Offsets...>, Pack<Steps...>>>
-#else
-class Slice : public BaseExpr
-#endif
+        static constexpr size_t rank = (static_cast<size_t>(!index_spec<Specs>) + ... + 0);
+
+        // Position of each kept dimension in the slice
+        static constexpr std::array<size_t, original_rank> position = []{
+                std::array<size_t, original_rank> res{};
+                size_t pos = 0;
+                for(size_t d = 0; d < original_rank; d++){
+                        res[d] = pos;
+                        pos += kept[d];
+                }
+                return res;
+        }();
+
+        // Original dimension of each dimension in the slice
+        static constexpr std::array<size_t, rank> original_dim = []{
+                std::array<size_t, rank> res{};
+                for(size_t d = 0; d < original_rank; d++){
+                        if(kept[d]){
+                                res[position[d]] = d;
+                        }
+                }
+                return res;
+        }();
+
+        static constexpr bool unit_inner_stride = original_rank > 0 && unit_step[original_rank - 1];
+
+        // Integer indices, followed by a unit step range, followed by full
+        // dimensions. Such a slice is one contiguous piece of a row major
+        // expression.
+        static constexpr bool contiguous = []{
+                size_t d = 0;
+                while(d < original_rank && !kept[d]){
+                        d++;
+                }
+                if(d == original_rank || !unit_step[d]){
+                        return false;
+                }
+                for(d++; d < original_rank; d++){
+                        if(!full[d]){
+                                return false;
+                        }
+                }
+                return true;
+        }();
+};
+
+template<typename IndexType, size_t... OriginalExtents, size_t... SliceDims>
+constexpr auto slice_extents_type(stdex::extents<IndexType, OriginalExtents...>, std::index_sequence<SliceDims...>, auto traits)
+{
+        constexpr std::array<size_t, sizeof...(OriginalExtents)> original_extents{OriginalExtents...};
+        return stdex::extents<IndexType, (decltype(traits)::full[decltype(traits)::original_dim[SliceDims]] ? original_extents[decltype(traits)::original_dim[SliceDims]] : std::dynamic_extent)...>{};
+}
+
+template<typename OriginalExtents, typename... Specs>
+using slice_extents_t = decltype(slice_extents_type(OriginalExtents{}, std::make_index_sequence<slice_traits<Specs...>::rank>{}, slice_traits<Specs...>{}));
+}; // detail
+
+/***************************************************************************//**
+* Slice represents a (possibly strided) sub-region of another expression.
+* Every dimension of the original expression is either fixed to one index
+* (and dropped from the slice), taken in full (all_t) or restricted to a
+* SliceRange/UnitSliceRange. Slices of writable expressions are writable,
+* assigning an expression (or a scalar) to a slice updates the matching
+* elements of the original expression in place.
+*
+* m ~ (1, 2, 3, 4, 5)
+* s = slice(m, 0, 0, all_t{}, all_t{}, SliceRange{1, 5, 2}) ~ (3, 4, 2)
+* s[2, 3, 1] = m[0, 0, 2, 3, 1 + 1*2] = m[0, 0, 2, 3, 3]
+ ******************************************************************************/
+template<expression Expr, typename... Specs>
+class Slice : public BaseExpr<Slice<Expr, Specs...>>
 {
         public:
+                using Base = BaseExpr<Slice<Expr, Specs...>>;
+                using Expr_noref = std::remove_cvref_t<Expr>;
+                using value_type = typename Expr_noref::value_type;
+                using original_extents_type = decltype(std::declval<Expr_noref>().extents());
+                using index_type = typename original_extents_type::index_type;
+                using step_type = std::make_signed_t<index_type>;
+                using traits = detail::slice_traits<Specs...>;
+                using extents_type = detail::slice_extents_t<original_extents_type, Specs...>;
+
+                static constexpr bool unit_inner_stride = traits::unit_inner_stride;
+                static constexpr bool contiguous = traits::contiguous;
 
-                constexpr explicit Slice(Expr&& expr, stdex::extents<IndexType, SliceExtents...>&& slice_extents, std::tuple<Offsets...>&& offsets, std::tuple<Steps...>&& steps)
-                        : Base(), m_offsets(std::forward<std::tuple<Offsets...>>(offsets)), m_steps(std::forward<std::tuple<Steps...>>(steps)), m_expr(std::forward<Expr>(expr)),  m_extents(std::forward<stdex::extents<IndexType, SliceExtents...>>(slice_extents))
+                constexpr explicit Slice(Expr&& expr, extents_type&& slice_extents,
+                                std::array<index_type, traits::original_rank>&& offsets,
+                                std::array<step_type, traits::original_rank>&& steps)
+                        : Base(), m_offsets(std::move(offsets)), m_steps(std::move(steps)),
+                        m_expr(std::forward<Expr>(expr)), m_extents(std::move(slice_extents)),
+                        m_flat_offset(flat_offset())
                 {}
                 constexpr explicit Slice(const Slice&) noexcept = default;
                 constexpr explicit Slice(Slice&&) noexcept = default;
                 ~Slice() noexcept = default;
 
-                constexpr Slice& operator=(const Slice&) noexcept = default;
-                constexpr Slice& operator=(Slice&&) noexcept = default;
+                /***************************************************************
+                * Assigning to a slice writes through to the sliced expression.
+                 **************************************************************/
+                constexpr Slice& operator=(const Slice& other)
+                {
+                        return assign(other);
+                }
+                template<expression Other>
+                constexpr Slice& operator=(Other&& other)
+                {
+                        return assign(std::forward<Other>(other));
+                }
+                constexpr Slice& operator=(const value_type& val)
+                {
+                        auto fill = [&](auto... indices)
+                        {
+#ifdef CLANGBUG
+                                (*this)(indices...) = val;
+#else
+                                (*this)[indices...] = val;
+#endif
+                        };
+                        exts::for_each_index(m_extents, std::move(fill));
+                        return *this;
+                }
 
-                using Base = BaseExpr<Slice<Expr, stdex::extents<IndexType, OriginalExtents...>, stdex::extents<IndexType, SliceExtents...>, Pack<Offsets...>, Pack<Steps...>>>;
-                constexpr auto extents() const
+                constexpr auto extents() const noexcept
                 {
-                        return m_extents();
+                        return m_extents;
                 }
-                constexpr auto extent(const size_t i) const
+                constexpr auto extent(const size_t i) const noexcept
                 {
                         return m_extents.extent(i);
                 }
 
 #ifdef CLANGBUG
-                constexpr auto operator()(auto&& ... indices) const
-#else
-                constexpr auto operator[](auto&& ... indices) const
+                constexpr decltype(auto) operator()(auto&& ... indices) const
+                {
+                        return get_value(*this, std::make_index_sequence<traits::original_rank>{}, indices...);
+                }
+                constexpr decltype(auto) operator()(auto&& ... indices)
+                {
+                        return get_value(*this, std::make_index_sequence<traits::original_rank>{}, indices...);
+                }
 #endif
+                constexpr decltype(auto) operator[](auto&& ... indices) const
+                {
+                        return get_value(*this, std::make_index_sequence<traits::original_rank>{}, indices...);
+                }
+                constexpr decltype(auto) operator[](auto&& ... indices)
+                {
+                        return get_value(*this, std::make_index_sequence<traits::original_rank>{}, indices...);
+                }
+
+                /***************************************************************
+                * Contiguous slices of expressions with flat (row major linear)
+                * access have flat access themselves.
+                 **************************************************************/
+                constexpr decltype(auto) flat(std::size_t n) const requires (contiguous && exts::has_flat_access<Expr>)
+                {
+                        return m_expr.flat(m_flat_offset + n);
+                }
+                constexpr decltype(auto) flat(std::size_t n) requires (contiguous && exts::has_flat_access<Expr>)
                 {
-                        return get_expanded_indices(
-                                        indices...,
-                                        std::make_index_sequence<sizeof...(OriginalExtents)>{}
-                                        );
+                        return m_expr.flat(m_flat_offset + n);
                 }
+                constexpr auto operands() const noexcept {return std::forward_as_tuple(m_expr);}
         private:
-                std::tuple<Offsets...> m_offsets;
-                std::tuple<Steps...> m_steps;
+                std::array<index_type, traits::original_rank> m_offsets;
+                std::array<step_type, traits::original_rank> m_steps;
                 std::remove_cv_t<Expr> m_expr;
-                stdex::extents<IndexType, SliceExtents...> m_extents;
-                template<typename SliceIndex, typename... SliceIndices, size_t I, size_t... Is, typename... ExpandedIndices>
-                constexpr auto get_expanded_indices(
-                        SliceIndex index,
-                        SliceIndices&&... indices,
-                        std::index_sequence<I, Is...>,
-                        ExpandedIndices&& ... expanded_indices) const
+                extents_type m_extents;
+                std::size_t m_flat_offset;
+
+                template<size_t D, typename... Indices>
+                constexpr index_type expand_index(Indices... indices) const
                 {
-                        if constexpr(sizeof...(Is) > 0){
-                                if constexpr(std::get<I>(m_steps) > 0){
-                                        return get_expanded_indices(
-                                                        indices...,
-                                                        std::index_sequence<Is...>{},
-                                                        expanded_indices...,
-                                                        std::get<I>(m_offsets) + index*std::get<I>(m_steps)
-                                                        );
+                        if constexpr(!traits::kept[D]){
+                                return m_offsets[D];
+                        }else{
+                                const std::array<index_type, sizeof...(Indices)> idx{static_cast<index_type>(indices)...};
+                                if constexpr(traits::unit_step[D]){
+                                        return m_offsets[D] + idx[traits::position[D]];
                                 }else{
-                                        return get_expanded_indices(
-                                                        index,
-                                                        indices...,
-                                                        std::index_sequence<Is...>{},
-                                                        expanded_indices...,
-                                                        std::get<I>(m_offsets)
-                                                        );
+                                        return static_cast<index_type>(static_cast<step_type>(m_offsets[D]) + static_cast<step_type>(idx[traits::position[D]])*m_steps[D]);
                                 }
-                        }else{
+                        }
+                }
+
+                template<typename Self, size_t... Ds, typename... Indices>
+                static constexpr decltype(auto) get_value(Self& self, std::index_sequence<Ds...>, Indices... indices)
+                {
 #ifdef CLANGBUG
-                                return m_expr(expanded_indices...);
+                        return self.m_expr(self.template expand_index<Ds>(indices...)...);
 #else
-                                return m_expr[expanded_indices...];
+                        return self.m_expr[self.template expand_index<Ds>(indices...)...];
 #endif
+                }
+
+                constexpr std::size_t flat_offset() const noexcept
+                {
+                        std::size_t offset = 0;
+                        for(size_t d = 0; d < traits::original_rank; d++){
+                                offset = offset*static_cast<std::size_t>(m_expr.extent(d)) + static_cast<std::size_t>(m_offsets[d]);
+                        }
+                        return offset;
+                }
+
+                template<expression Other>
+                constexpr Slice& assign(Other&& other)
+                {
+                        if (other.extents().rank() != m_extents.rank()){
+                                throw std::runtime_error("Rank of assigned expression does not match rank of slice!\n" + std::to_string(other.extents().rank()) + " != " + std::to_string(m_extents.rank()));
+                        }
+                        for (size_t i = 0; i < m_extents.rank(); i++){
+                                if (static_cast<size_t>(other.extent(i)) != static_cast<size_t>(m_extents.extent(i))){
+                                        throw std::runtime_error("Dimensions do not match!\nDimension " + std::to_string(i) + ": " + std::to_string(other.extent(i)) + " != " + std::to_string(m_extents.extent(i)));
+                                }
                         }
+                        exts::assign_each_index(std::forward<Other>(other), *this, m_extents);
+                        return *this;
                 }
+
                 constexpr explicit Slice() noexcept = default;
 };
 
+namespace detail{
+template<typename IndexType>
+constexpr void check_slice_index(IndexType index, size_t extent, size_t dim)
+{
+        if (static_cast<size_t>(index) >= extent){
+                throw std::runtime_error("Slice index out of range!\nDimension " + std::to_string(dim) + ": " + std::to_string(index) + " >= " + std::to_string(extent));
+        }
+}
+
+template<typename IndexType, typename StepType, typename Spec>
+constexpr void slice_spec_values(const Spec& spec, size_t extent, size_t dim, IndexType& offset, StepType& step, IndexType& size)
+{
+        if constexpr(index_spec<Spec>){
+                check_slice_index(spec, extent, dim);
+                offset = static_cast<IndexType>(spec);
+                step = 0;
+                size = 1;
+        }else if constexpr(all_spec<Spec>){
+                offset = 0;
+                step = 1;
+                size = static_cast<IndexType>(extent);
+        }else if constexpr(unit_range_spec<Spec>){
+                if (spec.m_stop < spec.m_start || static_cast<size_t>(spec.m_stop) > extent){
+                        throw std::runtime_error("Slice range out of range!\nDimension " + std::to_string(dim) + ": [" + std::to_string(spec.m_start) + ", " + std::to_string(spec.m_stop) + ") with extent " + std::to_string(extent));
+                }
+                offset = static_cast<IndexType>(spec.m_start);
+                step = 1;
+                size = static_cast<IndexType>(spec.m_stop - spec.m_start);
+        }else{
+                if (spec.m_step == 0){
+                        throw std::runtime_error("Slice range step must be non-zero!\nDimension " + std::to_string(dim));
+                }
+                offset = static_cast<IndexType>(spec.m_start);
+                step = static_cast<StepType>(spec.m_step);
+                const auto start = static_cast<StepType>(spec.m_start);
+                const auto stop = static_cast<StepType>(spec.m_stop);
+                const auto length = step > 0 ? stop - start : start - stop;
+                const auto abs_step = step > 0 ? step : -step;
+                size = length > 0 ? static_cast<IndexType>((length + abs_step - 1)/abs_step) : 0;
+                if (size > 0){
+                        check_slice_index(spec.m_start, extent, dim);
+                        check_slice_index(static_cast<IndexType>(start + static_cast<StepType>(size - 1)*step), extent, dim);
+                }
+        }
+}
+
+template<typename SliceType, size_t... Ds>
+constexpr auto build_slice_extents(std::index_sequence<Ds...>, const std::array<typename SliceType::index_type, SliceType::traits::original_rank>& sizes)
+{
+        return typename SliceType::extents_type{sizes[SliceType::traits::original_dim[Ds]]...};
+}
+}; // detail
+
+/***************************************************************************//**
+* The slice function creates a Slice of an expression. One slice specifier is
+* needed per dimension of the expression; an integer (fixes the index and drops
+* the dimension), all_t{} (keeps the whole dimension), a SliceRange or a
+* UnitSliceRange (keeps the selected indices).
+ ******************************************************************************/
+template<expression Expr, detail::slice_spec... Specs>
+constexpr inline auto slice(Expr&& expr, Specs... specs)
+{
+        using SliceType = Slice<Expr, Specs...>;
+        using index_type = typename SliceType::index_type;
+        using step_type = typename SliceType::step_type;
+        static_assert(sizeof...(Specs) == SliceType::original_extents_type::rank(), "One slice specifier is needed per dimension of the expression");
+        static_assert(SliceType::traits::rank > 0, "At least one dimension must be kept in a slice");
+
+        std::array<index_type, sizeof...(Specs)> offsets{}, sizes{};
+        std::array<step_type, sizeof...(Specs)> steps{};
+        size_t dim = 0;
+        ((detail::slice_spec_values(specs, static_cast<size_t>(expr.extent(dim)), dim, offsets[dim], steps[dim], sizes[dim]), dim++), ...);
+
+        auto slice_exts = detail::build_slice_extents<SliceType>(std::make_index_sequence<SliceType::traits::rank>{}, sizes);
+        return SliceType(std::forward<Expr>(expr), std::move(slice_exts), std::move(offsets), std::move(steps));
+}
+
 };
 #endif // EXPR_TEMPLATE_SLICE_EXPRESSION_H
@@ -0,0 +1,158 @@
+#ifndef SPARSE_MATRIX_H
+#define SPARSE_MATRIX_H
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include <experimental/mdspan>
+#include <expr_template.h>
+
+namespace stdex = std::experimental;
+using expr::BaseExpr;
+
+namespace expr::detail
+{
+        // Validate the arrays of a compressed sparse matrix
+        template<typename IndexType, typename T>
+        void check_compressed(IndexType major, IndexType minor, const std::vector<IndexType>& pointers, const std::vector<IndexType>& indices, const std::vector<T>& values)
+        {
+                if (pointers.size() != static_cast<std::size_t>(major) + 1){
+                        throw std::runtime_error("Wrong number of compressed pointers!\n" + std::to_string(pointers.size()) + " != " + std::to_string(major + 1));
+                }
+                if (indices.size() != values.size() || pointers.front() != 0 || static_cast<std::size_t>(pointers.back()) != values.size()){
+                        throw std::runtime_error("Compressed indices, values and pointers do not match!\n" + std::to_string(indices.size()) + " indices, " + std::to_string(values.size()) + " values, " + std::to_string(pointers.back()) + " non-zero elements");
+                }
+                for(std::size_t m = 0; m < static_cast<std::size_t>(major); m++){
+                        if (pointers[m + 1] < pointers[m]){
+                                throw std::runtime_error("Compressed pointers must be non-decreasing!\nPointer " + std::to_string(m + 1));
+                        }
+                        for(auto p = pointers[m]; p < pointers[m + 1]; p++){
+                                if (indices[p] >= minor || (p > pointers[m] && indices[p] <= indices[p - 1])){
+                                        throw std::runtime_error("Compressed indices must be sorted, unique and in range!\nIndex " + std::to_string(p) + ": " + std::to_string(indices[p]));
+                                }
+                        }
+                }
+        }
+}; // expr::detail
+
+/***************************************************************************//**
+* Sparse matrix in compressed sparse row (CSR) format. Only the non-zero
+* elements are stored, row by row. It is a regular expression leaf, elements
+* not stored are zero, and expr::matmul dispatches products with it to
+* dedicated sparse kernels.
+ ******************************************************************************/
+template<typename T, typename IndexType = std::size_t>
+class CSRMatrix : public BaseExpr<CSRMatrix<T, IndexType>>{
+    public:
+        using value_type = T;
+        using index_type = IndexType;
+        using extents_type = stdex::dextents<IndexType, 2>;
+
+        CSRMatrix(IndexType rows, IndexType cols, std::vector<IndexType> row_pointers, std::vector<IndexType> column_indices, std::vector<T> values)
+         : m_extents(rows, cols), m_row_pointers(std::move(row_pointers)), m_column_indices(std::move(column_indices)), m_values(std::move(values))
+        {
+                expr::detail::check_compressed(rows, cols, m_row_pointers, m_column_indices, m_values);
+        }
+
+        /***********************************************************************
+        * Compress the non-zero elements of a (dense) rank 2 expression.
+         **********************************************************************/
+        template<expr::expression Expr>
+        explicit CSRMatrix(const Expr& expr)
+         : m_extents(static_cast<IndexType>(expr.extent(0)), static_cast<IndexType>(expr.extent(1))), m_row_pointers(1, 0), m_column_indices(), m_values()
+        {
+                m_row_pointers.reserve(static_cast<std::size_t>(m_extents.extent(0)) + 1);
+                for(IndexType i = 0; i < m_extents.extent(0); i++){
+                        for(IndexType j = 0; j < m_extents.extent(1); j++){
+                                const T val = expr::detail::subscript(expr, i, j);
+                                if (val != T{0}){
+                                        m_column_indices.push_back(j);
+                                        m_values.push_back(val);
+                                }
+                        }
+                        m_row_pointers.push_back(static_cast<IndexType>(m_values.size()));
+                }
+        }
+
+        constexpr auto extents() const noexcept {return m_extents;}
+        constexpr auto extent(std::size_t i) const noexcept {return m_extents.extent(i);}
+
+#ifdef CLANGBUG
+        T operator()(IndexType i, IndexType j) const {return expr::detail::compressed_at(m_row_pointers, m_column_indices, m_values, i, j);}
+#endif
+        T operator[](IndexType i, IndexType j) const {return expr::detail::compressed_at(m_row_pointers, m_column_indices, m_values, i, j);}
+
+        std::size_t nnz() const noexcept {return m_values.size();}
+        const std::vector<IndexType>& row_pointers() const noexcept {return m_row_pointers;}
+        const std::vector<IndexType>& column_indices() const noexcept {return m_column_indices;}
+        const std::vector<T>& values() const noexcept {return m_values;}
+
+    private:
+        extents_type m_extents;
+        std::vector<IndexType> m_row_pointers;
+        std::vector<IndexType> m_column_indices;
+        std::vector<T> m_values;
+};
+
+/***************************************************************************//**
+* Sparse matrix in compressed sparse column (CSC) format. Only the non-zero
+* elements are stored, column by column. It is a regular expression leaf,
+* elements not stored are zero, and expr::matmul dispatches products with it to
+* dedicated sparse kernels.
+ ******************************************************************************/
+template<typename T, typename IndexType = std::size_t>
+class CSCMatrix : public BaseExpr<CSCMatrix<T, IndexType>>{
+    public:
+        using value_type = T;
+        using index_type = IndexType;
+        using extents_type = stdex::dextents<IndexType, 2>;
+
+        CSCMatrix(IndexType rows, IndexType cols, std::vector<IndexType> column_pointers, std::vector<IndexType> row_indices, std::vector<T> values)
+         : m_extents(rows, cols), m_column_pointers(std::move(column_pointers)), m_row_indices(std::move(row_indices)), m_values(std::move(values))
+        {
+                expr::detail::check_compressed(cols, rows, m_column_pointers, m_row_indices, m_values);
+        }
+
+        /***********************************************************************
+        * Compress the non-zero elements of a (dense) rank 2 expression.
+         **********************************************************************/
+        template<expr::expression Expr>
+        explicit CSCMatrix(const Expr& expr)
+         : m_extents(static_cast<IndexType>(expr.extent(0)), static_cast<IndexType>(expr.extent(1))), m_column_pointers(1, 0), m_row_indices(), m_values()
+        {
+                m_column_pointers.reserve(static_cast<std::size_t>(m_extents.extent(1)) + 1);
+                for(IndexType j = 0; j < m_extents.extent(1); j++){
+                        for(IndexType i = 0; i < m_extents.extent(0); i++){
+                                const T val = expr::detail::subscript(expr, i, j);
+                                if (val != T{0}){
+                                        m_row_indices.push_back(i);
+                                        m_values.push_back(val);
+                                }
+                        }
+                        m_column_pointers.push_back(static_cast<IndexType>(m_values.size()));
+                }
+        }
+
+        constexpr auto extents() const noexcept {return m_extents;}
+        constexpr auto extent(std::size_t i) const noexcept {return m_extents.extent(i);}
+
+#ifdef CLANGBUG
+        T operator()(IndexType i, IndexType j) const {return expr::detail::compressed_at(m_column_pointers, m_row_indices, m_values, j, i);}
+#endif
+        T operator[](IndexType i, IndexType j) const {return expr::detail::compressed_at(m_column_pointers, m_row_indices, m_values, j, i);}
+
+        std::size_t nnz() const noexcept {return m_values.size();}
+        const std::vector<IndexType>& column_pointers() const noexcept {return m_column_pointers;}
+        const std::vector<IndexType>& row_indices() const noexcept {return m_row_indices;}
+        const std::vector<T>& values() const noexcept {return m_values;}
+
+    private:
+        extents_type m_extents;
+        std::vector<IndexType> m_column_pointers;
+        std::vector<IndexType> m_row_indices;
+        std::vector<T> m_values;
+};
+
+#endif // SPARSE_MATRIX_H
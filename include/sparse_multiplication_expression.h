@@ -0,0 +1,409 @@
+#ifndef EXPR_TEMPLATE_SPARSE_MULTIPLICATION_EXPRESSION_H
+#define EXPR_TEMPLATE_SPARSE_MULTIPLICATION_EXPRESSION_H
+
+#include <base_expression.h>
+#include <matrix_multiplication_expression.h>
+#include <parallel.h>
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace expr
+{
+
+/***************************************************************************//**
+* Concept for sparse matrix expressions stored in compressed sparse row (CSR)
+* format. row_pointers()[i] to row_pointers()[i + 1] index the (sorted) column
+* indices and values of the non-zero elements in row i.
+ ******************************************************************************/
+template<typename Expr>
+concept compressed_rows = expression<Expr> && requires(const std::remove_cvref_t<Expr>& e)
+{
+        e.row_pointers();
+        e.column_indices();
+        e.values();
+};
+
+/***************************************************************************//**
+* Concept for sparse matrix expressions stored in compressed sparse column
+* (CSC) format. column_pointers()[j] to column_pointers()[j + 1] index the
+* (sorted) row indices and values of the non-zero elements in column j.
+ ******************************************************************************/
+template<typename Expr>
+concept compressed_columns = expression<Expr> && requires(const std::remove_cvref_t<Expr>& e)
+{
+        e.column_pointers();
+        e.row_indices();
+        e.values();
+};
+
+template<typename Expr>
+concept sparse_expression = compressed_rows<Expr> || compressed_columns<Expr>;
+
+namespace detail
+{
+        // Minimum number of rows (or columns) handed to each thread
+        inline constexpr std::size_t sparse_grain = 64;
+        // Minimum number of products per thread when splitting the inner dimension
+        inline constexpr std::size_t sparse_inner_grain = 1 << 14;
+
+        // Element at row i (or entry i of a vector) and column j of a dense operand
+        template<typename Expr, typename IndexType>
+        constexpr inline auto dense_at(const Expr& e, IndexType i, IndexType j)
+        {
+                if constexpr(decltype(e.extents())::rank() == 1){
+                        (void) j;
+                        return detail::subscript(e, i);
+                }else{
+                        return detail::subscript(e, i, j);
+                }
+        }
+
+        // Value stored at (major, minor) in a compressed matrix, or zero
+        template<typename Pointers, typename Indices, typename Values, typename IndexType>
+        constexpr inline auto compressed_at(const Pointers& pointers, const Indices& indices, const Values& values, IndexType major, IndexType minor)
+        {
+                using value_type = std::remove_cvref_t<decltype(values[0])>;
+                const auto first = indices.begin() + static_cast<std::ptrdiff_t>(pointers[major]);
+                const auto last = indices.begin() + static_cast<std::ptrdiff_t>(pointers[major + 1]);
+                const auto it = std::lower_bound(first, last, minor);
+                if(it != last && *it == minor){
+                        return values[static_cast<std::size_t>(it - indices.begin())];
+                }
+                return value_type{0};
+        }
+}; // detail
+
+/***************************************************************************//**
+* SparseMatrixMultiplicationOp represents the matrix product of two
+* expressions, at least one of which is a compressed sparse matrix. Individual
+* elements are computed from the non-zero elements of the sparse operand only,
+* and evaluating the whole product (assign_to) uses row (or column) parallel
+* SpMV/SpMM kernels, so both work and memory traffic scale with the number of
+* non-zero elements. The dense operand may be a matrix or a vector. The
+* scattering kernels (CSC x dense, dense x CSR) have too few columns (rows) to
+* split for SpMV, and instead split the inner dimension, every thread
+* accumulating into a private copy of the result.
+ ******************************************************************************/
+template<expression LHS, expression RHS, typename EXT>
+class SparseMatrixMultiplicationOp: public BaseExpr<SparseMatrixMultiplicationOp<LHS, RHS, EXT>>{
+    public:
+        using Base = BaseExpr<SparseMatrixMultiplicationOp<LHS, RHS, EXT>>;
+        using RHS_noref = std::remove_reference_t<RHS>;
+        using LHS_noref = std::remove_reference_t<LHS>;
+        using value_type = element_type<LHS, RHS>;
+        using index_type = typename EXT::index_type;
+
+        constexpr explicit SparseMatrixMultiplicationOp(LHS&& lhs, RHS&& rhs, EXT&& ext) noexcept
+         : Base(), m_lhs(std::forward<LHS>(lhs)), m_rhs(std::forward<RHS>(rhs)), m_ext(std::forward<EXT>(ext))
+        {}
+
+        ~SparseMatrixMultiplicationOp() noexcept = default;
+
+        constexpr auto extents() const noexcept {return m_ext;};
+        constexpr auto extent(std::size_t i) const noexcept {return m_ext.extent(i);};
+
+#ifdef CLANGBUG
+        constexpr auto operator()(auto&&... indices) const {return get_value(indices...);}
+#endif
+        constexpr auto operator[](auto&&... indices) const {return get_value(indices...);}
+
+        /***********************************************************************
+        * Evaluate the full product into destination.
+         **********************************************************************/
+        template<typename Destination>
+        void assign_to(Destination& destination) const
+        {
+                if constexpr(compressed_rows<LHS>){
+                        // SpMM, C[i, :] = sum_p A.val[p]*B[A.col[p], :]
+                        const auto& ptr = m_lhs.row_pointers();
+                        const auto& col = m_lhs.column_indices();
+                        const auto& val = m_lhs.values();
+                        parallel_for(index_type(0), rows(), static_cast<index_type>(detail::sparse_grain), [&](index_type begin, index_type end){
+                                for(index_type i = begin; i < end; i++){
+                                        for(index_type j = 0; j < cols(); j++){
+                                                store(destination, i, j, value_type(0));
+                                        }
+                                        for(auto p = ptr[i]; p < ptr[i + 1]; p++){
+                                                const auto a = val[p];
+                                                const auto k = static_cast<index_type>(col[p]);
+                                                for(index_type j = 0; j < cols(); j++){
+                                                        add(destination, i, j, a*detail::dense_at(m_rhs, k, j));
+                                                }
+                                        }
+                                }
+                        });
+                }else if constexpr(compressed_columns<RHS>){
+                        // C[i, j] = sum_p A[i, B.row[p]]*B.val[p]
+                        const auto& ptr = m_rhs.column_pointers();
+                        const auto& row = m_rhs.row_indices();
+                        const auto& val = m_rhs.values();
+                        parallel_for(index_type(0), rows(), static_cast<index_type>(detail::sparse_grain), [&](index_type begin, index_type end){
+                                for(index_type i = begin; i < end; i++){
+                                        for(index_type j = 0; j < cols(); j++){
+                                                value_type res = 0;
+                                                for(auto p = ptr[j]; p < ptr[j + 1]; p++){
+                                                        res += lhs_at(i, static_cast<index_type>(row[p]))*val[p];
+                                                }
+                                                store(destination, i, j, res);
+                                        }
+                                }
+                        });
+                }else if constexpr(compressed_columns<LHS>){
+                        // Scatter columns of A, C[:, j] += A[:, k]*B[k, j], parallel over columns of C
+                        // or, for few of them (SpMV), over k
+                        const auto& ptr = m_lhs.column_pointers();
+                        const auto& row = m_lhs.row_indices();
+                        const auto& val = m_lhs.values();
+                        const index_type inner = static_cast<index_type>(m_lhs.extent(1));
+                        const std::size_t parts = inner_parts(ptr[inner], cols());
+                        if(static_cast<std::size_t>(cols()) <= detail::sparse_grain && parts > 1){
+                                scatter_split(destination, ptr, inner, parts, [&](index_type k, value_type* acc){
+                                        for(index_type j = 0; j < cols(); j++){
+                                                const auto b = detail::dense_at(m_rhs, k, j);
+                                                if(b == decltype(b)(0)){
+                                                        continue;
+                                                }
+                                                for(auto p = ptr[k]; p < ptr[k + 1]; p++){
+                                                        acc[static_cast<std::size_t>(row[p])*static_cast<std::size_t>(cols()) + static_cast<std::size_t>(j)] += val[p]*b;
+                                                }
+                                        }
+                                });
+                                return;
+                        }
+                        parallel_for(index_type(0), cols(), static_cast<index_type>(detail::sparse_grain), [&](index_type begin, index_type end){
+                                for(index_type j = begin; j < end; j++){
+                                        for(index_type i = 0; i < rows(); i++){
+                                                store(destination, i, j, value_type(0));
+                                        }
+                                        for(index_type k = 0; k < inner; k++){
+                                                const auto b = detail::dense_at(m_rhs, k, j);
+                                                if(b == decltype(b)(0)){
+                                                        continue;
+                                                }
+                                                for(auto p = ptr[k]; p < ptr[k + 1]; p++){
+                                                        add(destination, static_cast<index_type>(row[p]), j, val[p]*b);
+                                                }
+                                        }
+                                }
+                        });
+                }else{
+                        // Scatter rows of B, C[i, :] += A[i, k]*B[k, :], parallel over rows of C or,
+                        // for few of them (row vector times B), over k
+                        const auto& ptr = m_rhs.row_pointers();
+                        const auto& col = m_rhs.column_indices();
+                        const auto& val = m_rhs.values();
+                        const index_type inner = static_cast<index_type>(m_rhs.extent(0));
+                        const std::size_t parts = inner_parts(ptr[inner], rows());
+                        if(static_cast<std::size_t>(rows()) <= detail::sparse_grain && parts > 1){
+                                scatter_split(destination, ptr, inner, parts, [&](index_type k, value_type* acc){
+                                        for(index_type i = 0; i < rows(); i++){
+                                                const auto a = lhs_at(i, k);
+                                                if(a == decltype(a)(0)){
+                                                        continue;
+                                                }
+                                                for(auto p = ptr[k]; p < ptr[k + 1]; p++){
+                                                        acc[static_cast<std::size_t>(i)*static_cast<std::size_t>(cols()) + static_cast<std::size_t>(col[p])] += a*val[p];
+                                                }
+                                        }
+                                });
+                                return;
+                        }
+                        parallel_for(index_type(0), rows(), static_cast<index_type>(detail::sparse_grain), [&](index_type begin, index_type end){
+                                for(index_type i = begin; i < end; i++){
+                                        for(index_type j = 0; j < cols(); j++){
+                                                store(destination, i, j, value_type(0));
+                                        }
+                                        for(index_type k = 0; k < inner; k++){
+                                                const auto a = lhs_at(i, k);
+                                                if(a == decltype(a)(0)){
+                                                        continue;
+                                                }
+                                                for(auto p = ptr[k]; p < ptr[k + 1]; p++){
+                                                        add(destination, i, static_cast<index_type>(col[p]), a*val[p]);
+                                                }
+                                        }
+                                }
+                        });
+                }
+        }
+
+        constexpr explicit SparseMatrixMultiplicationOp(const SparseMatrixMultiplicationOp&) noexcept = default;
+        constexpr explicit SparseMatrixMultiplicationOp(SparseMatrixMultiplicationOp&&) noexcept = default;
+
+        constexpr SparseMatrixMultiplicationOp& operator=(const SparseMatrixMultiplicationOp&) noexcept = default;
+        constexpr SparseMatrixMultiplicationOp& operator=(SparseMatrixMultiplicationOp&&) noexcept = default;
+        constexpr auto operands() const noexcept {return std::forward_as_tuple(m_lhs, m_rhs);}
+    private:
+        std::remove_cv_t<LHS> m_lhs;
+        std::remove_cv_t<RHS> m_rhs;
+        EXT m_ext;
+
+        constexpr explicit SparseMatrixMultiplicationOp() noexcept = default;
+
+        static constexpr bool vector_result = EXT::rank() == 1;
+        // A dense vector on the left hand side is a row vector
+        static constexpr bool row_vector_lhs = vector_result && !sparse_expression<LHS>;
+
+        constexpr index_type rows() const noexcept {return row_vector_lhs ? 1 : static_cast<index_type>(m_ext.extent(0));}
+        constexpr index_type cols() const noexcept {return vector_result && !row_vector_lhs ? 1 : static_cast<index_type>(m_ext.extent(EXT::rank() - 1));}
+
+        constexpr auto lhs_at(index_type i, index_type k) const
+        {
+                if constexpr(row_vector_lhs){
+                        (void) i;
+                        return detail::subscript(m_lhs, k);
+                }else{
+                        return detail::subscript(m_lhs, i, k);
+                }
+        }
+
+        template<typename Destination>
+        static constexpr decltype(auto) dest_at(Destination& destination, index_type i, index_type j)
+        {
+                if constexpr(!vector_result){
+                        return detail::subscript(destination, i, j);
+                }else if constexpr(row_vector_lhs){
+                        (void) i;
+                        return detail::subscript(destination, j);
+                }else{
+                        (void) j;
+                        return detail::subscript(destination, i);
+                }
+        }
+        // Number of threads splitting the inner dimension of a scatter kernel,
+        // each non-zero element being multiplied width times
+        static std::size_t inner_parts(auto nnz, index_type width) noexcept
+        {
+                const std::size_t work = static_cast<std::size_t>(nnz)*static_cast<std::size_t>(width);
+                return std::clamp<std::size_t>(work/detail::sparse_inner_grain, 1, num_threads());
+        }
+
+        /***********************************************************************
+        * Scatter kernel split over the inner dimension k into parts ranges of
+        * about the same number of non-zero elements. scatter(k, acc) adds the
+        * products of k to the row major result acc, private to each thread.
+        * The copies are summed into destination.
+         **********************************************************************/
+        template<typename Destination, typename Pointers, typename Scatter>
+        void scatter_split(Destination& destination, const Pointers& ptr, index_type inner, std::size_t parts, Scatter&& scatter) const
+        {
+                const std::size_t nnz = static_cast<std::size_t>(ptr[inner]);
+                const std::size_t n = static_cast<std::size_t>(rows())*static_cast<std::size_t>(cols());
+                auto split = [&](std::size_t q){
+                        const auto target = static_cast<std::remove_cvref_t<decltype(ptr[0])>>(q*nnz/parts);
+                        return static_cast<index_type>(std::lower_bound(ptr.begin(), ptr.begin() + static_cast<std::ptrdiff_t>(inner), target) - ptr.begin());
+                };
+                std::vector<value_type> partial(parts*n, value_type(0));
+                parallel_for(std::size_t(0), parts, std::size_t(1), [&](std::size_t begin, std::size_t end){
+                        for(std::size_t q = begin; q < end; q++){
+                                const index_type k_end = split(q + 1);
+                                for(index_type k = split(q); k < k_end; k++){
+                                        scatter(k, partial.data() + q*n);
+                                }
+                        }
+                });
+                parallel_for(index_type(0), rows(), static_cast<index_type>(detail::sparse_grain), [&](index_type begin, index_type end){
+                        for(index_type i = begin; i < end; i++){
+                                for(index_type j = 0; j < cols(); j++){
+                                        const std::size_t offset = static_cast<std::size_t>(i)*static_cast<std::size_t>(cols()) + static_cast<std::size_t>(j);
+                                        value_type res = 0;
+                                        for(std::size_t q = 0; q < parts; q++){
+                                                res += partial[q*n + offset];
+                                        }
+                                        store(destination, i, j, res);
+                                }
+                        }
+                });
+        }
+
+        template<typename Destination>
+        static constexpr void store(Destination& destination, index_type i, index_type j, value_type val)
+        {
+                dest_at(destination, i, j) = val;
+        }
+        template<typename Destination>
+        static constexpr void add(Destination& destination, index_type i, index_type j, value_type val)
+        {
+                dest_at(destination, i, j) += val;
+        }
+
+        constexpr value_type get_value(index_type i, index_type j) const
+        {
+                value_type res = 0;
+                if constexpr(compressed_rows<LHS>){
+                        const auto& ptr = m_lhs.row_pointers();
+                        const auto& col = m_lhs.column_indices();
+                        const auto& val = m_lhs.values();
+                        for(auto p = ptr[i]; p < ptr[i + 1]; p++){
+                                res += val[p]*detail::dense_at(m_rhs, static_cast<index_type>(col[p]), j);
+                        }
+                }else if constexpr(compressed_columns<RHS>){
+                        const auto& ptr = m_rhs.column_pointers();
+                        const auto& row = m_rhs.row_indices();
+                        const auto& val = m_rhs.values();
+                        for(auto p = ptr[j]; p < ptr[j + 1]; p++){
+                                res += lhs_at(i, static_cast<index_type>(row[p]))*val[p];
+                        }
+                }else if constexpr(compressed_columns<LHS>){
+                        const auto& ptr = m_lhs.column_pointers();
+                        const auto& row = m_lhs.row_indices();
+                        const auto& val = m_lhs.values();
+                        for(index_type k = 0; k < static_cast<index_type>(m_lhs.extent(1)); k++){
+                                res += detail::compressed_at(ptr, row, val, k, i)*detail::dense_at(m_rhs, k, j);
+                        }
+                }else{
+                        const auto& ptr = m_rhs.row_pointers();
+                        const auto& col = m_rhs.column_indices();
+                        const auto& val = m_rhs.values();
+                        for(index_type k = 0; k < static_cast<index_type>(m_rhs.extent(0)); k++){
+                                res += lhs_at(i, k)*detail::compressed_at(ptr, col, val, k, j);
+                        }
+                }
+                return res;
+        }
+        constexpr value_type get_value(index_type n) const
+        {
+                if constexpr(row_vector_lhs){
+                        return get_value(0, n);
+                }else{
+                        return get_value(n, 0);
+                }
+        }
+}; // SparseMatrixMultiplicationOp
+
+/***************************************************************************//**
+* Matrix multiplication where at least one operand is a compressed sparse
+* matrix. The other operand may be a dense (or sparse) matrix, or a vector.
+ ******************************************************************************/
+template<expression LHS, expression RHS>
+requires (sparse_expression<LHS> || sparse_expression<RHS>)
+constexpr inline auto matmul(LHS&& lhs, RHS&& rhs)
+{
+        constexpr size_t lhs_rank = decltype(lhs.extents())::rank();
+        constexpr size_t rhs_rank = decltype(rhs.extents())::rank();
+        static_assert(lhs_rank <= 2 && rhs_rank <= 2 && lhs_rank + rhs_rank >= 3, "Sparse matrix multiplication requires a matrix and a matrix or a vector");
+        using IndexType = typename decltype(lhs.extents())::index_type;
+
+        const auto inner_lhs = lhs.extent(lhs_rank - 1);
+        const auto inner_rhs = rhs.extent(0);
+        if (static_cast<size_t>(inner_lhs) != static_cast<size_t>(inner_rhs)){
+                throw std::runtime_error("incompatible dimensions for matrix multiplication!\n" + std::to_string(inner_lhs) + " != " + std::to_string(inner_rhs));
+        }
+        if constexpr(lhs_rank == 2 && rhs_rank == 2){
+                using EXT = stdex::dextents<IndexType, 2>;
+                EXT ext{static_cast<IndexType>(lhs.extent(0)), static_cast<IndexType>(rhs.extent(1))};
+                return SparseMatrixMultiplicationOp<LHS, RHS, EXT>{std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::move(ext)};
+        }else{
+                using EXT = stdex::dextents<IndexType, 1>;
+                EXT ext{static_cast<IndexType>(lhs_rank == 2 ? lhs.extent(0) : rhs.extent(rhs_rank - 1))};
+                return SparseMatrixMultiplicationOp<LHS, RHS, EXT>{std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::move(ext)};
+        }
+}
+
+}; //expr
+
+#endif // EXPR_TEMPLATE_SPARSE_MULTIPLICATION_EXPRESSION_H
@@ -0,0 +1,385 @@
+#ifndef EXPR_TEMPLATE_STENCIL_EXPRESSION_H
+#define EXPR_TEMPLATE_STENCIL_EXPRESSION_H
+
+#include <base_expression.h>
+#include <conditional_expression.h>
+#include <extents_utils.h>
+#include <parallel.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace expr
+{
+
+/***************************************************************************//**
+* Values of the elements outside an expression, as seen by shifted views and
+* stencils: zero, the nearest element inside (clamp) or the element whose
+* indices are taken modulo the extents (periodic).
+ ******************************************************************************/
+enum class boundary {zero, clamp, periodic};
+
+namespace detail
+{
+        // Bytes of the input a stencil sweep keeps in cache: the slices of one
+        // tile (with its halo) needed for one index of the first dimension
+        inline constexpr std::size_t stencil_cache_bytes = std::size_t(1) << 18;
+        // Rows (last dimension) of stencil tiles are not split below this
+        inline constexpr std::size_t stencil_row = 256;
+        // Elements evaluated per parallel chunk of a stencil sweep at least
+        inline constexpr std::size_t stencil_grain = std::size_t(1) << 14;
+
+        // Index j of a dimension with n elements mapped inside by b, -1 when
+        // the element is zero
+        template<typename Signed>
+        constexpr Signed boundary_index(Signed j, Signed n, boundary b) noexcept
+        {
+                if(j >= 0 && j < n){
+                        return j;
+                }
+                switch(b){
+                        case boundary::clamp:
+                                return j < 0 ? Signed(0) : n - 1;
+                        case boundary::periodic:
+                                return (j%n + n)%n;
+                        case boundary::zero:
+                        default:
+                                return Signed(-1);
+                }
+        }
+
+        // Extents of expr as signed offsets
+        template<typename Offset, std::size_t Rank, typename Expr>
+        constexpr std::array<Offset, Rank> signed_extents(const Expr& expr) noexcept
+        {
+                std::array<Offset, Rank> res{};
+                for(std::size_t d = 0; d < Rank; d++){
+                        res[d] = convert<Offset>(expr.extent(d));
+                }
+                return res;
+        }
+}; // detail
+
+/***************************************************************************//**
+* Shift is a view of an expression with its elements moved by a fixed offset
+* in each dimension, element i being element i + offset of the original
+* expression. Elements moved in from outside the expression are given by the
+* boundary. Sums of shifts express stencils, e.g. a 1D Laplacian
+*
+* shift(u, {-1}) - 2*u + shift(u, {1}),
+*
+* which the StencilOp computes in cache sized tiles.
+ ******************************************************************************/
+template<expression Expr>
+class Shift : public BaseExpr<Shift<Expr>>
+{
+    public:
+        using Base = BaseExpr<Shift<Expr>>;
+        using Expr_noref = std::remove_cvref_t<Expr>;
+        using value_type = typename Expr_noref::value_type;
+        using extents_type = decltype(std::declval<Expr_noref>().extents());
+        using index_type = typename extents_type::index_type;
+        using offset_type = std::make_signed_t<index_type>;
+        using layout_type = exts::layout_of_t<Expr>;
+        static constexpr std::size_t rank = extents_type::rank();
+
+        constexpr explicit Shift(Expr&& expr, const std::array<offset_type, rank>& offsets, boundary b) noexcept
+         : Base(), m_expr(std::forward<Expr>(expr)), m_offsets(offsets), m_boundary(b),
+                m_extents(detail::signed_extents<offset_type, rank>(m_expr))
+        {}
+        constexpr explicit Shift(const Shift&) noexcept = default;
+        constexpr explicit Shift(Shift&&) noexcept = default;
+        ~Shift() noexcept = default;
+
+        constexpr auto extents() const noexcept {return m_expr.extents();}
+        constexpr auto extent(std::size_t i) const noexcept {return m_expr.extent(i);}
+
+#ifdef CLANGBUG
+        constexpr value_type operator()(auto&&... indices) const
+        {
+                return get_value(std::make_index_sequence<rank>{}, {detail::convert<offset_type>(indices)...});
+        }
+#endif
+        constexpr value_type operator[](auto&&... indices) const
+        {
+                return get_value(std::make_index_sequence<rank>{}, {detail::convert<offset_type>(indices)...});
+        }
+
+        constexpr const std::array<offset_type, rank>& offsets() const noexcept {return m_offsets;}
+        constexpr boundary boundary_condition() const noexcept {return m_boundary;}
+
+        constexpr Shift& operator=(const Shift&) noexcept = default;
+        constexpr Shift& operator=(Shift&&) noexcept = default;
+        constexpr auto operands() const noexcept {return std::forward_as_tuple(m_expr);}
+    private:
+        std::remove_cv_t<Expr> m_expr;
+        std::array<offset_type, rank> m_offsets;
+        boundary m_boundary;
+        std::array<offset_type, rank> m_extents;
+
+        template<std::size_t... Ds>
+        constexpr value_type get_value(std::index_sequence<Ds...>, const std::array<offset_type, rank>& indices) const
+        {
+                const std::array<offset_type, rank> mapped{detail::boundary_index<offset_type>(indices[Ds] + m_offsets[Ds], m_extents[Ds], m_boundary)...};
+                if(((mapped[Ds] < 0) || ...)){
+                        return value_type(0);
+                }
+                return detail::subscript(m_expr, detail::convert<index_type>(mapped[Ds])...);
+        }
+};
+
+/***************************************************************************//**
+* StencilOp represents the weighted sum of N shifts of an expression, element
+* i being sum_k weights[k]*expr[i + offsets[k]], with the elements outside
+* the expression given by the boundary.
+*
+* Evaluating a whole stencil (assign_to) sweeps over the first dimension in
+* parallel chunks, within which the other dimensions are cut into tiles small
+* enough for the slices of a tile and its halo needed along the first
+* dimension to stay in cache. Each input element is then loaded from memory
+* about once per sweep, instead of once per point of the stencil. Interior
+* rows are computed without any boundary checks.
+ ******************************************************************************/
+template<expression Expr, typename Weight, std::size_t N>
+class StencilOp : public BaseExpr<StencilOp<Expr, Weight, N>>
+{
+    public:
+        using Base = BaseExpr<StencilOp<Expr, Weight, N>>;
+        using Expr_noref = std::remove_cvref_t<Expr>;
+        using operand_type = typename Expr_noref::value_type;
+        using value_type = decltype(std::declval<Weight>()*std::declval<operand_type>());
+        using extents_type = decltype(std::declval<Expr_noref>().extents());
+        using index_type = typename extents_type::index_type;
+        using offset_type = std::make_signed_t<index_type>;
+        static constexpr std::size_t rank = extents_type::rank();
+        using point_type = std::array<offset_type, rank>;
+
+        constexpr explicit StencilOp(Expr&& expr, const std::array<point_type, N>& offsets, const std::array<Weight, N>& weights, boundary b) noexcept
+         : Base(), m_expr(std::forward<Expr>(expr)), m_offsets(offsets), m_weights(weights), m_boundary(b),
+                m_extents(detail::signed_extents<offset_type, rank>(m_expr)), m_halo(), m_lower(), m_upper()
+        {
+                for(std::size_t d = 0; d < rank; d++){
+                        offset_type below = 0;
+                        offset_type above = 0;
+                        for(const auto& offset : m_offsets){
+                                below = std::max<offset_type>(below, -offset[d]);
+                                above = std::max<offset_type>(above, offset[d]);
+                        }
+                        m_halo[d] = std::max(below, above);
+                        m_lower[d] = below;
+                        m_upper[d] = m_extents[d] - above;
+                }
+        }
+        constexpr explicit StencilOp(const StencilOp&) noexcept = default;
+        constexpr explicit StencilOp(StencilOp&&) noexcept = default;
+        ~StencilOp() noexcept = default;
+
+        constexpr auto extents() const noexcept {return m_expr.extents();}
+        constexpr auto extent(std::size_t i) const noexcept {return m_expr.extent(i);}
+
+#ifdef CLANGBUG
+        constexpr value_type operator()(auto&&... indices) const
+        {
+                return get_value(std::make_index_sequence<rank>{}, {detail::convert<offset_type>(indices)...});
+        }
+#endif
+        constexpr value_type operator[](auto&&... indices) const
+        {
+                return get_value(std::make_index_sequence<rank>{}, {detail::convert<offset_type>(indices)...});
+        }
+
+        /***************************************************************
+        * Evaluate the whole stencil into destination, tile by tile.
+         **************************************************************/
+        template<typename Destination>
+        void assign_to(Destination& destination) const
+        {
+                const point_type tile = tile_extents();
+                std::size_t slice = 1;
+                for(std::size_t d = 1; d < rank; d++){
+                        slice *= static_cast<std::size_t>(m_extents[d]);
+                }
+                const auto grain = static_cast<offset_type>(std::max<std::size_t>(1, detail::stencil_grain/std::max<std::size_t>(1, slice)));
+                parallel_for(offset_type(0), m_extents[0], grain, [&](offset_type begin, offset_type end){
+                        point_type lower{}, upper{};
+                        lower[0] = begin;
+                        upper[0] = end;
+                        for_each_tile<1>(destination, tile, lower, upper);
+                });
+        }
+
+        constexpr StencilOp& operator=(const StencilOp&) noexcept = default;
+        constexpr StencilOp& operator=(StencilOp&&) noexcept = default;
+        constexpr auto operands() const noexcept {return std::forward_as_tuple(m_expr);}
+    private:
+        std::remove_cv_t<Expr> m_expr;
+        std::array<point_type, N> m_offsets;
+        std::array<Weight, N> m_weights;
+        boundary m_boundary;
+        point_type m_extents;
+        // Largest offset in each dimension, and the range of indices
+        // whose stencil lies inside the expression
+        point_type m_halo;
+        point_type m_lower;
+        point_type m_upper;
+
+        // Element of the expression at indices + offsets[k], given by the boundary outside
+        template<std::size_t... Ds>
+        constexpr operand_type shifted(std::index_sequence<Ds...>, const point_type& indices, const point_type& offset) const
+        {
+                const point_type mapped{detail::boundary_index<offset_type>(indices[Ds] + offset[Ds], m_extents[Ds], m_boundary)...};
+                if(((mapped[Ds] < 0) || ...)){
+                        return operand_type(0);
+                }
+                return detail::subscript(m_expr, detail::convert<index_type>(mapped[Ds])...);
+        }
+
+        template<std::size_t... Ds>
+        constexpr value_type get_value(std::index_sequence<Ds...> seq, const point_type& indices) const
+        {
+                value_type acc(0);
+                exts::static_for<N>([&](auto k){
+                        acc += m_weights[k]*shifted(seq, indices, m_offsets[k]);
+                });
+                return acc;
+        }
+
+        // Elements [first, last) of the row at indices, all of whose
+        // stencil points lie inside the expression
+        template<typename Destination, std::size_t... Ds>
+        void interior_row(Destination& destination, std::index_sequence<Ds...>, const point_type& indices, offset_type first, offset_type last) const
+        {
+                // Local copies, which stores to the destination cannot alias
+                const auto offsets = m_offsets;
+                const auto weights = m_weights;
+                for(offset_type i = first; i < last; i++){
+                        value_type acc(0);
+                        exts::static_for<N>([&](auto k){
+                                acc += weights[k]*detail::subscript(m_expr, detail::convert<index_type>(indices[Ds] + offsets[k][Ds])...,
+                                                                   detail::convert<index_type>(i + offsets[k][rank - 1]));
+                        });
+                        detail::subscript(destination, detail::convert<index_type>(indices[Ds])..., detail::convert<index_type>(i)) = acc;
+                }
+        }
+
+        template<typename Destination, std::size_t... Ds>
+        void boundary_row(Destination& destination, std::index_sequence<Ds...> seq, point_type& indices, offset_type first, offset_type last) const
+        {
+                for(indices[rank - 1] = first; indices[rank - 1] < last; indices[rank - 1]++){
+                        detail::subscript(destination, detail::convert<index_type>(indices[Ds])...) = get_value(seq, indices);
+                }
+        }
+
+        // Evaluates the box [lower, upper) in row major order, interior
+        // telling whether the indices of the dimensions before D are
+        template<std::size_t D, typename Destination>
+        void evaluate_box(Destination& destination, const point_type& lower, const point_type& upper, point_type& indices, bool interior) const
+        {
+                if constexpr(D + 1 == rank){
+                        const offset_type first = interior ? std::clamp(m_lower[D], lower[D], upper[D]) : upper[D];
+                        const offset_type last = interior ? std::clamp(m_upper[D], first, upper[D]) : upper[D];
+                        boundary_row(destination, std::make_index_sequence<rank>{}, indices, lower[D], first);
+                        interior_row(destination, std::make_index_sequence<rank - 1>{}, indices, first, last);
+                        boundary_row(destination, std::make_index_sequence<rank>{}, indices, last, upper[D]);
+                }else{
+                        for(indices[D] = lower[D]; indices[D] < upper[D]; indices[D]++){
+                                evaluate_box<D + 1>(destination, lower, upper, indices, interior && indices[D] >= m_lower[D] && indices[D] < m_upper[D]);
+                        }
+                }
+        }
+
+        // Cuts dimensions D, ..., rank - 1 into tiles, then evaluates each box
+        template<std::size_t D, typename Destination>
+        void for_each_tile(Destination& destination, const point_type& tile, point_type& lower, point_type& upper) const
+        {
+                if constexpr(D == rank){
+                        point_type indices{};
+                        evaluate_box<0>(destination, lower, upper, indices, true);
+                }else{
+                        for(lower[D] = 0; lower[D] < m_extents[D]; lower[D] += tile[D]){
+                                upper[D] = std::min(m_extents[D], lower[D] + tile[D]);
+                                for_each_tile<D + 1>(destination, tile, lower, upper);
+                        }
+                }
+        }
+
+        // Bytes of the slices of a tile with its halo needed for one
+        // index of the first dimension
+        std::size_t footprint(const point_type& tile) const noexcept
+        {
+                std::size_t bytes = static_cast<std::size_t>(2*m_halo[0] + 1)*sizeof(operand_type);
+                for(std::size_t d = 1; d < rank; d++){
+                        bytes *= static_cast<std::size_t>(tile[d] + 2*m_halo[d]);
+                }
+                return bytes;
+        }
+
+        // Tile extents of the dimensions after the first: the largest
+        // middle dimension is halved until the footprint fits in
+        // cache, rows only once all middle dimensions are one
+        point_type tile_extents() const noexcept
+        {
+                point_type tile = m_extents;
+                const auto min_row = static_cast<offset_type>(detail::stencil_row);
+                while(footprint(tile) > detail::stencil_cache_bytes){
+                        std::size_t largest = 0;
+                        for(std::size_t d = 1; d + 1 < rank; d++){
+                                if(tile[d] > 1 && (largest == 0 || tile[d] > tile[largest])){
+                                        largest = d;
+                                }
+                        }
+                        if(largest > 0){
+                                tile[largest] = (tile[largest] + 1)/2;
+                        }else if(rank > 1 && tile[rank - 1] > min_row){
+                                tile[rank - 1] = std::max(min_row, (tile[rank - 1] + 1)/2);
+                        }else{
+                                break;
+                        }
+                }
+                return tile;
+        }
+};
+
+/***************************************************************************//**
+* Returns a Shift of expr, element i being element i + offsets of expr, e.g.
+* shift(u, {1, 0}, boundary::periodic)[i, j] = u[(i + 1) % n, j].
+ ******************************************************************************/
+template<expression Expr, std::size_t Rank>
+constexpr inline auto shift(Expr&& expr, const std::ptrdiff_t (&offsets)[Rank], boundary b = boundary::zero)
+{
+        using ShiftType = Shift<Expr>;
+        static_assert(Rank == ShiftType::rank, "One offset is needed per dimension of the expression");
+        std::array<typename ShiftType::offset_type, Rank> offs{};
+        for(std::size_t d = 0; d < Rank; d++){
+                offs[d] = detail::convert<typename ShiftType::offset_type>(offsets[d]);
+        }
+        return ShiftType(std::forward<Expr>(expr), offs, b);
+}
+
+/***************************************************************************//**
+* Returns a StencilOp, the sum over k of weights[k]*shift(expr, offsets[k], b).
+* The 5 point Laplacian of a 2D array u is
+*
+* stencil(u, {{-1, 0}, {1, 0}, {0, -1}, {0, 1}, {0, 0}}, {1., 1., 1., 1., -4.}).
+ ******************************************************************************/
+template<expression Expr, std::size_t N, std::size_t Rank, typename Weight>
+constexpr inline auto stencil(Expr&& expr, const std::ptrdiff_t (&offsets)[N][Rank], const Weight (&weights)[N], boundary b = boundary::zero)
+{
+        using StencilType = StencilOp<Expr, Weight, N>;
+        static_assert(Rank == StencilType::rank, "One offset is needed per dimension of the expression");
+        std::array<typename StencilType::point_type, N> offs{};
+        std::array<Weight, N> ws{};
+        for(std::size_t k = 0; k < N; k++){
+                for(std::size_t d = 0; d < Rank; d++){
+                        offs[k][d] = detail::convert<typename StencilType::offset_type>(offsets[k][d]);
+                }
+                ws[k] = weights[k];
+        }
+        return StencilType(std::forward<Expr>(expr), offs, ws, b);
+}
+
+}; // expr
+#endif // EXPR_TEMPLATE_STENCIL_EXPRESSION_H
@@ -0,0 +1,44 @@
+#ifndef EXPR_TEMPLATE_STORAGE_H
+#define EXPR_TEMPLATE_STORAGE_H
+
+#include <allocation.h>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+
+namespace expr::detail
+{
+
+// Largest number of elements stored inline (in a std::array) by fixed size leaves
+inline constexpr std::size_t inline_storage_limit = 256;
+
+/***************************************************************************//**
+* Element storage of the Matrix and MDArray leaves. Objects whose size is known
+* at compile time (Size != std::dynamic_extent) and at most
+* inline_storage_limit elements store their elements inline, everything else
+* on the heap, allocated according to memory_policy().
+ ******************************************************************************/
+template<typename T, std::size_t Size>
+using storage_t = std::conditional_t<Size != std::dynamic_extent && Size <= inline_storage_limit, std::array<T, Size>, heap_storage<T>>;
+
+template<typename Storage>
+inline constexpr bool is_inline_storage = false;
+template<typename T, std::size_t Size>
+inline constexpr bool is_inline_storage<std::array<T, Size>> = true;
+
+// Storage holding size elements, all equal to val
+template<typename Storage, typename T>
+constexpr inline Storage make_storage(std::size_t size, const T& val)
+{
+        if constexpr(is_inline_storage<Storage>){
+                Storage storage;
+                storage.fill(val);
+                return storage;
+        }else{
+                return Storage(size, val);
+        }
+}
+
+}; // expr::detail
+#endif // EXPR_TEMPLATE_STORAGE_H
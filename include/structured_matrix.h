@@ -0,0 +1,279 @@
+#ifndef STRUCTURED_MATRIX_H
+#define STRUCTURED_MATRIX_H
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <experimental/mdspan>
+#include <expr_template.h>
+
+namespace stdex = std::experimental;
+using expr::BaseExpr;
+
+namespace expr::detail
+{
+        // Number of elements in a packed triangle of an n x n matrix
+        template<typename IndexType>
+        constexpr inline std::size_t packed_size(IndexType n) noexcept
+        {
+                return static_cast<std::size_t>(n)*(static_cast<std::size_t>(n) + 1)/2;
+        }
+
+        template<typename Expr>
+        void check_square(const Expr& expr)
+        {
+                if (expr.extent(0) != expr.extent(1)){
+                        throw std::runtime_error("Matrix is not square!\n" + std::to_string(expr.extent(0)) + " != " + std::to_string(expr.extent(1)));
+                }
+        }
+
+        template<typename T>
+        void check_storage_size(const std::vector<T>& values, std::size_t size)
+        {
+                if (values.size() != size){
+                        throw std::runtime_error("Wrong number of stored elements!\n" + std::to_string(values.size()) + " != " + std::to_string(size));
+                }
+        }
+}; // expr::detail
+
+/***************************************************************************//**
+* Symmetric n x n matrix, storing only the lower triangle packed row by row
+* (element (i, j), j <= i, at i*(i + 1)/2 + j). Elements (i, j) and (j, i)
+* refer to the same stored value. expr::matmul dispatches products with it to a
+* dedicated kernel reading the packed triangle directly.
+ ******************************************************************************/
+template<typename T, typename IndexType = std::size_t>
+class SymmetricMatrix : public BaseExpr<SymmetricMatrix<T, IndexType>>{
+    public:
+        using value_type = T;
+        using index_type = IndexType;
+        using extents_type = stdex::dextents<IndexType, 2>;
+        static constexpr bool symmetric = true;
+
+        explicit SymmetricMatrix(IndexType n, T val = T{0})
+         : m_extents(n, n), m_values(expr::detail::packed_size(n), val)
+        {}
+
+        SymmetricMatrix(IndexType n, std::vector<T> packed_values)
+         : m_extents(n, n), m_values(std::move(packed_values))
+        {
+                expr::detail::check_storage_size(m_values, expr::detail::packed_size(n));
+        }
+
+        /***********************************************************************
+        * Store the lower triangle of a square (rank 2) expression.
+         **********************************************************************/
+        template<expr::expression Expr>
+        explicit SymmetricMatrix(const Expr& expr)
+         : m_extents(static_cast<IndexType>(expr.extent(0)), static_cast<IndexType>(expr.extent(0))), m_values()
+        {
+                expr::detail::check_square(expr);
+                m_values.reserve(expr::detail::packed_size(m_extents.extent(0)));
+                for(IndexType i = 0; i < m_extents.extent(0); i++){
+                        for(IndexType j = 0; j <= i; j++){
+                                m_values.push_back(expr::detail::subscript(expr, i, j));
+                        }
+                }
+        }
+
+        constexpr auto extents() const noexcept {return m_extents;}
+        constexpr auto extent(std::size_t i) const noexcept {return m_extents.extent(i);}
+
+#ifdef CLANGBUG
+        T& operator()(IndexType i, IndexType j) {return m_values[packed_index(i, j)];}
+        T operator()(IndexType i, IndexType j) const {return m_values[packed_index(i, j)];}
+#endif
+        T& operator[](IndexType i, IndexType j) {return m_values[packed_index(i, j)];}
+        T operator[](IndexType i, IndexType j) const {return m_values[packed_index(i, j)];}
+
+        // Columns [first, last) of row i (rows of column j) that may be non-zero
+        constexpr std::pair<IndexType, IndexType> row_range(IndexType) const noexcept {return {0, m_extents.extent(1)};}
+        constexpr std::pair<IndexType, IndexType> col_range(IndexType) const noexcept {return {0, m_extents.extent(0)};}
+
+        const std::vector<T>& packed_values() const noexcept {return m_values;}
+
+    private:
+        extents_type m_extents;
+        std::vector<T> m_values;
+
+        static constexpr std::size_t packed_index(IndexType i, IndexType j) noexcept
+        {
+                if (i < j){
+                        std::swap(i, j);
+                }
+                return expr::detail::packed_size(i) + static_cast<std::size_t>(j);
+        }
+};
+
+/***************************************************************************//**
+* Lower (Uplo = expr::triangle::lower) or upper triangular n x n matrix,
+* storing only the triangle packed row by row. Elements outside the triangle
+* are zero. expr::matmul dispatches products with it to a dedicated kernel,
+* skipping the zero triangle.
+ ******************************************************************************/
+template<typename T, expr::triangle Uplo = expr::triangle::lower, typename IndexType = std::size_t>
+class TriangularMatrix : public BaseExpr<TriangularMatrix<T, Uplo, IndexType>>{
+    public:
+        using value_type = T;
+        using index_type = IndexType;
+        using extents_type = stdex::dextents<IndexType, 2>;
+
+        explicit TriangularMatrix(IndexType n, T val = T{0})
+         : m_extents(n, n), m_values(expr::detail::packed_size(n), val)
+        {}
+
+        TriangularMatrix(IndexType n, std::vector<T> packed_values)
+         : m_extents(n, n), m_values(std::move(packed_values))
+        {
+                expr::detail::check_storage_size(m_values, expr::detail::packed_size(n));
+        }
+
+        /***********************************************************************
+        * Store the triangle of a square (rank 2) expression, the elements
+        * outside of it are ignored.
+         **********************************************************************/
+        template<expr::expression Expr>
+        explicit TriangularMatrix(const Expr& expr)
+         : m_extents(static_cast<IndexType>(expr.extent(0)), static_cast<IndexType>(expr.extent(0))), m_values()
+        {
+                expr::detail::check_square(expr);
+                m_values.reserve(expr::detail::packed_size(m_extents.extent(0)));
+                for(IndexType i = 0; i < m_extents.extent(0); i++){
+                        const auto [first, last] = row_range(i);
+                        for(IndexType j = first; j < last; j++){
+                                m_values.push_back(expr::detail::subscript(expr, i, j));
+                        }
+                }
+        }
+
+        constexpr auto extents() const noexcept {return m_extents;}
+        constexpr auto extent(std::size_t i) const noexcept {return m_extents.extent(i);}
+
+#ifdef CLANGBUG
+        T operator()(IndexType i, IndexType j) const {return get_value(i, j);}
+#endif
+        T operator[](IndexType i, IndexType j) const {return get_value(i, j);}
+
+        // Columns [first, last) of row i (rows of column j) that may be non-zero
+        constexpr std::pair<IndexType, IndexType> row_range(IndexType i) const noexcept
+        {
+                if constexpr(Uplo == expr::triangle::lower){
+                        return {0, i + 1};
+                }else{
+                        return {i, m_extents.extent(1)};
+                }
+        }
+        constexpr std::pair<IndexType, IndexType> col_range(IndexType j) const noexcept
+        {
+                if constexpr(Uplo == expr::triangle::lower){
+                        return {j, m_extents.extent(0)};
+                }else{
+                        return {0, j + 1};
+                }
+        }
+
+        const std::vector<T>& packed_values() const noexcept {return m_values;}
+
+    private:
+        extents_type m_extents;
+        std::vector<T> m_values;
+
+        T get_value(IndexType i, IndexType j) const noexcept
+        {
+                if constexpr(Uplo == expr::triangle::lower){
+                        return j <= i ? m_values[expr::detail::packed_size(i) + static_cast<std::size_t>(j)] : T{0};
+                }else{
+                        // Row i starts after the i longer rows above it
+                        const std::size_t n = static_cast<std::size_t>(m_extents.extent(0));
+                        const std::size_t row = static_cast<std::size_t>(i);
+                        return j >= i ? m_values[row*n - row*(row - 1)/2 + static_cast<std::size_t>(j - i)] : T{0};
+                }
+        }
+};
+
+/***************************************************************************//**
+* Banded matrix with lower sub-diagonals and upper super-diagonals. The band is
+* stored row by row, lower + upper + 1 elements per row, element (i, j) at
+* i*(lower + upper + 1) + j - i + lower (band elements outside the matrix are
+* unused). Elements outside the band are zero. expr::matmul dispatches products
+* with it to a dedicated kernel, only touching the band.
+ ******************************************************************************/
+template<typename T, typename IndexType = std::size_t>
+class BandedMatrix : public BaseExpr<BandedMatrix<T, IndexType>>{
+    public:
+        using value_type = T;
+        using index_type = IndexType;
+        using extents_type = stdex::dextents<IndexType, 2>;
+
+        BandedMatrix(IndexType rows, IndexType cols, IndexType lower, IndexType upper, T val = T{0})
+         : m_extents(rows, cols), m_lower(lower), m_upper(upper), m_values(band_size(), val)
+        {}
+
+        BandedMatrix(IndexType rows, IndexType cols, IndexType lower, IndexType upper, std::vector<T> band_values)
+         : m_extents(rows, cols), m_lower(lower), m_upper(upper), m_values(std::move(band_values))
+        {
+                expr::detail::check_storage_size(m_values, band_size());
+        }
+
+        /***********************************************************************
+        * Store the band of a (rank 2) expression, the elements outside of it
+        * are ignored.
+         **********************************************************************/
+        template<expr::expression Expr>
+        BandedMatrix(const Expr& expr, IndexType lower, IndexType upper)
+         : m_extents(static_cast<IndexType>(expr.extent(0)), static_cast<IndexType>(expr.extent(1))), m_lower(lower), m_upper(upper), m_values(band_size(), T{0})
+        {
+                for(IndexType i = 0; i < m_extents.extent(0); i++){
+                        const auto [first, last] = row_range(i);
+                        for(IndexType j = first; j < last; j++){
+                                m_values[band_index(i, j)] = expr::detail::subscript(expr, i, j);
+                        }
+                }
+        }
+
+        constexpr auto extents() const noexcept {return m_extents;}
+        constexpr auto extent(std::size_t i) const noexcept {return m_extents.extent(i);}
+
+#ifdef CLANGBUG
+        T operator()(IndexType i, IndexType j) const {return in_band(i, j) ? m_values[band_index(i, j)] : T{0};}
+#endif
+        T operator[](IndexType i, IndexType j) const {return in_band(i, j) ? m_values[band_index(i, j)] : T{0};}
+
+        // Columns [first, last) of row i (rows of column j) that may be non-zero
+        constexpr std::pair<IndexType, IndexType> row_range(IndexType i) const noexcept
+        {
+                return {i > m_lower ? i - m_lower : 0, std::min<IndexType>(m_extents.extent(1), i + m_upper + 1)};
+        }
+        constexpr std::pair<IndexType, IndexType> col_range(IndexType j) const noexcept
+        {
+                return {j > m_upper ? j - m_upper : 0, std::min<IndexType>(m_extents.extent(0), j + m_lower + 1)};
+        }
+
+        constexpr IndexType lower_bandwidth() const noexcept {return m_lower;}
+        constexpr IndexType upper_bandwidth() const noexcept {return m_upper;}
+        const std::vector<T>& band_values() const noexcept {return m_values;}
+
+    private:
+        extents_type m_extents;
+        IndexType m_lower;
+        IndexType m_upper;
+        std::vector<T> m_values;
+
+        constexpr std::size_t band_size() const noexcept
+        {
+                return static_cast<std::size_t>(m_extents.extent(0))*static_cast<std::size_t>(m_lower + m_upper + 1);
+        }
+        constexpr bool in_band(IndexType i, IndexType j) const noexcept
+        {
+                return j + m_lower >= i && j <= i + m_upper;
+        }
+        constexpr std::size_t band_index(IndexType i, IndexType j) const noexcept
+        {
+                return static_cast<std::size_t>(i)*static_cast<std::size_t>(m_lower + m_upper + 1) + static_cast<std::size_t>(j + m_lower - i);
+        }
+};
+
+#endif // STRUCTURED_MATRIX_H
@@ -0,0 +1,285 @@
+#ifndef EXPR_TEMPLATE_STRUCTURED_MULTIPLICATION_EXPRESSION_H
+#define EXPR_TEMPLATE_STRUCTURED_MULTIPLICATION_EXPRESSION_H
+
+#include <base_expression.h>
+#include <matrix_multiplication_expression.h>
+#include <sparse_multiplication_expression.h>
+#include <parallel.h>
+#include <exception>
+#include <string>
+#include <tuple>
+#include <type_traits>
+
+namespace expr
+{
+
+/***************************************************************************//**
+* Triangle stored by a triangular matrix.
+ ******************************************************************************/
+enum class triangle {lower, upper};
+
+/***************************************************************************//**
+* Concept for structured matrix expressions (symmetric, triangular, banded).
+* row_range(i) and col_range(j) return the half open range of columns in row i
+* and rows in column j that may hold non-zero elements.
+ ******************************************************************************/
+template<typename Expr>
+concept structured_expression = expression<Expr> && requires(const std::remove_cvref_t<Expr>& e, typename std::remove_cvref_t<Expr>::index_type i)
+{
+        e.row_range(i);
+        e.col_range(i);
+};
+
+/***************************************************************************//**
+* Concept for symmetric matrices storing their lower triangle packed row by row
+* (element (i, j), j <= i, at i*(i + 1)/2 + j of packed_values()).
+ ******************************************************************************/
+template<typename Expr>
+concept packed_symmetric = structured_expression<Expr> && std::remove_cvref_t<Expr>::symmetric && requires(const std::remove_cvref_t<Expr>& e)
+{
+        e.packed_values().data();
+};
+
+namespace detail
+{
+        // Calls f(j, s[i, j]) for the elements of row i of a packed symmetric
+        // matrix, reading the stored part of the row (j <= i) contiguously and
+        // the mirrored part (j > i) down column i of the stored triangle
+        template<typename Symmetric, typename IndexType, typename F>
+        constexpr inline void for_each_symmetric(const Symmetric& s, IndexType i, F&& f)
+        {
+                const auto* values = s.packed_values().data();
+                const std::size_t row = static_cast<std::size_t>(i);
+                const auto* stored = values + row*(row + 1)/2;
+                for(std::size_t j = 0; j <= row; j++){
+                        f(static_cast<IndexType>(j), stored[j]);
+                }
+                const std::size_t n = static_cast<std::size_t>(s.extent(0));
+                std::size_t p = (row + 1)*(row + 2)/2 + row;
+                for(std::size_t j = row + 1; j < n; j++){
+                        f(static_cast<IndexType>(j), values[p]);
+                        p += j + 1;
+                }
+        }
+
+        // Calls f(k, s[i, k]) for the possibly non-zero elements of row i of s
+        template<typename Structured, typename IndexType, typename F>
+        constexpr inline void for_each_in_row(const Structured& s, IndexType i, F&& f)
+        {
+                if constexpr(packed_symmetric<Structured>){
+                        for_each_symmetric(s, i, f);
+                }else{
+                        const auto [first, last] = s.row_range(i);
+                        for(auto k = first; k < last; k++){
+                                f(static_cast<IndexType>(k), subscript(s, i, k));
+                        }
+                }
+        }
+
+        // Calls f(k, s[k, j]) for the possibly non-zero elements of column j of s
+        template<typename Structured, typename IndexType, typename F>
+        constexpr inline void for_each_in_column(const Structured& s, IndexType j, F&& f)
+        {
+                if constexpr(packed_symmetric<Structured>){
+                        // Column j of a symmetric matrix is its row j
+                        for_each_symmetric(s, j, f);
+                }else{
+                        const auto [first, last] = s.col_range(j);
+                        for(auto k = first; k < last; k++){
+                                f(static_cast<IndexType>(k), subscript(s, k, j));
+                        }
+                }
+        }
+}; // detail
+
+/***************************************************************************//**
+* StructuredMatrixMultiplicationOp represents the matrix product of two
+* expressions, at least one of which is a structured matrix. Individual
+* elements, and the whole product (assign_to), are computed from the possibly
+* non-zero range of each row (or column) of the structured operand only.
+* Triangular operands thus need half the work of a dense product and banded
+* ones work proportional to the bandwidth. Symmetric operands are read from
+* their packed triangle directly (SYMM), the stored part of each row
+* contiguously and the mirrored part down a column of the triangle.
+*
+* The whole product is evaluated in parallel over rows, as
+* C[i, :] += A[i, k]*B[k, :] over the range of row i of a structured A, or
+* over the range of row k of a structured B. A row vector times a structured
+* matrix is evaluated in parallel over the columns of the result, from the
+* range of each column. The other operand may be a matrix or a vector.
+ ******************************************************************************/
+template<expression LHS, expression RHS, typename EXT>
+class StructuredMatrixMultiplicationOp: public BaseExpr<StructuredMatrixMultiplicationOp<LHS, RHS, EXT>>{
+    public:
+        using Base = BaseExpr<StructuredMatrixMultiplicationOp<LHS, RHS, EXT>>;
+        using RHS_noref = std::remove_reference_t<RHS>;
+        using LHS_noref = std::remove_reference_t<LHS>;
+        using value_type = element_type<LHS, RHS>;
+        using index_type = typename EXT::index_type;
+
+        constexpr explicit StructuredMatrixMultiplicationOp(LHS&& lhs, RHS&& rhs, EXT&& ext) noexcept
+         : Base(), m_lhs(std::forward<LHS>(lhs)), m_rhs(std::forward<RHS>(rhs)), m_ext(std::forward<EXT>(ext))
+        {}
+
+        ~StructuredMatrixMultiplicationOp() noexcept = default;
+
+        constexpr auto extents() const noexcept {return m_ext;};
+        constexpr auto extent(std::size_t i) const noexcept {return m_ext.extent(i);};
+
+#ifdef CLANGBUG
+        constexpr auto operator()(auto&&... indices) const {return get_value(indices...);}
+#endif
+        constexpr auto operator[](auto&&... indices) const {return get_value(indices...);}
+
+        /***********************************************************************
+        * Evaluate the full product into destination.
+         **********************************************************************/
+        template<typename Destination>
+        void assign_to(Destination& destination) const
+        {
+                if constexpr(row_vector_lhs){
+                        // x^T*B[:, j] over the range of column j of B
+                        parallel_for(index_type(0), cols(), static_cast<index_type>(detail::sparse_grain), [&](index_type begin, index_type end){
+                                for(index_type j = begin; j < end; j++){
+                                        store(destination, 0, j, get_value(0, j));
+                                }
+                        });
+                }else{
+                        parallel_for(index_type(0), rows(), static_cast<index_type>(detail::sparse_grain), [&](index_type begin, index_type end){
+                                for(index_type i = begin; i < end; i++){
+                                        for(index_type j = 0; j < cols(); j++){
+                                                store(destination, i, j, value_type(0));
+                                        }
+                                        if constexpr(structured_expression<LHS>){
+                                                // C[i, :] = sum_k A[i, k]*B[k, :], k in the range of row i of A
+                                                detail::for_each_in_row(m_lhs, i, [&](index_type k, const auto& a){
+                                                        for(index_type j = 0; j < cols(); j++){
+                                                                add(destination, i, j, a*detail::dense_at(m_rhs, k, j));
+                                                        }
+                                                });
+                                        }else{
+                                                // C[i, :] = sum_k A[i, k]*B[k, :], the columns in the range of row k of B
+                                                for(index_type k = 0; k < inner(); k++){
+                                                        const auto a = lhs_at(i, k);
+                                                        detail::for_each_in_row(m_rhs, k, [&](index_type j, const auto& b){
+                                                                add(destination, i, j, a*b);
+                                                        });
+                                                }
+                                        }
+                                }
+                        });
+                }
+        }
+
+        constexpr explicit StructuredMatrixMultiplicationOp(const StructuredMatrixMultiplicationOp&) noexcept = default;
+        constexpr explicit StructuredMatrixMultiplicationOp(StructuredMatrixMultiplicationOp&&) noexcept = default;
+
+        constexpr StructuredMatrixMultiplicationOp& operator=(const StructuredMatrixMultiplicationOp&) noexcept = default;
+        constexpr StructuredMatrixMultiplicationOp& operator=(StructuredMatrixMultiplicationOp&&) noexcept = default;
+        constexpr auto operands() const noexcept {return std::forward_as_tuple(m_lhs, m_rhs);}
+    private:
+        std::remove_cv_t<LHS> m_lhs;
+        std::remove_cv_t<RHS> m_rhs;
+        EXT m_ext;
+
+        constexpr explicit StructuredMatrixMultiplicationOp() noexcept = default;
+
+        static constexpr bool vector_result = EXT::rank() == 1;
+        // A dense vector on the left hand side is a row vector
+        static constexpr bool row_vector_lhs = vector_result && !structured_expression<LHS>;
+
+        constexpr index_type rows() const noexcept {return row_vector_lhs ? 1 : static_cast<index_type>(m_ext.extent(0));}
+        constexpr index_type cols() const noexcept {return vector_result && !row_vector_lhs ? 1 : static_cast<index_type>(m_ext.extent(EXT::rank() - 1));}
+        constexpr index_type inner() const noexcept {return static_cast<index_type>(m_lhs.extent(decltype(m_lhs.extents())::rank() - 1));}
+
+        constexpr auto lhs_at(index_type i, index_type k) const
+        {
+                if constexpr(row_vector_lhs){
+                        (void) i;
+                        return detail::subscript(m_lhs, k);
+                }else{
+                        return detail::subscript(m_lhs, i, k);
+                }
+        }
+
+        template<typename Destination>
+        static constexpr decltype(auto) dest_at(Destination& destination, index_type i, index_type j)
+        {
+                if constexpr(!vector_result){
+                        return detail::subscript(destination, i, j);
+                }else if constexpr(row_vector_lhs){
+                        (void) i;
+                        return detail::subscript(destination, j);
+                }else{
+                        (void) j;
+                        return detail::subscript(destination, i);
+                }
+        }
+        template<typename Destination>
+        static constexpr void store(Destination& destination, index_type i, index_type j, value_type val)
+        {
+                dest_at(destination, i, j) = val;
+        }
+        template<typename Destination>
+        static constexpr void add(Destination& destination, index_type i, index_type j, value_type val)
+        {
+                dest_at(destination, i, j) += val;
+        }
+
+        constexpr value_type get_value(index_type i, index_type j) const
+        {
+                value_type res = 0;
+                if constexpr(structured_expression<LHS>){
+                        detail::for_each_in_row(m_lhs, i, [&](index_type k, const auto& a){
+                                res += a*detail::dense_at(m_rhs, k, j);
+                        });
+                }else{
+                        detail::for_each_in_column(m_rhs, j, [&](index_type k, const auto& b){
+                                res += lhs_at(i, k)*b;
+                        });
+                }
+                return res;
+        }
+        constexpr value_type get_value(index_type n) const
+        {
+                if constexpr(row_vector_lhs){
+                        return get_value(0, n);
+                }else{
+                        return get_value(n, 0);
+                }
+        }
+}; // StructuredMatrixMultiplicationOp
+
+/***************************************************************************//**
+* Matrix multiplication where at least one operand is a structured
+* (symmetric, triangular or banded) matrix and neither is sparse. The other
+* operand may be a dense (or structured) matrix, or a vector.
+ ******************************************************************************/
+template<expression LHS, expression RHS>
+requires ((structured_expression<LHS> || structured_expression<RHS>) && !sparse_expression<LHS> && !sparse_expression<RHS>)
+constexpr inline auto matmul(LHS&& lhs, RHS&& rhs)
+{
+        constexpr size_t lhs_rank = decltype(lhs.extents())::rank();
+        constexpr size_t rhs_rank = decltype(rhs.extents())::rank();
+        static_assert(lhs_rank <= 2 && rhs_rank <= 2 && lhs_rank + rhs_rank >= 3, "Structured matrix multiplication requires a matrix and a matrix or a vector");
+        using IndexType = typename decltype(lhs.extents())::index_type;
+
+        const auto inner_lhs = lhs.extent(lhs_rank - 1);
+        const auto inner_rhs = rhs.extent(0);
+        if (static_cast<size_t>(inner_lhs) != static_cast<size_t>(inner_rhs)){
+                throw std::runtime_error("incompatible dimensions for matrix multiplication!\n" + std::to_string(inner_lhs) + " != " + std::to_string(inner_rhs));
+        }
+        if constexpr(lhs_rank == 2 && rhs_rank == 2){
+                using EXT = stdex::dextents<IndexType, 2>;
+                EXT ext{static_cast<IndexType>(lhs.extent(0)), static_cast<IndexType>(rhs.extent(1))};
+                return StructuredMatrixMultiplicationOp<LHS, RHS, EXT>{std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::move(ext)};
+        }else{
+                using EXT = stdex::dextents<IndexType, 1>;
+                EXT ext{static_cast<IndexType>(lhs_rank == 2 ? lhs.extent(0) : rhs.extent(rhs_rank - 1))};
+                return StructuredMatrixMultiplicationOp<LHS, RHS, EXT>{std::forward<LHS>(lhs), std::forward<RHS>(rhs), std::move(ext)};
+        }
+}
+
+}; //expr
+
+#endif // EXPR_TEMPLATE_STRUCTURED_MULTIPLICATION_EXPRESSION_H
@@ -0,0 +1,224 @@
+#ifndef EXPR_TEMPLATE_TAKE_EXPRESSION_H
+#define EXPR_TEMPLATE_TAKE_EXPRESSION_H
+
+#include <base_expression.h>
+#include <conditional_expression.h>
+#include <extents_utils.h>
+#include <parallel.h>
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace expr
+{
+
+namespace detail
+{
+        // Gathered rows (index entries) prefetched ahead by default
+        inline constexpr std::size_t take_prefetch_distance = 16;
+        // Bytes of a gathered row prefetched at most, further lines of long
+        // rows are left to the hardware prefetcher
+        inline constexpr std::size_t take_prefetch_bytes = 1024;
+        // Elements gathered per parallel chunk at least
+        inline constexpr std::size_t take_grain = std::size_t(1) << 14;
+
+        inline void prefetch([[maybe_unused]] const void* address) noexcept
+        {
+#if defined(__GNUC__) || defined(__clang__)
+                __builtin_prefetch(address, 0, 3);
+#endif
+        }
+}; // detail
+
+/***************************************************************************//**
+* Take is a view of an expression indexed along one axis by a 1D integer
+* expression, as numpy.take: element [i, j, k] of a take along axis 1 is
+* element [i, indices[j], k] of the original expression, e.g. the rows of an
+* embedding table selected by a list of ids. The indices are checked and
+* stored when the view is created, the elements are read when evaluated.
+*
+* Evaluating a whole take (assign_to) from a row major leaf copies the
+* selected rows in parallel chunks, prefetching the row prefetch_distance
+* indices ahead so that the latency of random reads overlaps the copying.
+* This matters for rows of more than a few elements; loads of single
+* elements (a take along the last axis) are independent of each other and
+* already overlap without it.
+ ******************************************************************************/
+template<expression Expr>
+class Take : public BaseExpr<Take<Expr>>
+{
+    public:
+        using Base = BaseExpr<Take<Expr>>;
+        using Expr_noref = std::remove_cvref_t<Expr>;
+        using value_type = typename Expr_noref::value_type;
+        using source_extents_type = decltype(std::declval<Expr_noref>().extents());
+        using index_type = typename source_extents_type::index_type;
+        static constexpr std::size_t rank = source_extents_type::rank();
+        using extents_type = stdex::dextents<index_type, rank>;
+
+        explicit Take(Expr&& expr, std::vector<index_type>&& indices, std::size_t axis, std::size_t prefetch_distance)
+         : Base(), m_expr(std::forward<Expr>(expr)), m_indices(std::move(indices)), m_axis(axis),
+                m_prefetch(prefetch_distance), m_extents(take_extents())
+        {}
+        explicit Take(const Take&) = default;
+        explicit Take(Take&&) noexcept = default;
+        ~Take() noexcept = default;
+
+        constexpr extents_type extents() const noexcept {return m_extents;}
+        constexpr index_type extent(std::size_t i) const noexcept {return m_extents.extent(i);}
+
+#ifdef CLANGBUG
+        value_type operator()(auto&&... indices) const
+        {
+                return get_value(std::make_index_sequence<rank>{}, {detail::convert<index_type>(indices)...});
+        }
+#endif
+        value_type operator[](auto&&... indices) const
+        {
+                return get_value(std::make_index_sequence<rank>{}, {detail::convert<index_type>(indices)...});
+        }
+
+        constexpr std::size_t axis() const noexcept {return m_axis;}
+        constexpr const std::vector<index_type>& indices() const noexcept {return m_indices;}
+
+        /***************************************************************
+        * Gather all selected elements into destination.
+         **************************************************************/
+        template<typename Destination>
+        void assign_to(Destination& destination) const
+        {
+                if constexpr(gathers_flat<Destination>){
+                        std::size_t outer = 1, inner = 1;
+                        for(std::size_t d = 0; d < m_axis; d++){
+                                outer *= static_cast<std::size_t>(m_expr.extent(d));
+                        }
+                        for(std::size_t d = m_axis + 1; d < rank; d++){
+                                inner *= static_cast<std::size_t>(m_expr.extent(d));
+                        }
+                        const std::size_t count = m_indices.size();
+                        const std::size_t rows = outer*count;
+                        const std::size_t grain = std::max<std::size_t>(1, detail::take_grain/std::max<std::size_t>(1, inner));
+                        parallel_for(std::size_t(0), rows, grain, [&](std::size_t begin, std::size_t end){
+                                // Rows [begin, end) in pieces of consecutive indices
+                                while(begin < end){
+                                        const std::size_t o = begin/count;
+                                        const std::size_t first = begin%count;
+                                        const std::size_t last = std::min(count, first + (end - begin));
+                                        gather(destination, o, first, last, count, inner);
+                                        begin += last - first;
+                                }
+                        });
+                }else{
+                        auto assign = [&](auto... indices)
+                        {
+                                detail::subscript(destination, indices...) = detail::subscript(*this, indices...);
+                        };
+                        exts::for_each_index(m_extents, std::move(assign));
+                }
+        }
+
+        Take& operator=(const Take&) = default;
+        Take& operator=(Take&&) noexcept = default;
+        constexpr auto operands() const noexcept {return std::forward_as_tuple(m_expr);}
+    private:
+        std::remove_cv_t<Expr> m_expr;
+        std::vector<index_type> m_indices;
+        std::size_t m_axis;
+        std::size_t m_prefetch;
+        extents_type m_extents;
+
+        // Row major source elements in memory, and a row major destination
+        template<typename Destination>
+        static constexpr bool gathers_flat = requires(const Expr_noref& e, Destination& d, std::size_t n)
+        {
+                {e.flat(n)} -> std::same_as<const value_type&>;
+                d.flat(n) = e.flat(n);
+        };
+
+        extents_type take_extents() const noexcept
+        {
+                std::array<index_type, rank> exts{};
+                for(std::size_t d = 0; d < rank; d++){
+                        exts[d] = d == m_axis ? static_cast<index_type>(m_indices.size()) : m_expr.extent(d);
+                }
+                return std::apply([](auto... e){ return extents_type(e...); }, exts);
+        }
+
+        template<std::size_t... Ds>
+        value_type get_value(std::index_sequence<Ds...>, std::array<index_type, rank> indices) const
+        {
+                indices[m_axis] = m_indices[static_cast<std::size_t>(indices[m_axis])];
+                return detail::subscript(m_expr, indices[Ds]...);
+        }
+
+        // Copies the rows of indices [first, last) of outer index o
+        template<typename Destination>
+        void gather(Destination& destination, std::size_t o, std::size_t first, std::size_t last, std::size_t count, std::size_t inner) const
+        {
+                const std::size_t base = o*static_cast<std::size_t>(m_expr.extent(m_axis));
+                const std::size_t out = o*count;
+                const value_type* source = &m_expr.flat(base*inner);
+                const index_type* index = m_indices.data();
+                if(inner == 1){
+                        for(std::size_t k = first; k < last; k++){
+                                if(m_prefetch > 0 && k + m_prefetch < last){
+                                        detail::prefetch(source + index[k + m_prefetch]);
+                                }
+                                destination.flat(out + k) = source[index[k]];
+                        }
+                        return;
+                }
+                const std::size_t bytes = std::min(inner*sizeof(value_type), detail::take_prefetch_bytes);
+                for(std::size_t k = first; k < last; k++){
+                        if(m_prefetch > 0 && k + m_prefetch < last){
+                                const auto* ahead = reinterpret_cast<const char*>(source + static_cast<std::size_t>(index[k + m_prefetch])*inner);
+                                for(std::size_t b = 0; b < bytes; b += detail::cache_line_bytes){
+                                        detail::prefetch(ahead + b);
+                                }
+                        }
+                        const value_type* row = source + static_cast<std::size_t>(index[k])*inner;
+                        const std::size_t dst = (out + k)*inner;
+                        for(std::size_t j = 0; j < inner; j++){
+                                destination.flat(dst + j) = row[j];
+                        }
+                }
+        }
+};
+
+/***************************************************************************//**
+* Returns a Take of expr, selecting the elements along axis given by the 1D
+* integer expression indices (which may repeat and be in any order). The
+* evaluation prefetches the row prefetch_distance indices ahead, 0 disables
+* prefetching.
+ ******************************************************************************/
+template<expression Expr, expression Index>
+requires std::integral<typename Index::value_type>
+inline auto take(Expr&& expr, const Index& indices, std::size_t axis = 0, std::size_t prefetch_distance = detail::take_prefetch_distance)
+{
+        using TakeType = Take<Expr>;
+        using index_type = typename TakeType::index_type;
+        static_assert(decltype(indices.extents())::rank() == 1, "Take indices must be a 1D expression");
+        if(axis >= TakeType::rank){
+                throw std::runtime_error("Take axis out of range!\n" + std::to_string(axis) + " >= " + std::to_string(TakeType::rank));
+        }
+        const auto extent = expr.extent(axis);
+        std::vector<index_type> idx(static_cast<std::size_t>(indices.extent(0)));
+        for(std::size_t k = 0; k < idx.size(); k++){
+                const auto i = detail::subscript(indices, static_cast<typename decltype(indices.extents())::index_type>(k));
+                if(std::cmp_less(i, 0) || std::cmp_greater_equal(i, extent)){
+                        throw std::runtime_error("Take index out of range!\nIndex " + std::to_string(k) + ": " + std::to_string(i) + " with extent " + std::to_string(extent));
+                }
+                idx[k] = static_cast<index_type>(i);
+        }
+        return TakeType(std::forward<Expr>(expr), std::move(idx), axis, prefetch_distance);
+}
+
+}; // expr
+#endif // EXPR_TEMPLATE_TAKE_EXPRESSION_H
@@ -2,19 +2,82 @@
 #define EXPR_TEMPLATE_TRANSPOSE_EXPRESSION_H
 
 #include<base_expression.h>
+#include <elementwise_nary_operators.h>
 #include <bits/utility.h>
+#include <array>
 #include <functional>
+#include <tuple>
 #include<iostream>
 #include<exception>
 
 namespace expr
 {
 
+template<size_t N, typename Type, Type Target, Type T, Type... Ts>
+constexpr auto find_in_sequence(std::integer_sequence<Type, T, Ts...>)
+{
+        if constexpr(Target == T){
+                return N;
+        }else if constexpr(sizeof...(Ts) > 0){
+                return find_in_sequence<N + 1, Type, Target, Ts... >(std::integer_sequence<Type, Ts...>{});
+        }else{
+                return N + 1; 
+        }
+}
+
+template<size_t... Order>
+constexpr bool is_reversal() noexcept
+{
+        constexpr std::size_t N = sizeof...(Order);
+        std::size_t d = N;
+        return ((Order == --d) && ...);
+}
+
+template<size_t... Order>
+constexpr bool is_identity() noexcept
+{
+        std::size_t d = 0;
+        return ((Order == d++) && ...);
+}
+
+/***************************************************************************//**
+* Layout of an expression with layout Layout, its dimensions permuted by Order
+* (void if unknown). Reversing the dimensions of a row major expression makes
+* it column major and vice versa. Other permutations of a row major expression
+* are contiguous along the dimension the last one was moved to, and are
+* traversed in tiles when assigned to (or combined with) a row major one.
+ ******************************************************************************/
+template<typename Layout, size_t... Order>
+struct permuted_layout
+{
+        using type = void;
+};
+template<size_t... Order>
+requires (sizeof...(Order) >= 2)
+struct permuted_layout<stdex::layout_right, Order...>
+{
+        static constexpr size_t fast_dim = find_in_sequence<0, size_t, sizeof...(Order) - 1>(std::index_sequence<Order...>{});
+        using type = std::conditional_t<fast_dim == sizeof...(Order) - 1, stdex::layout_right,
+                     std::conditional_t<is_reversal<Order...>(), stdex::layout_left, exts::layout_tiled<fast_dim>>>;
+};
+template<size_t... Order>
+requires (sizeof...(Order) >= 2)
+struct permuted_layout<stdex::layout_left, Order...>
+{
+        using type = std::conditional_t<is_reversal<Order...>(), stdex::layout_right,
+                     std::conditional_t<is_identity<Order...>(), stdex::layout_left, void>>;
+};
+template<typename Layout, size_t Order>
+struct permuted_layout<Layout, Order>
+{
+        using type = Layout;
+};
+
 /***************************************************************************//**
-* ElementwiseBinaryOp represents expressions where a function is
-* applied to mathcing elements in two expressions. The evaluation of the
-* function is not performed until the specific element of this expression is
-* required (via the subscript operator).
+* TransposeExpressionOp represents an expression with its dimensions permuted,
+* dimension i of the transposed expression being dimension Order[i] of the
+* original one. No elements are moved, the indices are permuted when an element
+* is required (via the subscript operator).
  ******************************************************************************/
 template<expression LHS, typename EXT, size_t... Order>
 class TransposeExpressionOp: public BaseExpr<TransposeExpressionOp<LHS, EXT, Order...>>{
@@ -22,6 +85,8 @@ class TransposeExpressionOp: public BaseExpr<TransposeExpressionOp<LHS, EXT, Ord
         using Base = BaseExpr<TransposeExpressionOp<LHS, EXT, Order...>>;
         using LHS_noref = std::remove_reference_t<LHS>;
         using value_type = std::remove_reference_t<LHS>::value_type;
+        using layout_type = typename permuted_layout<exts::layout_of_t<LHS>, Order...>::type;
+        static constexpr std::array<size_t, sizeof...(Order)> order{Order...};
 
         constexpr explicit TransposeExpressionOp(LHS&& lhs, EXT&& exts ) noexcept
          : Base(), m_expr(std::forward<LHS>(lhs)),
@@ -30,31 +95,99 @@ class TransposeExpressionOp: public BaseExpr<TransposeExpressionOp<LHS, EXT, Ord
 
         ~TransposeExpressionOp() noexcept = default;
 
-        constexpr auto extents() const noexcept {return m_ext.extents();};
+        constexpr auto extents() const noexcept {return m_ext;};
         constexpr auto extent(std::size_t i) const noexcept {return m_ext.extent(i);};
 
+#ifdef CLANGBUG
+        constexpr auto operator()(auto&&... indices) const
+        {
+                return get_value(std::make_index_sequence<sizeof...(indices)>{}, std::tuple{indices...});
+        }
+#endif
         constexpr auto operator[](auto&&... indices) const
         {
-                return get_value(indices...);
+                return get_value(std::make_index_sequence<sizeof...(indices)>{}, std::tuple{indices...});
         }
 
+        // The identity permutation keeps the operand's flat access
+        constexpr auto flat(std::size_t n) const requires (is_identity<Order...>() && exts::has_flat_access<LHS>) {return m_expr.flat(n);}
+
+        // The expression before transposition
+        constexpr const auto& operand() const noexcept {return m_expr;}
+
+        // The expression before transposition, moved out to rewrite this node
+        constexpr LHS&& release() && noexcept {return std::forward<LHS>(m_expr);}
+
         constexpr explicit TransposeExpressionOp(const TransposeExpressionOp&) noexcept = default;
         constexpr explicit TransposeExpressionOp(TransposeExpressionOp&&) noexcept = default;
 
         constexpr TransposeExpressionOp& operator=(const TransposeExpressionOp&) noexcept = default;
         constexpr TransposeExpressionOp& operator=(TransposeExpressionOp&&) noexcept = default;
+        constexpr auto operands() const noexcept {return std::forward_as_tuple(m_expr);}
     private:
         std::remove_cv_t<LHS> m_expr;
         EXT m_ext;
 
 
-        auto get_value(auto&&... indices) const
+        // Index D of the original expression is index Inverse[D] of the transposed one
+        template<typename Tuple, size_t... Ds>
+        constexpr auto get_value(std::index_sequence<Ds...>, Tuple&& indices) const
         {
-                return m_expr[indices...];
+                return detail::subscript(m_expr, std::get<find_in_sequence<0, size_t, Ds>(std::index_sequence<Order...>{})>(indices)...);
         }
 
 }; // TransposeExpressionOp
 
+namespace detail
+{
+        // Order swaps the last two dimensions and keeps the leading (batch) ones in place
+        template<size_t... Order>
+        consteval bool swaps_last_two() noexcept
+        {
+                constexpr std::size_t N = sizeof...(Order);
+                if constexpr(N < 2){
+                        return false;
+                }else{
+                        constexpr std::array<std::size_t, N> order{Order...};
+                        for(std::size_t d = 0; d + 2 < N; d++){
+                                if(order[d] != d){
+                                        return false;
+                                }
+                        }
+                        return order[N - 2] == N - 1 && order[N - 1] == N - 2;
+                }
+        }
+
+        // Transposes of (batched) matrices, i.e. expressions with the last two dimensions swapped
+        template<typename T>
+        struct is_matrix_transpose : std::false_type {};
+        template<expression LHS, typename EXT, size_t... Order>
+        struct is_matrix_transpose<TransposeExpressionOp<LHS, EXT, Order...>> : std::bool_constant<swaps_last_two<Order...>()> {};
+
+        template<typename T>
+        struct is_transpose : std::false_type {};
+        template<expression LHS, typename EXT, size_t... Order>
+        struct is_transpose<TransposeExpressionOp<LHS, EXT, Order...>> : std::true_type {};
+
+        // Layout of the operands of an elementwise node (parts as released by
+        // the node) after each of them is permuted by Order
+        template<typename Parts, typename Order>
+        struct distributed_layout;
+        template<typename Op, typename... Operands, size_t... Order>
+        struct distributed_layout<std::tuple<Op, Operands...>, std::index_sequence<Order...>>
+        {
+                using type = typename nary_layout<typename permuted_layout<exts::layout_of_t<Operands>, Order...>::type...>::type;
+        };
+
+        // Transposing the operands of the temporary elementwise node Expr
+        // instead of the node tells the order to traverse it in, when the
+        // transposed node itself has no known layout
+        template<typename Expr, size_t... Order>
+        concept distributes_transpose = foldable<Expr>
+                && std::is_void_v<typename permuted_layout<exts::layout_of_t<Expr>, Order...>::type>
+                && !std::is_void_v<typename distributed_layout<decltype(std::declval<std::remove_cvref_t<Expr>>().release()), std::index_sequence<Order...>>::type>;
+}; // detail
+
 template<size_t T, size_t... Ts, size_t... Reversed>
 constexpr auto reverse_sequence(std::index_sequence<T, Ts...>, std::index_sequence<Reversed...>)
 {
@@ -65,18 +198,6 @@ constexpr auto reverse_sequence(std::index_sequence<T, Ts...>, std::index_sequen
         }
 }
 
-template<size_t N, typename Type, Type Target, Type T, Type... Ts>
-constexpr auto find_in_sequence(std::integer_sequence<Type, T, Ts...>)
-{
-        if constexpr(Target == T){
-                return N;
-        }else if constexpr(sizeof...(Ts) > 0){
-                return find_in_sequence<N + 1, Type, Target, Ts... >(std::integer_sequence<Type, Ts...>{});
-        }else{
-                return N + 1; 
-        }
-}
-
 
 template<typename IndexType, size_t... Extents, typename... Order, size_t Idx>
 constexpr auto reorder_extents(stdex::extents<IndexType, Extents...> exts, std::index_sequence<Idx>, std::tuple<Order...> order, auto... reordered_extents)
@@ -124,26 +245,48 @@ constexpr auto reorder_extents(stdex::extents<IndexType, Extents...> exts, std::
 template<typename IndexType, size_t... Extents>
 constexpr auto reverse_extents(stdex::extents<IndexType, Extents...>)
 {
-        return reverse_sequence(std::index_sequence<sizeof...(Extents)>{});
+        return reverse_sequence(std::make_index_sequence<sizeof...(Extents)>{}, std::index_sequence<>{});
 }
 
+/***************************************************************************//**
+* Returns a TransposeExpressionOp permuting the dimensions of lhs by Order.
+* Transposing a temporary transpose composes the permutations. The identity
+* permutation results in the original expression when the transpose held it
+* (transpose(transpose(A + B)) being A + B), and in a view with the identity
+* order when it referred to an lvalue. A temporary elementwise expression
+* whose traversal order is lost by transposing it, e.g. the sum of a row major
+* and a column major array, is rewritten as the elementwise expression of its
+* transposed operands.
+ ******************************************************************************/
 template<expression LHS, size_t... Order>
 constexpr inline auto transpose(LHS&& lhs, std::index_sequence<Order...>)
 {
         if (lhs.extents().rank() != sizeof...(Order)){
                 throw std::runtime_error("Rank of expression and dimensions of new ordering do not match!\n" + std::to_string(lhs.extents().rank()) + " != " + std::to_string(sizeof...(Order)));
         }
-        auto reordered_exts = reorder_extents(lhs.extents(), std::make_index_sequence<sizeof...(Order)>{});
-        return TransposeExpressionOp<LHS, decltype(reordered_exts), Order...>{std::forward<LHS>(lhs), std::move(reordered_exts)};
+        using E = std::remove_cvref_t<LHS>;
+        if constexpr(!std::is_lvalue_reference_v<LHS> && detail::is_transpose<E>::value){
+                using Composed = std::index_sequence<E::order[Order]...>;
+                if constexpr(std::is_same_v<Composed, std::make_index_sequence<sizeof...(Order)>>
+                             && !std::is_lvalue_reference_v<decltype(std::move(lhs).release())>){
+                        return detail::unwrap(std::move(lhs).release());
+                }else{
+                        return transpose(std::move(lhs).release(), Composed{});
+                }
+        }else if constexpr(detail::distributes_transpose<LHS, Order...>){
+                return std::apply([](auto&& op, auto&&... operands){
+                        return detail::make_nary(std::forward<decltype(op)>(op), transpose(std::forward<decltype(operands)>(operands), std::index_sequence<Order...>{})...);
+                }, std::move(lhs).release());
+        }else{
+                auto reordered_exts = reorder_extents(lhs.extents(), std::index_sequence<Order...>{});
+                return TransposeExpressionOp<LHS, decltype(reordered_exts), Order...>{std::forward<LHS>(lhs), std::move(reordered_exts)};
+        }
 }
-
 template<expression LHS>
 constexpr inline auto transpose(LHS&& lhs)
 {
         return transpose(std::forward<LHS>(lhs), reverse_extents(lhs.extents()));
 }
-
-
 }; //expr
 
 #endif // EXPR_TEMPLATE_TRANSPOSE_EXPRESSION_H
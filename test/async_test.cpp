@@ -0,0 +1,130 @@
+#include <mdarray.h>
+#include <async.h>
+#include <gtest/gtest.h>
+#include <coroutine>
+#include <future>
+
+namespace
+{
+using D2 = stdex::dextents<std::size_t, 2>;
+
+// Coroutine type starting eagerly, signalling completion through a promise
+struct Detached
+{
+        struct promise_type
+        {
+                Detached get_return_object() noexcept {return {};}
+                std::suspend_never initial_suspend() noexcept {return {};}
+                std::suspend_never final_suspend() noexcept {return {};}
+                void return_void() noexcept {}
+                void unhandled_exception() noexcept {std::terminate();}
+        };
+};
+
+Detached add_and_sum(MDArray<double, D2>& dest, const MDArray<double, D2>& a, std::promise<double>& result)
+{
+        co_await expr::async_assign(dest, a + a);
+        const double s = co_await expr::async_reduce(expr::sum(dest));
+        result.set_value(s);
+}
+} // namespace
+
+TEST(Async, AssignAndReduce)
+{
+        MDArray<double, D2> a(D2(200, 300), 1.5), dest(D2(200, 300), 0.0);
+        auto assigned = expr::async_assign(dest, a*2.0);
+        assigned.get();
+        ASSERT_TRUE(assigned.ready());
+        ASSERT_DOUBLE_EQ((dest[199, 299]), 3.0);
+
+        auto total = expr::async_reduce(expr::sum(dest));
+        std::shared_future<double> future = total.future();
+        ASSERT_DOUBLE_EQ(future.get(), 3.0*200*300);
+        auto largest = expr::async_reduce(a, [](double acc, double val){ return std::max(acc, val); }, 0.0);
+        ASSERT_DOUBLE_EQ(largest.get(), 1.5);
+}
+
+TEST(Async, Coroutine)
+{
+        MDArray<double, D2> a(D2(50, 40), 2.0), dest(D2(50, 40), 0.0);
+        std::promise<double> result;
+        auto future = result.get_future();
+        add_and_sum(dest, a, result);
+        ASSERT_DOUBLE_EQ(future.get(), 4.0*50*40);
+        ASSERT_DOUBLE_EQ((dest[49, 39]), 4.0);
+}
+
+TEST(Async, WhenAll)
+{
+        MDArray<int, D2> a(D2(100, 100), 1), b(D2(100, 100), 0), c(D2(100, 100), 0);
+        auto done = expr::when_all(expr::async_assign(b, a + a), expr::async_assign(c, a*3), expr::async_reduce(expr::sum(a)));
+        done.get();
+        ASSERT_EQ((b[99, 99]), 2);
+        ASSERT_EQ((c[0, 0]), 3);
+
+        // The assignments to b depend on each other and run in order, the one to c is independent
+        for(int n = 0; n < 20; n++){
+                expr::when_all(expr::assignment(b, a*n),
+                               expr::assignment(c, a + a),
+                               expr::assignment(b, b + a)).get();
+                ASSERT_EQ((b[50, 50]), n + 1);
+                ASSERT_EQ((c[50, 50]), 2);
+        }
+}
+
+TEST(Async, MismatchedExtents)
+{
+        MDArray<double, D2> a(D2(20, 30), 1.0), small(D2(20, 10), 0.0), flat(D2(600, 1), 0.0);
+        ASSERT_THROW(expr::async_assign(small, a + a), std::runtime_error);
+        ASSERT_THROW(expr::async_assign(flat, a*2.0), std::runtime_error);
+        ASSERT_THROW(expr::assignment(small, a + a), std::runtime_error);
+        ASSERT_DOUBLE_EQ((small[19, 9]), 0.0);
+}
+
+TEST(Async, WhenAllOrder)
+{
+        // Each step reads the result of the previous one, only the order given gives 2*(n + 1) - 1
+        MDArray<long, D2> a(D2(64, 64), 1), b(D2(64, 64), 0), c(D2(64, 64), 0);
+        for(long n = 0; n < 20; n++){
+                expr::when_all(expr::assignment(b, a*n),
+                               expr::assignment(c, a*(n + 5)),
+                               expr::assignment(b, b + a),
+                               expr::assignment(c, c - a),
+                               expr::assignment(b, b*2),
+                               expr::assignment(b, b - a)).get();
+                ASSERT_EQ((b[0, 0]), 2*(n + 1) - 1);
+                ASSERT_EQ((b[63, 63]), 2*(n + 1) - 1);
+                ASSERT_EQ((c[31, 17]), n + 4);
+        }
+
+}
+
+TEST(Async, WhenAllDependencies)
+{
+        MDArray<long, D2> a(D2(64, 64), 1), b(D2(64, 64), 0), c(D2(64, 64), 0);
+        stdex::mdspan<long, D2> view(b.data(), 64, 64);
+        for(long n = 0; n < 20; n++){
+                // c reads b after it is written, then b is overwritten after c has read it
+                expr::when_all(expr::assignment(b, a*n),
+                               expr::assignment(c, 2*b),
+                               expr::assignment(b, a + a)).get();
+                ASSERT_EQ((c[17, 40]), 2*n);
+                ASSERT_EQ((b[17, 40]), 2);
+
+                // The same elements written through a view of b
+                expr::when_all(expr::assignment(view, a*n),
+                               expr::assignment(c, b + a)).get();
+                ASSERT_EQ((c[63, 0]), n + 1);
+        }
+}
+
+TEST(Async, LvalueHeldByReference)
+{
+        MDArray<double, D2> a(D2(30, 30), 1.0), dest(D2(30, 30), 0.0);
+        // The assignment refers to a instead of copying it
+        auto copy = expr::assignment(dest, a);
+        a[3, 4] = 5.0;
+        expr::when_all(copy).get();
+        ASSERT_DOUBLE_EQ((dest[3, 4]), 5.0);
+        ASSERT_DOUBLE_EQ((dest[0, 0]), 1.0);
+}
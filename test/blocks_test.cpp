@@ -0,0 +1,54 @@
+#include <mdarray.h>
+#include <blocks.h>
+#include <gtest/gtest.h>
+
+TEST(Blocks, CoverExpression)
+{
+        using D2 = stdex::dextents<std::size_t, 2>;
+        MDArray<int, D2> a(D2(70, 45), 0);
+        for(std::size_t i = 0; i < 70; i++){
+                for(std::size_t j = 0; j < 45; j++){
+                        a[i, j] = static_cast<int>(100*i + j);
+                }
+        }
+        MDArray<int, D2> seen(D2(70, 45), 0);
+        std::size_t count = 0, i0 = 0, j0 = 0;
+        for(const auto& block : expr::blocks(a + a, D2(32, 16))){
+                // Blocks come in row major order, clipped at the edges
+                ASSERT_EQ(block.extent(0), (std::min<std::size_t>(32, 70 - i0)));
+                ASSERT_EQ(block.extent(1), (std::min<std::size_t>(16, 45 - j0)));
+                for(std::size_t i = 0; i < block.extent(0); i++){
+                        for(std::size_t j = 0; j < block.extent(1); j++){
+                                ASSERT_EQ((block[i, j]), (2*a[i0 + i, j0 + j]));
+                                seen[i0 + i, j0 + j]++;
+                        }
+                }
+                j0 += 16;
+                if(j0 >= 45){
+                        j0 = 0;
+                        i0 += 32;
+                }
+                count++;
+        }
+        ASSERT_EQ(count, 3*3);
+        ASSERT_EQ(expr::sum(seen), 70*45);
+        ASSERT_EQ(expr::min(seen), 1);
+}
+
+TEST(Blocks, StaticBlocks)
+{
+        using D3 = stdex::dextents<std::size_t, 3>;
+        MDArray<double, D3> a(D3(3, 10, 9), 0.5);
+        double total = 0;
+        std::size_t count = 0;
+        for(const auto& block : expr::blocks(a, stdex::extents<std::size_t, 1, 4, 9>{})){
+                for(std::size_t i = 0; i < block.extent(1); i++){
+                        for(std::size_t j = 0; j < block.extent(2); j++){
+                                total += block[0, i, j];
+                        }
+                }
+                count++;
+        }
+        ASSERT_EQ(count, 3*3);
+        ASSERT_DOUBLE_EQ(total, expr::sum(a));
+}
@@ -0,0 +1,72 @@
+// Compile time benchmark of long elementwise formulas. Build the
+// compile-time-check target to get the compiler's time report (-ftime-report),
+// run it for the nesting depth and symbol size of the expression types.
+#include <mdarray.h>
+#include <algorithm>
+#include <iostream>
+#include <typeinfo>
+#include <cstring>
+
+template<typename Expr>
+struct depth
+{
+    static constexpr std::size_t value = 1;
+};
+template<typename RHS, typename OP>
+struct depth<expr::ElementwiseUnaryOp<RHS, OP>>
+{
+    static constexpr std::size_t value = 1 + depth<std::remove_cvref_t<RHS>>::value;
+};
+template<typename LHS, typename RHS, typename OP>
+struct depth<expr::ElementwiseBinaryOp<LHS, RHS, OP>>
+{
+    static constexpr std::size_t value = 1 + std::max(depth<std::remove_cvref_t<LHS>>::value, depth<std::remove_cvref_t<RHS>>::value);
+};
+template<typename OP, typename... Exprs>
+struct depth<expr::ElementwiseNaryOp<OP, Exprs...>>
+{
+    static constexpr std::size_t value = 1 + std::max({depth<std::remove_cvref_t<Exprs>>::value...});
+};
+
+template<typename Expr>
+void report(const char* name, const Expr&)
+{
+    std::cout << name << ": depth " << depth<Expr>::value << ", type name " << std::strlen(typeid(Expr).name()) << " characters\n";
+}
+
+int main()
+{
+    using D2 = stdex::dextents<std::size_t, 2>;
+    MDArray<double, D2> a(D2(100, 100), 1), b(D2(100, 100), 2), c(D2(100, 100), 3), d(D2(100, 100), 4);
+
+    // Temporaries, folded into a single node
+    auto folded = (a + b)*(c - d) + (a*b - c/d)*(b + c) - (d - a)*(a + d)/(b*c + a) + 2.0*(a - b*c);
+    report("folded", folded);
+
+    // The same formula from named subexpressions, which are nested
+    auto ab = a + b;
+    auto cd = c - d;
+    auto t1 = ab*cd;
+    auto m1 = a*b;
+    auto m2 = c/d;
+    auto t2 = m1 - m2;
+    auto bc = b + c;
+    auto t3 = t2*bc;
+    auto da = d - a;
+    auto ad = a + d;
+    auto t4 = da*ad;
+    auto q1 = b*c;
+    auto q2 = q1 + a;
+    auto t5 = t4/q2;
+    auto r1 = b*c;
+    auto r2 = a - r1;
+    auto t6 = 2.0*r2;
+    auto s1 = t1 + t3;
+    auto s2 = s1 - t5;
+    auto nested = s2 + t6;
+    report("nested", nested);
+
+    MDArray<double, D2> r_folded = folded, r_nested = nested;
+    std::cout << "total difference " << expr::sum(expr::map(r_folded - r_nested, [](double v){ return v < 0 ? -v : v; })) << "\n";
+    return 0;
+}
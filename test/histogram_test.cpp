@@ -0,0 +1,170 @@
+#include <mdarray.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using D1 = stdex::dextents<std::size_t, 1>;
+using D2 = stdex::dextents<std::size_t, 2>;
+
+namespace
+{
+        MDArray<double, D1> normal(std::size_t n, unsigned seed)
+        {
+                std::mt19937_64 gen(seed);
+                std::normal_distribution<double> dist(0., 2.);
+                MDArray<double, D1> res(D1(n), 0.);
+                for(std::size_t i = 0; i < n; i++){
+                        res[i] = dist(gen);
+                }
+                return res;
+        }
+
+        // Bin of v between edges, as numpy.histogram, -1 outside
+        std::ptrdiff_t reference_bin(const std::vector<double>& edges, double v)
+        {
+                if(!(v >= edges.front() && v <= edges.back())){
+                        return -1;
+                }
+                if(v == edges.back()){
+                        return static_cast<std::ptrdiff_t>(edges.size()) - 2;
+                }
+                return std::upper_bound(edges.begin(), edges.end(), v) - edges.begin() - 1;
+        }
+}
+
+TEST(Histogram, Bincount)
+{
+        const std::size_t n = 1000003;
+        MDArray<int, D1> a(D1(n), 0);
+        for(std::size_t i = 0; i < n; i++){
+                a[i] = static_cast<int>((i*i)%23) - 3;
+        }
+        MDArray<std::size_t, D1> counts = expr::bincount(a, 17);
+        ASSERT_EQ(counts.extent(0), 17);
+        std::vector<std::size_t> ref(17, 0);
+        for(std::size_t i = 0; i < n; i++){
+                if(a[i] >= 0 && a[i] < 17){
+                        ref[static_cast<std::size_t>(a[i])]++;
+                }
+        }
+        for(std::size_t b = 0; b < 17; b++){
+                ASSERT_EQ(counts[b], ref[b]);
+                ASSERT_EQ(expr::bincount(a, 17)[b], ref[b]);
+        }
+        MDArray<unsigned char, D1> small(D1(4), 0);
+        small[1] = 255;
+        small[2] = 3;
+        MDArray<std::size_t, D1> small_counts = expr::bincount(small, 300);
+        ASSERT_EQ(small_counts[0], 2);
+        ASSERT_EQ(small_counts[3], 1);
+        ASSERT_EQ(small_counts[255], 1);
+        ASSERT_THROW(expr::bincount(a, 0), std::runtime_error);
+}
+
+TEST(Histogram, Uniform)
+{
+        const auto x = normal(1 << 20, 1);
+        MDArray<std::size_t, D1> counts = expr::histogram(x, 40, -5., 5.);
+        std::vector<std::size_t> ref(40, 0);
+        std::size_t inside = 0;
+        for(std::size_t i = 0; i < x.extent(0); i++){
+                if(x[i] >= -5. && x[i] <= 5.){
+                        ref[std::min<std::size_t>(39, static_cast<std::size_t>((x[i] + 5.)*4.))]++;
+                        inside++;
+                }
+        }
+        std::size_t total = 0;
+        for(std::size_t b = 0; b < 40; b++){
+                ASSERT_EQ(counts[b], ref[b]) << b;
+                total += counts[b];
+        }
+        ASSERT_EQ(total, inside);
+        ASSERT_THROW(expr::histogram(x, 10, 1., 1.), std::runtime_error);
+}
+
+TEST(Histogram, Edges)
+{
+        const auto x = normal(300001, 2);
+        MDArray<double, D1> uniform(D1(21), 0.);
+        MDArray<double, D1> skewed(D1(6), 0.);
+        for(std::size_t b = 0; b < 21; b++){
+                uniform[b] = -4. + 0.4*static_cast<double>(b);
+        }
+        const double skewed_edges[] = {-3., -1., 0., 0.1, 2., 6.};
+        for(std::size_t b = 0; b < 6; b++){
+                skewed[b] = skewed_edges[b];
+        }
+        for(const auto* edges : {&uniform, &skewed}){
+                std::vector<double> e(edges->data(), edges->data() + edges->extent(0));
+                MDArray<std::size_t, D1> counts = expr::histogram(x, *edges);
+                std::vector<std::size_t> ref(e.size() - 1, 0);
+                for(std::size_t i = 0; i < x.extent(0); i++){
+                        const auto b = reference_bin(e, x[i]);
+                        if(b >= 0){
+                                ref[static_cast<std::size_t>(b)]++;
+                        }
+                }
+                for(std::size_t b = 0; b + 1 < e.size(); b++){
+                        ASSERT_EQ(counts[b], ref[b]) << b;
+                }
+        }
+        // Elements exactly on the edges, the last edge in the last bin
+        MDArray<double, D1> on_edges = expr::cast<double>(uniform);
+        MDArray<std::size_t, D1> counts = expr::histogram(on_edges, uniform);
+        for(std::size_t b = 0; b < 20; b++){
+                ASSERT_EQ(counts[b], b == 19 ? 2 : 1) << b;
+        }
+        MDArray<double, D1> unordered(D1(3), 0.);
+        ASSERT_THROW(expr::histogram(x, unordered), std::runtime_error);
+}
+
+TEST(Histogram, Expressions)
+{
+        // Non flat (column major) arrays and temporaries, NaNs not counted
+        const std::size_t n = 300, m = 500;
+        MDArray<double, D2, stdex::layout_left> a(D2(n, m), 0.);
+        for(std::size_t i = 0; i < n; i++){
+                for(std::size_t j = 0; j < m; j++){
+                        a[i, j] = static_cast<double>((i*7 + j*3)%10);
+                }
+        }
+        a[3, 4] = std::numeric_limits<double>::quiet_NaN();
+        MDArray<std::size_t, D1> counts = expr::histogram(a, 10, 0., 10.);
+        MDArray<std::size_t, D1> doubled = expr::histogram(2.*a, 10, 0., 20.);
+        std::vector<std::size_t> ref(10, 0);
+        for(std::size_t i = 0; i < n; i++){
+                for(std::size_t j = 0; j < m; j++){
+                        if(!std::isnan(a[i, j])){
+                                ref[static_cast<std::size_t>(a[i, j])]++;
+                        }
+                }
+        }
+        for(std::size_t b = 0; b < 10; b++){
+                ASSERT_EQ(counts[b], ref[b]);
+                ASSERT_EQ(doubled[b], ref[b]);
+        }
+}
+
+TEST(Histogram, Empty)
+{
+        MDArray<double, D1> empty(D1(0), 0.);
+        MDArray<int, D1> no_ints(D1(0), 0);
+        MDArray<double, D2, stdex::layout_left> no_rows(D2(0, 7), 0.);
+        MDArray<std::size_t, D1> counts = expr::histogram(empty, 10, 0., 1.);
+        MDArray<std::size_t, D1> int_counts = expr::bincount(no_ints, 5);
+        MDArray<std::size_t, D1> column_counts = expr::histogram(no_rows, 4, 0., 1.);
+        ASSERT_EQ(counts.extent(0), 10);
+        for(std::size_t b = 0; b < 10; b++){
+                ASSERT_EQ(counts[b], 0);
+                ASSERT_EQ(expr::histogram(empty, 10, 0., 1.)[b], 0);
+        }
+        for(std::size_t b = 0; b < 5; b++){
+                ASSERT_EQ(int_counts[b], 0);
+        }
+        for(std::size_t b = 0; b < 4; b++){
+                ASSERT_EQ(column_counts[b], 0);
+        }
+}
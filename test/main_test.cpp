@@ -1,7 +1,11 @@
 #include <gtest/gtest.h>
+#include <cstdlib>
 
 int main(int argc, char **argv)
 {
+	// Several threads even on a single core, so that the parallel kernels
+	// (e.g. the block scan) are tested, unless EXPR_NUM_THREADS is set
+	setenv("EXPR_NUM_THREADS", "4", 0);
 	testing::InitGoogleTest(&argc, argv);
 	return RUN_ALL_TESTS();
 }
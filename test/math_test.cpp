@@ -0,0 +1,189 @@
+#include <mdarray.h>
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <random>
+
+using D1 = stdex::dextents<std::size_t, 1>;
+
+namespace
+{
+        // Distance from val to ref in units in the last place of ref
+        double ulps(double val, double ref)
+        {
+                if(std::isnan(ref) || std::isinf(ref)){
+                        return (std::isnan(val) == std::isnan(ref)) && (std::isnan(ref) || val == ref) ? 0. : std::numeric_limits<double>::infinity();
+                }
+                const double ulp = std::nextafter(std::abs(ref), std::numeric_limits<double>::infinity()) - std::abs(ref);
+                return std::abs(val - ref)/ulp;
+        }
+
+        MDArray<double, D1> uniform(std::size_t n, double lo, double hi, unsigned seed)
+        {
+                std::mt19937_64 gen(seed);
+                std::uniform_real_distribution<double> dist(lo, hi);
+                MDArray<double, D1> res(D1(n), 0.);
+                for(std::size_t i = 0; i < n; i++){
+                        res[i] = dist(gen);
+                }
+                return res;
+        }
+
+        // Largest error of res against f applied to each element of x
+        template<typename F>
+        double max_ulps(const MDArray<double, D1>& res, const MDArray<double, D1>& x, F f)
+        {
+                double worst = 0.;
+                for(std::size_t i = 0; i < x.extent(0); i++){
+                        worst = std::max(worst, ulps(res[i], f(x[i])));
+                }
+                return worst;
+        }
+}
+
+TEST(Math, Exp)
+{
+        for(auto [lo, hi] : {std::pair{-1., 1.}, {-745., 709.7}, {-1e-8, 1e-8}}){
+                const auto x = uniform(100000, lo, hi, 1);
+                MDArray<double, D1> res = expr::exp(x);
+                ASSERT_LE(max_ulps(res, x, [](double v){ return std::exp(v); }), 1.);
+        }
+}
+
+TEST(Math, Log)
+{
+        for(auto [lo, hi] : {std::pair{0.5, 2.}, {0., 1e300}, {1e-310, 1e-300}}){
+                const auto x = uniform(100000, lo, hi, 2);
+                MDArray<double, D1> res = expr::log(x);
+                ASSERT_LE(max_ulps(res, x, [](double v){ return std::log(v); }), 1.);
+        }
+}
+
+TEST(Math, SinCos)
+{
+        for(auto [lo, hi] : {std::pair{-4., 4.}, {-1e5, 1e5}, {1e6, 1e7}}){
+                const auto x = uniform(100000, lo, hi, 3);
+                MDArray<double, D1> s = expr::sin(x);
+                MDArray<double, D1> c = expr::cos(x);
+                ASSERT_LE(max_ulps(s, x, [](double v){ return std::sin(v); }), 1.);
+                ASSERT_LE(max_ulps(c, x, [](double v){ return std::cos(v); }), 1.);
+        }
+}
+
+TEST(Math, Tanh)
+{
+        for(auto [lo, hi] : {std::pair{-1., 1.}, {-25., 25.}, {-1e-6, 1e-6}}){
+                const auto x = uniform(100000, lo, hi, 4);
+                MDArray<double, D1> res = expr::tanh(x);
+                ASSERT_LE(max_ulps(res, x, [](double v){ return std::tanh(v); }), 2.);
+        }
+}
+
+TEST(Math, Erf)
+{
+        for(auto [lo, hi] : {std::pair{-2., 2.}, {-7., 7.}, {-1e-6, 1e-6}}){
+                const auto x = uniform(100000, lo, hi, 5);
+                MDArray<double, D1> res = expr::erf(x);
+                ASSERT_LE(max_ulps(res, x, [](double v){ return std::erf(v); }), 8.);
+        }
+}
+
+TEST(Math, Pow)
+{
+        const auto x = uniform(100000, 0., 100., 6);
+        const auto y = uniform(100000, -150., 150., 7);
+        MDArray<double, D1> res = expr::pow(x, y);
+        double worst = 0.;
+        for(std::size_t i = 0; i < x.extent(0); i++){
+                worst = std::max(worst, ulps(res[i], std::pow(x[i], y[i])));
+        }
+        ASSERT_LE(worst, 2.);
+        MDArray<double, D1> cube = expr::pow(x, 3);
+        ASSERT_LE(max_ulps(cube, x, [](double v){ return std::pow(v, 3); }), 2.);
+
+        // Large |y| multiply the error of log x, results up to e^(+-700)
+        const auto near_one = uniform(200000, 0.6, 1.5, 8);
+        auto large = uniform(200000, -1., 1., 9);
+        for(std::size_t i = 0; i < near_one.extent(0); i++){
+                large[i] *= std::min(700./std::abs(std::log(near_one[i])), 1e8);
+        }
+        large[0] = 691.30887958690391;
+        MDArray<double, D1> base = near_one;
+        base[0] = 1.4203392075960179;
+        MDArray<double, D1> large_res = expr::pow(base, large);
+        worst = 0.;
+        for(std::size_t i = 0; i < base.extent(0); i++){
+                worst = std::max(worst, ulps(large_res[i], std::pow(base[i], large[i])));
+        }
+        ASSERT_LE(worst, 2.);
+}
+
+TEST(Math, SpecialValues)
+{
+        constexpr double inf = std::numeric_limits<double>::infinity();
+        constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+        const double max = std::numeric_limits<double>::max();
+        const double denorm = std::numeric_limits<double>::denorm_min();
+        MDArray<double, D1> x(D1(13), 0.);
+        const double vals[] = {0., -0., 1., -1., inf, -inf, nan, 710., -746., max, denorm, -2., 0.5};
+        for(std::size_t i = 0; i < 13; i++){
+                x[i] = vals[i];
+        }
+        MDArray<double, D1> e = expr::exp(x);
+        MDArray<double, D1> l = expr::log(x);
+        MDArray<double, D1> s = expr::sin(x);
+        MDArray<double, D1> c = expr::cos(x);
+        MDArray<double, D1> t = expr::tanh(x);
+        MDArray<double, D1> f = expr::erf(x);
+        MDArray<double, D1> r = expr::sqrt(x);
+        for(std::size_t i = 0; i < 13; i++){
+                ASSERT_LE(ulps(e[i], std::exp(x[i])), 1.) << x[i];
+                ASSERT_LE(ulps(l[i], std::log(x[i])), 1.) << x[i];
+                ASSERT_LE(ulps(s[i], std::sin(x[i])), 1.) << x[i];
+                ASSERT_LE(ulps(c[i], std::cos(x[i])), 1.) << x[i];
+                ASSERT_LE(ulps(t[i], std::tanh(x[i])), 2.) << x[i];
+                ASSERT_LE(ulps(f[i], std::erf(x[i])), 8.) << x[i];
+                ASSERT_LE(ulps(r[i], std::sqrt(x[i])), 0.) << x[i];
+                for(std::size_t j = 0; j < 13; j++){
+                        MDArray<double, D1> p = expr::pow(x, x[j]);
+                        ASSERT_LE(ulps(p[i], std::pow(x[i], x[j])), 2.) << x[i] << "^" << x[j];
+                }
+        }
+        ASSERT_TRUE(std::signbit((MDArray<double, D1>(expr::tanh(x))[1])));
+        ASSERT_TRUE(std::signbit((MDArray<double, D1>(expr::pow(x, 3.))[1])));
+}
+
+TEST(Math, ElementTypes)
+{
+        const auto x = uniform(1000, -3., 3., 8);
+        MDArray<float, D1> xf = expr::cast<float>(x);
+        MDArray<expr::half, D1> xh = expr::cast<expr::half>(x);
+        MDArray<int, D1> xi = expr::cast<int>(x);
+        auto ef = expr::exp(xf);
+        auto eh = expr::tanh(xh);
+        auto ei = expr::erf(xi);
+        static_assert(std::is_same_v<decltype(ef)::value_type, float>);
+        static_assert(std::is_same_v<decltype(eh)::value_type, float>);
+        static_assert(std::is_same_v<decltype(ei)::value_type, double>);
+        static_assert(std::is_same_v<decltype(expr::pow(xf, 2))::value_type, float>);
+        for(std::size_t i = 0; i < 1000; i++){
+                ASSERT_LE(std::abs(ef[i] - std::exp(xf[i])), std::abs(std::nextafter(std::exp(xf[i]), 0.f) - std::exp(xf[i])));
+                ASSERT_FLOAT_EQ(eh[i], std::tanh(static_cast<float>(xh[i])));
+                ASSERT_DOUBLE_EQ(ei[i], std::erf(xi[i]));
+        }
+}
+
+TEST(Math, Fold)
+{
+        const auto x = uniform(1000, -3., 3., 9);
+        const auto y = uniform(1000, -3., 3., 10);
+        // exp of a temporary product is folded into one node with both leaves
+        auto e = expr::exp(x*y);
+        static_assert(std::tuple_size_v<decltype(std::move(e).release())> == 3);
+        MDArray<double, D1> gauss = expr::exp(-0.5*x*x);
+        MDArray<double, D1> act = expr::tanh(x*y + x);
+        for(std::size_t i = 0; i < 1000; i++){
+                ASSERT_DOUBLE_EQ(gauss[i], std::exp(-0.5*x[i]*x[i]));
+                ASSERT_NEAR(act[i], std::tanh(x[i]*y[i] + x[i]), 1e-15);
+        }
+}
@@ -284,3 +284,233 @@ TEST(Matmul, RunTimeRunTimeExtentsMatMul4122)
         ASSERT_EQ((mm[0, 0, 1, 0]), 1);
         ASSERT_EQ((mm[0, 0, 1, 1]), 0);
 }
+
+template<typename LHS, typename RHS, typename Res>
+static void check_matmul_3(const LHS& m1, const RHS& m2, const Res& res)
+{
+        for(size_t b = 0; b < res.extent(0); b++){
+                for(size_t i = 0; i < res.extent(1); i++){
+                        for(size_t j = 0; j < res.extent(2); j++){
+                                double ref = 0;
+                                for(size_t k = 0; k < m1.extent(2); k++){
+                                        ref += m1[b, i, k]*m2[b, k, j];
+                                }
+                                ASSERT_DOUBLE_EQ((res[b, i, j]), ref);
+                        }
+                }
+        }
+}
+
+template<typename T>
+static void fill_3(T& m)
+{
+        for(size_t b = 0; b < m.extent(0); b++){
+                for(size_t i = 0; i < m.extent(1); i++){
+                        for(size_t j = 0; j < m.extent(2); j++){
+                                m[b, i, j] = static_cast<double>((b + 3*i + 7*j) % 11) - 5;
+                        }
+                }
+        }
+}
+
+TEST(Matmul, EvaluateMatMul22)
+{
+        using D2 = stdex::dextents<std::size_t, 2>;
+        MDArray<int, D2> m1(D2(300, 70), 0);
+        MDArray<int, D2> m2(D2(70, 600), 0);
+        for(size_t i = 0; i < 300; i++){
+                for(size_t j = 0; j < 70; j++){
+                        m1[i, j] = static_cast<int>((i*j) % 7) - 3;
+                        m2[j, 2*i] = static_cast<int>((i + j) % 5);
+                }
+        }
+        auto mm = expr::matmul(m1, m2);
+        MDArray<int, D2> res = mm;
+        ASSERT_EQ(res.extent(0), 300);
+        ASSERT_EQ(res.extent(1), 600);
+        for(size_t i = 0; i < 300; i += 7){
+                for(size_t j = 0; j < 600; j += 3){
+                        ASSERT_EQ((res[i, j]), (mm[i, j]));
+                }
+        }
+}
+
+TEST(Matmul, EvaluateManyBatches)
+{
+        using D3 = stdex::dextents<std::size_t, 3>;
+        MDArray<double, D3> m1(D3(40, 9, 5), 0), m2(D3(40, 5, 7), 0);
+        fill_3(m1);
+        fill_3(m2);
+        MDArray<double, D3> res = expr::matmul(m1, m2);
+        check_matmul_3(m1, m2, res);
+}
+
+TEST(Matmul, EvaluateFewLargeBatches)
+{
+        using D3 = stdex::dextents<std::size_t, 3>;
+        MDArray<double, D3> m1(D3(2, 130, 300), 0), m2(D3(2, 300, 70), 0);
+        fill_3(m1);
+        fill_3(m2);
+        MDArray<double, D3> res = expr::matmul(m1, m2);
+        check_matmul_3(m1, m2, res);
+}
+
+TEST(Matmul, EvaluateMixedTypes)
+{
+        using C3L = stdex::extents<std::size_t, 3, 4, 6>;
+        using C3R = stdex::extents<std::size_t, 3, 6, 2>;
+        MDArray<int, C3L> m1(C3L(), 0);
+        MDArray<double, C3R> m2(C3R(), 0);
+        fill_3(m2);
+        for(size_t b = 0; b < 3; b++){
+                for(size_t i = 0; i < 4; i++){
+                        for(size_t j = 0; j < 6; j++){
+                                m1[b, i, j] = static_cast<int>(b*i + j);
+                        }
+                }
+        }
+        MDArray<double, stdex::dextents<std::size_t, 3>> res = expr::matmul(m1, m2);
+        check_matmul_3(m1, m2, res);
+}
+
+TEST(Matmul, ChainOrder)
+{
+        // (10x100)(100x5)(5x50): (AB)C costs 7500, A(BC) costs 75000
+        constexpr auto split3 = expr::detail::matrix_chain_order<3>({10, 100, 5, 50});
+        static_assert(split3[0][2] == 1);
+        auto split4 = expr::detail::matrix_chain_order<4>({40, 20, 30, 10, 30});
+        ASSERT_EQ(split4[0][3], 2);
+        ASSERT_EQ(split4[0][2], 0);
+}
+
+TEST(Matmul, EvaluateChain)
+{
+        using D2 = stdex::dextents<std::size_t, 2>;
+        MDArray<double, D2> a(D2(50, 3), 0), b(D2(3, 40), 0), c(D2(40, 2), 0), d(D2(2, 30), 0);
+        for(auto* m : {&a, &b, &c, &d}){
+                for(size_t i = 0; i < m->extent(0); i++){
+                        for(size_t j = 0; j < m->extent(1); j++){
+                                (*m)[i, j] = static_cast<double>((3*i + 5*j) % 7) - 3;
+                        }
+                }
+        }
+        static_assert(expr::detail::chain_length<decltype(expr::matmul(expr::matmul(a, b), expr::matmul(c, d)))>() == 4);
+        MDArray<double, D2> ab = expr::matmul(a, b);
+        MDArray<double, D2> abc = expr::matmul(ab, c);
+        MDArray<double, D2> ref = expr::matmul(abc, d);
+        MDArray<double, D2> res = expr::matmul(expr::matmul(a, b), expr::matmul(c, d));
+        MDArray<double, D2> res2 = expr::matmul(a, expr::matmul(b, expr::matmul(c, d)));
+        ASSERT_EQ(res.extent(0), 50);
+        ASSERT_EQ(res.extent(1), 30);
+        for(size_t i = 0; i < 50; i++){
+                for(size_t j = 0; j < 30; j++){
+                        ASSERT_DOUBLE_EQ((res[i, j]), (ref[i, j]));
+                        ASSERT_DOUBLE_EQ((res2[i, j]), (ref[i, j]));
+                }
+        }
+}
+
+TEST(Matmul, EvaluateStaticBatchedChain)
+{
+        using E1 = stdex::extents<std::size_t, 2, 4, 6>;
+        using E2 = stdex::extents<std::size_t, 2, 6, 3>;
+        using E3 = stdex::extents<std::size_t, 2, 3, 5>;
+        MDArray<double, E1> m1(E1(), 0);
+        MDArray<double, E2> m2(E2(), 0);
+        MDArray<double, E3> m3(E3(), 0);
+        fill_3(m1);
+        fill_3(m2);
+        fill_3(m3);
+        MDArray<double, stdex::dextents<std::size_t, 3>> m12 = expr::matmul(m1, m2);
+        MDArray<double, stdex::dextents<std::size_t, 3>> res = expr::matmul(expr::matmul(m1, m2), m3);
+        check_matmul_3(m12, m3, res);
+}
+
+TEST(Matmul, SmallStatic)
+{
+        Matrix<double, 3, 3> a(0), b(0);
+        Matrix<double, 3, 4> c(0);
+        for(size_t i = 0; i < 3; i++){
+                for(size_t j = 0; j < 3; j++){
+                        a[i, j] = static_cast<double>(i + 2*j);
+                        b[i, j] = static_cast<double>(3*i) - static_cast<double>(j);
+                }
+                for(size_t j = 0; j < 4; j++){
+                        c[i, j] = static_cast<double>(i*j) + 1;
+                }
+        }
+        Matrix<double, 3, 4> res = expr::matmul(expr::matmul(a, b), c);
+        for(size_t i = 0; i < 3; i++){
+                for(size_t j = 0; j < 4; j++){
+                        double ref = 0;
+                        for(size_t k = 0; k < 3; k++){
+                                for(size_t l = 0; l < 3; l++){
+                                        ref += a[i, l]*b[l, k]*c[k, j];
+                                }
+                        }
+                        ASSERT_DOUBLE_EQ((res[i, j]), ref);
+                }
+        }
+}
+
+TEST(Matmul, SmallStaticBatched)
+{
+        using E1 = stdex::extents<std::size_t, 5, 4, 4>;
+        MDArray<double, E1> m1(E1(), 0), m2(E1(), 0);
+        fill_3(m1);
+        fill_3(m2);
+        MDArray<double, E1> res = expr::matmul(m1, m2);
+        check_matmul_3(m1, m2, res);
+}
+
+TEST(Matmul, EvaluateTransposed)
+{
+        using D2 = stdex::dextents<std::size_t, 2>;
+        MDArray<double, D2> a(D2(70, 45), 0), b(D2(70, 45), 0);
+        for(size_t i = 0; i < 70; i++){
+                for(size_t j = 0; j < 45; j++){
+                        a[i, j] = static_cast<double>((2*i + 5*j) % 9) - 4;
+                        b[i, j] = static_cast<double>((i + 3*j) % 7) - 3;
+                }
+        }
+        static_assert(expr::detail::is_matrix_transpose<decltype(expr::transpose(a))>::value);
+        MDArray<double, D2> a_t = expr::transpose(a), b_t = expr::transpose(b);
+        MDArray<double, D2> tn = expr::matmul(expr::transpose(a), b);
+        MDArray<double, D2> nt = expr::matmul(a, expr::transpose(b));
+        MDArray<double, D2> tt = expr::matmul(expr::transpose(a), expr::transpose(a_t));
+        MDArray<double, D2> tn_ref = expr::matmul(a_t, b), nt_ref = expr::matmul(a, b_t), tt_ref = expr::matmul(a_t, a);
+        ASSERT_EQ(tn.extent(0), 45);
+        ASSERT_EQ(nt.extent(0), 70);
+        for(size_t i = 0; i < 45; i++){
+                for(size_t j = 0; j < 45; j++){
+                        ASSERT_DOUBLE_EQ((tn[i, j]), (tn_ref[i, j]));
+                }
+        }
+        for(size_t i = 0; i < 70; i++){
+                for(size_t j = 0; j < 70; j++){
+                        ASSERT_DOUBLE_EQ((nt[i, j]), (nt_ref[i, j]));
+                }
+        }
+        for(size_t i = 0; i < 45; i++){
+                for(size_t j = 0; j < 45; j++){
+                        ASSERT_DOUBLE_EQ((tt[i, j]), (tt_ref[i, j]));
+                }
+        }
+}
+
+TEST(Matmul, EvaluateBatchedTransposed)
+{
+        using D3 = stdex::dextents<std::size_t, 3>;
+        MDArray<double, D3> m1(D3(3, 40, 9), 0), m2(D3(3, 40, 7), 0);
+        fill_3(m1);
+        fill_3(m2);
+        auto m1_t = expr::transpose(m1, std::index_sequence<0, 2, 1>{});
+        static_assert(expr::detail::is_matrix_transpose<decltype(m1_t)>::value);
+        static_assert(!expr::detail::is_matrix_transpose<decltype(expr::transpose(m1))>::value);
+        MDArray<double, D3> m1_t_eval = m1_t;
+        MDArray<double, D3> res = expr::matmul(m1_t, m2);
+        MDArray<double, D3> chain = expr::matmul(expr::matmul(m1_t, m2), expr::transpose(m2, std::index_sequence<0, 2, 1>{}));
+        check_matmul_3(m1_t_eval, m2, res);
+        MDArray<double, D3> m2_t = expr::transpose(m2, std::index_sequence<0, 2, 1>{});
+        check_matmul_3(res, m2_t, chain);
+}
@@ -311,3 +311,79 @@ TEST(Matrix, Cast)
         }
     }
 }
+
+TEST(Matrix, InlineStorage)
+{
+    static_assert(expr::detail::is_inline_storage<Matrix<double, 4, 4>::storage_type>);
+    static_assert(!expr::detail::is_inline_storage<Matrix<double, 64, 64>::storage_type>);
+    Matrix<double, 4, 4> m(2.0);
+    Matrix<double, 4, 4> copy = m;
+    copy[3, 3] = 1.0;
+    Matrix<double, 4, 4> res = m*copy;
+    ASSERT_DOUBLE_EQ((res[0, 0]), 4.0);
+    ASSERT_DOUBLE_EQ((res[3, 3]), 2.0);
+}
+
+constexpr Matrix<int, 3, 3> rotation()
+{
+    Matrix<int, 3, 3> r;
+    r[0, 1] = -1;
+    r[1, 0] = 1;
+    r[2, 2] = 1;
+    return r;
+}
+
+TEST(Matrix, Constexpr)
+{
+    constexpr Matrix<int, 3, 3> r = rotation();
+    constexpr Matrix<int, 3, 3> scaled = 2*r + r;
+    static_assert(scaled[0, 1] == -3);
+    static_assert(scaled[2, 2] == 3);
+    constexpr Matrix<int, 3, 3> r2 = expr::matmul(r, r);
+    static_assert(r2[0, 0] == -1 && r2[1, 1] == -1 && r2[2, 2] == 1);
+    constexpr Matrix<int, 3, 3> rt = expr::transpose(r);
+    static_assert(rt[1, 0] == -1);
+    constexpr int total = expr::sum(r2);
+    static_assert(total == -1);
+    ASSERT_EQ((scaled[1, 0]), 3);
+}
+
+TEST(Matrix, Simplify)
+{
+    Matrix<double, 2, 3> a, b, c;
+    for(std::size_t i = 0; i < a.rows; i++){
+        for(std::size_t j = 0; j < a.cols; j++){
+            a[i, j] = v1<double>(i, j);
+            b[i, j] = v2<double>(i, j);
+            c[i, j] = 0.5;
+        }
+    }
+    // -(-a) stays a view of a, -(-(a + b)) is a + b
+    auto v = -(-a);
+    static_assert(!std::is_reference_v<decltype(-(-a))> && expr::detail::is_negated<decltype(v)>::value);
+    auto n = -(-(a + b));
+    static_assert(expr::detail::is_elementwise_node<decltype(n)>::value && !expr::detail::is_negated<decltype(n)>::value);
+
+    // Scalars are multiplied once
+    auto s = 2.0*(3.0*a);
+    static_assert(std::is_same_v<decltype(s), expr::ElementwiseUnaryOp<Matrix<double, 2, 3>&, expr::detail::scalar_multiplier<double>>>);
+    auto s2 = (a*2.0)*0.25;
+    static_assert(std::is_same_v<decltype(s2), decltype(s)>);
+
+    // a*b + c is fused
+    auto f = a*b + c;
+    auto g = c + a*b;
+    static_assert(std::is_same_v<decltype(f), expr::ElementwiseNaryOp<expr::detail::fused_multiply_add, Matrix<double, 2, 3>&, Matrix<double, 2, 3>&, Matrix<double, 2, 3>&>>);
+    static_assert(std::is_same_v<decltype(f), decltype(g)>);
+    for(std::size_t i = 0; i < a.rows; i++){
+        for(std::size_t j = 0; j < a.cols; j++){
+            ASSERT_DOUBLE_EQ((n[i, j]), (a[i, j] + b[i, j]));
+            ASSERT_DOUBLE_EQ((s[i, j]), (6*a[i, j]));
+            ASSERT_DOUBLE_EQ((s2[i, j]), (0.5*a[i, j]));
+            ASSERT_DOUBLE_EQ((f[i, j]), (a[i, j]*b[i, j] + 0.5));
+            ASSERT_DOUBLE_EQ((g[i, j]), (a[i, j]*b[i, j] + 0.5));
+        }
+    }
+    a[1, 2] = 42.0;
+    ASSERT_DOUBLE_EQ((v[1, 2]), 42.0);
+}
@@ -1,4 +1,7 @@
 #include <mdarray.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <gtest/gtest.h>
 TEST(MDArray, TestAccess)
 {
@@ -108,3 +111,280 @@ TEST(MDArray, TestAddMul)
         }
     }
 }
+
+TEST(MDArray, InlineStorage)
+{
+    using S2 = stdex::extents<std::size_t, 3, 3>;
+    using D2 = stdex::dextents<std::size_t, 2>;
+    static_assert(expr::detail::is_inline_storage<MDArray<double, S2>::storage_type>);
+    static_assert(!expr::detail::is_inline_storage<MDArray<double, D2>::storage_type>);
+    static_assert(!expr::detail::is_inline_storage<MDArray<double, stdex::extents<std::size_t, 100, 100>>::storage_type>);
+    static_assert(sizeof(MDArray<double, S2>) >= 9*sizeof(double));
+
+    MDArray<double, S2> m(S2(), 1.5);
+    MDArray<double, S2> res = m + m;
+    ASSERT_DOUBLE_EQ((res[2, 1]), 3.0);
+}
+
+TEST(MDArray, CopyIsIndependent)
+{
+    using D2 = stdex::dextents<std::size_t, 2>;
+    using S2 = stdex::extents<std::size_t, 2, 2>;
+    MDArray<int, D2> m(D2(2, 2), 1);
+    MDArray<int, D2> c(m);
+    c[0, 1] = 5;
+    ASSERT_EQ((m[0, 1]), 1);
+    ASSERT_EQ((c[0, 1]), 5);
+
+    MDArray<int, S2> s(S2(), 1);
+    MDArray<int, S2> moved(std::move(s));
+    MDArray<int, S2> copy(moved);
+    copy[1, 1] = 3;
+    ASSERT_EQ((moved[1, 1]), 1);
+    ASSERT_EQ((copy[1, 1]), 3);
+}
+
+TEST(MDArray, Constexpr)
+{
+    using S1 = stdex::extents<std::size_t, 8>;
+    constexpr MDArray<int, S1> table = []{
+        MDArray<int, S1> squares(S1{});
+        for(std::size_t i = 0; i < 8; i++){
+            squares[i] = static_cast<int>(i*i);
+        }
+        return MDArray<int, S1>(squares + squares);
+    }();
+    static_assert(table[3] == 18);
+    static_assert(expr::max(table) == 98);
+    ASSERT_EQ(table[7], 98);
+}
+
+TEST(MDArray, KernelExceptions)
+{
+    using D1 = stdex::dextents<std::size_t, 1>;
+    MDArray<long, D1> a(D1(100000), 1);
+    static_assert(noexcept(MDArray<long, D1>(a + a)));
+    static_assert(!noexcept(MDArray<long, D1>(expr::inclusive_scan(a))));
+    // Exceptions thrown by a dedicated kernel reach the caller
+    auto failing = [](long x, long y){
+        if(x > 50000){
+            throw std::runtime_error("failing scan");
+        }
+        return x + y;
+    };
+    ASSERT_THROW((MDArray<long, D1>(expr::inclusive_scan(a, failing))), std::runtime_error);
+}
+
+TEST(MDArray, ColumnMajor)
+{
+    using D2 = stdex::dextents<std::size_t, 2>;
+    using Left = MDArray<int, D2, stdex::layout_left>;
+    MDArray<int, D2> r(D2(3, 4), 0);
+    for(std::size_t i = 0; i < 3; i++){
+        for(std::size_t j = 0; j < 4; j++){
+            r[i, j] = static_cast<int>(10*i + j);
+        }
+    }
+    Left l = r + r;
+    static_assert(std::is_same_v<exts::layout_of_t<decltype(l + l)>, stdex::layout_left>);
+    static_assert(std::is_same_v<exts::layout_of_t<decltype(expr::transpose(r))>, stdex::layout_left>);
+    static_assert(!exts::has_flat_access<Left>);
+    for(std::size_t i = 0; i < 3; i++){
+        for(std::size_t j = 0; j < 4; j++){
+            ASSERT_EQ((l[i, j]), (2*r[i, j]));
+            ASSERT_EQ(l.data()[j*3 + i], (2*r[i, j]));
+        }
+    }
+    // The transpose of a row major array has the same memory order as the column major one
+    MDArray<int, D2, stdex::layout_left> t = expr::transpose(r);
+    for(std::size_t n = 0; n < 12; n++){
+        ASSERT_EQ(t.data()[n], r.data()[n]);
+    }
+    MDArray<int, D2> back = l;
+    ASSERT_EQ((back[2, 3]), 46);
+    ASSERT_EQ(expr::sum(l), 2*expr::sum(r));
+}
+
+TEST(MDArray, ColumnMajorTraversal)
+{
+    using D3 = stdex::dextents<std::size_t, 3>;
+    std::vector<std::size_t> left, right;
+    const D3 ext(2, 3, 4);
+    exts::for_each_index_ordered<stdex::layout_left>(ext, [&](std::size_t i, std::size_t j, std::size_t k){
+        left.push_back(i + 2*j + 6*k);
+    });
+    exts::for_each_index_ordered<stdex::layout_right>(ext, [&](std::size_t i, std::size_t j, std::size_t k){
+        right.push_back(12*i + 4*j + k);
+    });
+    ASSERT_EQ(left.size(), 24);
+    for(std::size_t n = 0; n < 24; n++){
+        ASSERT_EQ(left[n], n);
+        ASSERT_EQ(right[n], n);
+    }
+}
+
+TEST(MDArray, Strided)
+{
+    using D2 = stdex::dextents<std::size_t, 2>;
+    using Mapping = stdex::layout_stride::mapping<D2>;
+    // 3x2 array with a padded leading dimension of 4
+    MDArray<double, D2, stdex::layout_stride> s(Mapping(D2(3, 2), std::array<std::size_t, 2>{4, 1}), 0.0);
+    for(std::size_t i = 0; i < 3; i++){
+        for(std::size_t j = 0; j < 2; j++){
+            s[i, j] = static_cast<double>(i + 2*j);
+        }
+    }
+    ASSERT_DOUBLE_EQ(s.data()[9], 4.0);
+    MDArray<double, D2> dense = s*2.0;
+    ASSERT_DOUBLE_EQ((dense[2, 1]), 8.0);
+    ASSERT_DOUBLE_EQ(expr::sum(s), 12.0);
+}
+
+TEST(MDArray, LargeArrayPolicy)
+{
+    using D2 = stdex::dextents<std::size_t, 2>;
+    // Restores the process wide policy for the following tests, also when an assertion fails
+    struct RestorePolicy
+    {
+        expr::MemoryPolicy saved = expr::memory_policy();
+        ~RestorePolicy() {expr::memory_policy() = saved;}
+    } restore;
+    expr::memory_policy().large_array_bytes = 4096;
+    for(auto pages : {expr::huge_pages::none, expr::huge_pages::transparent, expr::huge_pages::explicit_pages}){
+        for(bool interleave : {false, true}){
+            expr::memory_policy().pages = pages;
+            expr::memory_policy().interleave = interleave;
+            MDArray<double, D2> m(D2(300, 70), 1.5);
+            ASSERT_EQ(reinterpret_cast<std::uintptr_t>(m.data()) % alignof(double), 0u);
+            MDArray<double, D2> copy(m);
+            copy[299, 69] = 2.0;
+            MDArray<double, D2> res = m + copy;
+            ASSERT_DOUBLE_EQ((m[299, 69]), 1.5);
+            ASSERT_DOUBLE_EQ((res[0, 0]), 3.0);
+            ASSERT_DOUBLE_EQ((res[299, 69]), 3.5);
+            MDArray<double, D2> moved(std::move(copy));
+            ASSERT_DOUBLE_EQ((moved[299, 69]), 2.0);
+        }
+    }
+}
+
+TEST(MDArray, ZipN)
+{
+    using D2 = stdex::dextents<std::size_t, 2>;
+    MDArray<double, D2> a(D2(3, 4), 2), b(D2(3, 4), 3), c(D2(3, 4), 0.5), d(D2(4, 3), 1);
+    MDArray<double, D2> res = expr::zip_n([](double x, double y, double z){ return std::fma(x, y, z); }, a, b, c);
+    ASSERT_DOUBLE_EQ(expr::sum(res), 12*6.5);
+    ASSERT_THROW(expr::zip_n(std::plus<>(), a, d), std::runtime_error);
+}
+
+TEST(MDArray, FoldedFormula)
+{
+    using D2 = stdex::dextents<std::size_t, 2>;
+    MDArray<double, D2> m1(D2(2, 3), 1), m2(D2(2, 3), 2), m3(D2(2, 3), 4);
+    m1[1, 2] = 3;
+    // All leaves become operands of a single node
+    auto e = (m1 - m2*(m3 + m1))/m3 + 2.0*m1;
+    static_assert(std::tuple_size_v<decltype(std::move(e).release())> == 7);
+    MDArray<double, D2> res = (m1 - m2*(m3 + m1))/m3 + 2.0*m1;
+    for(std::size_t i = 0; i < 2; i++){
+        for(std::size_t j = 0; j < 3; j++){
+            ASSERT_DOUBLE_EQ((res[i, j]), ((m1[i, j] - m2[i, j]*(m3[i, j] + m1[i, j]))/m3[i, j] + 2.0*m1[i, j]));
+        }
+    }
+
+    // Named subexpressions are referred to, not folded
+    auto s = m1 + m2;
+    auto f = s*m3;
+    static_assert(std::tuple_size_v<decltype(std::move(f).release())> == 3);
+    ASSERT_DOUBLE_EQ((f[1, 2]), 20.0);
+}
+
+TEST(MDArray, Comparison)
+{
+    using D2 = stdex::dextents<std::size_t, 2>;
+    MDArray<double, D2> a(D2(2, 3), 1), b(D2(2, 3), 2);
+    a[0, 1] = 3;
+    a[1, 2] = 2;
+    MDArray<bool, D2> less = a < b;
+    MDArray<bool, D2> equal = a == b;
+    MDArray<bool, D2> both = (a >= 1.0) & !(2.0 < a);
+    static_assert(std::is_same_v<decltype(a != b)::value_type, bool>);
+    for(std::size_t i = 0; i < 2; i++){
+        for(std::size_t j = 0; j < 3; j++){
+            ASSERT_EQ((less[i, j]), (a[i, j] < b[i, j]));
+            ASSERT_EQ((equal[i, j]), (a[i, j] == b[i, j]));
+            ASSERT_EQ((both[i, j]), (a[i, j] >= 1.0 && a[i, j] <= 2.0));
+        }
+    }
+    ASSERT_EQ(expr::sum(expr::cast<int>((a > b) | (a == b))), 2);
+}
+
+TEST(MDArray, Where)
+{
+    using D1 = stdex::dextents<std::size_t, 1>;
+    MDArray<double, D1> x(D1(7), 0.), y(D1(7), 10.), z(D1(3), 0.);
+    for(std::size_t i = 0; i < 7; i++){
+        x[i] = static_cast<double>(i) - 3.0;
+    }
+    MDArray<double, D1> leaky = expr::where(x > 0.0, x, 0.1*x);
+    MDArray<double, D1> mixed = expr::where(x < 0.0, y, 1.0);
+    MDArray<double, D1> scalars = expr::where(x == 0.0, 5.0, -5.0);
+    // The comparison and the formulas of both branches are folded into one node
+    auto e = expr::where(x*y > y, x + y, 2.0*x);
+    static_assert(std::tuple_size_v<decltype(std::move(e).release())> == 7);
+    for(std::size_t i = 0; i < 7; i++){
+        ASSERT_DOUBLE_EQ(leaky[i], x[i] > 0 ? x[i] : 0.1*x[i]);
+        ASSERT_DOUBLE_EQ(mixed[i], x[i] < 0 ? 10.0 : 1.0);
+        ASSERT_DOUBLE_EQ(scalars[i], x[i] == 0 ? 5.0 : -5.0);
+    }
+    ASSERT_THROW(expr::where(x > 0.0, z, x), std::runtime_error);
+}
+
+TEST(MDArray, MinMaxClamp)
+{
+    using D1 = stdex::dextents<std::size_t, 1>;
+    MDArray<double, D1> x(D1(6), 0.), y(D1(6), 0.5);
+    for(std::size_t i = 0; i < 6; i++){
+        x[i] = static_cast<double>(i) - 2.5;
+    }
+    x[5] = std::numeric_limits<double>::quiet_NaN();
+    MDArray<double, D1> relu = expr::max(x, 0.0);
+    MDArray<double, D1> lo = expr::min(x, y);
+    MDArray<double, D1> hi = expr::max(2.0*x, y);
+    MDArray<double, D1> clamped = expr::clamp(x + y, -1.0, 1.0);
+    MDArray<double, D1> bounded = expr::clamp(x, -y, y);
+    for(std::size_t i = 0; i < 6; i++){
+        ASSERT_EQ(std::isnan(relu[i]), std::isnan(x[i]));
+        if(!std::isnan(x[i])){
+            ASSERT_DOUBLE_EQ(relu[i], std::max(x[i], 0.0));
+            ASSERT_DOUBLE_EQ(lo[i], std::min(x[i], y[i]));
+            ASSERT_DOUBLE_EQ(hi[i], std::max(2.0*x[i], y[i]));
+            ASSERT_DOUBLE_EQ(clamped[i], std::clamp(x[i] + y[i], -1.0, 1.0));
+            ASSERT_DOUBLE_EQ(bounded[i], std::clamp(x[i], -y[i], y[i]));
+        }
+    }
+    // Reductions are still found for a single argument
+    ASSERT_DOUBLE_EQ(expr::max(y), 0.5);
+
+    // Integers and a double scalar are compared as doubles
+    MDArray<int, D1> k(D1(6), 0);
+    for(std::size_t i = 0; i < 6; i++){
+        k[i] = static_cast<int>(i) - 3;
+    }
+    MDArray<double, D1> k_max = expr::max(k, 0.5);
+    MDArray<double, D1> k_min = expr::min(0.5, k);
+    for(std::size_t i = 0; i < 6; i++){
+        ASSERT_DOUBLE_EQ(k_max[i], std::max(static_cast<double>(k[i]), 0.5));
+        ASSERT_DOUBLE_EQ(k_min[i], std::min(static_cast<double>(k[i]), 0.5));
+    }
+
+    // Elements of temporary operands are evaluated once
+    std::size_t calls = 0;
+    MDArray<double, D1> once = expr::max(expr::map(y, [&calls](double v){ calls++; return v; }), x);
+    ASSERT_EQ(calls, 6);
+    calls = 0;
+    MDArray<double, D1> once_scalar = expr::min(expr::map(y, [&calls](double v){ calls++; return v; }), 0.25);
+    ASSERT_EQ(calls, 6);
+    ASSERT_DOUBLE_EQ(once[0], 0.5);
+    ASSERT_DOUBLE_EQ(once_scalar[0], 0.25);
+}
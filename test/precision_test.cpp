@@ -0,0 +1,94 @@
+#include <mdarray.h>
+#include <matrix.h>
+#include <gtest/gtest.h>
+#include <cmath>
+
+using D1 = stdex::dextents<std::size_t, 1>;
+using D2 = stdex::dextents<std::size_t, 2>;
+
+TEST(Precision, HalfConversion)
+{
+        ASSERT_EQ(expr::half(1.f).bits(), 0x3c00);
+        ASSERT_EQ(expr::half(-2.f).bits(), 0xc000);
+        ASSERT_EQ(expr::half(65504.f).bits(), 0x7bff);
+        ASSERT_EQ(expr::half(65519.f).bits(), 0x7bff);
+        ASSERT_EQ(expr::half(65520.f).bits(), 0x7c00);
+        ASSERT_EQ(expr::half(0x1p-24f).bits(), 0x0001);
+        ASSERT_EQ(expr::half(0x1p-25f).bits(), 0x0000);
+        ASSERT_EQ(expr::half(0x1.8p-25f).bits(), 0x0001);
+        ASSERT_EQ(expr::half(0x1p-14f).bits(), 0x0400);
+        // 1 + 2^-11 is halfway between 1 and the next half, ties to even
+        ASSERT_EQ(expr::half(1.f + 0x1p-11f).bits(), 0x3c00);
+        ASSERT_EQ(expr::half(1.f + 0x1.8p-11f).bits(), 0x3c01);
+        ASSERT_TRUE(std::isnan(static_cast<float>(expr::half(std::numeric_limits<float>::quiet_NaN()))));
+        ASSERT_TRUE(std::isinf(static_cast<float>(expr::half(std::numeric_limits<float>::infinity()))));
+        for(float val : {0.f, 1.f, -3.5f, 0.1f, 1000.25f, 0x1p-20f, 6e-5f}){
+                const float round_trip = expr::half(val);
+                ASSERT_NEAR(round_trip, val, std::abs(val)*0x1p-11f);
+        }
+        static_assert(static_cast<float>(std::numeric_limits<expr::half>::max()) == 65504.f);
+}
+
+TEST(Precision, BFloat16Conversion)
+{
+        ASSERT_EQ(expr::bfloat16(1.f).bits(), 0x3f80);
+        ASSERT_EQ(expr::bfloat16(-1.f).bits(), 0xbf80);
+        // 1 + 2^-8 is halfway between 1 and the next bfloat16, ties to even
+        ASSERT_EQ(expr::bfloat16(1.f + 0x1p-8f).bits(), 0x3f80);
+        ASSERT_EQ(expr::bfloat16(1.f + 0x1.8p-8f).bits(), 0x3f81);
+        ASSERT_EQ(static_cast<float>(expr::bfloat16(3.f)), 3.f);
+        ASSERT_TRUE(std::isnan(static_cast<float>(expr::bfloat16(std::numeric_limits<float>::quiet_NaN()))));
+        ASSERT_TRUE(std::isinf(static_cast<float>(expr::bfloat16(std::numeric_limits<float>::max()))));
+        static_assert(sizeof(expr::bfloat16) == 2 && sizeof(expr::half) == 2);
+}
+
+TEST(Precision, Cast)
+{
+        MDArray<double, D2> m(D2(3, 4), 0.);
+        for(size_t i = 0; i < 3; i++){
+                for(size_t j = 0; j < 4; j++){
+                        m[i, j] = 0.5*static_cast<double>(i) - static_cast<double>(j);
+                }
+        }
+        MDArray<expr::half, D2> h = expr::cast<expr::half>(m);
+        MDArray<expr::bfloat16, D2> b = expr::cast<expr::bfloat16>(2.*m);
+        static_assert(std::is_same_v<decltype(h + h)::value_type, float>);
+        MDArray<float, D2> res = h + b;
+        for(size_t i = 0; i < 3; i++){
+                for(size_t j = 0; j < 4; j++){
+                        ASSERT_FLOAT_EQ((res[i, j]), static_cast<float>(3*m[i, j]));
+                }
+        }
+        ASSERT_FLOAT_EQ(expr::sum(h), static_cast<float>(expr::sum(m)));
+}
+
+TEST(Precision, SumAccumulator)
+{
+        MDArray<float, D1> v(D1(1001), 1.f);
+        v[0] = 1e8f;
+        ASSERT_EQ(expr::sum(v), 1e8f);
+        static_assert(std::is_same_v<decltype(expr::sum<double>(v))::value_type, double>);
+        ASSERT_EQ(expr::sum<double>(v), 1e8 + 1000);
+}
+
+TEST(Precision, MatmulAccumulator)
+{
+        MDArray<float, D2> a(D2(2, 1001), 1.f), b(D2(1001, 3), 1.f);
+        a[0, 0] = 1e8f;
+        a[1, 0] = 1e8f;
+        auto lazy = expr::matmul<double>(a, b);
+        static_assert(std::is_same_v<decltype(lazy)::value_type, float>);
+        static_assert(std::is_same_v<decltype(lazy)::accumulator_type, double>);
+        MDArray<float, D2> single = expr::matmul(a, b);
+        MDArray<float, D2> mixed = lazy;
+        ASSERT_EQ((single[0, 0]), 1e8f);
+        for(size_t i = 0; i < 2; i++){
+                for(size_t j = 0; j < 3; j++){
+                        ASSERT_EQ((mixed[i, j]), 100001000.f);
+                        ASSERT_EQ((lazy[i, j]), 100001000.f);
+                }
+        }
+        Matrix<float, 2, 2> s(1e8f);
+        Matrix<float, 2, 2> small = expr::matmul<double>(s, s);
+        ASSERT_EQ((small[1, 1]), 2e16f);
+}
@@ -1,4 +1,6 @@
 #include <matrix.h>
+#include <mdarray.h>
+#include <cmath>
 #include <gtest/gtest.h>
 
 template<typename T>
@@ -126,3 +128,87 @@ TEST(Reduce, Combined)
         }
     }
 }
+
+TEST(Reduce, Dot)
+{
+    Matrix<int, 3, 4> m1, m2;
+    int expected = 0;
+    for(std::size_t i = 0; i < m1.rows; i++){
+        for(std::size_t j = 0; j < m1.cols; j++){
+            m1[i, j] = v1<int>(i, j);
+            m2[i, j] = v2<int>(i, j);
+            expected += v1<int>(i, j)*v2<int>(i, j);
+        }
+    }
+    // The sum of a product is a dot product
+    auto d = expr::sum(m1*m2);
+    static_assert(std::is_same_v<decltype(d), expr::DotProductOp<Matrix<int, 3, 4>&, Matrix<int, 3, 4>&>>);
+    ASSERT_EQ(static_cast<int>(d), expected);
+    ASSERT_EQ(expr::dot(m1, m2), expected);
+    ASSERT_EQ(expr::dot(m1, expr::transpose(expr::transpose(m2))), expected);
+}
+
+TEST(Reduce, NormAndDistance)
+{
+    using D1 = stdex::dextents<std::size_t, 1>;
+    // Longer than the accumulators, with a remainder
+    MDArray<double, D1> a(D1(1003), 0), b(D1(1003), 0);
+    double dot = 0, norm = 0, dist = 0;
+    for(std::size_t i = 0; i < 1003; i++){
+        a[i] = 0.001*static_cast<double>(i);
+        b[i] = 1.0 - 0.002*static_cast<double>(i);
+        dot += a[i]*b[i];
+        norm += a[i]*a[i];
+        dist += (a[i] - b[i])*(a[i] - b[i]);
+    }
+    ASSERT_NEAR(expr::dot(a, b), dot, 1e-9);
+    ASSERT_NEAR(expr::norm2(a), std::sqrt(norm), 1e-9);
+    ASSERT_NEAR(expr::squared_distance(a, b), dist, 1e-9);
+    // Without flat access
+    ASSERT_NEAR(expr::squared_distance(expr::transpose(a), b), dist, 1e-9);
+
+    Matrix<int, 3, 4> m1, m2;
+    for(std::size_t i = 0; i < m1.rows; i++){
+        for(std::size_t j = 0; j < m1.cols; j++){
+            m1[i, j] = v1<int>(i, j);
+            m2[i, j] = v2<int>(i, j);
+        }
+    }
+    ASSERT_EQ(expr::squared_distance(m1, m2), expr::sum(expr::map(m1 - m2, [](int v){ return v*v; })));
+}
+
+TEST(Reduce, Rowwise)
+{
+    using D1 = stdex::dextents<std::size_t, 1>;
+    using D2 = stdex::dextents<std::size_t, 2>;
+    using D3 = stdex::dextents<std::size_t, 3>;
+    MDArray<float, D2> a(D2(5, 37), 0), b(D2(5, 37), 0);
+    MDArray<float, D1> q(D1(37), 0);
+    for(std::size_t i = 0; i < 5; i++){
+        for(std::size_t j = 0; j < 37; j++){
+            a[i, j] = static_cast<float>(i) - 0.25f*static_cast<float>(j);
+            b[i, j] = 0.5f*static_cast<float>(i*j % 7);
+            q[j] = static_cast<float>(j % 3);
+        }
+    }
+    MDArray<float, D1> dots = expr::dot_rows(a, b), norms = expr::norm2_rows(a), dists = expr::squared_distance_rows(a, q);
+    ASSERT_EQ(dots.extent(0), 5);
+    for(std::size_t i = 0; i < 5; i++){
+        float dot = 0, norm = 0, dist = 0;
+        for(std::size_t j = 0; j < 37; j++){
+            dot += a[i, j]*b[i, j];
+            norm += a[i, j]*a[i, j];
+            dist += (a[i, j] - q[j])*(a[i, j] - q[j]);
+        }
+        ASSERT_NEAR(dots[i], dot, 1e-3f);
+        ASSERT_NEAR(norms[i], std::sqrt(norm), 1e-3f);
+        ASSERT_NEAR(dists[i], dist, 1e-3f);
+    }
+    // Batched rows, and rows without flat access
+    MDArray<double, D3> c(D3(2, 3, 4), 1.5);
+    MDArray<double, D2> batched = expr::norm2_rows(c);
+    ASSERT_DOUBLE_EQ((batched[1, 2]), 3.0);
+    MDArray<float, D1> transposed = expr::dot_rows(expr::transpose(expr::transpose(a) + expr::transpose(a)), b);
+    ASSERT_NEAR(transposed[3], 2*dots[3], 1e-3f);
+    ASSERT_THROW(expr::squared_distance_rows(a, MDArray<float, D1>(D1(36), 0)), std::runtime_error);
+}
@@ -0,0 +1,88 @@
+#include <mdarray.h>
+#include <runtime_expression.h>
+#include <cmath>
+#include <gtest/gtest.h>
+
+using rt = expr::runtime::Expression<double>;
+
+template<typename Destination>
+concept evaluable_into = requires(const rt& e, Destination& destination){ e.evaluate(destination); };
+
+TEST(Runtime, MatchesStaticExpression)
+{
+        using D2 = stdex::dextents<std::size_t, 2>;
+        // Not a multiple of the block size
+        MDArray<double, D2> a(D2(37, 29), 0), b(D2(37, 29), 0), res(D2(37, 29), 0);
+        for(std::size_t i = 0; i < 37; i++){
+                for(std::size_t j = 0; j < 29; j++){
+                        a[i, j] = 1.0 + static_cast<double>(i + j);
+                        b[i, j] = static_cast<double>(i) - 0.5*static_cast<double>(j);
+                }
+        }
+        const rt x = rt::leaf(a), y = rt::leaf(b);
+        // x + y is shared, and evaluated once per block
+        const rt s = x + y;
+        const rt e = s*s - rt::unary(expr::runtime::unary_op::sqrt, x)/rt::constant(2.0)
+                + rt::binary(expr::runtime::binary_op::max, -y, s);
+        const expr::runtime::Program<double> program(e);
+        ASSERT_EQ(program.instruction_count(), 8);
+        ASSERT_LE(program.register_count(), 4);
+        program.evaluate(res);
+
+        MDArray<double, D2> expected = (a + b)*(a + b) - expr::map(a, [](double v){ return std::sqrt(v)/2.0; })
+                + expr::zip(-b, a + b, [](double u, double v){ return std::max(u, v); });
+        for(std::size_t i = 0; i < 37; i++){
+                for(std::size_t j = 0; j < 29; j++){
+                        ASSERT_DOUBLE_EQ((res[i, j]), (expected[i, j]));
+                }
+        }
+}
+
+TEST(Runtime, LargeArray)
+{
+        using D1 = stdex::dextents<std::size_t, 1>;
+        MDArray<double, D1> a(D1(100000), 1.5), res(D1(100000), 0);
+        const rt x = rt::leaf(a);
+        (rt::constant(3.0)*x - x).evaluate(res);
+        ASSERT_DOUBLE_EQ(expr::sum(res), 3.0*100000);
+
+        // A leaf alone is copied
+        MDArray<double, D1> copy(D1(100000), 0);
+        x.evaluate(copy);
+        ASSERT_DOUBLE_EQ(expr::sum(copy), 1.5*100000);
+}
+
+TEST(Runtime, MathFunctions)
+{
+        using D1 = stdex::dextents<std::size_t, 1>;
+        using expr::runtime::unary_op, expr::runtime::binary_op;
+        const std::size_t n = 1000;
+        MDArray<double, D1> a(D1(n), 0), b(D1(n), 0), res(D1(n), 0);
+        for(std::size_t i = 0; i < n; i++){
+                a[i] = 0.01 + 0.013*static_cast<double>(i);
+                b[i] = std::sin(static_cast<double>(i))*3.0;
+        }
+        const rt x = rt::leaf(a), y = rt::leaf(b);
+        // The runtime operations use the same kernels as the static expressions
+        const rt e = rt::unary(unary_op::exp, y) + rt::unary(unary_op::log, x)*rt::unary(unary_op::sin, y)
+                - rt::unary(unary_op::cos, x) + rt::unary(unary_op::tanh, y) + rt::binary(binary_op::pow, x, y);
+        e.evaluate(res);
+        MDArray<double, D1> expected = expr::exp(b) + expr::log(a)*expr::sin(b) - expr::cos(a) + expr::tanh(b) + expr::pow(a, b);
+        for(std::size_t i = 0; i < n; i++){
+                ASSERT_DOUBLE_EQ(res[i], expected[i]) << i;
+                ASSERT_NEAR(res[i], std::exp(b[i]) + std::log(a[i])*std::sin(b[i]) - std::cos(a[i]) + std::tanh(b[i]) + std::pow(a[i], b[i]),
+                            1e-12*(1.0 + std::abs(res[i]))) << i;
+        }
+}
+
+TEST(Runtime, Errors)
+{
+        using D2 = stdex::dextents<std::size_t, 2>;
+        MDArray<double, D2> a(D2(3, 4), 1), b(D2(4, 3), 1), res(D2(3, 3), 0);
+        ASSERT_THROW(rt::leaf(a) + rt::leaf(b), std::runtime_error);
+        ASSERT_THROW(rt::leaf(a).evaluate(res), std::runtime_error);
+        ASSERT_THROW(expr::runtime::Program<double>(rt::constant(1.0)), std::runtime_error);
+        // Programs write row major, column major destinations are rejected at compile time
+        static_assert(evaluable_into<MDArray<double, D2>>);
+        static_assert(!evaluable_into<MDArray<double, D2, stdex::layout_left>>);
+}
@@ -0,0 +1,151 @@
+#include <mdarray.h>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+using D1 = stdex::dextents<std::size_t, 1>;
+using D2 = stdex::dextents<std::size_t, 2>;
+using D3 = stdex::dextents<std::size_t, 3>;
+
+namespace
+{
+        MDArray<long, D1> sequence(std::size_t n)
+        {
+                MDArray<long, D1> res(D1(n), 0);
+                for(std::size_t i = 0; i < n; i++){
+                        res[i] = static_cast<long>((i*37)%101) - 50;
+                }
+                return res;
+        }
+}
+
+TEST(Scan, Small)
+{
+        MDArray<int, D1> a(D1(5), 0);
+        for(std::size_t i = 0; i < 5; i++){
+                a[i] = static_cast<int>(i) + 1;
+        }
+        MDArray<int, D1> inclusive = expr::inclusive_scan(a);
+        MDArray<int, D1> exclusive = expr::exclusive_scan(a, std::plus<>{}, 0, 10);
+        MDArray<int, D1> product = expr::inclusive_scan(a, std::multiplies<>{});
+        const int inclusive_ref[] = {1, 3, 6, 10, 15};
+        const int exclusive_ref[] = {10, 11, 13, 16, 20};
+        const int product_ref[] = {1, 2, 6, 24, 120};
+        for(std::size_t i = 0; i < 5; i++){
+                ASSERT_EQ(inclusive[i], inclusive_ref[i]);
+                ASSERT_EQ(exclusive[i], exclusive_ref[i]);
+                ASSERT_EQ(product[i], product_ref[i]);
+                ASSERT_EQ(expr::inclusive_scan(a)[i], inclusive_ref[i]);
+                ASSERT_EQ((expr::exclusive_scan(a, std::plus<>{}, 0, 10)[i]), exclusive_ref[i]);
+        }
+        ASSERT_EQ(expr::inclusive_scan(a).blocks(), 1);
+        ASSERT_THROW(expr::inclusive_scan(a, std::plus<>{}, 1), std::runtime_error);
+}
+
+TEST(Scan, Long1D)
+{
+        // Long enough for the two pass block scan with several threads
+        for(std::size_t n : {std::size_t(1) << 20, (std::size_t(1) << 20) + 13}){
+                const auto a = sequence(n);
+                if(expr::num_threads() > 1){
+                        ASSERT_GT(expr::inclusive_scan(a).blocks(), 1);
+                        ASSERT_GT(expr::exclusive_scan(a).blocks(), 1);
+                }
+                std::vector<long> ref(n);
+                std::inclusive_scan(a.data(), a.data() + n, ref.begin());
+                MDArray<long, D1> inclusive = expr::inclusive_scan(a);
+                MDArray<long, D1> exclusive = expr::exclusive_scan(a, std::plus<>{}, 0, 3);
+                for(std::size_t i = 0; i < n; i++){
+                        ASSERT_EQ(inclusive[i], ref[i]) << i;
+                        ASSERT_EQ(exclusive[i], 3 + (i == 0 ? 0 : ref[i - 1])) << i;
+                }
+        }
+}
+
+TEST(Scan, Axes)
+{
+        const std::size_t n = 7, m = 9, l = 11;
+        MDArray<long, D3> a(D3(n, m, l), 0);
+        for(std::size_t i = 0; i < n; i++){
+                for(std::size_t j = 0; j < m; j++){
+                        for(std::size_t k = 0; k < l; k++){
+                                a[i, j, k] = static_cast<long>((i*31 + j*17 + k*7)%23) - 11;
+                        }
+                }
+        }
+        for(std::size_t axis = 0; axis < 3; axis++){
+                MDArray<long, D3> inclusive = expr::inclusive_scan(a, std::plus<>{}, axis);
+                MDArray<long, D3> exclusive = expr::exclusive_scan(a, std::plus<>{}, axis, 5);
+                for(std::size_t i = 0; i < n; i++){
+                        for(std::size_t j = 0; j < m; j++){
+                                for(std::size_t k = 0; k < l; k++){
+                                        const std::size_t idx[] = {i, j, k};
+                                        long acc = 0;
+                                        for(std::size_t p = 0; p <= idx[axis]; p++){
+                                                std::size_t q[] = {i, j, k};
+                                                q[axis] = p;
+                                                acc += a[q[0], q[1], q[2]];
+                                        }
+                                        ASSERT_EQ((inclusive[i, j, k]), acc);
+                                        ASSERT_EQ((exclusive[i, j, k]), (5 + acc - a[i, j, k]));
+                                }
+                        }
+                }
+        }
+}
+
+TEST(Scan, BlockAcrossRows)
+{
+        // Few long columns scanned across rows, and few long rows, both with block scans
+        const std::size_t n = 100000, m = 3;
+        MDArray<long, D2> a(D2(n, m), 0);
+        for(std::size_t i = 0; i < n; i++){
+                for(std::size_t j = 0; j < m; j++){
+                        a[i, j] = static_cast<long>((i*13 + j*5)%19) - 9;
+                }
+        }
+        MDArray<long, D2> down = expr::inclusive_scan(a, std::plus<>{}, 0);
+        MDArray<long, D2> down_exclusive = expr::exclusive_scan(a, std::plus<>{}, 0);
+        auto at = expr::transpose(a);
+        MDArray<long, D2> along = expr::inclusive_scan(at, std::plus<>{}, 1);
+        if(expr::num_threads() > 1){
+                ASSERT_GT(expr::inclusive_scan(a, std::plus<>{}, 0).blocks(), 1);
+                ASSERT_GT(expr::exclusive_scan(a, std::plus<>{}, 0).blocks(), 1);
+        }
+        if(expr::num_threads() > m){
+                ASSERT_GT(expr::inclusive_scan(at, std::plus<>{}, 1).blocks(), 1);
+        }
+        std::vector<long> acc(m, 0);
+        for(std::size_t i = 0; i < n; i++){
+                for(std::size_t j = 0; j < m; j++){
+                        ASSERT_EQ((down_exclusive[i, j]), acc[j]);
+                        acc[j] += a[i, j];
+                        ASSERT_EQ((down[i, j]), acc[j]);
+                        ASSERT_EQ((along[j, i]), acc[j]);
+                }
+        }
+}
+
+TEST(Scan, Operators)
+{
+        const std::size_t n = 100003;
+        MDArray<double, D1> x(D1(n), 0.);
+        for(std::size_t i = 0; i < n; i++){
+                x[i] = std::sin(static_cast<double>(i)*0.01)*static_cast<double>(i%13);
+        }
+        // Running maximum, and "keep the last", which is associative but not commutative
+        MDArray<double, D1> running = expr::inclusive_scan(x, [](double a, double b){return std::max(a, b);});
+        MDArray<double, D1> last = expr::inclusive_scan(x, [](double, double b){return b;});
+        MDArray<double, D1> sum = expr::inclusive_scan(2.*x);
+        double max = x[0];
+        double total = 0.;
+        for(std::size_t i = 0; i < n; i++){
+                max = std::max(max, x[i]);
+                total += 2.*x[i];
+                ASSERT_EQ(running[i], max);
+                ASSERT_EQ(last[i], x[i]);
+                ASSERT_NEAR(sum[i], total, 1e-9*static_cast<double>(i + 1));
+        }
+}
@@ -0,0 +1,151 @@
+#include "slice_expression.h"
+#include <matrix.h>
+#include <mdarray.h>
+#include <gtest/gtest.h>
+
+using D2 = stdex::dextents<std::size_t, 2>;
+using D3 = stdex::dextents<std::size_t, 3>;
+
+template<typename T>
+T v1(const size_t i, const size_t j)
+{
+    T i_t = static_cast<T>(i);
+    T j_t = static_cast<T>(j);
+    return 10*i_t + j_t;
+}
+
+TEST(Slice, Extents)
+{
+        MDArray<int, D3> m(D3(4, 5, 6), 0);
+        auto s = expr::slice(m, 1, expr::all_t{}, expr::SliceRange<size_t>(1, 6, 2));
+        ASSERT_EQ(s.extents().rank(), 2);
+        ASSERT_EQ(s.extent(0), 5);
+        ASSERT_EQ(s.extent(1), 3);
+
+        auto s2 = expr::slice(m, expr::UnitSliceRange<size_t>(1, 3), 2, expr::all_t{});
+        ASSERT_EQ(s2.extents().rank(), 2);
+        ASSERT_EQ(s2.extent(0), 2);
+        ASSERT_EQ(s2.extent(1), 6);
+}
+
+TEST(Slice, StaticExtents)
+{
+        Matrix<int, 3, 4> m(0);
+        auto s = expr::slice(m, expr::all_t{}, 2);
+        static_assert(decltype(s.extents())::static_extent(0) == 3);
+        ASSERT_EQ(s.extent(0), 3);
+}
+
+TEST(Slice, Access)
+{
+        MDArray<int, D2> m(D2(4, 5), 0);
+        for(size_t i = 0; i < 4; i++){
+                for(size_t j = 0; j < 5; j++){
+                        m[i, j] = v1<int>(i, j);
+                }
+        }
+        auto row = expr::slice(m, 2, expr::all_t{});
+        for(size_t j = 0; j < 5; j++){
+                ASSERT_EQ(row[j], v1<int>(2, j));
+        }
+        auto strided = expr::slice(m, expr::SliceRange<size_t>(3, 0, -2), expr::SliceRange<size_t>(0, 5, 3));
+        ASSERT_EQ(strided.extent(0), 2);
+        ASSERT_EQ(strided.extent(1), 2);
+        ASSERT_EQ((strided[0, 0]), v1<int>(3, 0));
+        ASSERT_EQ((strided[0, 1]), v1<int>(3, 3));
+        ASSERT_EQ((strided[1, 0]), v1<int>(1, 0));
+        ASSERT_EQ((strided[1, 1]), v1<int>(1, 3));
+}
+
+TEST(Slice, UnitStride)
+{
+        MDArray<int, D3> m(D3(2, 3, 4), 0);
+        using Contiguous = decltype(expr::slice(m, 1, expr::UnitSliceRange<size_t>(1, 3), expr::all_t{}));
+        using Unit = decltype(expr::slice(m, expr::all_t{}, expr::SliceRange<size_t>(0, 3, 2), expr::UnitSliceRange<size_t>(1, 3)));
+        using Strided = decltype(expr::slice(m, expr::all_t{}, expr::all_t{}, expr::SliceRange<size_t>(0, 4, 2)));
+        using Column = decltype(expr::slice(m, expr::all_t{}, expr::all_t{}, 1));
+        static_assert(Contiguous::unit_inner_stride && Contiguous::contiguous);
+        static_assert(Unit::unit_inner_stride && !Unit::contiguous);
+        static_assert(!Strided::unit_inner_stride && !Strided::contiguous);
+        static_assert(!Column::unit_inner_stride && !Column::contiguous);
+        static_assert(exts::has_flat_access<Contiguous>);
+        static_assert(!exts::has_flat_access<Unit>);
+}
+
+TEST(Slice, FlatAccess)
+{
+        MDArray<int, D3> m(D3(2, 3, 4), 0);
+        for(size_t i = 0; i < 24; i++){
+                m.flat(i) = static_cast<int>(i);
+        }
+        auto s = expr::slice(m, 1, expr::UnitSliceRange<size_t>(1, 3), expr::all_t{});
+        for(size_t n = 0; n < 8; n++){
+                ASSERT_EQ(s.flat(n), static_cast<int>(12 + 4 + n));
+        }
+        MDArray<int, D2> res = 2*s;
+        ASSERT_EQ((res[0, 0]), 32);
+        ASSERT_EQ((res[1, 3]), 46);
+}
+
+TEST(Slice, AssignExpression)
+{
+        MDArray<int, D2> m(D2(4, 5), 0);
+        MDArray<int, D2> ones(D2(2, 5), 1);
+        auto rows = expr::slice(m, expr::UnitSliceRange<size_t>(1, 3), expr::all_t{});
+        rows = ones + ones;
+        for(size_t i = 0; i < 4; i++){
+                for(size_t j = 0; j < 5; j++){
+                        int expected = (i == 1 || i == 2) ? 2 : 0;
+                        ASSERT_EQ((m[i, j]), expected);
+                }
+        }
+}
+
+TEST(Slice, AssignStrided)
+{
+        MDArray<int, D2> m(D2(4, 5), 0);
+        auto even = expr::slice(m, expr::all_t{}, expr::SliceRange<size_t>(0, 5, 2));
+        even = 7;
+        auto col = expr::slice(m, expr::all_t{}, 1);
+        MDArray<int, stdex::dextents<std::size_t, 1>> vals(stdex::dextents<std::size_t, 1>(4), 3);
+        col = vals;
+        for(size_t i = 0; i < 4; i++){
+                for(size_t j = 0; j < 5; j++){
+                        int expected = j % 2 == 0 ? 7 : (j == 1 ? 3 : 0);
+                        ASSERT_EQ((m[i, j]), expected);
+                }
+        }
+}
+
+TEST(Slice, AssignSlice)
+{
+        MDArray<int, D2> m(D2(2, 3), 0);
+        m[0, 0] = 1;
+        m[0, 1] = 2;
+        m[0, 2] = 3;
+        auto top = expr::slice(m, 0, expr::all_t{});
+        auto bottom = expr::slice(m, 1, expr::all_t{});
+        bottom = top;
+        ASSERT_EQ((m[1, 0]), 1);
+        ASSERT_EQ((m[1, 1]), 2);
+        ASSERT_EQ((m[1, 2]), 3);
+}
+
+TEST(Slice, Reduce)
+{
+        MDArray<int, D2> m(D2(3, 3), 1);
+        m[1, 1] = 5;
+        ASSERT_EQ(expr::sum(expr::slice(m, 1, expr::all_t{})), 7);
+        ASSERT_EQ(expr::sum(expr::slice(m, expr::all_t{}, expr::SliceRange<size_t>(0, 3, 2))), 6);
+}
+
+TEST(Slice, OutOfRange)
+{
+        MDArray<int, D2> m(D2(3, 3), 1);
+        ASSERT_THROW(expr::slice(m, 3, expr::all_t{}), std::runtime_error);
+        ASSERT_THROW(expr::slice(m, expr::UnitSliceRange<size_t>(1, 4), expr::all_t{}), std::runtime_error);
+        ASSERT_THROW(expr::slice(m, expr::SliceRange<size_t>(0, 3, 0), expr::all_t{}), std::runtime_error);
+        MDArray<int, D2> other(D2(2, 2), 1);
+        auto s = expr::slice(m, expr::all_t{}, expr::all_t{});
+        ASSERT_THROW(s = other, std::runtime_error);
+}
@@ -0,0 +1,214 @@
+#include <sparse_matrix.h>
+#include <matrix.h>
+#include <mdarray.h>
+#include <gtest/gtest.h>
+
+using D1 = stdex::dextents<std::size_t, 1>;
+using D2 = stdex::dextents<std::size_t, 2>;
+
+// 4x5 matrix with 6 non-zero elements
+static MDArray<double, D2> sparse_dense()
+{
+        MDArray<double, D2> m(D2(4, 5), 0);
+        m[0, 0] = 1;
+        m[0, 3] = 2;
+        m[1, 1] = 3;
+        m[2, 4] = 4;
+        m[3, 0] = 5;
+        m[3, 2] = 6;
+        return m;
+}
+
+static MDArray<double, D2> dense(size_t rows, size_t cols)
+{
+        MDArray<double, D2> m(D2(rows, cols), 0);
+        for(size_t i = 0; i < rows; i++){
+                for(size_t j = 0; j < cols; j++){
+                        m[i, j] = static_cast<double>(i + 2*j) - 3;
+                }
+        }
+        return m;
+}
+
+TEST(Sparse, CSRFromArrays)
+{
+        CSRMatrix<double> csr(2, 3, {0, 1, 3}, {2, 0, 1}, {1., 2., 3.});
+        ASSERT_EQ(csr.nnz(), 3);
+        ASSERT_EQ((csr[0, 0]), 0.);
+        ASSERT_EQ((csr[0, 2]), 1.);
+        ASSERT_EQ((csr[1, 0]), 2.);
+        ASSERT_EQ((csr[1, 1]), 3.);
+        ASSERT_EQ((csr[1, 2]), 0.);
+}
+
+TEST(Sparse, InvalidArrays)
+{
+        ASSERT_THROW((CSRMatrix<double>(2, 3, {0, 1}, {2}, {1.})), std::runtime_error);
+        ASSERT_THROW((CSRMatrix<double>(2, 3, {0, 1, 2}, {2, 3}, {1., 2.})), std::runtime_error);
+        ASSERT_THROW((CSCMatrix<double>(2, 3, {0, 2, 2, 2}, {1, 0}, {1., 2.})), std::runtime_error);
+}
+
+TEST(Sparse, Compress)
+{
+        auto m = sparse_dense();
+        CSRMatrix<double> csr(m);
+        CSCMatrix<double> csc(m);
+        ASSERT_EQ(csr.nnz(), 6);
+        ASSERT_EQ(csc.nnz(), 6);
+        for(size_t i = 0; i < 4; i++){
+                for(size_t j = 0; j < 5; j++){
+                        ASSERT_EQ((csr[i, j]), (m[i, j]));
+                        ASSERT_EQ((csc[i, j]), (m[i, j]));
+                }
+        }
+        ASSERT_EQ(expr::sum(csr), 21.);
+}
+
+template<typename Product, typename Reference>
+static void check_product(const Product& product, const Reference& reference)
+{
+        MDArray<double, D2> evaluated = product;
+        ASSERT_EQ(product.extent(0), reference.extent(0));
+        ASSERT_EQ(product.extent(1), reference.extent(1));
+        for(size_t i = 0; i < reference.extent(0); i++){
+                for(size_t j = 0; j < reference.extent(1); j++){
+                        ASSERT_DOUBLE_EQ((product[i, j]), (reference[i, j]));
+                        ASSERT_DOUBLE_EQ((evaluated[i, j]), (reference[i, j]));
+                }
+        }
+}
+
+TEST(Sparse, SparseDense)
+{
+        auto m = sparse_dense();
+        auto b = dense(5, 3);
+        MDArray<double, D2> reference = expr::matmul(m, b);
+        CSRMatrix<double> csr(m);
+        CSCMatrix<double> csc(m);
+        check_product(expr::matmul(csr, b), reference);
+        check_product(expr::matmul(csc, b), reference);
+}
+
+TEST(Sparse, DenseSparse)
+{
+        auto m = sparse_dense();
+        auto a = dense(3, 4);
+        MDArray<double, D2> reference = expr::matmul(a, m);
+        CSRMatrix<double> csr(m);
+        CSCMatrix<double> csc(m);
+        check_product(expr::matmul(a, csr), reference);
+        check_product(expr::matmul(a, csc), reference);
+}
+
+TEST(Sparse, SparseSparse)
+{
+        auto m = sparse_dense();
+        auto mt = dense(5, 4);
+        for(size_t i = 0; i < 5; i++){
+                for(size_t j = 0; j < 4; j++){
+                        mt[i, j] = m[j, i];
+                }
+        }
+        MDArray<double, D2> reference = expr::matmul(m, mt);
+        CSRMatrix<double> csr(m);
+        CSCMatrix<double> csc(mt);
+        check_product(expr::matmul(csr, csc), reference);
+}
+
+TEST(Sparse, SpMV)
+{
+        auto m = sparse_dense();
+        CSRMatrix<double> csr(m);
+        CSCMatrix<double> csc(m);
+        MDArray<double, D1> x(D1(5), 0), y(D1(4), 0);
+        for(size_t i = 0; i < 5; i++){
+                x[i] = static_cast<double>(i) + 1;
+        }
+        for(size_t i = 0; i < 4; i++){
+                y[i] = static_cast<double>(i) - 1;
+        }
+        MDArray<double, D1> ax = expr::matmul(csr, x), ax_csc = expr::matmul(csc, x);
+        MDArray<double, D1> ya = expr::matmul(y, csr), ya_csc = expr::matmul(y, csc);
+        ASSERT_EQ(ax.extent(0), 4);
+        ASSERT_EQ(ya.extent(0), 5);
+        for(size_t i = 0; i < 4; i++){
+                double ref = 0;
+                for(size_t k = 0; k < 5; k++){
+                        ref += m[i, k]*x[k];
+                }
+                ASSERT_DOUBLE_EQ(ax[i], ref);
+                ASSERT_DOUBLE_EQ(ax_csc[i], ref);
+        }
+        for(size_t j = 0; j < 5; j++){
+                double ref = 0;
+                for(size_t k = 0; k < 4; k++){
+                        ref += y[k]*m[k, j];
+                }
+                ASSERT_DOUBLE_EQ(ya[j], ref);
+                ASSERT_DOUBLE_EQ(ya_csc[j], ref);
+        }
+}
+
+TEST(Sparse, LargeParallel)
+{
+        const size_t n = 1000;
+        std::vector<std::size_t> ptr(1, 0), col;
+        std::vector<double> val;
+        for(size_t i = 0; i < n; i++){
+                for(size_t j : {i, (i*7 + 3) % n}){
+                        if(col.size() > ptr.back() && col.back() >= j){
+                                continue;
+                        }
+                        col.push_back(j);
+                        val.push_back(static_cast<double>(j % 5) + 1);
+                }
+                ptr.push_back(col.size());
+        }
+        CSRMatrix<double> csr(n, n, ptr, col, val);
+        auto b = dense(n, 4);
+        MDArray<double, D2> res = expr::matmul(csr, b);
+        for(size_t i = 0; i < n; i += 97){
+                for(size_t j = 0; j < 4; j++){
+                        ASSERT_DOUBLE_EQ((res[i, j]), (expr::matmul(csr, b)[i, j]));
+                }
+        }
+}
+
+TEST(Sparse, LargeScatterSpMV)
+{
+        // CSC times a vector and a vector times CSR split the inner dimension over the threads
+        const size_t n = 20000;
+        std::vector<std::size_t> ptr(1, 0), idx;
+        std::vector<double> val;
+        for(size_t k = 0; k < n; k++){
+                for(size_t i = k % 3; i < n; i += 1 + (k*13 + 7) % 997){
+                        idx.push_back(i);
+                        val.push_back(static_cast<double>((i + k) % 7) - 3);
+                }
+                ptr.push_back(idx.size());
+        }
+        CSCMatrix<double> csc(n, n, ptr, idx, val);
+        CSRMatrix<double> csr(n, n, ptr, idx, val);
+        MDArray<double, D1> x(D1(n), 0);
+        for(size_t k = 0; k < n; k++){
+                x[k] = static_cast<double>(k % 11) - 5;
+        }
+        MDArray<double, D1> ax = expr::matmul(csc, x), xa = expr::matmul(x, csr);
+        std::vector<double> ref(n, 0);
+        for(size_t k = 0; k < n; k++){
+                for(size_t p = ptr[k]; p < ptr[k + 1]; p++){
+                        ref[idx[p]] += val[p]*x[k];
+                }
+        }
+        for(size_t i = 0; i < n; i++){
+                ASSERT_DOUBLE_EQ(ax[i], ref[i]);
+                ASSERT_DOUBLE_EQ(xa[i], ref[i]);
+        }
+}
+
+TEST(Sparse, IncompatibleDimensions)
+{
+        CSRMatrix<double> csr(sparse_dense());
+        auto b = dense(4, 3);
+        ASSERT_THROW(expr::matmul(csr, b), std::runtime_error);
+}
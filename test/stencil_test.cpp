@@ -0,0 +1,146 @@
+#include <mdarray.h>
+#include <gtest/gtest.h>
+#include <cstddef>
+
+using D1 = stdex::dextents<std::size_t, 1>;
+using D2 = stdex::dextents<std::size_t, 2>;
+using D3 = stdex::dextents<std::size_t, 3>;
+
+namespace
+{
+        // Element j of a dimension with n elements under boundary b, -1 for zero
+        std::ptrdiff_t reference_index(std::ptrdiff_t j, std::ptrdiff_t n, expr::boundary b)
+        {
+                if(j >= 0 && j < n){
+                        return j;
+                }
+                if(b == expr::boundary::clamp){
+                        return j < 0 ? 0 : n - 1;
+                }
+                if(b == expr::boundary::periodic){
+                        return ((j%n) + n)%n;
+                }
+                return -1;
+        }
+
+        double v3(std::size_t i, std::size_t j, std::size_t k)
+        {
+                return static_cast<double>((i*7 + j*13 + k*3)%17) - 0.5*static_cast<double>(k%5);
+        }
+
+        constexpr expr::boundary boundaries[] = {expr::boundary::zero, expr::boundary::clamp, expr::boundary::periodic};
+}
+
+TEST(Stencil, Shift1D)
+{
+        MDArray<int, D1> a(D1(5), 0);
+        for(std::size_t i = 0; i < 5; i++){
+                a[i] = static_cast<int>(i) + 1;
+        }
+        MDArray<int, D1> zero = expr::shift(a, {2});
+        MDArray<int, D1> clamp = expr::shift(a, {-2}, expr::boundary::clamp);
+        MDArray<int, D1> periodic = expr::shift(a, {7}, expr::boundary::periodic);
+        const int zero_ref[] = {3, 4, 5, 0, 0};
+        const int clamp_ref[] = {1, 1, 1, 2, 3};
+        const int periodic_ref[] = {3, 4, 5, 1, 2};
+        for(std::size_t i = 0; i < 5; i++){
+                ASSERT_EQ(zero[i], zero_ref[i]);
+                ASSERT_EQ(clamp[i], clamp_ref[i]);
+                ASSERT_EQ(periodic[i], periodic_ref[i]);
+        }
+}
+
+TEST(Stencil, Shift2D)
+{
+        MDArray<double, D2> u(D2(6, 9), 0.);
+        for(std::size_t i = 0; i < 6; i++){
+                for(std::size_t j = 0; j < 9; j++){
+                        u[i, j] = v3(i, j, 0);
+                }
+        }
+        for(auto b : boundaries){
+                MDArray<double, D2> s = expr::shift(u, {-1, 3}, b);
+                ASSERT_EQ(s.extent(0), 6);
+                ASSERT_EQ(s.extent(1), 9);
+                for(std::ptrdiff_t i = 0; i < 6; i++){
+                        for(std::ptrdiff_t j = 0; j < 9; j++){
+                                const auto si = reference_index(i - 1, 6, b);
+                                const auto sj = reference_index(j + 3, 9, b);
+                                const double ref = si < 0 || sj < 0 ? 0. : u[static_cast<std::size_t>(si), static_cast<std::size_t>(sj)];
+                                ASSERT_EQ((s[static_cast<std::size_t>(i), static_cast<std::size_t>(j)]), ref);
+                        }
+                }
+        }
+}
+
+TEST(Stencil, Laplacian2D)
+{
+        const std::size_t n = 70, m = 1100;
+        MDArray<double, D2> u(D2(n, m), 0.);
+        for(std::size_t i = 0; i < n; i++){
+                for(std::size_t j = 0; j < m; j++){
+                        u[i, j] = v3(i, j, 1);
+                }
+        }
+        for(auto b : boundaries){
+                auto lap = expr::stencil(u, {{-1, 0}, {1, 0}, {0, -1}, {0, 1}, {0, 0}}, {1., 1., 1., 1., -4.}, b);
+                MDArray<double, D2> res = lap;
+                MDArray<double, D2> shifts = expr::shift(u, {-1, 0}, b) + expr::shift(u, {1, 0}, b) + expr::shift(u, {0, -1}, b) + expr::shift(u, {0, 1}, b) - 4.*u;
+                for(std::size_t i = 0; i < n; i++){
+                        for(std::size_t j = 0; j < m; j++){
+                                ASSERT_DOUBLE_EQ((res[i, j]), (shifts[i, j])) << i << ", " << j;
+                                ASSERT_DOUBLE_EQ((res[i, j]), (lap[i, j]));
+                        }
+                }
+        }
+}
+
+TEST(Stencil, Tiled3D)
+{
+        // Planes larger than the cache budget, evaluated in tiles
+        const std::size_t n = 9, m = 150, l = 700;
+        MDArray<double, D3> u(D3(n, m, l), 0.);
+        for(std::size_t i = 0; i < n; i++){
+                for(std::size_t j = 0; j < m; j++){
+                        for(std::size_t k = 0; k < l; k++){
+                                u[i, j, k] = v3(i, j, k);
+                        }
+                }
+        }
+        const std::ptrdiff_t offsets[][3] = {{0, 0, 0}, {-1, 0, 0}, {2, 0, 0}, {0, -2, 1}, {0, 1, 0}, {0, 0, -3}, {0, 0, 1}};
+        const double weights[] = {-6., 1., 0.5, 1.5, 1., 2., 1.};
+        for(auto b : boundaries){
+                MDArray<double, D3> res = expr::stencil(u, offsets, weights, b);
+                for(std::size_t i = 0; i < n; i++){
+                        for(std::size_t j = 0; j < m; j++){
+                                for(std::size_t k = 0; k < l; k++){
+                                        double ref = 0.;
+                                        for(std::size_t p = 0; p < 7; p++){
+                                                const auto si = reference_index(static_cast<std::ptrdiff_t>(i) + offsets[p][0], static_cast<std::ptrdiff_t>(n), b);
+                                                const auto sj = reference_index(static_cast<std::ptrdiff_t>(j) + offsets[p][1], static_cast<std::ptrdiff_t>(m), b);
+                                                const auto sk = reference_index(static_cast<std::ptrdiff_t>(k) + offsets[p][2], static_cast<std::ptrdiff_t>(l), b);
+                                                if(si >= 0 && sj >= 0 && sk >= 0){
+                                                        ref += weights[p]*u[static_cast<std::size_t>(si), static_cast<std::size_t>(sj), static_cast<std::size_t>(sk)];
+                                                }
+                                        }
+                                        ASSERT_DOUBLE_EQ((res[i, j, k]), ref) << i << ", " << j << ", " << k;
+                                }
+                        }
+                }
+        }
+}
+
+TEST(Stencil, InExpression)
+{
+        MDArray<double, D1> u(D1(100), 0.);
+        for(std::size_t i = 0; i < 100; i++){
+                u[i] = static_cast<double>(i*i%11);
+        }
+        // One explicit time step of the heat equation, on a temporary operand
+        MDArray<double, D1> next = u + 0.1*expr::stencil(2.*u, {{-1}, {0}, {1}}, {1., -2., 1.}, expr::boundary::periodic);
+        static_assert(std::is_same_v<decltype(expr::stencil(expr::cast<float>(u), {{0}}, {1.}))::value_type, double>);
+        for(std::size_t i = 0; i < 100; i++){
+                const double lap = 0. + 1.*(2.*u[(i + 99)%100]) + -2.*(2.*u[i]) + 1.*(2.*u[(i + 1)%100]);
+                ASSERT_DOUBLE_EQ(next[i], u[i] + 0.1*lap);
+        }
+}
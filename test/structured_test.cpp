@@ -0,0 +1,174 @@
+#include <structured_matrix.h>
+#include <matrix.h>
+#include <mdarray.h>
+#include <gtest/gtest.h>
+
+using D1 = stdex::dextents<std::size_t, 1>;
+using D2 = stdex::dextents<std::size_t, 2>;
+
+static MDArray<double, D2> dense(size_t rows, size_t cols)
+{
+        MDArray<double, D2> m(D2(rows, cols), 0);
+        for(size_t i = 0; i < rows; i++){
+                for(size_t j = 0; j < cols; j++){
+                        m[i, j] = static_cast<double>((3*i + 2*j) % 7) - 3;
+                }
+        }
+        return m;
+}
+
+template<typename LHS, typename RHS, typename Res>
+static void check_product(const LHS& lhs, const RHS& rhs, const Res& res)
+{
+        ASSERT_EQ(res.extent(0), lhs.extent(0));
+        ASSERT_EQ(res.extent(1), rhs.extent(1));
+        for(size_t i = 0; i < res.extent(0); i++){
+                for(size_t j = 0; j < res.extent(1); j++){
+                        double ref = 0;
+                        for(size_t k = 0; k < lhs.extent(1); k++){
+                                ref += lhs[i, k]*rhs[k, j];
+                        }
+                        ASSERT_DOUBLE_EQ((res[i, j]), ref);
+                }
+        }
+}
+
+TEST(Structured, Symmetric)
+{
+        SymmetricMatrix<double> s(3);
+        s[0, 0] = 1;
+        s[1, 0] = 2;
+        s[2, 1] = 3;
+        ASSERT_EQ(s.packed_values().size(), 6);
+        ASSERT_EQ((s[0, 1]), 2.);
+        ASSERT_EQ((s[1, 2]), 3.);
+        ASSERT_EQ((s[2, 0]), 0.);
+
+        SymmetricMatrix<double> from_dense(dense(4, 4));
+        ASSERT_EQ((from_dense[0, 3]), (dense(4, 4)[3, 0]));
+        ASSERT_THROW(SymmetricMatrix<double>(dense(3, 4)), std::runtime_error);
+}
+
+TEST(Structured, Triangular)
+{
+        const auto m = dense(5, 5);
+        TriangularMatrix<double> lower(m);
+        TriangularMatrix<double, expr::triangle::upper> upper(m);
+        ASSERT_EQ(lower.packed_values().size(), 15);
+        ASSERT_EQ(upper.packed_values().size(), 15);
+        for(size_t i = 0; i < 5; i++){
+                for(size_t j = 0; j < 5; j++){
+                        ASSERT_EQ((lower[i, j]), j <= i ? (m[i, j]) : 0.);
+                        ASSERT_EQ((upper[i, j]), j >= i ? (m[i, j]) : 0.);
+                }
+        }
+}
+
+TEST(Structured, Banded)
+{
+        const auto m = dense(6, 5);
+        BandedMatrix<double> band(m, 2, 1);
+        ASSERT_EQ(band.band_values().size(), 6*4);
+        for(size_t i = 0; i < 6; i++){
+                for(size_t j = 0; j < 5; j++){
+                        const bool in_band = j + 2 >= i && j <= i + 1;
+                        ASSERT_EQ((band[i, j]), in_band ? (m[i, j]) : 0.);
+                }
+        }
+        ASSERT_THROW(BandedMatrix<double>(4, 4, 1, 1, std::vector<double>(4)), std::runtime_error);
+}
+
+TEST(Structured, MatmulStructuredDense)
+{
+        const auto b = dense(7, 4);
+        SymmetricMatrix<double> s(dense(7, 7));
+        TriangularMatrix<double> l(dense(7, 7));
+        TriangularMatrix<double, expr::triangle::upper> u(dense(7, 7));
+        BandedMatrix<double> band(dense(7, 7), 1, 2);
+        MDArray<double, D2> sb = expr::matmul(s, b);
+        MDArray<double, D2> lb = expr::matmul(l, b);
+        MDArray<double, D2> ub = expr::matmul(u, b);
+        MDArray<double, D2> bb = expr::matmul(band, b);
+        check_product(s, b, sb);
+        check_product(l, b, lb);
+        check_product(u, b, ub);
+        check_product(band, b, bb);
+        auto lazy = expr::matmul(band, b);
+        for(size_t i = 0; i < 7; i++){
+                for(size_t j = 0; j < 4; j++){
+                        ASSERT_DOUBLE_EQ((lazy[i, j]), (bb[i, j]));
+                }
+        }
+}
+
+TEST(Structured, MatmulDenseStructured)
+{
+        const auto a = dense(3, 6);
+        TriangularMatrix<double> l(dense(6, 6));
+        BandedMatrix<double> band(dense(6, 6), 2, 0);
+        TriangularMatrix<double, expr::triangle::upper> u(dense(6, 6));
+        MDArray<double, D2> al = expr::matmul(a, l);
+        MDArray<double, D2> ab = expr::matmul(a, band);
+        MDArray<double, D2> au = expr::matmul(a, u);
+        check_product(a, l, al);
+        check_product(a, band, ab);
+        check_product(a, u, au);
+        auto lazy = expr::matmul(a, band);
+        for(size_t i = 0; i < 3; i++){
+                for(size_t j = 0; j < 6; j++){
+                        ASSERT_DOUBLE_EQ((lazy[i, j]), (ab[i, j]));
+                }
+        }
+}
+
+TEST(Structured, MatmulSymmetric)
+{
+        // Large enough for several row blocks, the mirrored part of the rows read from the triangle
+        const std::size_t n = 301;
+        SymmetricMatrix<double> s(dense(n, n));
+        const auto b = dense(n, 5);
+        const auto a = dense(4, n);
+        MDArray<double, D2> sb = expr::matmul(s, b);
+        MDArray<double, D2> as = expr::matmul(a, s);
+        check_product(s, b, sb);
+        check_product(a, s, as);
+        auto lazy = expr::matmul(a, s);
+        ASSERT_DOUBLE_EQ((lazy[3, 200]), (as[3, 200]));
+
+        MDArray<double, D1> v(D1(n), 0.);
+        for(std::size_t i = 0; i < n; i++){
+                v[i] = static_cast<double>(i%5) - 2.;
+        }
+        MDArray<double, D1> sv = expr::matmul(s, v);
+        MDArray<double, D1> vs = expr::matmul(v, s);
+        for(std::size_t i = 0; i < n; i++){
+                double ref = 0;
+                for(std::size_t k = 0; k < n; k++){
+                        ref += s[i, k]*v[k];
+                }
+                ASSERT_DOUBLE_EQ(sv[i], ref);
+                ASSERT_DOUBLE_EQ(vs[i], ref);
+        }
+}
+
+TEST(Structured, MatVec)
+{
+        BandedMatrix<double> lap(5, 5, 1, 1);
+        const auto stencil = dense(5, 5);
+        BandedMatrix<double> band(stencil, 1, 1);
+        MDArray<double, D1> v(D1(5), 1.);
+        v[2] = 3.;
+        MDArray<double, D1> res = expr::matmul(band, v);
+        MDArray<double, D1> res_t = expr::matmul(v, band);
+        ASSERT_EQ(res.extent(0), 5);
+        for(size_t i = 0; i < 5; i++){
+                double ref = 0, ref_t = 0;
+                for(size_t k = 0; k < 5; k++){
+                        ref += band[i, k]*v[k];
+                        ref_t += v[k]*band[k, i];
+                }
+                ASSERT_DOUBLE_EQ(res[i], ref);
+                ASSERT_DOUBLE_EQ(res_t[i], ref_t);
+        }
+        ASSERT_THROW(expr::matmul(band, MDArray<double, D1>(D1(4), 1.)), std::runtime_error);
+}
@@ -0,0 +1,131 @@
+#include <mdarray.h>
+#include <gtest/gtest.h>
+#include <cstddef>
+#include <random>
+
+using D1 = stdex::dextents<std::size_t, 1>;
+using D2 = stdex::dextents<std::size_t, 2>;
+using D3 = stdex::dextents<std::size_t, 3>;
+
+namespace
+{
+        MDArray<long, D1> random_indices(std::size_t n, std::size_t extent, unsigned seed)
+        {
+                std::mt19937_64 gen(seed);
+                std::uniform_int_distribution<long> dist(0, static_cast<long>(extent) - 1);
+                MDArray<long, D1> res(D1(n), 0);
+                for(std::size_t i = 0; i < n; i++){
+                        res[i] = dist(gen);
+                }
+                return res;
+        }
+
+        double v3(std::size_t i, std::size_t j, std::size_t k)
+        {
+                return static_cast<double>(i*10000 + j*100 + k);
+        }
+}
+
+TEST(Take, Gather1D)
+{
+        const std::size_t n = 100000;
+        MDArray<double, D1> x(D1(n), 0.);
+        for(std::size_t i = 0; i < n; i++){
+                x[i] = static_cast<double>(i)*0.5;
+        }
+        const auto idx = random_indices(300007, n, 1);
+        for(std::size_t distance : {std::size_t(0), std::size_t(1), std::size_t(16), std::size_t(1000)}){
+                MDArray<double, D1> y = expr::take(x, idx, 0, distance);
+                ASSERT_EQ(y.extent(0), idx.extent(0));
+                for(std::size_t i = 0; i < idx.extent(0); i++){
+                        ASSERT_EQ(y[i], x[static_cast<std::size_t>(idx[i])]) << i;
+                }
+        }
+        MDArray<int, D1> small(D1(3), 0);
+        small[0] = 2;
+        MDArray<double, D1> z = expr::take(x, small);
+        ASSERT_EQ(z[0], 1.);
+        ASSERT_EQ(z[1], 0.);
+        ASSERT_EQ(expr::take(x, small)[0], 1.);
+}
+
+TEST(Take, Rows)
+{
+        // Embedding lookup, and a take along the other axes of a 3D array
+        const std::size_t n = 2000, dim = 100;
+        MDArray<float, D2> table(D2(n, dim), 0.f);
+        for(std::size_t i = 0; i < n; i++){
+                for(std::size_t j = 0; j < dim; j++){
+                        table[i, j] = static_cast<float>(i) + 0.001f*static_cast<float>(j);
+                }
+        }
+        const auto ids = random_indices(5003, n, 2);
+        MDArray<float, D2> rows = expr::take(table, ids);
+        ASSERT_EQ(rows.extent(0), 5003);
+        ASSERT_EQ(rows.extent(1), dim);
+        for(std::size_t i = 0; i < ids.extent(0); i++){
+                for(std::size_t j = 0; j < dim; j++){
+                        ASSERT_EQ((rows[i, j]), (table[static_cast<std::size_t>(ids[i]), j]));
+                }
+        }
+
+        MDArray<double, D3> a(D3(5, 7, 9), 0.);
+        for(std::size_t i = 0; i < 5; i++){
+                for(std::size_t j = 0; j < 7; j++){
+                        for(std::size_t k = 0; k < 9; k++){
+                                a[i, j, k] = v3(i, j, k);
+                        }
+                }
+        }
+        MDArray<std::size_t, D1> sel(D1(4), 0);
+        sel[0] = 4;
+        sel[1] = 1;
+        sel[2] = 4;
+        for(std::size_t axis = 0; axis < 3; axis++){
+                MDArray<double, D3> t = expr::take(a, sel, axis);
+                for(std::size_t i = 0; i < t.extent(0); i++){
+                        for(std::size_t j = 0; j < t.extent(1); j++){
+                                for(std::size_t k = 0; k < t.extent(2); k++){
+                                        std::size_t q[] = {i, j, k};
+                                        q[axis] = sel[q[axis]];
+                                        ASSERT_EQ((t[i, j, k]), (a[q[0], q[1], q[2]]));
+                                }
+                        }
+                }
+        }
+}
+
+TEST(Take, Expressions)
+{
+        // Takes of a temporary, in an expression, into a column major array
+        MDArray<double, D2> a(D2(50, 30), 0.);
+        for(std::size_t i = 0; i < 50; i++){
+                for(std::size_t j = 0; j < 30; j++){
+                        a[i, j] = v3(0, i, j);
+                }
+        }
+        const auto idx = random_indices(40, 50, 3);
+        MDArray<double, D2> scaled = 2.*expr::take(a, idx) + expr::take(2.*a, idx);
+        MDArray<double, D2, stdex::layout_left> left = expr::take(a, idx);
+        auto cols = expr::take(expr::transpose(a), idx, 1);
+        for(std::size_t i = 0; i < 40; i++){
+                for(std::size_t j = 0; j < 30; j++){
+                        const double ref = a[static_cast<std::size_t>(idx[i]), j];
+                        ASSERT_EQ((scaled[i, j]), 4.*ref);
+                        ASSERT_EQ((left[i, j]), ref);
+                        ASSERT_EQ((cols[j, i]), ref);
+                }
+        }
+        ASSERT_DOUBLE_EQ(expr::sum(expr::take(a, idx)), expr::sum(left));
+}
+
+TEST(Take, Errors)
+{
+        MDArray<double, D2> a(D2(4, 3), 0.);
+        MDArray<int, D1> idx(D1(2), 0);
+        ASSERT_THROW(expr::take(a, idx, 2), std::runtime_error);
+        idx[1] = 3;
+        ASSERT_THROW(expr::take(a, idx, 1), std::runtime_error);
+        idx[1] = -1;
+        ASSERT_THROW(expr::take(a, idx), std::runtime_error);
+}
@@ -43,3 +43,151 @@ TEST(Transpose, TransposeMatrix)
                 }
         }
 }
+TEST(Transpose, ReverseTranspose)
+{
+        using E = stdex::extents<size_t, 2, std::dynamic_extent, 4>;
+        MDArray<int, E> m(E(3), 0);
+        for(size_t i = 0; i < 2; i++){
+                for(size_t j = 0; j < 3; j++){
+                        for(size_t k = 0; k < 4; k++){
+                                m[i, j, k] = static_cast<int>(100*i + 10*j + k);
+                        }
+                }
+        }
+        auto m_t = expr::transpose(m);
+        static_assert(decltype(m_t.extents())::static_extent(0) == 4);
+        static_assert(decltype(m_t.extents())::static_extent(2) == 2);
+        ASSERT_EQ(m_t.extent(1), 3);
+        MDArray<int, stdex::dextents<size_t, 3>> res = m_t;
+        for(size_t i = 0; i < 2; i++){
+                for(size_t j = 0; j < 3; j++){
+                        for(size_t k = 0; k < 4; k++){
+                                ASSERT_EQ((res[k, j, i]), (m[i, j, k]));
+                        }
+                }
+        }
+}
+TEST(Transpose, Permute3)
+{
+        MDArray<int, stdex::dextents<size_t, 3>> m(stdex::dextents<size_t, 3>(2, 3, 4), 0);
+        m[1, 2, 3] = 7;
+        auto m_t = expr::transpose(m, std::index_sequence<2, 0, 1>{});
+        ASSERT_EQ(m_t.extent(0), 4);
+        ASSERT_EQ(m_t.extent(1), 2);
+        ASSERT_EQ(m_t.extent(2), 3);
+        ASSERT_EQ((m_t[3, 1, 2]), 7);
+        ASSERT_EQ(expr::sum(m_t), 7);
+}
+TEST(Transpose, MixedOrderLayouts)
+{
+        using D2 = stdex::dextents<size_t, 2>;
+        using D3 = stdex::dextents<size_t, 3>;
+        using A2 = MDArray<int, D2>;
+        using A3 = MDArray<int, D3>;
+        static_assert(std::is_same_v<exts::layout_of_t<decltype(std::declval<A2&>() + expr::transpose(std::declval<A2&>()))>, exts::layout_tiled<0>>);
+        static_assert(std::is_same_v<exts::layout_of_t<decltype(expr::transpose(std::declval<A3&>(), std::index_sequence<0, 2, 1>{}))>, exts::layout_tiled<1>>);
+        static_assert(std::is_same_v<exts::layout_of_t<decltype(expr::transpose(std::declval<A3&>(), std::index_sequence<1, 0, 2>{}))>, stdex::layout_right>);
+        static_assert(std::is_same_v<exts::common_layout_t<A3, MDArray<int, D3, stdex::layout_left>>, exts::layout_tiled<0>>);
+}
+TEST(Transpose, TiledTraversal)
+{
+        using D3 = stdex::dextents<size_t, 3>;
+        const D3 ext(45, 3, 70);
+        std::vector<int> visits(45*3*70, 0);
+        exts::for_each_index_tiled<0>(ext, [&](size_t i, size_t j, size_t k){
+                visits[(i*3 + j)*70 + k]++;
+        });
+        for(int v : visits){
+                ASSERT_EQ(v, 1);
+        }
+}
+TEST(Transpose, AddTransposed)
+{
+        using D2 = stdex::dextents<size_t, 2>;
+        MDArray<int, D2> a(D2(70, 45), 0), b(D2(45, 70), 0);
+        for(size_t i = 0; i < 70; i++){
+                for(size_t j = 0; j < 45; j++){
+                        a[i, j] = static_cast<int>(i + 100*j);
+                        b[j, i] = static_cast<int>(3*i + 7*j);
+                }
+        }
+        MDArray<int, D2> sum = a + expr::transpose(b);
+        MDArray<int, D2> prod = a*expr::transpose(b);
+        MDArray<int, D2> b_t = expr::transpose(b);
+        for(size_t i = 0; i < 70; i++){
+                for(size_t j = 0; j < 45; j++){
+                        ASSERT_EQ((sum[i, j]), (a[i, j] + b[j, i]));
+                        ASSERT_EQ((prod[i, j]), (a[i, j]*b[j, i]));
+                        ASSERT_EQ((b_t[i, j]), (b[j, i]));
+                }
+        }
+        ASSERT_EQ(expr::sum(a + expr::transpose(b)), expr::sum(a) + expr::sum(b));
+
+        using D3 = stdex::dextents<size_t, 3>;
+        MDArray<int, D3> c(D3(2, 40, 35), 0);
+        for(size_t n = 0; n < 2; n++){
+                for(size_t i = 0; i < 40; i++){
+                        for(size_t j = 0; j < 35; j++){
+                                c[n, i, j] = static_cast<int>(n + 2*i + 5*j);
+                        }
+                }
+        }
+        MDArray<int, D3> c_t = expr::transpose(c, std::index_sequence<0, 2, 1>{});
+        for(size_t n = 0; n < 2; n++){
+                for(size_t i = 0; i < 40; i++){
+                        for(size_t j = 0; j < 35; j++){
+                                ASSERT_EQ((c_t[n, j, i]), (c[n, i, j]));
+                        }
+                }
+        }
+}
+TEST(Transpose, Simplify)
+{
+        using D2 = stdex::dextents<size_t, 2>;
+        using D3 = stdex::dextents<size_t, 3>;
+        MDArray<int, D3> a(D3(2, 3, 4), 0);
+        for(size_t n = 0; n < 24; n++){
+                a.flat(n) = static_cast<int>(n);
+        }
+        // Transposing an lvalue back results in a view with the identity order
+        auto back = expr::transpose(expr::transpose(a));
+        static_assert(decltype(back)::order == std::array<size_t, 3>{0, 1, 2});
+        static_assert(std::is_same_v<decltype(expr::transpose(expr::transpose(a, std::index_sequence<1, 2, 0>{}), std::index_sequence<2, 0, 1>{})), decltype(back)>);
+        static_assert(std::is_same_v<exts::layout_of_t<decltype(back)>, stdex::layout_right>);
+        a[1, 2, 3] = -1;
+        ASSERT_EQ((back[1, 2, 3]), -1);
+        ASSERT_EQ(back.flat(23), -1);
+        a[1, 2, 3] = 23;
+        // and a temporary back in the temporary itself
+        static_assert(std::is_same_v<decltype(expr::transpose(expr::transpose(a + a))), decltype(a + a)>);
+        // Other permutations are composed
+        auto t = expr::transpose(expr::transpose(a, std::index_sequence<1, 0, 2>{}), std::index_sequence<0, 2, 1>{});
+        static_assert(decltype(t)::order == std::array<size_t, 3>{1, 2, 0});
+        for(size_t i = 0; i < 3; i++){
+                for(size_t j = 0; j < 4; j++){
+                        for(size_t k = 0; k < 2; k++){
+                                ASSERT_EQ((t[i, j, k]), (a[k, i, j]));
+                        }
+                }
+        }
+
+        // A transposed sum of row and column major arrays is the sum of the transposes
+        MDArray<int, D2> r(D2(30, 40), 0);
+        MDArray<int, D2, stdex::layout_left> l(D2(30, 40), 0);
+        for(size_t i = 0; i < 30; i++){
+                for(size_t j = 0; j < 40; j++){
+                        r[i, j] = static_cast<int>(i + 100*j);
+                        l[i, j] = static_cast<int>(3*i - j);
+                }
+        }
+        auto sum_t = expr::transpose(r + l);
+        static_assert(std::is_same_v<exts::layout_of_t<decltype(sum_t)>, exts::layout_tiled<0>>);
+        MDArray<int, D2> res = expr::transpose(r + l);
+        for(size_t i = 0; i < 30; i++){
+                for(size_t j = 0; j < 40; j++){
+                        ASSERT_EQ((res[j, i]), (r[i, j] + l[i, j]));
+                }
+        }
+        // A transposed sum of row major arrays stays row major when transposed, and is not rewritten
+        static_assert(expr::detail::is_transpose<decltype(expr::transpose(r + r))>::value);
+}